@@ -176,6 +176,19 @@ ece391_vidmap (uint8_t** screen_start)
     return 0;
 }
 
+/* No back buffer here, fish falls back to vidmap */
+int32_t 
+ece391_vidmap_buffered (uint8_t** screen_start)
+{
+    return -1;
+}
+
+int32_t 
+ece391_present (int32_t rtc_fd)
+{
+    return -1;
+}
+
 int32_t 
 ece391_read (int32_t fd, void* buf, int32_t nbytes)
 {
@@ -20,5 +20,12 @@ extern int32_t ece391_close (int32_t fd);
 extern int32_t ece391_getargs (uint8_t* buf, int32_t nbytes);
 extern int32_t ece391_vidmap (uint8_t** screen_start);
 
+/*
+ * vidmap_buffered maps a back buffer of the screen instead, which present
+ * copies out (the rows that changed) after waiting for the rtc fd's tick.
+ */
+extern int32_t ece391_vidmap_buffered (uint8_t** screen_start);
+extern int32_t ece391_present (int32_t rtc_fd);
+
 #endif /* ECE391SYSCALL_H */
 
@@ -11,5 +11,7 @@
 #define SYS_VIDMAP  8
 #define SYS_SET_HANDLER  9
 #define SYS_SIGRETURN  10
+#define SYS_VIDMAP_BUFFERED 25
+#define SYS_PRESENT 26
 
 #endif /* ECE391SYSNUM_H */
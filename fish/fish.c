@@ -6,7 +6,9 @@
 #define NULL 0
 #define WAIT 100
 uint8_t *vmem_base_addr;
+int32_t vmem_buffered = 0;
 uint8_t *mp1_set_video_mode (void);
+void mp1_next_frame(int32_t rtc_fd);
 void add_frames(uint8_t *, uint8_t *, int32_t);
 void ece391_memset(void* memory, char c, int n);
 int32_t ece391_memcpy(void* dest, const void* src, int32_t n);
@@ -22,7 +24,7 @@ static struct mp1_blink_struct blink_array[80*25];
 
 int main(void)
 {
-    int rtc_fd, ret_val, i, garbage;
+    int rtc_fd, ret_val, i;
     struct mp1_blink_struct blink_struct;
 
     ece391_memset(blink_array, 0, sizeof(struct mp1_blink_struct)*80*25);
@@ -39,8 +41,7 @@ int main(void)
     ret_val = ece391_write(rtc_fd, &ret_val, 4);
 
     for(i=0; i<WAIT; i++) {
-        ece391_read(rtc_fd, &garbage, 4);
-        mp1_rtc_tasklet(garbage);
+        mp1_next_frame(rtc_fd);
     }
 
     blink_struct.on_char = 'I';
@@ -52,22 +53,19 @@ int main(void)
     mp1_ioctl((unsigned long)&blink_struct, RTC_ADD);
 
     for(i=0; i<WAIT; i++) {
-        ece391_read(rtc_fd, &garbage, 4);
-        mp1_rtc_tasklet(garbage);
+        mp1_next_frame(rtc_fd);
     }
 
     mp1_ioctl((40 << 16 | (6*80+60)), RTC_SYNC);
 
     for(i=0; i<WAIT; i++) {
-        ece391_read(rtc_fd, &garbage, 4);
-        mp1_rtc_tasklet(garbage);
+        mp1_next_frame(rtc_fd);
     }
 
     mp1_ioctl(6*80+60, RTC_REMOVE);
 
     for(i=0; i<WAIT; i++) {
-        ece391_read(rtc_fd, &garbage, 4);
-        mp1_rtc_tasklet(garbage);
+        mp1_next_frame(rtc_fd);
     }
 
     ece391_close(rtc_fd);
@@ -147,9 +145,14 @@ add_frames(uint8_t *f0, uint8_t *f1, int32_t rtc_fd)
     }
 }
 
+/* Draws into a back buffer when the kernel has one, so a frame shows all at once */
 uint8_t*
 mp1_set_video_mode (void)
 {
+    if(ece391_vidmap_buffered(&vmem_base_addr) == 0) {
+        vmem_buffered = 1;
+        return vmem_base_addr;
+    }
     if(ece391_vidmap(&vmem_base_addr) == -1) {
         return NULL;
     } else {
@@ -157,6 +160,21 @@ mp1_set_video_mode (void)
     }
 }
 
+/* Runs the tasklet once per RTC tick, presenting what it drew when buffered */
+void
+mp1_next_frame(int32_t rtc_fd)
+{
+    int garbage = 0;
+
+    if(vmem_buffered) {
+        mp1_rtc_tasklet(garbage);
+        ece391_present(rtc_fd);
+    } else {
+        ece391_read(rtc_fd, &garbage, 4);
+        mp1_rtc_tasklet(garbage);
+    }
+}
+
 void* mp1_malloc(int32_t size)
 {
     int32_t i;
@@ -8,13 +8,9 @@
 #define VIDEO_MEM 0xB8000
 // 0xB8
 #define VIDEO_MEM_INDEX (VIDEO_MEM >> 12)
-#define VIDEO_PERM_MEM_ADDR (VIDEO_MEM - PAGE_SIZE_4KB)
-// 0xB9
-#define VIDEO_PERM_MEM_INDEX ((VIDEO_MEM - PAGE_SIZE_4KB) >> 12)
-// 3 terminals max!
-#define VIDEO_MEM_BACKGROUND_START_ADDR (VIDEO_MEM + PAGE_SIZE_4KB)
-#define VIDEO_MEM_BACKGROUND_START_INDEX (VIDEO_MEM_BACKGROUND_START_ADDR >> 12)
-#define VIDEO_MEM_BACKGROUND_END_INDEX (VIDEO_MEM_BACKGROUND_START_INDEX + 2)
+// VGA text memory runs 32KB from VIDEO_MEM, the displayed terminal's scrollback ring fills it
+#define VGA_TEXT_MEM_SIZE 0x8000
+#define VGA_TEXT_END_INDEX (VIDEO_MEM_INDEX + VGA_TEXT_MEM_SIZE / PAGE_SIZE_4KB)
 
 #define PROGRAM_IMAGE_OFFSET 0x00048000
 #define PROGRAM_IMAGE_VIRTUAL_BASE_ADDR 0x08000000
@@ -26,6 +22,24 @@
 #define PROGRAM_VIDEO_VIRTUAL_ADDR (PROGRAM_IMAGE_VIRTUAL_BASE_ADDR + PAGE_SIZE_4MB + VIDEO_MEM)
 // index 33, right after the program image
 #define PROGRAM_VIDEO_PD_IDX (PROGRAM_VIDEO_VIRTUAL_ADDR >> 22)
+// Where vidmap puts the framebuffer in graphics mode, the rest of the vidmap table past the text page
+#define PROGRAM_FB_VIRTUAL_ADDR (PROGRAM_IMAGE_VIRTUAL_BASE_ADDR + PAGE_SIZE_4MB + 0x100000)
+#define PROGRAM_FB_INDEX ((PROGRAM_FB_VIRTUAL_ADDR & (PAGE_SIZE_4MB - 1)) / PAGE_SIZE_4KB)
+#define PROGRAM_FB_MAX_SIZE (PAGE_SIZE_4MB - 0x100000)
+// index 34, right after the vidmap table
+#define SHM_VIRTUAL_ADDR (PROGRAM_IMAGE_VIRTUAL_BASE_ADDR + 2 * PAGE_SIZE_4MB)
+#define SHM_PD_IDX (SHM_VIRTUAL_ADDR >> 22)
+
+// 72 MB, past the program images of all 16 pids. One 4MB page of 4KB frames handed out at runtime
+#define FRAME_POOL_PHYSICAL_ADDR 0x4800000
+#define FRAME_POOL_PD_IDX (FRAME_POOL_PHYSICAL_ADDR >> 22)
+#define FRAME_POOL_COUNT TABLE_SIZE
+
+// Local APIC and IOAPIC registers live in the top 20 MB of the address space and are identity mapped
+#define APIC_MMIO_PHYSICAL_ADDR 0xFEC00000
+// 2 consecutive 4MB pages the kernel reaches firmware tables and low memory through, so a table never gets cut off
+#define PHYS_WINDOW_VIRTUAL_ADDR 0xFF400000
+#define PHYS_WINDOW_PD_IDX (PHYS_WINDOW_VIRTUAL_ADDR >> 22)
 
 #define KERNEL_STACK_ADDR 0x800000
 #define USER_KERNEL_STACK_SIZE 0x2000
@@ -0,0 +1,425 @@
+/* apic.c - Functions to interact with the local APIC and the IOAPIC
+ * vim:ts=4 noexpandtab
+ */
+
+#include "apic.h"
+#include "lib.h"
+#include "paging.h"
+#include "devices/tsc.h"
+
+/* Whether interrupts go through the APIC instead of the 8259, and whether its timer drives scheduling */
+uint8_t apic_enabled = 0;
+uint8_t apic_timer_enabled = 0;
+
+// Local APIC IDs of the processors the MADT lists as usable, the boot processor included
+uint32_t apic_cpu_ids[MAX_CPUS];
+uint32_t apic_num_cpus = 0;
+
+// Register bases, identity mapped
+static volatile uint32_t* lapic = NULL;
+static volatile uint32_t* ioapic = NULL;
+static uint32_t ioapic_gsi_base = 0;
+static uint32_t ioapic_max_entry = 0;
+// Initial count of the local timer for the scheduler tick, the same on every processor
+static uint32_t apic_timer_count = 0;
+
+// Global system interrupt and MPS INTI flags of each ISA IRQ, from the MADT's source overrides
+static uint32_t isa_gsi[NUM_ISA_IRQS];
+static uint16_t isa_flags[NUM_ISA_IRQS];
+
+/*
+ * lapic_read / lapic_write
+ *   DESCRIPTION: Access a local APIC register
+ *   INPUTS: reg -- byte offset of the register (LAPIC_*)
+ *           val -- new value
+ *   OUTPUTS: none
+ *   RETURN VALUE: value of the register (lapic_read)
+ *   SIDE EFFECTS: none
+ */
+static inline uint32_t lapic_read(uint32_t reg) {
+    return lapic[reg / sizeof(uint32_t)];
+}
+
+static inline void lapic_write(uint32_t reg, uint32_t val) {
+    lapic[reg / sizeof(uint32_t)] = val;
+}
+
+/*
+ * ioapic_read / ioapic_write
+ *   DESCRIPTION: Access an IOAPIC register through the select/window pair. Must be called with interrupts disabled.
+ *   INPUTS: reg -- register number (IOAPIC_VER, IOAPIC_REDTBL + ...)
+ *           val -- new value
+ *   OUTPUTS: none
+ *   RETURN VALUE: value of the register (ioapic_read)
+ *   SIDE EFFECTS: none
+ */
+static inline uint32_t ioapic_read(uint32_t reg) {
+    ioapic[IOAPIC_REGSEL / sizeof(uint32_t)] = reg;
+    return ioapic[IOAPIC_WIN / sizeof(uint32_t)];
+}
+
+static inline void ioapic_write(uint32_t reg, uint32_t val) {
+    ioapic[IOAPIC_REGSEL / sizeof(uint32_t)] = reg;
+    ioapic[IOAPIC_WIN / sizeof(uint32_t)] = val;
+}
+
+/*
+ * acpi_checksum_ok
+ *   DESCRIPTION: Checks that the bytes of an ACPI structure sum to 0
+ *   INPUTS: table -- the structure
+ *           length -- its length in bytes
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if the checksum matches, 0 otherwise
+ *   SIDE EFFECTS: none
+ */
+static int32_t acpi_checksum_ok(const uint8_t* table, uint32_t length) {
+    uint8_t sum = 0;
+    uint32_t i;
+    for (i = 0; i < length; i++) {
+        sum += table[i];
+    }
+    return sum == 0;
+}
+
+/*
+ * acpi_scan_rsdp
+ *   DESCRIPTION: Looks for the RSDP on the 16 byte boundaries of a low memory range
+ *   INPUTS: start, end -- physical range to scan
+ *   OUTPUTS: none
+ *   RETURN VALUE: physical address of the RSDT, 0 if there is no RSDP
+ *   SIDE EFFECTS: maps the physical window
+ */
+static uint32_t acpi_scan_rsdp(uint32_t start, uint32_t end) {
+    uint8_t* low_mem = (uint8_t*) map_phys_window(0);
+    acpi_rsdp_t* rsdp;
+    uint32_t addr;
+    for (addr = start; addr + sizeof(acpi_rsdp_t) <= end; addr += ACPI_RSDP_ALIGN) {
+        rsdp = (acpi_rsdp_t*) (low_mem + addr);
+        if (strncmp(rsdp->signature, ACPI_RSDP_SIGNATURE, sizeof(rsdp->signature)) == 0
+            && acpi_checksum_ok((uint8_t*) rsdp, sizeof(acpi_rsdp_t))) {
+            return rsdp->rsdt_addr;
+        }
+    }
+    return 0;
+}
+
+/*
+ * acpi_find_madt
+ *   DESCRIPTION: Finds the MADT through the RSDP (in the EBDA or the BIOS ROM) and the RSDT
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: physical address of the MADT, 0 if there is none
+ *   SIDE EFFECTS: maps the physical window
+ */
+static uint32_t acpi_find_madt() {
+    uint32_t ebda, rsdt_addr, entry_addr, count, i;
+    acpi_header_t* header;
+
+    ebda = *((uint16_t*) ((uint8_t*) map_phys_window(0) + BDA_EBDA_SEGMENT)) << 4;
+    rsdt_addr = acpi_scan_rsdp(ebda, ebda + EBDA_SCAN_SIZE);
+    if (rsdt_addr == 0) {
+        rsdt_addr = acpi_scan_rsdp(BIOS_ROM_START, BIOS_ROM_END);
+    }
+    if (rsdt_addr == 0) return 0;
+
+    header = (acpi_header_t*) map_phys_window(rsdt_addr);
+    if (!acpi_checksum_ok((uint8_t*) header, header->length)) return 0;
+    count = (header->length - sizeof(acpi_header_t)) / sizeof(uint32_t);
+
+    // Each table can sit in a different 4MB page, so the RSDT is remapped before reading every entry
+    for (i = 0; i < count; i++) {
+        entry_addr = *((uint32_t*) map_phys_window(rsdt_addr + sizeof(acpi_header_t) + i * sizeof(uint32_t)));
+        header = (acpi_header_t*) map_phys_window(entry_addr);
+        if (strncmp(header->signature, ACPI_MADT_SIGNATURE, sizeof(header->signature)) == 0) {
+            return acpi_checksum_ok((uint8_t*) header, header->length) ? entry_addr : 0;
+        }
+    }
+    return 0;
+}
+
+/*
+ * madt_parse
+ *   DESCRIPTION: Reads the local APIC and first IOAPIC addresses, the processors and the ISA IRQ
+ *                overrides out of the MADT
+ *   INPUTS: none
+ *   OUTPUTS: lapic_addr, ioapic_addr -- physical register bases
+ *   RETURN VALUE: 0 on success, -1 if there is no MADT or no IOAPIC
+ *   SIDE EFFECTS: fills in isa_gsi, isa_flags, ioapic_gsi_base and apic_cpu_ids
+ */
+static int32_t madt_parse(uint32_t* lapic_addr, uint32_t* ioapic_addr) {
+    uint32_t madt_addr = acpi_find_madt();
+    acpi_madt_t* madt;
+    madt_entry_t* entry;
+    uint8_t* end;
+    int32_t i;
+
+    if (madt_addr == 0) return -1;
+    madt = (acpi_madt_t*) map_phys_window(madt_addr);
+    *lapic_addr = madt->lapic_addr;
+    *ioapic_addr = 0;
+
+    // ISA IRQs are identity mapped, edge triggered and active high unless overridden
+    for (i = 0; i < NUM_ISA_IRQS; i++) {
+        isa_gsi[i] = i;
+        isa_flags[i] = 0;
+    }
+
+    end = (uint8_t*) madt + madt->header.length;
+    for (entry = (madt_entry_t*) (madt + 1); (uint8_t*) entry < end && entry->length > 0;
+         entry = (madt_entry_t*) ((uint8_t*) entry + entry->length)) {
+        switch (entry->type) {
+            case MADT_LAPIC:
+                if ((entry->lapic.flags & MADT_LAPIC_ENABLED) && apic_num_cpus < MAX_CPUS) {
+                    apic_cpu_ids[apic_num_cpus++] = entry->lapic.apic_id;
+                }
+                break;
+            case MADT_IOAPIC:
+                // Only the first IOAPIC is used, it's the one with the ISA IRQs on every PC
+                if (*ioapic_addr == 0) {
+                    *ioapic_addr = entry->ioapic.addr;
+                    ioapic_gsi_base = entry->ioapic.gsi_base;
+                }
+                break;
+            case MADT_OVERRIDE:
+                if (entry->override.source < NUM_ISA_IRQS) {
+                    isa_gsi[entry->override.source] = entry->override.gsi;
+                    isa_flags[entry->override.source] = entry->override.flags;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    return *ioapic_addr == 0 ? -1 : 0;
+}
+
+/*
+ * ioapic_route
+ *   DESCRIPTION: Points the IOAPIC pin of an ISA IRQ at the IRQ's usual vector on the boot CPU
+ *   INPUTS: irq_num -- ISA IRQ
+ *           masked -- whether the pin should start out masked
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void ioapic_route(uint32_t irq_num, uint32_t masked) {
+    uint32_t pin = isa_gsi[irq_num] - ioapic_gsi_base;
+    uint32_t low = ICW2_MASTER + irq_num;
+    if (pin > ioapic_max_entry) return;
+    if ((isa_flags[irq_num] & MADT_POLARITY_MASK) == MADT_POLARITY_LOW) {
+        low |= IOAPIC_ACTIVE_LOW;
+    }
+    if (((isa_flags[irq_num] >> MADT_TRIGGER_SHIFT) & MADT_TRIGGER_MASK) == MADT_TRIGGER_LEVEL) {
+        low |= IOAPIC_LEVEL;
+    }
+    if (masked) {
+        low |= IOAPIC_MASKED;
+    }
+    ioapic_write(IOAPIC_REDTBL + 2 * pin + 1, (lapic_read(LAPIC_ID) >> LAPIC_ID_SHIFT) << IOAPIC_DEST_SHIFT);
+    ioapic_write(IOAPIC_REDTBL + 2 * pin, low);
+}
+
+/*
+ * apic_init
+ *   DESCRIPTION: Switches interrupt delivery from the 8259 to the local APIC and IOAPIC if the CPU
+ *                has one (CPUID) and the firmware describes it (ACPI MADT). IRQs already enabled on
+ *                the 8259 stay enabled. Must be called with paging on and interrupts disabled.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: the 8259 is left fully masked when the APIC takes over
+ */
+void apic_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+    uint32_t lapic_addr, ioapic_addr, pin;
+    uint16_t enabled_irqs;
+    int32_t i;
+
+    cpuid(CPUID_FEATURES, &eax, &ebx, &ecx, &edx);
+    if (!(edx & CPUID_EDX_APIC) || madt_parse(&lapic_addr, &ioapic_addr) != 0) {
+        printf("No APIC, using the 8259\n");
+        return;
+    }
+
+    map_mmio(lapic_addr);
+    map_mmio(ioapic_addr);
+    lapic = (volatile uint32_t*) lapic_addr;
+    ioapic = (volatile uint32_t*) ioapic_addr;
+
+    apic_local_init();
+
+    // Start with every pin masked, then take over what the 8259 had enabled
+    ioapic_max_entry = (ioapic_read(IOAPIC_VER) >> IOAPIC_MAX_ENTRY_SHIFT) & 0xFF;
+    for (pin = 0; pin <= ioapic_max_entry; pin++) {
+        ioapic_write(IOAPIC_REDTBL + 2 * pin, IOAPIC_MASKED);
+    }
+    enabled_irqs = i8259_handover();
+    apic_enabled = 1;
+    for (i = 0; i < NUM_ISA_IRQS; i++) {
+        ioapic_route(i, !(enabled_irqs & (1 << i)));
+    }
+}
+
+/*
+ * apic_local_init
+ *   DESCRIPTION: Enables the local APIC of the calling processor and lets every priority through
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void apic_local_init(void) {
+    wrmsr(IA32_APIC_BASE_MSR, rdmsr(IA32_APIC_BASE_MSR) | IA32_APIC_BASE_ENABLE);
+    lapic_write(LAPIC_TPR, 0);
+    lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | APIC_SPURIOUS_VECTOR);
+}
+
+/*
+ * apic_id
+ *   DESCRIPTION: Gets the local APIC ID of the calling processor
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: the ID, 0 if the APIC isn't in use
+ *   SIDE EFFECTS: none
+ */
+uint32_t apic_id(void) {
+    if (!apic_enabled) return 0;
+    return lapic_read(LAPIC_ID) >> LAPIC_ID_SHIFT;
+}
+
+/*
+ * apic_timer_init
+ *   DESCRIPTION: Measures the local APIC timer against the TSC and starts it periodically on
+ *                APIC_TIMER_VECTOR. Must be called with interrupts disabled.
+ *   INPUTS: hz -- interrupt rate
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if there is no APIC or no calibrated TSC to measure it with
+ *   SIDE EFFECTS: busy waits for APIC_CALIBRATE_MS ms
+ */
+int32_t apic_timer_init(uint32_t hz) {
+    uint64_t start, wait;
+    uint32_t count;
+
+    if (!apic_enabled || tsc_khz == 0) return -1;
+
+    // Count down from the top for a known number of TSC cycles
+    lapic_write(LAPIC_TIMER_DIV, LAPIC_TIMER_DIV_16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED | APIC_TIMER_VECTOR);
+    lapic_write(LAPIC_TIMER_INIT, 0xFFFFFFFF);
+    wait = (uint64_t) tsc_khz * APIC_CALIBRATE_MS;
+    start = now_cycles();
+    while (now_cycles() - start < wait);
+    count = 0xFFFFFFFF - lapic_read(LAPIC_TIMER_CURRENT);
+    lapic_write(LAPIC_TIMER_INIT, 0);
+    if (count == 0) return -1;
+
+    apic_timer_count = count * (1000 / APIC_CALIBRATE_MS) / hz;
+    apic_timer_enabled = 1;
+    apic_timer_start();
+    return 0;
+}
+
+/*
+ * apic_timer_start
+ *   DESCRIPTION: Starts the calling processor's local timer at the rate apic_timer_init measured.
+ *                The timers of all processors run off the same bus clock.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void apic_timer_start(void) {
+    lapic_write(LAPIC_TIMER_DIV, LAPIC_TIMER_DIV_16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_PERIODIC | APIC_TIMER_VECTOR);
+    lapic_write(LAPIC_TIMER_INIT, apic_timer_count);
+}
+
+/*
+ * apic_send_ipi
+ *   DESCRIPTION: Sends an interprocessor interrupt and waits until the local APIC has sent it
+ *   INPUTS: dest_apic_id -- local APIC ID of the target processor
+ *           icr -- low half of the interrupt command (vector and LAPIC_ICR_* flags)
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void apic_send_ipi(uint32_t dest_apic_id, uint32_t icr) {
+    lapic_write(LAPIC_ICR_HIGH, dest_apic_id << LAPIC_ICR_DEST_SHIFT);
+    lapic_write(LAPIC_ICR_LOW, icr);
+    while (lapic_read(LAPIC_ICR_LOW) & LAPIC_ICR_PENDING) {
+        asm volatile ("pause");
+    }
+}
+
+/*
+ * apic_spurious_handler
+ *   DESCRIPTION: Handles a spurious interrupt from the local APIC. These don't get an EOI.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void apic_spurious_handler(void) {
+}
+
+/*
+ * apic_enable_irq
+ *   DESCRIPTION: Unmask the IOAPIC pin of an ISA IRQ
+ *   INPUTS: irq_num -- number of the IRQ to be enabled
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void apic_enable_irq(uint32_t irq_num) {
+    uint32_t flags;
+    if (irq_num >= NUM_ISA_IRQS) return;
+    cli_and_save(flags);
+    ioapic_route(irq_num, 0);
+    restore_flags(flags);
+}
+
+/*
+ * apic_disable_irq
+ *   DESCRIPTION: Mask the IOAPIC pin of an ISA IRQ
+ *   INPUTS: irq_num -- number of the IRQ to be disabled
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void apic_disable_irq(uint32_t irq_num) {
+    uint32_t flags;
+    if (irq_num >= NUM_ISA_IRQS) return;
+    cli_and_save(flags);
+    ioapic_route(irq_num, 1);
+    restore_flags(flags);
+}
+
+/*
+ * apic_send_eoi
+ *   DESCRIPTION: Signal the end of the interrupt being handled. A single register write, the
+ *                local APIC knows which vector it was.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void apic_send_eoi(void) {
+    lapic_write(LAPIC_EOI, 0);
+}
+
+/*
+ * ioapic_redirection
+ *   DESCRIPTION: Reads the low half of the redirection entry of an ISA IRQ
+ *   INPUTS: irq_num -- ISA IRQ
+ *   OUTPUTS: none
+ *   RETURN VALUE: vector and IOAPIC_* flags, IOAPIC_MASKED if the APIC isn't in use
+ *   SIDE EFFECTS: none
+ */
+uint32_t ioapic_redirection(uint32_t irq_num) {
+    uint32_t flags, low;
+    if (!apic_enabled || irq_num >= NUM_ISA_IRQS) return IOAPIC_MASKED;
+    cli_and_save(flags);
+    low = ioapic_read(IOAPIC_REDTBL + 2 * (isa_gsi[irq_num] - ioapic_gsi_base));
+    restore_flags(flags);
+    return low;
+}
@@ -0,0 +1,160 @@
+/* apic.h - Defines used in interactions with the local APIC and the IOAPIC
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _APIC_H
+#define _APIC_H
+
+#include "types.h"
+#include "i8259.h"
+#include "devices/pit.h"
+#include "smp.h"
+
+// CPUID leaf 1, EDX bit 9: the processor has a local APIC
+#define CPUID_FEATURES 1
+#define CPUID_EDX_APIC 0x200
+
+// Model specific register holding the local APIC base, bit 11 enables the APIC
+#define IA32_APIC_BASE_MSR 0x1B
+#define IA32_APIC_BASE_ENABLE 0x800
+
+/* Local APIC registers, byte offsets from the base */
+#define LAPIC_ID            0x020
+#define LAPIC_TPR           0x080
+#define LAPIC_EOI           0x0B0
+#define LAPIC_SVR           0x0F0
+#define LAPIC_ICR_LOW       0x300
+#define LAPIC_ICR_HIGH      0x310
+#define LAPIC_LVT_TIMER     0x320
+#define LAPIC_TIMER_INIT    0x380
+#define LAPIC_TIMER_CURRENT 0x390
+#define LAPIC_TIMER_DIV     0x3E0
+
+#define LAPIC_ID_SHIFT 24
+#define LAPIC_SVR_ENABLE 0x100
+#define LAPIC_LVT_MASKED 0x10000
+#define LAPIC_LVT_PERIODIC 0x20000
+// Interrupt command register: delivery mode, level and status bits, and where the destination goes
+#define LAPIC_ICR_INIT 0x500
+#define LAPIC_ICR_STARTUP 0x600
+#define LAPIC_ICR_PENDING 0x1000
+#define LAPIC_ICR_ASSERT 0x4000
+#define LAPIC_ICR_DEST_SHIFT 24
+// Divide configuration 0b0011: the timer counts at the bus clock / 16
+#define LAPIC_TIMER_DIV_16 0x3
+
+/* IOAPIC registers, written through a select/window pair */
+#define IOAPIC_REGSEL 0x00
+#define IOAPIC_WIN    0x10
+#define IOAPIC_VER    0x01
+#define IOAPIC_REDTBL 0x10
+#define IOAPIC_MAX_ENTRY_SHIFT 16
+
+// Redirection entry bits (low dword), delivery mode fixed and physical destination are 0
+#define IOAPIC_ACTIVE_LOW 0x2000
+#define IOAPIC_LEVEL 0x8000
+#define IOAPIC_MASKED 0x10000
+#define IOAPIC_DEST_SHIFT 24
+
+// Vectors the APIC raises on its own. The local timer takes over the PIT's vector and handler
+#define APIC_TIMER_VECTOR (ICW2_MASTER + PIT_IRQ_NUM)
+#define APIC_SPURIOUS_VECTOR 0xFF
+
+// Length of the window the local timer is measured over against the TSC
+#define APIC_CALIBRATE_MS 10
+
+/* ACPI tables (ACPI spec 5.2), only the fields used to find the MADT */
+#define NUM_ISA_IRQS 16
+#define ACPI_RSDP_SIGNATURE "RSD PTR "
+#define ACPI_RSDP_ALIGN 16
+#define ACPI_MADT_SIGNATURE "APIC"
+// Real mode segment of the extended BIOS data area, and the BIOS ROM, where the RSDP can be
+#define BDA_EBDA_SEGMENT 0x40E
+#define EBDA_SCAN_SIZE 1024
+#define BIOS_ROM_START 0xE0000
+#define BIOS_ROM_END 0x100000
+
+// MADT entry types
+#define MADT_LAPIC 0
+#define MADT_IOAPIC 1
+#define MADT_OVERRIDE 2
+
+// Processor entry flag: the processor can be started
+#define MADT_LAPIC_ENABLED 0x1
+
+// MPS INTI flags of an interrupt source override
+#define MADT_POLARITY_MASK 0x3
+#define MADT_POLARITY_LOW 0x3
+#define MADT_TRIGGER_SHIFT 2
+#define MADT_TRIGGER_MASK 0x3
+#define MADT_TRIGGER_LEVEL 0x3
+
+typedef struct __attribute__((packed)) acpi_rsdp {
+    int8_t signature[8];
+    uint8_t checksum;
+    int8_t oem_id[6];
+    uint8_t revision;
+    uint32_t rsdt_addr;
+} acpi_rsdp_t;
+
+typedef struct __attribute__((packed)) acpi_header {
+    int8_t signature[4];
+    uint32_t length;                // of the whole table, header included
+    uint8_t revision;
+    uint8_t checksum;
+    int8_t oem_id[6];
+    int8_t oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} acpi_header_t;
+
+typedef struct __attribute__((packed)) acpi_madt {
+    acpi_header_t header;
+    uint32_t lapic_addr;            // physical address of every CPU's local APIC
+    uint32_t flags;
+} acpi_madt_t;
+
+typedef struct __attribute__((packed)) madt_entry {
+    uint8_t type;                   // MADT_*
+    uint8_t length;
+    union {
+        struct __attribute__((packed)) {
+            uint8_t acpi_id;
+            uint8_t apic_id;
+            uint32_t flags;
+        } lapic;
+        struct __attribute__((packed)) {
+            uint8_t id;
+            uint8_t reserved;
+            uint32_t addr;
+            uint32_t gsi_base;      // first global system interrupt of its pins
+        } ioapic;
+        struct __attribute__((packed)) {
+            uint8_t bus;
+            uint8_t source;         // ISA IRQ
+            uint32_t gsi;           // global system interrupt it's wired to instead
+            uint16_t flags;
+        } override;
+    };
+} madt_entry_t;
+
+extern uint8_t apic_enabled;
+extern uint8_t apic_timer_enabled;
+extern uint32_t apic_cpu_ids[MAX_CPUS];
+extern uint32_t apic_num_cpus;
+
+void apic_init(void);
+void apic_local_init(void);
+uint32_t apic_id(void);
+int32_t apic_timer_init(uint32_t hz);
+void apic_timer_start(void);
+void apic_send_ipi(uint32_t dest_apic_id, uint32_t icr);
+void apic_spurious_handler(void);
+
+void apic_enable_irq(uint32_t irq_num);
+void apic_disable_irq(uint32_t irq_num);
+void apic_send_eoi(void);
+uint32_t ioapic_redirection(uint32_t irq_num);
+
+#endif /* _APIC_H */
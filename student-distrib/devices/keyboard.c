@@ -3,6 +3,25 @@
 #include "terminal.h"
 #include "../address.h"
 #include "../lib.h"
+#include "../task.h"
+#include "../signal.h"
+#include "../irq_stats.h"
+#include "../irqoff.h"
+#include "../lock.h"
+#include "../profile.h"
+#include "../timer.h"
+#include "../trace.h"
+#include "../klog.h"
+#include "../interrupt_handlers/irq.h"
+
+uint8_t is_extended;
+uint8_t caps_lock_toggle;
+uint8_t caps_lock_active;
+uint8_t left_control_pressed;
+uint8_t right_control_pressed;
+uint8_t left_shift_pressed;
+uint8_t right_shift_pressed;
+uint8_t alt_pressed;
 
 /* 
  * keyboard_init
@@ -24,64 +43,85 @@ void keyboard_init() {
     alt_pressed = 0;
 }
 
-// Pretend to be in the context of the displayed terminal
-#define KEYBOARD_HANDLER_PROLOGUE(original_terminal_id)        \
-    original_terminal_id = curr_executing_terminal_id;         \
-    curr_executing_terminal_id = curr_displaying_terminal_id;  \
-    video_mem = (char*) VIDEO_PERM_MEM_ADDR;
+/*
+ * Scancodes go from the interrupt handler to the keyboard thread through a single-producer,
+ * single-consumer ring. Each side only writes its own index, and reads the other's, so neither
+ * needs a lock or has to turn interrupts off.
+ */
+static uint8_t keyboard_ring[KEYBOARD_RING_SIZE];
+static volatile uint32_t keyboard_ring_head = 0;        // next scancode the thread takes
+static volatile uint32_t keyboard_ring_tail = 0;        // next free entry for the handler
+volatile uint32_t keyboard_dropped = 0;                 // scancodes the handler found no room for
+static volatile uint32_t keyboard_paused = 0;           // set while a test drains the ring itself
+static volatile uint32_t keyboard_draining = 0;         // set while the thread drains the ring
 
-// Restore the original executing terminal context
-#define KEYBOARD_HANDLER_EPILOGUE(original_terminal_id)  \
-    send_eoi(KEYBOARD_IRQ_NUM);                          \
-    curr_executing_terminal_id = original_terminal_id;   \
-    video_mem = (char*) VIDEO_MEM;
+/* 
+ * keyboard_type
+ *   DESCRIPTION: Types a character on a terminal. In raw mode it goes to the terminal's readers as it
+ *                is, in canonical mode it edits the line being typed, which Enter hands to the readers.
+ *   INPUTS: terminal_id -- the terminal
+ *           c -- the character, '\b' erases in canonical mode
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: echoes the character unless echo is off
+ */
+static void keyboard_type(uint8_t terminal_id, char c) {
+    terminal_data_t* term = &terminals[terminal_id];
+    uint8_t echo = term->mode.flags & TERM_MODE_ECHO;
+
+    if (!(term->mode.flags & TERM_MODE_CANON)) {
+        term_input(terminal_id, c);
+        return;
+    }
+    if (c == '\b') {
+        if (term->keyboard_buffer_size > 0) {
+            if (echo) putc('\b');
+            term->keyboard_buffer_size--;
+        }
+        return;
+    }
+    if (term->keyboard_buffer_size >= KBUFFER_SIZE) return;
+    term->keyboard_buffer[term->keyboard_buffer_size++] = c;
+    if (echo) putc(c);
+    if (c == '\n') {
+        term->is_done_typing = 1;
+        task_wakeup(&term->is_done_typing);
+    }
+}
 
 /* 
- * keyboard_handler
- *   DESCRIPTION: Handle a keyboard interrupt (data available).
- *   INPUTS: none
+ * keyboard_process
+ *   DESCRIPTION: Act on one scancode: track modifiers, edit the displayed terminal's line & echo it.
+ *                Runs in the keyboard thread, which belongs to the displayed terminal while it does,
+ *                so the echo & the debug keys' output go there.
+ *   INPUTS: scancode -- the scancode
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: reads available data and acknowledges interrupt
+ *   SIDE EFFECTS: may write to the displayed terminal, switch terminals or signal its programs
  */
-void keyboard_handler() {
-    cli();
+static void keyboard_process(uint8_t scancode) {
+    terminal_data_t* curr_terminal;
 
-    uint8_t scancode = inb(KEYBOARD_DATA_PORT);
     // If the scancode is 0xE0, then the next byte is an extended scancode
     if (scancode == CODE_EXTENDED) {
         is_extended = 1;
-        send_eoi(KEYBOARD_IRQ_NUM);
-        sti();
         return;
     }
-    // if (is_extended) { // we ignore extended for now
-    //     is_extended = 0;
-    //     KEYBOARD_HANDLER_EPILOGUE(original_executing_terminal_id);
-    //     sti();
-    //     return;
-    // }
-
-    // Keyboard should only ever be active on the currently shown terminal
-    // Don't context switch, just fake it
-    uint8_t original_executing_terminal_id;
-    KEYBOARD_HANDLER_PROLOGUE(original_executing_terminal_id);
-    terminal_data_t* curr_terminal = &terminals[curr_displaying_terminal_id];
+
+    curr_executing_terminal_id = curr_displaying_terminal_id;
+    if (curr_pcb != NULL) curr_pcb->terminal_id = curr_displaying_terminal_id;
+    curr_terminal = &terminals[curr_displaying_terminal_id];
 
     if (scancode >= RELEASED_SCANCODE_OFFSET) { // released
         scancode -= RELEASED_SCANCODE_OFFSET;
 
         // Supports right alt
         if (is_extended && scancode != CODE_ALT) {
-            KEYBOARD_HANDLER_EPILOGUE(original_executing_terminal_id);
             is_extended = 0;
-            sti();
             return;
         }
 
         if (scancode >= NUM_SCANCODES) {
-            KEYBOARD_HANDLER_EPILOGUE(original_executing_terminal_id);
-            sti();
             return;
         }
 
@@ -107,33 +147,50 @@ void keyboard_handler() {
 
     } else { // pressed
 
+        if (is_extended && (scancode == CODE_PAGE_UP || scancode == CODE_PAGE_DOWN) &&
+                (left_shift_pressed || right_shift_pressed)) {
+            term_scroll_view(curr_displaying_terminal_id,
+                scancode == CODE_PAGE_UP ? TERM_SCROLLBACK_STEP : -TERM_SCROLLBACK_STEP);
+            is_extended = 0;
+            return;
+        }
+        // Any other key but a modifier brings the view back to the screen
+        if (!is_extended && scancode != CODE_LEFT_SHIFT && scancode != CODE_RIGHT_SHIFT &&
+                scancode != CODE_LEFT_CONTROL && scancode != CODE_ALT && scancode != CODE_CAPS_LOCK) {
+            term_scroll_view(curr_displaying_terminal_id, -(int32_t) curr_terminal->ring_rows);
+        }
+
+        // Raw mode gets the arrows as escape sequences, canonical mode has no use for them
+        if (is_extended && !(curr_terminal->mode.flags & TERM_MODE_CANON)) {
+            char arrow = scancode == CODE_UP ? 'A' : scancode == CODE_DOWN ? 'B' :
+                         scancode == CODE_RIGHT ? 'C' : scancode == CODE_LEFT ? 'D' : '\0';
+            if (arrow != '\0') {
+                term_input(curr_displaying_terminal_id, ASCII_ESCAPE);
+                term_input(curr_displaying_terminal_id, '[');
+                term_input(curr_displaying_terminal_id, arrow);
+            }
+        }
+
         // Supports right alt
         if (is_extended && scancode != CODE_ALT) {
-            KEYBOARD_HANDLER_EPILOGUE(original_executing_terminal_id);
-            sti();
             is_extended = 0;
             return;
         }
 
         switch (scancode) {
-            case CODE_BACKSPACE:
-                if (curr_terminal->keyboard_buffer_size > 0) {
-                    putc('\b');
-                    curr_terminal->keyboard_buffer_size--;
+            case CODE_ESCAPE:
+                if (!(curr_terminal->mode.flags & TERM_MODE_CANON)) {
+                    term_input(curr_displaying_terminal_id, ASCII_ESCAPE);
                 }
                 break;
+            case CODE_BACKSPACE:
+                keyboard_type(curr_displaying_terminal_id, '\b');
+                break;
             case CODE_TAB:
-                if (curr_terminal->keyboard_buffer_size < KBUFFER_SIZE) {
-                    curr_terminal->keyboard_buffer[curr_terminal->keyboard_buffer_size++] = '\t';
-                    putc('\t');
-                }
+                keyboard_type(curr_displaying_terminal_id, '\t');
                 break;
             case CODE_ENTER:
-                if (curr_terminal->keyboard_buffer_size < KBUFFER_SIZE) {
-                    curr_terminal->keyboard_buffer[curr_terminal->keyboard_buffer_size++] = '\n';
-                    putc('\n');
-                    curr_terminal->is_done_typing = 1;
-                }
+                keyboard_type(curr_displaying_terminal_id, '\n');
                 break;
             case CODE_LEFT_CONTROL:
                 left_control_pressed = 1;
@@ -153,23 +210,54 @@ void keyboard_handler() {
                     caps_lock_active = !caps_lock_active;
                 }
                 break;
-            case CODE_F1:
-            case CODE_F2:
-            case CODE_F3:
+            case CODE_F1: case CODE_F2: case CODE_F3: case CODE_F4: case CODE_F5:
+            case CODE_F6: case CODE_F7: case CODE_F8: case CODE_F9: case CODE_F10:
+            case CODE_F11: case CODE_F12:
                 if (alt_pressed) {
-                    // Don't forget to restore keyboard display terminal context
-                    KEYBOARD_HANDLER_EPILOGUE(original_executing_terminal_id);
-                    // We know the scancodes are consecutive!
-                    term_video_switch(scancode - CODE_F1);
+                    // F1..F10 are consecutive, F11 & F12 come after the keypad
+                    term_video_switch(scancode <= CODE_F10 ? scancode - CODE_F1 : scancode - CODE_F11 + 10);
                     is_extended = 0;
-                    sti();
                     return;
                 }
                 break;
             default:
-                if (scancode == CODE_L && (left_control_pressed || right_control_pressed)) {
+                if (scancode == CODE_S && alt_pressed && (left_control_pressed || right_control_pressed)) {
+                    // Debug dump of the interrupt, interrupts-off and lock statistics
+                    putc('\n');
+                    irq_stats_print();
+                    irqoff_print();
+                    lock_stats_print();
+                } else if (scancode == CODE_P && alt_pressed && (left_control_pressed || right_control_pressed)) {
+                    // Toggle the profiler at its highest rate, "cat profile" reads the samples
+                    if (profile_running()) {
+                        profile_stop();
+                        printf("\nprofiler stopped, %d samples (%d dropped)\n", profile_ring.count, profile_ring.dropped);
+                    } else {
+                        profile_start(TIMER_TICK_HZ);
+                        printf("\nprofiler started\n");
+                    }
+                } else if (scancode == CODE_T && alt_pressed && (left_control_pressed || right_control_pressed)) {
+                    // Toggle every tracepoint, the records stream out COM1
+                    trace_set_mask(trace_mask ? 0 : TRACE_MASK_ALL);
+                    printf("\ntracing %s\n", trace_mask ? "started" : "stopped");
+                } else if (scancode == CODE_L && (left_control_pressed || right_control_pressed)) {
                     term_reset();
-                } else if (curr_terminal->keyboard_buffer_size < KBUFFER_SIZE) {
+                } else if (scancode == CODE_C && (left_control_pressed || right_control_pressed)) {
+                    // Interrupt the foreground program of the displayed terminal & the stages it spawned
+                    int32_t pid;
+                    pcb_t* pcb;
+                    for (pid = 0; pid < MAX_PID_COUNT; pid++) {
+                        pcb = get_pcb(pid);
+                        if (pcb->active && (pid == curr_terminal->foreground_pid ||
+                                (pcb->is_spawned && pcb->parent_pid == curr_terminal->foreground_pid))) {
+                            signal_send(pid, SIG_INTERRUPT);
+                        }
+                    }
+                    putc('^');
+                    putc('C');
+                    putc('\n');
+                    clear_kbuffer();
+                } else {
                     char c;
                     if (left_shift_pressed || right_shift_pressed) {
                         c = scancodeToKey[scancode][1];
@@ -178,15 +266,147 @@ void keyboard_handler() {
                     } else {
                         c = scancodeToKey[scancode][0];
                     }
-                    curr_terminal->keyboard_buffer[curr_terminal->keyboard_buffer_size++] = c;
-                    putc(c);
+                    // Raw mode turns Ctrl+letter into its control character, Ctrl+A is 1
+                    if (!(curr_terminal->mode.flags & TERM_MODE_CANON) &&
+                            (left_control_pressed || right_control_pressed) && isalpha(c)) {
+                        c &= 0x1F;
+                    }
+                    if (c != '\0') keyboard_type(curr_displaying_terminal_id, c);
                 }
                 break;
         }
     }
-    KEYBOARD_HANDLER_EPILOGUE(original_executing_terminal_id);
     is_extended = 0;
-    sti();
+}
+
+/* 
+ * keyboard_queue_scancode
+ *   DESCRIPTION: Puts a scancode in the ring for the keyboard thread, dropping it if the ring is full.
+ *                The keyboard interrupt handler is the ring's only producer.
+ *   INPUTS: scancode -- the scancode
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void keyboard_queue_scancode(uint8_t scancode) {
+    uint32_t tail = keyboard_ring_tail;
+    if (tail - keyboard_ring_head == KEYBOARD_RING_SIZE) {
+        keyboard_dropped++;
+        klog(KLOG_WARN, "keyboard ring full, %u scancodes dropped", keyboard_dropped);
+        return;
+    }
+    keyboard_ring[tail % KEYBOARD_RING_SIZE] = scancode;
+    // The scancode has to be in the ring before the thread sees the new tail
+    asm volatile ("" : : : "memory");
+    keyboard_ring_tail = tail + 1;
+}
+
+/* 
+ * keyboard_drain
+ *   DESCRIPTION: Takes every scancode out of the ring & acts on it. The keyboard thread is the ring's
+ *                only consumer, tests pause it with keyboard_thread_pause before calling this.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: number of scancodes processed
+ *   SIDE EFFECTS: see keyboard_process
+ */
+uint32_t keyboard_drain() {
+    uint32_t head, count = 0;
+    uint8_t scancode;
+    while ((head = keyboard_ring_head) != keyboard_ring_tail) {
+        scancode = keyboard_ring[head % KEYBOARD_RING_SIZE];
+        // The scancode has to be read before the handler may reuse its entry
+        asm volatile ("" : : : "memory");
+        keyboard_ring_head = head + 1;
+        keyboard_process(scancode);
+        count++;
+    }
+    return count;
+}
+
+/* 
+ * keyboard_thread
+ *   DESCRIPTION: Kernel thread running the line discipline: decoding, line editing & echo. Sleeps
+ *                until the interrupt handler puts scancodes in the ring.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: never returns
+ *   SIDE EFFECTS: see keyboard_process
+ */
+static void keyboard_thread() {
+    uint32_t flags, draining;
+    while (1) {
+        sti();
+        // Claim the ring, then look at the pause flag, keyboard_thread_pause does it the other way around
+        draining = 1;
+        asm volatile ("xchgl %0, %1" : "+r"(draining), "+m"(keyboard_draining) : : "memory");
+        if (!keyboard_paused) keyboard_drain();
+        keyboard_draining = 0;
+        cli_and_save(flags);
+        // The handler can't slip a scancode in between the check & going to sleep with interrupts off
+        if (keyboard_ring_head == keyboard_ring_tail || keyboard_paused) {
+            task_block(keyboard_ring);
+        }
+        restore_flags(flags);
+    }
+}
+
+/* 
+ * keyboard_thread_pause
+ *   DESCRIPTION: Stops the keyboard thread taking scancodes out of the ring, so a test can be the ring's
+ *                consumer, or lets it go on. Pausing waits for a drain the thread is in the middle of.
+ *   INPUTS: paused -- 1 to stop the thread, 0 to let it go on
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: wakes the thread when it goes on
+ */
+void keyboard_thread_pause(uint8_t paused) {
+    uint32_t flags;
+    if (paused) {
+        keyboard_paused = 1;
+        asm volatile ("mfence" : : : "memory");
+        while (keyboard_draining) {
+            asm volatile ("pause");
+        }
+    } else {
+        cli_and_save(flags);
+        keyboard_paused = 0;
+        task_wakeup(keyboard_ring);
+        restore_flags(flags);
+    }
+}
+
+/* 
+ * keyboard_thread_start
+ *   DESCRIPTION: Starts the keyboard thread
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if there is no pid left for it
+ *   SIDE EFFECTS: takes a pid
+ */
+int32_t keyboard_thread_start() {
+    return task_create_kthread(keyboard_thread) == -1 ? -1 : 0;
+}
+
+/* 
+ * keyboard_handler
+ *   DESCRIPTION: Handle a keyboard interrupt (data available). All it does is put the scancode in the
+ *                ring & wake the keyboard thread, which does the rest. The thread preempts whatever
+ *                runs on this processor, so echo doesn't wait for the other tasks' time slices.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: reads available data and acknowledges interrupt
+ */
+void keyboard_handler() {
+    // Without a byte waiting this was raised in software, only wake the thread for what is queued
+    if (inb(KEYBOARD_CONTROL_PORT) & KEYBOARD_STATUS_OUTPUT_FULL) {
+        keyboard_queue_scancode(inb(KEYBOARD_DATA_PORT));
+    }
+    send_eoi(KEYBOARD_IRQ_NUM);
+    if (task_wakeup_first(keyboard_ring) != 0) {
+        irq_request_resched();
+    }
 }
 
 void clear_kbuffer() {
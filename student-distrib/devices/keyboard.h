@@ -8,20 +8,34 @@
 
 #define KEYBOARD_DATA_PORT 0x60
 #define KEYBOARD_CONTROL_PORT 0x64
+// Status register bit: a byte waits in the data port
+#define KEYBOARD_STATUS_OUTPUT_FULL 0x01
+
+// Scancodes waiting for the keyboard thread, a power of 2 so the ring indices can wrap around
+#define KEYBOARD_RING_SIZE 64
 
 #define KBUFFER_SIZE 128
 
-uint8_t is_extended;
-uint8_t caps_lock_toggle;
-uint8_t caps_lock_active;
-uint8_t left_control_pressed;
-uint8_t right_control_pressed;
-uint8_t left_shift_pressed;
-uint8_t right_shift_pressed;
-uint8_t alt_pressed;
+// What raw mode hands programs for the escape key, arrows come as ESC '[' 'A'..'D' like on a VT100
+#define ASCII_ESCAPE 0x1B
+
+extern uint8_t is_extended;
+extern uint8_t caps_lock_toggle;
+extern uint8_t caps_lock_active;
+extern uint8_t left_control_pressed;
+extern uint8_t right_control_pressed;
+extern uint8_t left_shift_pressed;
+extern uint8_t right_shift_pressed;
+extern uint8_t alt_pressed;
 
 extern void keyboard_init();
 extern void keyboard_handler();
+extern void keyboard_queue_scancode(uint8_t scancode);
+extern uint32_t keyboard_drain();
+extern void keyboard_thread_pause(uint8_t paused);
+extern int32_t keyboard_thread_start();
+
+extern volatile uint32_t keyboard_dropped;
 
 extern void clear_kbuffer();
 
@@ -2,11 +2,16 @@
 #define RELEASED_SCANCODE_OFFSET 0x80
 
 // Special scancodes
+#define CODE_ESCAPE 0x01
 #define CODE_BACKSPACE 0x0E
 #define CODE_TAB 0x0F
 #define CODE_ENTER 0x1C
 #define CODE_LEFT_CONTROL 0x1D
+#define CODE_P 0x19
+#define CODE_S 0x1F
+#define CODE_T 0x14
 #define CODE_L 0x26
+#define CODE_C 0x2E
 #define CODE_LEFT_SHIFT 0x2A
 #define CODE_RIGHT_SHIFT 0x36
 #define CODE_CAPS_LOCK 0x3A
@@ -15,6 +20,22 @@
 #define CODE_F1 0x3B
 #define CODE_F2 0x3C
 #define CODE_F3 0x3D
+#define CODE_F4 0x3E
+#define CODE_F5 0x3F
+#define CODE_F6 0x40
+#define CODE_F7 0x41
+#define CODE_F8 0x42
+#define CODE_F9 0x43
+#define CODE_F10 0x44
+#define CODE_F11 0x57
+#define CODE_F12 0x58
+// Extended, after CODE_EXTENDED
+#define CODE_PAGE_UP 0x49
+#define CODE_PAGE_DOWN 0x51
+#define CODE_UP 0x48
+#define CODE_LEFT 0x4B
+#define CODE_RIGHT 0x4D
+#define CODE_DOWN 0x50
 
 // https://wiki.osdev.org/PS/2_Keyboard#Scan_Code_Set_1
 // Index 0 is lowercase, index 1 is capital
@@ -0,0 +1,83 @@
+#include "kmsg.h"
+#include "../lib.h"
+#include "../klog.h"
+
+funcptrs kmsg_fops = {
+    .open = kmsg_open,
+    .close = kmsg_close,
+    .read = kmsg_read,
+    .write = kmsg_write,
+};
+
+/* 
+ * kmsg_open
+ *   DESCRIPTION: Opens the kernel log, reads start at the oldest record still in the ring
+ *   INPUTS: f -- file descriptor being opened
+ *           filename -- name it was opened by
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0
+ *   SIDE EFFECTS: none
+ */
+int32_t kmsg_open(fd_array_member_t* f, const uint8_t* filename) {
+    return 0;
+}
+
+/* 
+ * kmsg_close
+ *   DESCRIPTION: Closes the kernel log
+ *   INPUTS: f -- file descriptor being closed
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0
+ *   SIDE EFFECTS: none
+ */
+int32_t kmsg_close(fd_array_member_t* f) {
+    return 0;
+}
+
+/* 
+ * kmsg_read
+ *   DESCRIPTION: Reads the records after the descriptor's position as lines of klog_format, as many whole
+ *                lines as fit; a first line longer than buf is cut short. Each descriptor keeps its own
+ *                position, so every reader sees every record and nothing is taken out of the ring.
+ *   INPUTS: f -- file descriptor
+ *           buf -- buffer to read into
+ *           nbytes -- size of buf
+ *   OUTPUTS: the lines, oldest record first
+ *   RETURN VALUE: number of bytes read, 0 once the reader is caught up
+ *   SIDE EFFECTS: moves the descriptor past the records read
+ */
+int32_t kmsg_read(fd_array_member_t* f, void* buf, int32_t nbytes) {
+    klog_record_t record;
+    int8_t line[KLOG_LINE_SIZE];
+    uint32_t pos, len, copied = 0;
+    if (nbytes < 0) return -1;
+
+    while (copied < (uint32_t) nbytes) {
+        // Only move the descriptor once the line is taken
+        pos = f->file_pos;
+        if (!klog_next_record(&pos, &record)) break;
+        len = klog_format(&record, line, KLOG_LINE_SIZE);
+        if (len > (uint32_t) nbytes - copied) {
+            if (copied != 0) break;
+            len = nbytes;
+        }
+        memcpy((int8_t*) buf + copied, line, len);
+        copied += len;
+        f->file_pos = pos;
+    }
+    return copied;
+}
+
+/* 
+ * kmsg_write
+ *   DESCRIPTION: Programs can't add to the kernel log
+ *   INPUTS: f -- file descriptor
+ *           buf -- ignored
+ *           nbytes -- size of buf
+ *   OUTPUTS: none
+ *   RETURN VALUE: -1
+ *   SIDE EFFECTS: none
+ */
+int32_t kmsg_write(fd_array_member_t* f, const void* buf, int32_t nbytes) {
+    return -1;
+}
@@ -0,0 +1,16 @@
+#ifndef _KMSG_H
+#define _KMSG_H
+
+#include "../types.h"
+#include "../filesystem/filesys_interface.h"
+
+#define KMSG_DEVICE_NAME "kmsg"
+
+extern funcptrs kmsg_fops;
+
+int32_t kmsg_open(fd_array_member_t* f, const uint8_t* filename);
+int32_t kmsg_close(fd_array_member_t* f);
+int32_t kmsg_read(fd_array_member_t* f, void* buf, int32_t nbytes);
+int32_t kmsg_write(fd_array_member_t* f, const void* buf, int32_t nbytes);
+
+#endif
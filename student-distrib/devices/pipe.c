@@ -0,0 +1,245 @@
+#include "pipe.h"
+#include "../lib.h"
+#include "../task.h"
+#include "../signal.h"
+
+funcptrs pipe_read_fops = {
+    .open = pipe_open,
+    .close = pipe_close,
+    .read = pipe_read,
+    .write = pipe_write_bad_call
+};
+
+funcptrs pipe_write_fops = {
+    .open = pipe_open,
+    .close = pipe_close,
+    .read = pipe_read_bad_call,
+    .write = pipe_write
+};
+
+pipe_t pipes[MAX_PIPE_COUNT];
+
+/*
+ * pipe_init
+ *   DESCRIPTION: Marks every pipe as unused.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void pipe_init() {
+    int32_t i;
+    for (i = 0; i < MAX_PIPE_COUNT; i++) {
+        pipes[i].read_pos = 0;
+        pipes[i].count = 0;
+        pipes[i].readers = 0;
+        pipes[i].writers = 0;
+    }
+}
+
+/*
+ * pipe_create
+ *   DESCRIPTION: Allocates an unused pipe and opens both of its ends.
+ *   INPUTS: read_end -- unused file descriptor struct for the read end
+ *           write_end -- unused file descriptor struct for the write end
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 for success, -1 if every pipe is in use
+ *   SIDE EFFECTS: fills in both file descriptor structs
+ */
+int32_t pipe_create(fd_array_member_t* read_end, fd_array_member_t* write_end) {
+    uint32_t flags;
+    int32_t i;
+    cli_and_save(flags);
+    for (i = 0; i < MAX_PIPE_COUNT; i++) {
+        if (pipes[i].readers == 0 && pipes[i].writers == 0) break;
+    }
+    if (i == MAX_PIPE_COUNT) {
+        restore_flags(flags);
+        return -1;
+    }
+    pipes[i].read_pos = 0;
+    pipes[i].count = 0;
+    pipes[i].readers = 1;
+    pipes[i].writers = 1;
+    restore_flags(flags);
+
+    read_end->fops = &pipe_read_fops;
+    read_end->inode = i;
+    read_end->file_pos = 0;
+    read_end->flags = 1;
+
+    write_end->fops = &pipe_write_fops;
+    write_end->inode = i;
+    write_end->file_pos = 0;
+    write_end->flags = 1;
+    return 0;
+}
+
+/*
+ * pipe_dup
+ *   DESCRIPTION: Counts another open copy of a pipe end (for descriptors handed to a spawned task).
+ *   INPUTS: f -- file descriptor struct that was copied
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 for success, -1 if f is not a pipe end
+ *   SIDE EFFECTS: none
+ */
+int32_t pipe_dup(fd_array_member_t* f) {
+    if (f->fops == &pipe_read_fops) {
+        pipes[f->inode].readers++;
+    } else if (f->fops == &pipe_write_fops) {
+        pipes[f->inode].writers++;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * pipe_open
+ *   DESCRIPTION: Pipes have no name, they can only be created by the pipe syscall.
+ *   INPUTS: f -- file descriptor struct
+ *           filename -- the name of the file to open (unused)
+ *   OUTPUTS: none
+ *   RETURN VALUE: -1
+ *   SIDE EFFECTS: none
+ */
+int32_t pipe_open(fd_array_member_t* f, const uint8_t* filename) {
+    return -1;
+}
+
+/*
+ * pipe_close
+ *   DESCRIPTION: Closes one end of a pipe and wakes up tasks blocked on the other end.
+ *   INPUTS: f -- file descriptor struct
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 for success
+ *   SIDE EFFECTS: frees the pipe once both ends are closed
+ */
+int32_t pipe_close(fd_array_member_t* f) {
+    pipe_t* p = &pipes[f->inode];
+    uint32_t flags;
+    cli_and_save(flags);
+    if (f->fops == &pipe_read_fops) {
+        p->readers--;
+    } else {
+        p->writers--;
+    }
+    // Readers see end of file & writers see the broken pipe
+    task_wakeup(p);
+    restore_flags(flags);
+    return 0;
+}
+
+/*
+ * pipe_read
+ *   DESCRIPTION: Reads whatever is buffered in the pipe, blocking while it is empty.
+ *   INPUTS: f -- file descriptor struct
+ *           buf -- the buffer to read into
+ *           nbytes -- the maximum number of bytes to read
+ *   OUTPUTS: none
+ *   RETURN VALUE: number of bytes read, 0 once the pipe is empty and every write end is closed,
+ *                 -1 if the task is being killed
+ *   SIDE EFFECTS: wakes up writers blocked on a full pipe
+ */
+int32_t pipe_read(fd_array_member_t* f, void* buf, int32_t nbytes) {
+    if (buf == NULL || nbytes < 0) return -1;
+    pipe_t* p = &pipes[f->inode];
+    uint32_t flags, n, first;
+    cli_and_save(flags);
+    while (p->count == 0) {
+        if (p->writers == 0) {
+            restore_flags(flags);
+            return 0;
+        }
+        if (signal_fatal_pending()) {
+            restore_flags(flags);
+            return -1;
+        }
+        task_block(p);
+    }
+
+    // At most two bulk copies, the second one when the data wraps around the ring
+    n = MIN((uint32_t) nbytes, p->count);
+    first = MIN(n, PIPE_BUFFER_SIZE - p->read_pos);
+    memcpy(buf, p->buffer + p->read_pos, first);
+    memcpy((uint8_t*) buf + first, p->buffer, n - first);
+    p->read_pos = (p->read_pos + n) % PIPE_BUFFER_SIZE;
+    p->count -= n;
+
+    task_wakeup(p);
+    restore_flags(flags);
+    return n;
+}
+
+/*
+ * pipe_write
+ *   DESCRIPTION: Writes the whole buffer into the pipe, blocking while it is full.
+ *   INPUTS: f -- file descriptor struct
+ *           buf -- the buffer to write from
+ *           nbytes -- the number of bytes to write
+ *   OUTPUTS: none
+ *   RETURN VALUE: nbytes for success, -1 if every read end is closed or the task is being killed
+ *   SIDE EFFECTS: wakes up readers blocked on an empty pipe
+ */
+int32_t pipe_write(fd_array_member_t* f, const void* buf, int32_t nbytes) {
+    if (buf == NULL || nbytes < 0) return -1;
+    pipe_t* p = &pipes[f->inode];
+    uint32_t flags, written, n, write_pos, first;
+    cli_and_save(flags);
+    written = 0;
+    while (written < nbytes) {
+        if (p->readers == 0) {
+            restore_flags(flags);
+            return -1;
+        }
+        if (p->count == PIPE_BUFFER_SIZE) {
+            if (signal_fatal_pending()) {
+                restore_flags(flags);
+                return -1;
+            }
+            task_block(p);
+            continue;
+        }
+
+        // Fill as much free space as possible, at most two bulk copies
+        n = MIN((uint32_t) nbytes - written, PIPE_BUFFER_SIZE - p->count);
+        write_pos = (p->read_pos + p->count) % PIPE_BUFFER_SIZE;
+        first = MIN(n, PIPE_BUFFER_SIZE - write_pos);
+        memcpy(p->buffer + write_pos, (const uint8_t*) buf + written, first);
+        memcpy(p->buffer, (const uint8_t*) buf + written + first, n - first);
+        p->count += n;
+        written += n;
+
+        task_wakeup(p);
+    }
+    restore_flags(flags);
+    return nbytes;
+}
+
+/*
+ * pipe_read_bad_call
+ *   DESCRIPTION: No-op function for invalid reads from the write end
+ *   INPUTS: f -- file descriptor struct
+ *           buf -- buffer to read into
+ *           nbytes -- the number of bytes to read
+ *   OUTPUTS: none
+ *   RETURN VALUE: -1 since can't read from the write end
+ *   SIDE EFFECTS: none
+ */
+int32_t pipe_read_bad_call(fd_array_member_t* f, void* buf, int32_t nbytes) {
+    return -1;
+}
+
+/*
+ * pipe_write_bad_call
+ *   DESCRIPTION: No-op function for invalid writes to the read end
+ *   INPUTS: f -- file descriptor struct
+ *           buf -- buffer to write from
+ *           nbytes -- the number of bytes to write
+ *   OUTPUTS: none
+ *   RETURN VALUE: -1 since can't write to the read end
+ *   SIDE EFFECTS: none
+ */
+int32_t pipe_write_bad_call(fd_array_member_t* f, const void* buf, int32_t nbytes) {
+    return -1;
+}
@@ -0,0 +1,31 @@
+#ifndef _PIPE_H
+#define _PIPE_H
+
+#include "../types.h"
+#include "../filesystem/filesys_interface.h"
+
+#define MAX_PIPE_COUNT 8
+#define PIPE_BUFFER_SIZE 4096
+
+typedef struct pipe {
+    uint8_t buffer[PIPE_BUFFER_SIZE];   // ring buffer
+    uint32_t read_pos;                  // index of the oldest unread byte
+    uint32_t count;                     // number of unread bytes
+    uint32_t readers;                   // open read ends
+    uint32_t writers;                   // open write ends
+} pipe_t;
+
+extern funcptrs pipe_read_fops;
+extern funcptrs pipe_write_fops;
+
+void pipe_init();
+int32_t pipe_create(fd_array_member_t* read_end, fd_array_member_t* write_end);
+int32_t pipe_dup(fd_array_member_t* f);
+int32_t pipe_open(fd_array_member_t* f, const uint8_t* filename);
+int32_t pipe_close(fd_array_member_t* f);
+int32_t pipe_read(fd_array_member_t* f, void* buf, int32_t nbytes);
+int32_t pipe_write(fd_array_member_t* f, const void* buf, int32_t nbytes);
+int32_t pipe_read_bad_call(fd_array_member_t* f, void* buf, int32_t nbytes);
+int32_t pipe_write_bad_call(fd_array_member_t* f, const void* buf, int32_t nbytes);
+
+#endif
@@ -1,15 +1,22 @@
 #include "pit.h"
 #include "../lib.h"
 #include "../i8259.h"
+#include "../apic.h"
 #include "../devices/terminal.h"
+#include "../task.h"
+#include "../timer.h"
+#include "../interrupt_handlers/irq.h"
+#include "../profile.h"
+#include "../trace.h"
+#include "../klog.h"
 
 /* 
  * pit_init
- *   DESCRIPTION: Initialize PIT by turning on IRQ
+ *   DESCRIPTION: Start the scheduler tick, from the local APIC timer if there is one and the PIT otherwise
  *   INPUTS: none
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: enables interrupts for IRQ 0 (pit)
+ *   SIDE EFFECTS: enables interrupts for IRQ 0 (pit) or the local APIC timer
  */
 void pit_init() {
     cli();
@@ -24,25 +31,36 @@ void pit_init() {
     outb(l, PIT_DATA);
     outb(h, PIT_DATA);
 
-    // Finally, enable the PIT IRQ
-    enable_irq(PIT_IRQ_NUM);
+    // Finally, enable the PIT IRQ. The local APIC timer raises the same vector, so it needs nothing else
+    if (apic_timer_init(PIT_DESIRED_FREQ) != 0) {
+        enable_irq(PIT_IRQ_NUM);
+    }
 
     sti();
 }
 
 /* 
  * pit_handler
- *   DESCRIPTION: Round robin scheduling for terminals
- *   INPUTS: none
+ *   DESCRIPTION: Round robin scheduling of runnable tasks, on every PIT or local APIC timer tick of
+ *                each processor. Runs with interrupts disabled; it can interrupt the keyboard handler.
+ *   INPUTS: context -- registers of the interrupted code, for the profiler
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: sends EOI and switches terminals
+ *   SIDE EFFECTS: sends EOI, runs expired timers, streams out trace records, takes a profiler sample
+ *                 and switches tasks
  */
-void pit_handler() {
+void pit_handler(hw_context_t* context) {
     cli();
     // printf("PIT interrupt\n");
     send_eoi(PIT_IRQ_NUM);
-    // printf("context switch to %d\n", curr_executing_terminal_id + 1);
-    term_context_switch((curr_executing_terminal_id + 1) % MAX_TERMINAL_ID);
+    // Every processor's local timer lands here, the timer wheel runs on the boot processor's
+    if (this_cpu()->id == 0) {
+        timer_tick();
+        trace_flush();
+        klog_flush();
+    }
+    profile_tick(context);
+    // The tick itself is short and never waits, a task switch waits for a handler it interrupted
+    irq_request_resched();
     sti();
 }
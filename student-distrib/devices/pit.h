@@ -1,6 +1,8 @@
 #ifndef _PIT_H
 #define _PIT_H
 
+#include "../interrupt_handlers/context.h"
+
 #define PIT_IRQ_NUM 0
 
 #define PIT_PORT 0x43
@@ -18,6 +20,6 @@
 #define PIT_MODE 0x36
 
 void pit_init();
-void pit_handler();
+void pit_handler(hw_context_t* context);
 
 #endif
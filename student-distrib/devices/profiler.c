@@ -0,0 +1,102 @@
+#include "profiler.h"
+#include "../lib.h"
+#include "../profile.h"
+#include "../paging.h"
+
+funcptrs profiler_fops = {
+    .open = profiler_open,
+    .close = profiler_close,
+    .read = profiler_read,
+    .write = profiler_write,
+};
+
+/* 
+ * profiler_open
+ *   DESCRIPTION: Opens the profiler device. Every fd keeps the line it is partway through in a frame
+ *                its inode points at, so readers don't cut into each other's lines.
+ *   INPUTS: f -- file descriptor being opened
+ *           filename -- name it was opened by
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if the frame pool ran out
+ *   SIDE EFFECTS: none
+ */
+int32_t profiler_open(fd_array_member_t* f, const uint8_t* filename) {
+    uint32_t frame = frame_alloc();
+    if (frame == 0) return -1;
+    // The frame comes zeroed, no line yet
+    f->inode = frame;
+    return 0;
+}
+
+/* 
+ * profiler_close
+ *   DESCRIPTION: Closes the profiler device
+ *   INPUTS: f -- file descriptor being closed
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0
+ *   SIDE EFFECTS: frees the fd's line once no copy of the fd uses it
+ */
+int32_t profiler_close(fd_array_member_t* f) {
+    frame_put(f->inode);
+    return 0;
+}
+
+/* 
+ * profiler_dup
+ *   DESCRIPTION: Counts another open copy of a profiler fd (for descriptors handed to a spawned task),
+ *                the copies share the line
+ *   INPUTS: f -- file descriptor struct that was copied
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 for success, -1 if f is not the profiler device
+ *   SIDE EFFECTS: none
+ */
+int32_t profiler_dup(fd_array_member_t* f) {
+    if (f->fops != &profiler_fops) return -1;
+    frame_get(f->inode);
+    return 0;
+}
+
+/* 
+ * profiler_read
+ *   DESCRIPTION: Reads the samples in the ring as lines of profile_format, so "cat profile" dumps them
+ *                for symbolize_profile.py
+ *   INPUTS: f -- file descriptor
+ *           buf -- buffer to read into
+ *           nbytes -- size of buf
+ *   OUTPUTS: the lines, oldest sample first
+ *   RETURN VALUE: number of bytes read, 0 once the ring is empty
+ *   SIDE EFFECTS: takes the samples read out of the ring
+ */
+int32_t profiler_read(fd_array_member_t* f, void* buf, int32_t nbytes) {
+    profiler_line_t* line = (profiler_line_t*) f->inode;
+    profile_sample_t sample;
+    uint32_t count, copied = 0;
+    if (nbytes < 0) return -1;
+
+    while (copied < (uint32_t) nbytes) {
+        if (line->pos == line->len) {
+            if (profile_read(&sample, 1) == 0) break;
+            line->len = profile_format(&sample, line->text, PROFILE_LINE_SIZE);
+            line->pos = 0;
+        }
+        count = MIN((uint32_t) nbytes - copied, line->len - line->pos);
+        memcpy((int8_t*) buf + copied, line->text + line->pos, count);
+        line->pos += count;
+        copied += count;
+    }
+    return copied;
+}
+
+/* 
+ * profiler_write
+ *   DESCRIPTION: The profiler is controlled through the profile syscall
+ *   INPUTS: f -- file descriptor
+ *           buf -- ignored
+ *           nbytes -- size of buf
+ *   OUTPUTS: none
+ *   RETURN VALUE: -1
+ *   SIDE EFFECTS: none
+ */
+int32_t profiler_write(fd_array_member_t* f, const void* buf, int32_t nbytes) {
+    return -1;
+}
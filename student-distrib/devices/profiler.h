@@ -0,0 +1,25 @@
+#ifndef _PROFILER_H
+#define _PROFILER_H
+
+#include "../types.h"
+#include "../filesystem/filesys_interface.h"
+#include "../profile.h"
+
+#define PROFILER_DEVICE_NAME "profile"
+
+// Line of the sample an fd took out of the ring last, for readers with buffers shorter than a line
+typedef struct profiler_line {
+    uint32_t len;
+    uint32_t pos;                               // bytes of it read so far
+    int8_t text[PROFILE_LINE_SIZE];
+} profiler_line_t;
+
+extern funcptrs profiler_fops;
+
+int32_t profiler_open(fd_array_member_t* f, const uint8_t* filename);
+int32_t profiler_close(fd_array_member_t* f);
+int32_t profiler_dup(fd_array_member_t* f);
+int32_t profiler_read(fd_array_member_t* f, void* buf, int32_t nbytes);
+int32_t profiler_write(fd_array_member_t* f, const void* buf, int32_t nbytes);
+
+#endif
@@ -1,7 +1,8 @@
 #include "rtc.h"
 #include "../lib.h"
 #include "../i8259.h"
-#include "../devices/terminal.h"
+#include "../task.h"
+#include "../signal.h"
 #define bit6 0x40
 #define MAX_RTC_FREQ 1024
 #define RESET_FREQ 2
@@ -14,37 +15,121 @@ funcptrs rtc_fops = {
     .write = rtc_write
 };
 
+rtc_timer_t rtc_timers[MAX_RTC_TIMERS];
+// Open virtual RTCs sorted by deadline, soonest first
+static rtc_timer_t* rtc_deadlines = NULL;
+// Time in 1/RTC_FREQ s units, advanced by every interrupt
+static uint32_t rtc_time = 0;
+// Rate the hardware is programmed to, 0 while the IRQ is disabled
+static int32_t rtc_hw_freq = 0;
+
 /* 
  * rtc_init
- *   DESCRIPTION: Initialize RTC by turning on IRQ with a default 1024 Hz rate.
+ *   DESCRIPTION: Initialize RTC periodic interrupts. The IRQ stays disabled until a virtual RTC is opened.
  *   INPUTS: none
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: enables interrupts for IRQ 8 (rtc)
+ *   SIDE EFFECTS: none
  */
 void rtc_init() {
     // Adapted from https://wiki.osdev.org/RTC#Turning_on_IRQ_8
     // interrupt_flag = 0;
     // interrupt_counter = 0;
+    int32_t i;
+    for (i = 0; i < MAX_RTC_TIMERS; i++) {
+        rtc_timers[i].in_use = 0;
+    }
+    rtc_deadlines = NULL;
+    rtc_hw_freq = 0;
+
     cli();
     outb(disable_NMI_B, RTC_PORT);   // select register B, and disable NMI
     char prev = inb(RTC_DATA);   // read the current value of register B
     outb(disable_NMI_B, RTC_PORT);   // set the index again (a read will reset the index to register D)
     outb(prev | bit6, RTC_DATA);     // write the previous value ORed with 0x40. This turns on bit 6 of register B
-    enable_irq(RTC_IRQ_NUM); 
     sti();
 }
 
+/* 
+ * rtc_insert
+ *   DESCRIPTION: Inserts a virtual RTC in the deadline list. Must be called with interrupts disabled.
+ *   INPUTS: t -- the virtual RTC, with its deadline set
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void rtc_insert(rtc_timer_t* t) {
+    rtc_timer_t** link = &rtc_deadlines;
+    // Compare relative to now so the wrap of rtc_time doesn't matter
+    while (*link != NULL && (*link)->deadline - rtc_time <= t->deadline - rtc_time) {
+        link = &(*link)->next;
+    }
+    t->next = *link;
+    *link = t;
+}
+
+/* 
+ * rtc_remove
+ *   DESCRIPTION: Removes a virtual RTC from the deadline list. Must be called with interrupts disabled.
+ *   INPUTS: t -- the virtual RTC
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void rtc_remove(rtc_timer_t* t) {
+    rtc_timer_t** link = &rtc_deadlines;
+    while (*link != NULL && *link != t) {
+        link = &(*link)->next;
+    }
+    if (*link == t) {
+        *link = t->next;
+    }
+    t->next = NULL;
+}
+
+/* 
+ * rtc_update_hw_freq
+ *   DESCRIPTION: Programs the hardware to the highest rate of the open virtual RTCs, and turns the
+ *                IRQ off when there are none. Must be called with interrupts disabled.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: reprograms the RTC
+ */
+static void rtc_update_hw_freq() {
+    int32_t freq = 0;
+    int32_t i;
+    for (i = 0; i < MAX_RTC_TIMERS; i++) {
+        if (rtc_timers[i].in_use) {
+            freq = MAX(freq, rtc_timers[i].freq);
+        }
+    }
+    if (freq == rtc_hw_freq) return;
+
+    if (freq == 0) {
+        disable_irq(RTC_IRQ_NUM);
+    } else {
+        set_rtc_freq(freq);
+        if (rtc_hw_freq == 0) {
+            // Drop an interrupt that was pending while the IRQ was off, so the next one raises the line
+            outb(disable_NMI_C, RTC_PORT);
+            inb(RTC_DATA);
+            enable_irq(RTC_IRQ_NUM);
+        }
+    }
+    rtc_hw_freq = freq;
+}
+
 /* 
  * rtc_handler
  *   DESCRIPTION: Handle a periodic RTC interrupt.
  *   INPUTS: none
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: reads available data and acknowledges interrupt
+ *   SIDE EFFECTS: reads available data and acknowledges interrupt, wakes readers of expired virtual RTCs
  */
 void rtc_handler() {
-    int i;
+    rtc_timer_t* t;
     
     // test_interrupts();
     // Print 1 character for every interrupt
@@ -54,88 +139,129 @@ void rtc_handler() {
     outb(disable_NMI_C, RTC_PORT);
     inb(RTC_DATA); // drop unneeded data
 
-    for (i = 0; i< MAX_TERMINAL_ID; i++){
-        if (terminals[curr_executing_terminal_id].rtc_counter > 0){
-            terminals[curr_executing_terminal_id].rtc_counter--;
-        }
-        else{
-            terminals[curr_executing_terminal_id].rtc_counter = terminals[curr_executing_terminal_id].rtc_freq;
-            terminals[curr_executing_terminal_id].rtc_flag = 1;
-        }
+    if (rtc_hw_freq != 0) {
+        rtc_time += RTC_FREQ / rtc_hw_freq;
+    }
+
+    // Only the expired virtual RTCs at the head of the list are touched
+    while ((t = rtc_deadlines) != NULL && (int32_t) (rtc_time - t->deadline) >= 0) {
+        rtc_deadlines = t->next;
+        t->deadline += RTC_FREQ / t->freq;
+        rtc_insert(t);
+        t->ticked = 1;
+        task_wakeup(t);
     }
     send_eoi(RTC_IRQ_NUM);
 }
 
 /* 
  * rtc_open
- *   DESCRIPTION: Initialize RTC frequency to 2HZ.
+ *   DESCRIPTION: Opens a virtual RTC ticking at 2 Hz.
  *   INPUTS: f -- file descriptor struct
  *           filename -- filename to open
  *   OUTPUTS: none
- *   RETURN VALUE: none
- *   SIDE EFFECTS: none
+ *   RETURN VALUE: 0 on success, -1 if every virtual RTC is in use
+ *   SIDE EFFECTS: may change the hardware rate
  */
 int32_t rtc_open(fd_array_member_t* f, const uint8_t* filename) {
-    // set_rtc_freq(RESET_FREQ);
-    terminals[curr_executing_terminal_id].rtc_freq = RTC_FREQ/RESET_FREQ;
-    terminals[curr_executing_terminal_id].rtc_counter = RESET_FREQ;
-    terminals[curr_executing_terminal_id].rtc_enabled = 1;
+    uint32_t flags;
+    int32_t i;
+    if (f == NULL) return -1;
+
+    cli_and_save(flags);
+    for (i = 0; i < MAX_RTC_TIMERS; i++) {
+        if (!rtc_timers[i].in_use) break;
+    }
+    if (i == MAX_RTC_TIMERS) {
+        restore_flags(flags);
+        return -1;
+    }
+    rtc_timers[i].in_use = 1;
+    rtc_timers[i].freq = RESET_FREQ;
+    rtc_timers[i].ticked = 0;
+    rtc_timers[i].deadline = rtc_time + RTC_FREQ / RESET_FREQ;
+    rtc_insert(&rtc_timers[i]);
+    f->inode = i;
+    rtc_update_hw_freq();
+    restore_flags(flags);
+    return 0;
+}
+
+/* 
+ * rtc_dup
+ *   DESCRIPTION: Counts another open copy of a virtual RTC (for descriptors handed to a spawned task),
+ *                so it stays in the deadline list until every copy is closed.
+ *   INPUTS: f -- file descriptor struct that was copied
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 for success, -1 if f is not an RTC
+ *   SIDE EFFECTS: none
+ */
+int32_t rtc_dup(fd_array_member_t* f) {
+    uint32_t flags;
+    if (f->fops != &rtc_fops) return -1;
+    cli_and_save(flags);
+    rtc_timers[f->inode].in_use++;
+    restore_flags(flags);
     return 0;
 }
 
 /* 
  * rtc_close
- *   DESCRIPTION: Close RTC.
+ *   DESCRIPTION: Close RTC. The virtual RTC goes away with its last open copy.
  *   INPUTS: f -- file descriptor struct
  *   OUTPUTS: none
- *   RETURN VALUE: none
- *   SIDE EFFECTS: none
+ *   RETURN VALUE: 0
+ *   SIDE EFFECTS: may change the hardware rate or turn the IRQ off
  */
 int32_t rtc_close(fd_array_member_t* f) {
-    terminals[curr_executing_terminal_id].rtc_enabled = 0;
+    uint32_t flags;
+    rtc_timer_t* t = &rtc_timers[f->inode];
+    cli_and_save(flags);
+    if (t->in_use != 0 && --t->in_use == 0) {
+        rtc_remove(t);
+        rtc_update_hw_freq();
+    }
+    restore_flags(flags);
     return 0;
 }
 
 /* 
  * rtc_read
- *   DESCRIPTION: Block until the next interrupt.
+ *   DESCRIPTION: Block until the next tick of the fd's virtual RTC.
  *   INPUTS: f -- file descriptor struct
  *           buf -- buffer to read from
  *           nbytes -- number of bytes to read
  *   OUTPUTS: none
- *   RETURN VALUE: 0 
- *   SIDE EFFECTS: none
+ *   RETURN VALUE: 0, -1 if the task is being killed
+ *   SIDE EFFECTS: other tasks run meanwhile
  */
 int32_t rtc_read(fd_array_member_t* f, void* buf, int32_t nbytes) {
     // Block until the next interrupt
-    // Wait until the interrupt handler clears interrupt_flag, then return 0
-
-    if (terminals[curr_executing_terminal_id].rtc_enabled == 1){
-        terminals[curr_executing_terminal_id].rtc_flag = 0;
+    // Wait until the interrupt handler sets ticked, then return 0
+    uint32_t flags;
+    rtc_timer_t* t = &rtc_timers[f->inode];
+    cli_and_save(flags);
+    t->ticked = 0;
+    while (!t->ticked) {
+        if (signal_fatal_pending()) {
+            restore_flags(flags);
+            return -1;
+        }
+        task_block(t);
     }
-    sti();
-    // while (!interrupt_flag) {
-    //     // Do nothing
-    //     asm volatile("hlt");
-    // }
-    // interrupt_flag = 0;
-
-    while (terminals[curr_executing_terminal_id].rtc_flag == 0);
-
-    cli();
-
+    restore_flags(flags);
     return 0;
 }
 
 /* 
  * rtc_write
- *   DESCRIPTION: Set RTC frequency.
+ *   DESCRIPTION: Set the fd's virtual RTC frequency.
  *   INPUTS: f -- file descriptor struct
  *           buf -- buffer to read from
  *           nbytes -- number of bytes to read
  *   OUTPUTS: none
  *   RETURN VALUE: 0 on success, -1 on failure
- *   SIDE EFFECTS: none
+ *   SIDE EFFECTS: may change the hardware rate
  */
 int32_t rtc_write(fd_array_member_t* f, const void* buf, int32_t nbytes) {
     if(buf == NULL) return -1;
@@ -147,9 +273,15 @@ int32_t rtc_write(fd_array_member_t* f, const void* buf, int32_t nbytes) {
     if(freq < RESET_FREQ || freq > MAX_RTC_FREQ) return -1;
     if (!(freq & (freq - 1)) != 1) return -1; // Check if power of 2
 
-
-    terminals[curr_executing_terminal_id].rtc_freq = RTC_FREQ/freq;
-    terminals[curr_executing_terminal_id].rtc_counter = terminals[curr_executing_terminal_id].rtc_freq;
+    uint32_t flags;
+    rtc_timer_t* t = &rtc_timers[f->inode];
+    cli_and_save(flags);
+    t->freq = freq;
+    rtc_remove(t);
+    t->deadline = rtc_time + RTC_FREQ / freq;
+    rtc_insert(t);
+    rtc_update_hw_freq();
+    restore_flags(flags);
     return 0;
 }
 
@@ -164,12 +296,13 @@ int32_t rtc_write(fd_array_member_t* f, const void* buf, int32_t nbytes) {
 int32_t set_rtc_freq(int32_t freq) {
     int32_t rate = freq_to_rate(freq);
     if(rate == -1) return -1;
-    cli();
+    uint32_t flags;
+    cli_and_save(flags);
     outb(disable_NMI_A, RTC_PORT);
     char prev = inb(RTC_DATA);
     outb(disable_NMI_A, RTC_PORT);
     outb((prev & 0xF0) | rate, RTC_DATA);
-    sti();
+    restore_flags(flags);
     return 0;
 }
 
@@ -3,6 +3,7 @@
 
 #include "../lib.h"
 #include "../filesystem/filesys_interface.h"
+#include "../task.h"
 
 #define RTC_IRQ_NUM 8
 
@@ -18,11 +19,24 @@
 #define disable_NMI_C   0x8C
 #define RTC_FREQ       1024
 
+// One virtual RTC for every fd of every task
+#define MAX_RTC_TIMERS (MAX_PID_COUNT * MAX_FILE_COUNT)
+
+typedef struct rtc_timer {
+    uint8_t in_use;                 // number of fds that have this virtual RTC open, spawn copies them
+    uint8_t ticked;                 // set when the deadline passes, rtc_read waits for it
+    int32_t freq;                   // virtual rate in Hz
+    uint32_t deadline;              // next tick, in 1/RTC_FREQ s
+    struct rtc_timer* next;         // next virtual RTC by deadline
+} rtc_timer_t;
+
 extern funcptrs rtc_fops;
+extern rtc_timer_t rtc_timers[MAX_RTC_TIMERS];
 
 void rtc_init();
 int32_t rtc_open(fd_array_member_t* f, const uint8_t* filename);
 int32_t rtc_close(fd_array_member_t* f);
+int32_t rtc_dup(fd_array_member_t* f);
 int32_t rtc_read(fd_array_member_t* f, void* buf, int32_t nbytes);
 int32_t rtc_write(fd_array_member_t* f, const void* buf, int32_t nbytes);
 void rtc_handler();
@@ -0,0 +1,312 @@
+#include "serial.h"
+#include "../lib.h"
+#include "../i8259.h"
+#include "../task.h"
+
+funcptrs serial_fops = {
+    .open = serial_open,
+    .close = serial_close,
+    .read = serial_read,
+    .write = serial_write,
+};
+
+/*
+ * Bytes go out through a ring the interrupt handler feeds the UART's transmit FIFO from, a FIFO load
+ * per interrupt, and come in through a ring it fills from the receive FIFO. The rings are only touched
+ * with interrupts off by whoever holds the kernel lock, like the other drivers' state.
+ */
+static uint8_t serial_tx[SERIAL_TX_SIZE];
+static uint32_t serial_tx_head = 0;         // next byte to hand the UART
+static uint32_t serial_tx_tail = 0;         // next free byte
+static uint8_t serial_rx[SERIAL_RX_SIZE];
+static uint32_t serial_rx_head = 0;         // next byte a read takes
+static uint32_t serial_rx_tail = 0;         // next free byte
+static uint32_t serial_rx_dropped = 0;      // bytes received while the ring was full
+
+static uint8_t serial_found = 0;
+static uint8_t serial_ier = 0;              // what the UART may interrupt for
+static uint8_t serial_console = 0;          // whether the console is mirrored here
+
+/*
+ * serial_init
+ *   DESCRIPTION: Sets up COM1 if there is a UART there: 115200 baud 8N1 with both FIFOs, interrupting
+ *                when bytes arrive
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: programs the UART & enables IRQ 4
+ */
+void serial_init() {
+    // A UART's scratch register keeps what's written to it
+    outb(0x5A, SERIAL_PORT + UART_SCRATCH);
+    if (inb(SERIAL_PORT + UART_SCRATCH) != 0x5A) return;
+
+    outb(0, SERIAL_PORT + UART_IER);
+    outb(UART_LCR_DLAB, SERIAL_PORT + UART_LCR);
+    outb(SERIAL_DIVISOR & 0xFF, SERIAL_PORT + UART_DATA);
+    outb(SERIAL_DIVISOR >> 8, SERIAL_PORT + UART_IER);
+    outb(UART_LCR_8N1, SERIAL_PORT + UART_LCR);
+    outb(UART_FCR_ENABLE, SERIAL_PORT + UART_FCR);
+    outb(UART_MCR_DTR_RTS_OUT2, SERIAL_PORT + UART_MCR);
+    serial_ier = UART_IER_RX;
+    outb(serial_ier, SERIAL_PORT + UART_IER);
+    serial_found = 1;
+    enable_irq(SERIAL_IRQ_NUM);
+}
+
+/*
+ * serial_present
+ *   DESCRIPTION: Tells whether serial_init found a UART
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if it did, 0 if not
+ *   SIDE EFFECTS: none
+ */
+uint8_t serial_present() {
+    return serial_found;
+}
+
+/*
+ * serial_tx_fill
+ *   DESCRIPTION: Hands the UART a FIFO load of the ring if its transmit FIFO is empty. Must be called
+ *                with interrupts disabled.
+ *   INPUTS: none
+ *   OUTPUTS: bytes on the serial port
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: takes the bytes sent out of the ring
+ */
+static void serial_tx_fill() {
+    uint32_t i;
+    if (!(inb(SERIAL_PORT + UART_LSR) & UART_LSR_THRE)) return;
+    for (i = 0; i < UART_FIFO_SIZE && serial_tx_head != serial_tx_tail; i++) {
+        outb(serial_tx[serial_tx_head++ % SERIAL_TX_SIZE], SERIAL_PORT + UART_DATA);
+    }
+}
+
+/*
+ * serial_tx_kick
+ *   DESCRIPTION: Starts sending what was put in the ring, unless the interrupt handler is already at it.
+ *                Must be called with interrupts disabled.
+ *   INPUTS: none
+ *   OUTPUTS: bytes on the serial port
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: turns the transmit interrupt on while there is more than a FIFO load to send
+ */
+static void serial_tx_kick() {
+    if (serial_ier & UART_IER_TX) return;
+    serial_tx_fill();
+    if (serial_tx_head != serial_tx_tail) {
+        serial_ier |= UART_IER_TX;
+        outb(serial_ier, SERIAL_PORT + UART_IER);
+    }
+}
+
+/*
+ * serial_tx_room
+ *   DESCRIPTION: Tells how many bytes serial_send takes right now
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: free bytes in the transmit ring
+ *   SIDE EFFECTS: none
+ */
+uint32_t serial_tx_room() {
+    return SERIAL_TX_SIZE - (serial_tx_tail - serial_tx_head);
+}
+
+/*
+ * serial_send
+ *   DESCRIPTION: Puts bytes in the transmit ring, as many as fit; it never waits for the line. Safe to
+ *                call from interrupt handlers.
+ *   INPUTS: buf -- the bytes
+ *           nbytes -- how many
+ *   OUTPUTS: none
+ *   RETURN VALUE: number of bytes taken, 0 without a UART
+ *   SIDE EFFECTS: may start the transmission
+ */
+uint32_t serial_send(const void* buf, uint32_t nbytes) {
+    uint32_t flags, n = 0;
+    if (!serial_found) return 0;
+
+    cli_and_save(flags);
+    while (n < nbytes && serial_tx_tail - serial_tx_head != SERIAL_TX_SIZE) {
+        serial_tx[serial_tx_tail++ % SERIAL_TX_SIZE] = ((const uint8_t*) buf)[n++];
+    }
+    serial_tx_kick();
+    restore_flags(flags);
+    return n;
+}
+
+/*
+ * serial_set_console
+ *   DESCRIPTION: Turns mirroring the console to the serial port on or off, see serial_console_write
+ *   INPUTS: on -- 1 to mirror it, 0 to stop
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void serial_set_console(uint8_t on) {
+    serial_console = on && serial_found;
+}
+
+/*
+ * serial_console_write
+ *   DESCRIPTION: Mirrors console output (kernel printf & what programs write to their terminal) while
+ *                the mirror is on, with newlines as CR LF for the terminal on the other end. Unlike
+ *                serial_send it waits for room, a log missing lines is no use.
+ *   INPUTS: buf -- the bytes written to the console
+ *           nbytes -- how many
+ *   OUTPUTS: bytes on the serial port
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may busy wait for the UART with interrupts disabled
+ */
+void serial_console_write(const uint8_t* buf, uint32_t nbytes) {
+    uint32_t flags, i;
+    if (!serial_console) return;
+
+    cli_and_save(flags);
+    for (i = 0; i < nbytes; i++) {
+        // Room for a CR LF, the interrupt can't drain the ring with interrupts off so do it here
+        while (SERIAL_TX_SIZE - (serial_tx_tail - serial_tx_head) < 2) {
+            serial_tx_fill();
+        }
+        if (buf[i] == '\n') {
+            serial_tx[serial_tx_tail++ % SERIAL_TX_SIZE] = '\r';
+        }
+        serial_tx[serial_tx_tail++ % SERIAL_TX_SIZE] = buf[i];
+    }
+    serial_tx_kick();
+    restore_flags(flags);
+}
+
+/*
+ * serial_service
+ *   DESCRIPTION: Moves the received bytes into the receive ring and refills the transmit FIFO from the
+ *                transmit ring, then wakes whoever waits on either ring. The interrupt handler's work,
+ *                tests call it directly while the UART can't interrupt. Must be called with interrupts
+ *                disabled.
+ *   INPUTS: none
+ *   OUTPUTS: bytes on the serial port
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: turns the transmit interrupt off once the transmit ring is empty
+ */
+void serial_service() {
+    uint8_t c;
+    // Reading the interrupt identification clears a transmit interrupt
+    inb(SERIAL_PORT + UART_IIR);
+    while (inb(SERIAL_PORT + UART_LSR) & UART_LSR_DR) {
+        c = inb(SERIAL_PORT + UART_DATA);
+        if (serial_rx_tail - serial_rx_head == SERIAL_RX_SIZE) {
+            serial_rx_dropped++;
+        } else {
+            serial_rx[serial_rx_tail++ % SERIAL_RX_SIZE] = c;
+        }
+    }
+
+    if (serial_ier & UART_IER_TX) {
+        serial_tx_fill();
+        if (serial_tx_head == serial_tx_tail) {
+            serial_ier &= ~UART_IER_TX;
+            outb(serial_ier, SERIAL_PORT + UART_IER);
+        }
+    }
+    task_wakeup(serial_rx);
+    task_wakeup(serial_tx);
+}
+
+/*
+ * serial_handler
+ *   DESCRIPTION: Handle a COM1 interrupt, see serial_service
+ *   INPUTS: none
+ *   OUTPUTS: bytes on the serial port
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: acknowledges the interrupt
+ */
+void serial_handler() {
+    serial_service();
+    send_eoi(SERIAL_IRQ_NUM);
+}
+
+/*
+ * serial_open
+ *   DESCRIPTION: Opens the serial port
+ *   INPUTS: f -- file descriptor being opened
+ *           filename -- name it was opened by
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0, -1 without a UART
+ *   SIDE EFFECTS: none
+ */
+int32_t serial_open(fd_array_member_t* f, const uint8_t* filename) {
+    return serial_found ? 0 : -1;
+}
+
+/*
+ * serial_close
+ *   DESCRIPTION: Closes the serial port, bytes still in the transmit ring go out anyway
+ *   INPUTS: f -- file descriptor being closed
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0
+ *   SIDE EFFECTS: none
+ */
+int32_t serial_close(fd_array_member_t* f) {
+    return 0;
+}
+
+/*
+ * serial_read
+ *   DESCRIPTION: Reads the bytes received so far, waiting for the first one if there are none yet
+ *   INPUTS: f -- file descriptor
+ *           buf -- buffer to read into
+ *           nbytes -- size of buf
+ *   OUTPUTS: the bytes
+ *   RETURN VALUE: number of bytes read, -1 if the wait was cut short to kill the caller
+ *   SIDE EFFECTS: takes the bytes read out of the receive ring
+ */
+int32_t serial_read(fd_array_member_t* f, void* buf, int32_t nbytes) {
+    uint32_t flags;
+    int32_t n = 0;
+    if (nbytes <= 0) return 0;
+
+    // Interrupts stay off from checking the ring to sleeping, so the handler's wakeup can't be missed
+    cli_and_save(flags);
+    while (serial_rx_head == serial_rx_tail) {
+        if (signal_fatal_pending()) {
+            restore_flags(flags);
+            return -1;
+        }
+        task_block(serial_rx);
+    }
+    while (n < nbytes && serial_rx_head != serial_rx_tail) {
+        ((uint8_t*) buf)[n++] = serial_rx[serial_rx_head++ % SERIAL_RX_SIZE];
+    }
+    restore_flags(flags);
+    return n;
+}
+
+/*
+ * serial_write
+ *   DESCRIPTION: Sends bytes out the serial port, waiting while the transmit ring is full
+ *   INPUTS: f -- file descriptor
+ *           buf -- the bytes
+ *           nbytes -- how many
+ *   OUTPUTS: none
+ *   RETURN VALUE: number of bytes written, -1 if the wait was cut short to kill the caller
+ *   SIDE EFFECTS: the bytes go out in the background
+ */
+int32_t serial_write(fd_array_member_t* f, const void* buf, int32_t nbytes) {
+    uint32_t flags;
+    int32_t n = 0;
+    if (nbytes < 0) return -1;
+
+    cli_and_save(flags);
+    while (n < nbytes) {
+        n += serial_send((const uint8_t*) buf + n, nbytes - n);
+        if (n == nbytes) break;
+        if (signal_fatal_pending()) {
+            restore_flags(flags);
+            return -1;
+        }
+        task_block(serial_tx);
+    }
+    restore_flags(flags);
+    return n;
+}
@@ -0,0 +1,64 @@
+#ifndef _SERIAL_H
+#define _SERIAL_H
+
+#include "../types.h"
+#include "../filesystem/filesys_interface.h"
+
+#define SERIAL_DEVICE_NAME "serial"
+// Boot parameter mirroring the console (printf & terminal writes) to the serial port
+#define SERIAL_CMDLINE_CONSOLE "console=serial"
+
+// COM1 at 115200 baud, 8N1
+#define SERIAL_IRQ_NUM 4
+#define SERIAL_PORT 0x3F8
+#define SERIAL_DIVISOR 1
+
+/* 16550 UART registers, offsets from the port */
+#define UART_DATA 0
+#define UART_IER 1
+#define UART_IIR 2
+#define UART_FCR 2
+#define UART_LCR 3
+#define UART_MCR 4
+#define UART_LSR 5
+#define UART_SCRATCH 7
+#define UART_LCR_DLAB 0x80
+#define UART_LCR_8N1 0x03
+// Interrupt when a byte arrives, & when the transmit FIFO empties (only while there is more to send)
+#define UART_IER_RX 0x01
+#define UART_IER_TX 0x02
+// Enable & clear both FIFOs, receive trigger at 14 bytes
+#define UART_FCR_ENABLE 0xC7
+// DTR & RTS, OUT2 connects the UART's interrupt line
+#define UART_MCR_DTR_RTS_OUT2 0x0B
+// What goes out comes straight back in, for testing
+#define UART_MCR_LOOPBACK 0x10
+// A received byte waits in the data register
+#define UART_LSR_DR 0x01
+// The transmit FIFO is empty
+#define UART_LSR_THRE 0x20
+// Both the transmit FIFO & the shift register are empty, the last byte is out
+#define UART_LSR_TEMT 0x40
+#define UART_FIFO_SIZE 16
+
+// Bytes waiting to go out / waiting for a read, powers of 2 so the indices can wrap around
+#define SERIAL_TX_SIZE 4096
+#define SERIAL_RX_SIZE 256
+
+extern funcptrs serial_fops;
+
+void serial_init();
+uint8_t serial_present();
+uint32_t serial_tx_room();
+uint32_t serial_send(const void* buf, uint32_t nbytes);
+void serial_set_console(uint8_t on);
+void serial_console_write(const uint8_t* buf, uint32_t nbytes);
+void serial_service();
+void serial_handler();
+
+int32_t serial_open(fd_array_member_t* f, const uint8_t* filename);
+int32_t serial_close(fd_array_member_t* f);
+int32_t serial_read(fd_array_member_t* f, void* buf, int32_t nbytes);
+int32_t serial_write(fd_array_member_t* f, const void* buf, int32_t nbytes);
+
+#endif
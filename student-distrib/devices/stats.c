@@ -0,0 +1,97 @@
+#include "stats.h"
+#include "../lib.h"
+#include "../irq_stats.h"
+#include "../paging.h"
+
+funcptrs stats_fops = {
+    .open = stats_open,
+    .close = stats_close,
+    .read = stats_read,
+    .write = stats_write,
+};
+
+/* 
+ * stats_open
+ *   DESCRIPTION: Opens the interrupt statistics device. Every fd pages through a snapshot of its own,
+ *                kept in a frame its inode points at, so readers can't take one under each other.
+ *   INPUTS: f -- file descriptor being opened
+ *           filename -- name it was opened by
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if the frame pool ran out
+ *   SIDE EFFECTS: none
+ */
+int32_t stats_open(fd_array_member_t* f, const uint8_t* filename) {
+    uint32_t frame = frame_alloc();
+    if (frame == 0) return -1;
+    f->inode = frame;
+    return 0;
+}
+
+/* 
+ * stats_close
+ *   DESCRIPTION: Closes the interrupt statistics device
+ *   INPUTS: f -- file descriptor being closed
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0
+ *   SIDE EFFECTS: frees the fd's snapshot once no copy of the fd uses it
+ */
+int32_t stats_close(fd_array_member_t* f) {
+    frame_put(f->inode);
+    return 0;
+}
+
+/* 
+ * stats_dup
+ *   DESCRIPTION: Counts another open copy of a statistics fd (for descriptors handed to a spawned task),
+ *                the copies share the snapshot
+ *   INPUTS: f -- file descriptor struct that was copied
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 for success, -1 if f is not the statistics device
+ *   SIDE EFFECTS: none
+ */
+int32_t stats_dup(fd_array_member_t* f) {
+    if (f->fops != &stats_fops) return -1;
+    frame_get(f->inode);
+    return 0;
+}
+
+/* 
+ * stats_read
+ *   DESCRIPTION: Reads the text report of irq_stats_format. A read at offset 0 takes a new snapshot,
+ *                later reads continue through it.
+ *   INPUTS: f -- file descriptor
+ *           buf -- buffer to read into
+ *           nbytes -- size of buf
+ *   OUTPUTS: part of the report
+ *   RETURN VALUE: number of bytes read, 0 at the end of the report
+ *   SIDE EFFECTS: advances the file position
+ */
+int32_t stats_read(fd_array_member_t* f, void* buf, int32_t nbytes) {
+    stats_snapshot_t* snapshot = (stats_snapshot_t*) f->inode;
+    uint32_t count;
+    if (nbytes < 0) return -1;
+    if (f->file_pos == 0) {
+        snapshot->len = irq_stats_format(snapshot->report, STATS_SNAPSHOT_SIZE);
+    }
+    if (f->file_pos >= snapshot->len) return 0;
+
+    count = MIN((uint32_t) nbytes, snapshot->len - f->file_pos);
+    memcpy(buf, snapshot->report + f->file_pos, count);
+    f->file_pos += count;
+    return count;
+}
+
+/* 
+ * stats_write
+ *   DESCRIPTION: Any write zeroes the statistics, to measure a workload on its own
+ *   INPUTS: f -- file descriptor
+ *           buf -- ignored
+ *           nbytes -- size of buf
+ *   OUTPUTS: none
+ *   RETURN VALUE: nbytes
+ *   SIDE EFFECTS: resets every counter and histogram
+ */
+int32_t stats_write(fd_array_member_t* f, const void* buf, int32_t nbytes) {
+    irq_stats_reset();
+    return nbytes;
+}
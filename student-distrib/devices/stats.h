@@ -0,0 +1,26 @@
+#ifndef _STATS_H
+#define _STATS_H
+
+#include "../types.h"
+#include "../filesystem/filesys_interface.h"
+#include "../address.h"
+
+#define STATS_DEVICE_NAME "stats"
+
+// An fd's snapshot of the report fills a 4KB frame
+#define STATS_SNAPSHOT_SIZE (PAGE_SIZE_4KB - sizeof(uint32_t))
+
+typedef struct stats_snapshot {
+    uint32_t len;                               // length of the report, taken by a read at offset 0
+    int8_t report[STATS_SNAPSHOT_SIZE];
+} stats_snapshot_t;
+
+extern funcptrs stats_fops;
+
+int32_t stats_open(fd_array_member_t* f, const uint8_t* filename);
+int32_t stats_close(fd_array_member_t* f);
+int32_t stats_dup(fd_array_member_t* f);
+int32_t stats_read(fd_array_member_t* f, void* buf, int32_t nbytes);
+int32_t stats_write(fd_array_member_t* f, const void* buf, int32_t nbytes);
+
+#endif
@@ -6,24 +6,44 @@
 #include "../paging.h"
 #include "../interrupt_handlers/syscalls_def.h"
 #include "../x86_desc.h"
+#include "../timer.h"
+#include "serial.h"
+#include "vga.h"
+#include "../klog.h"
 
 funcptrs stdin_fops = {
     .open = term_open,
     .close = term_close,
     .read = term_read,
-    .write = stdin_write_bad_call
+    .write = stdin_write_bad_call,
+    .ioctl = term_ioctl
 };
 
 funcptrs stdout_fops = {
     .open = term_open,
     .close = term_close,
     .read = stdout_read_bad_call,
-    .write = term_write
+    .write = term_write,
+    .ioctl = term_ioctl
 };
 
-uint8_t curr_executing_terminal_id = 0;
 uint8_t curr_displaying_terminal_id = 0;
-terminal_data_t terminals[MAX_TERMINAL_ID];
+volatile uint32_t term_shell_pending = 0;
+
+// What printf writes to until term_init sets up the terminals, the text stays on terminal 0's screen
+static terminal_data_t boot_terminal = {
+    .ring = (uint16_t*) VIDEO_MEM,
+    .ring_rows = NUM_ROWS,
+    .mode = { .flags = TERM_MODE_DEFAULT },
+    .foreground_pid = -1
+};
+uint32_t num_terminals = 1;
+terminal_data_t* terminals = &boot_terminal;
+
+// Slot of VGA text memory terminals past the ones that own a slot take turns in
+static uint16_t* term_shared_slot = NULL;
+
+static void term_show(uint8_t terminal_id);
 
 /*
  * stdin_write_bad_call
@@ -68,35 +88,68 @@ void term_reset() {
 
 /*
  * term_init
- *   DESCRIPTION: Initializes the terminal.
- *   INPUTS: none
+ *   DESCRIPTION: Initializes the terminals. Their data & the pages the ones without a slot of VGA text
+ *                memory keep their text in come from the frame pool, so it has to be set up first. Only
+ *                terminal 0 gets a shell right away, the others get theirs when they're first switched to.
+ *   INPUTS: count -- number of terminals, 1 to MAX_TERMINAL_ID
  *   OUTPUTS: none
  *   RETURN VALUE: none
  *   SIDE EFFECTS: initializes the cursor & resets the terminal
  */
-void term_init() {
-    uint32_t backing_video_page;
-    int32_t i, j;
-    for (i = 0; i < MAX_TERMINAL_ID; i++) {
-        terminals[i].screen_x = 0;
-        terminals[i].screen_y = 0;
-        terminals[i].is_done_typing = 0;
-        terminals[i].keyboard_buffer_size = 0;
-        terminals[i].curr_pid = -1;
-
-        terminals[i].rtc_enabled = 0;
-        terminals[i].rtc_freq = 0;
-        terminals[i].rtc_counter = 0;
-        terminals[i].rtc_flag = 0;
-
-        backing_video_page = VIDEO_MEM_BACKGROUND_START_ADDR + i * PAGE_SIZE_4KB;
+void term_init(uint32_t count) {
+    terminal_data_t* term;
+    uint32_t i, j, owners, slot_pages;
+
+    if (count < 1 || count > MAX_TERMINAL_ID) count = TERM_DEFAULT_COUNT;
+    if (count * sizeof(terminal_data_t) > PAGE_SIZE_4KB) count = PAGE_SIZE_4KB / sizeof(terminal_data_t);
+    term = (terminal_data_t*) frame_alloc();
+    if (term == NULL) return;
+
+    if (count <= VGA_TEXT_PAGES) {
+        owners = count;
+        slot_pages = VGA_TEXT_PAGES / count;
+    } else {
+        owners = VGA_TEXT_PAGES - 1;
+        slot_pages = 1;
+        term_shared_slot = (uint16_t*) (VIDEO_MEM + owners * PAGE_SIZE_4KB);
+    }
+
+    for (i = 0; i < count; i++) {
+        term[i].screen_x = 0;
+        term[i].screen_y = 0;
+        term[i].is_done_typing = 0;
+        term[i].keyboard_buffer_size = 0;
+        term[i].foreground_pid = -1;
+        term[i].mode.flags = TERM_MODE_DEFAULT;
+        term[i].mode.min = 1;
+        term[i].mode.time_ms = 0;
+        term[i].input_head = 0;
+        term[i].input_tail = 0;
+
+        term[i].ring_rows = slot_pages * PAGE_SIZE_4KB / (NUM_COLS * 2);
+        term[i].top = 0;
+        term[i].scrollback = 0;
+        term[i].screen_writes = 0;
+        if (i < owners) {
+            term[i].ring = (uint16_t*) (VIDEO_MEM + i * slot_pages * PAGE_SIZE_4KB);
+            term[i].backing = NULL;
+        } else {
+            term[i].backing = (uint16_t*) frame_alloc();
+            if (term[i].backing == NULL) break;
+            term[i].ring = term[i].backing;
+        }
         for (j = 0; j < NUM_ROWS * NUM_COLS; j++) {
-            *(uint8_t *)(backing_video_page + (j << 1)) = ' ';
-            *(uint8_t *)(backing_video_page + (j << 1) + 1) = ATTRIB;
+            term[i].ring[j] = (ATTRIB << 8) | ' ';
         }
     }
+
+    terminals = term;
+    num_terminals = i;
+    curr_displaying_terminal_id = 0;
+    term_shell_pending = 1 << 0;
     cursor_init();
     term_reset();
+    term_show(curr_displaying_terminal_id);
     return;
 }
 
@@ -127,24 +180,91 @@ int32_t term_close(fd_array_member_t* f) {
     return -1;
 }
 
+/*
+ * term_read_timeout
+ *   DESCRIPTION: Timer callback ending a raw read's wait
+ *   INPUTS: timer -- the expired timer, its data is the channel the reader sleeps on
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void term_read_timeout(timer_t* timer) {
+    task_wakeup(timer->data);
+}
+
+/*
+ * term_read_raw
+ *   DESCRIPTION: Reads the bytes typed in raw mode straight out of the terminal's input ring, waiting
+ *                for them the way the terminal's min & time_ms ask for.
+ *   INPUTS: term -- the terminal
+ *           buf -- the buffer to read into
+ *           nbytes -- the number of bytes to read
+ *   OUTPUTS: none
+ *   RETURN VALUE: number of bytes read, -1 if the wait was cut short to kill the caller
+ *   SIDE EFFECTS: takes the bytes read out of the ring
+ */
+static int32_t term_read_raw(terminal_data_t* term, uint8_t* buf, int32_t nbytes) {
+    timer_t timer;
+    uint32_t want, n = 0;
+    uint8_t armed = 0;
+
+    want = term->mode.min < (uint32_t) nbytes ? term->mode.min : (uint32_t) nbytes;
+    // Interrupts stay off from checking the ring to sleeping, so neither wakeup can be missed
+    cli();
+    timer_setup(&timer, term_read_timeout, &term->input_tail);
+    if (want == 0 && term->mode.time_ms != 0) {
+        timer_add(&timer, timer_ms_to_ticks(term->mode.time_ms), 0);
+        armed = 1;
+    }
+    while (1) {
+        while (n < (uint32_t) nbytes && term->input_head != term->input_tail) {
+            buf[n++] = term->input[term->input_head++ % TERM_INPUT_SIZE];
+        }
+        if (want != 0 ? n >= want : (n != 0 || term->mode.time_ms == 0)) break;
+        if (armed && !timer_pending(&timer)) break;
+        if (!armed && term->mode.time_ms != 0 && n != 0) {
+            // The wait for the rest starts with the first byte
+            timer_add(&timer, timer_ms_to_ticks(term->mode.time_ms), 0);
+            armed = 1;
+        }
+        if (signal_fatal_pending()) {
+            timer_del(&timer);
+            sti();
+            return -1;
+        }
+        task_block(&term->input_tail);
+    }
+    timer_del(&timer);
+    sti();
+    return n;
+}
+
 /*
  * term_read
- *   DESCRIPTION: Reads from the terminal input buffer.
+ *   DESCRIPTION: Reads from the terminal input buffer. In canonical mode that waits for a whole line,
+ *                in raw mode it takes the bytes typed so far, see term_read_raw.
  *   INPUTS: buf -- the buffer to read into
  *           nbytes -- the number of bytes to read
  *   OUTPUTS: none
- *   RETURN VALUE: 0 for success, -1 for failrure
+ *   RETURN VALUE: number of bytes read, -1 for failure
  *   SIDE EFFECTS: resets the terminal's keyboard buffer once done
  */
 int32_t term_read(fd_array_member_t* f, void* buf, int32_t nbytes) {
     if (buf == NULL) return -1;
+    if (!(terminals[curr_executing_terminal_id].mode.flags & TERM_MODE_CANON)) {
+        return term_read_raw(&terminals[curr_executing_terminal_id], buf, nbytes);
+    }
 
-    // Wait until user is done typing
+    // Sleep until the keyboard thread has a line, interrupts stay off so its wakeup can't be missed
+    cli();
     while (terminals[curr_executing_terminal_id].is_done_typing == 0) {
-        asm volatile("hlt");
+        if (signal_fatal_pending()) {
+            sti();
+            return -1;
+        }
+        task_block(&terminals[curr_executing_terminal_id].is_done_typing);
     }
 
-    cli();
     int i;
     for (i = 0; i < terminals[curr_executing_terminal_id].keyboard_buffer_size; i++) {
         ((char *) buf)[i] = terminals[curr_executing_terminal_id].keyboard_buffer[i];
@@ -158,9 +278,112 @@ int32_t term_read(fd_array_member_t* f, void* buf, int32_t nbytes) {
     return i + 1;
 }
 
+/*
+ * term_input
+ *   DESCRIPTION: Hands a byte typed on a terminal in raw mode to its readers, the keyboard thread's
+ *                side of the input ring. The byte is dropped if the ring is full.
+ *   INPUTS: terminal_id -- the terminal
+ *           c -- the byte
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: echoes the byte in echo mode, wakes the terminal's readers ahead of queued tasks, they
+ *                 run as soon as the keyboard thread sleeps again
+ */
+void term_input(uint8_t terminal_id, uint8_t c) {
+    terminal_data_t* term = &terminals[terminal_id];
+    if (term->input_tail - term->input_head == TERM_INPUT_SIZE) return;
+    term->input[term->input_tail++ % TERM_INPUT_SIZE] = c;
+    // Escape sequences & other control bytes have nothing to show
+    if ((term->mode.flags & TERM_MODE_ECHO) && (c >= ' ' || c == '\n' || c == '\b' || c == '\t')) {
+        putc(c);
+    }
+    task_wakeup_first(&term->input_tail);
+}
+
+/*
+ * term_set_mode
+ *   DESCRIPTION: Changes a terminal's input mode. What was typed & not read yet is thrown away, it was
+ *                meant for the old mode.
+ *   INPUTS: terminal_id -- the terminal
+ *           mode -- the new mode
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 for flags that don't exist
+ *   SIDE EFFECTS: empties the line being typed & the input ring
+ */
+static int32_t term_set_mode(uint8_t terminal_id, const term_mode_t* mode) {
+    terminal_data_t* term = &terminals[terminal_id];
+    uint32_t flags;
+    if (mode->flags & ~(TERM_MODE_CANON | TERM_MODE_ECHO)) return -1;
+
+    cli_and_save(flags);
+    term->mode = *mode;
+    term->keyboard_buffer_size = 0;
+    term->is_done_typing = 0;
+    term->input_head = term->input_tail;
+    restore_flags(flags);
+    return 0;
+}
+
+/*
+ * term_mode_reset
+ *   DESCRIPTION: Puts a terminal back in canonical mode with echo, for when the program that changed
+ *                its mode halts
+ *   INPUTS: terminal_id -- the terminal
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: see term_set_mode
+ */
+void term_mode_reset(uint8_t terminal_id) {
+    term_mode_t mode;
+    if (terminals[terminal_id].mode.flags == TERM_MODE_DEFAULT) return;
+    mode.flags = TERM_MODE_DEFAULT;
+    mode.min = 1;
+    mode.time_ms = 0;
+    term_set_mode(terminal_id, &mode);
+}
+
+/*
+ * term_ioctl
+ *   DESCRIPTION: Reads or changes the input mode of the caller's terminal
+ *   INPUTS: f -- file descriptor struct (unused)
+ *           request -- TERM_GETMODE or TERM_SETMODE
+ *           arg -- user pointer to a term_mode_t to fill in or take the mode from
+ *   OUTPUTS: the mode for TERM_GETMODE
+ *   RETURN VALUE: 0 on success, -1 for a bad request or pointer
+ *   SIDE EFFECTS: see term_set_mode
+ */
+int32_t term_ioctl(fd_array_member_t* f, uint32_t request, void* arg) {
+    if ((uint32_t) arg < USER_STACK_VIRTUAL_ADDR) return -1;
+    if ((uint32_t) arg > USER_STACK_VIRTUAL_ADDR + PAGE_SIZE_4MB - sizeof(term_mode_t)) return -1;
+
+    switch (request) {
+        case TERM_GETMODE:
+            *(term_mode_t*) arg = terminals[curr_executing_terminal_id].mode;
+            return 0;
+        case TERM_SETMODE:
+            return term_set_mode(curr_executing_terminal_id, (term_mode_t*) arg);
+        default:
+            return -1;
+    }
+}
+
+/*
+ * term_is_control
+ *   DESCRIPTION: Tells whether putc does something other than drawing the character
+ *   INPUTS: c -- the character
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 for the characters putc handles specially, 0 for ones it draws
+ *   SIDE EFFECTS: none
+ */
+static inline int32_t term_is_control(uint8_t c) {
+    return c == '\0' || c == '\n' || c == '\r' || c == '\b' || c == '\t';
+}
+
 /*
  * term_write
- *   DESCRIPTION: Writes to the terminal.
+ *   DESCRIPTION: Writes to the terminal. Runs of characters that are drawn as they are go straight
+ *                into video memory a row at a time, control characters go through putc_raw. The
+ *                hardware cursor moves once, at the end.
  *   INPUTS: buf -- the buffer to write from
  *           nbytes -- the number of bytes to read
  *   OUTPUTS: none
@@ -168,14 +391,40 @@ int32_t term_read(fd_array_member_t* f, void* buf, int32_t nbytes) {
  *   SIDE EFFECTS: prints buffer to the screen
  */
 int32_t term_write(fd_array_member_t* f, const void* buf, int32_t nbytes) {
+    const uint8_t* s = (const uint8_t*) buf;
+    terminal_data_t* term;
+    uint16_t* cell;
+    uint32_t flags, run, i = 0;
+
     if (buf == NULL) return -1;
-    int i;
-    // char c;
-    for (i = 0; i < nbytes; i++) {
-        // if ((c = ((char *) buf)[i]) == '\0') {
-        //     return i;
-        // }
-        putc(((char *) buf)[i]);
+    if (nbytes < 0) return -1;
+    while (i < (uint32_t) nbytes) {
+        if (term_is_control(s[i])) {
+            putc_raw(s[i++]);
+            continue;
+        }
+        // The keyboard thread echoes into the same terminal, so the position is read fresh for every run
+        cli_and_save(flags);
+        term = &terminals[curr_executing_terminal_id];
+        cell = term_screen(curr_executing_terminal_id) + NUM_COLS * term->screen_y + term->screen_x;
+        for (run = 0; term->screen_x + run < NUM_COLS && i < (uint32_t) nbytes && !term_is_control(s[i]); run++) {
+            cell[run] = (ATTRIB << 8) | s[i++];
+        }
+        term->screen_writes++;
+        term->screen_x += run;
+        if (term->screen_x >= NUM_COLS) {
+            term->screen_x = 0;
+            term->screen_y++;
+            // Scroll terminal if we reach the end of the screen
+            if (term->screen_y >= NUM_ROWS) {
+                term_scroll(curr_executing_terminal_id);
+            }
+        }
+        restore_flags(flags);
+    }
+    serial_console_write(s, nbytes);
+    if (curr_executing_terminal_id == curr_displaying_terminal_id) {
+        cursor_set(terminals[curr_executing_terminal_id].screen_x, terminals[curr_executing_terminal_id].screen_y);
     }
     return nbytes;
 }
@@ -200,62 +449,277 @@ void cursor_init() {
  * cursor_set
  *   DESCRIPTION: Sets the cursor to the given coordinates.
  *   INPUTS: x -- the x coordinate of the cursor
- *           y -- the y coordinate of the cursor
+ *           y -- the y coordinate of the cursor, on the displayed terminal's screen
  *   OUTPUTS: none
  *   RETURN VALUE: none
  *   SIDE EFFECTS: sets the cursor position.
  */
 void cursor_set(uint32_t x, uint32_t y) {
-    uint32_t pos = y * SCREEN_WIDTH + x;
+    terminal_data_t* term = &terminals[curr_displaying_terminal_id];
+    uint32_t pos = (term->ring - (uint16_t*) VIDEO_MEM) + (term->top + y) * SCREEN_WIDTH + x;
     outb(CURSOR_LOCATION_HIGH, VGA_INDEX_PORT);
     outb(pos >> 8, VGA_DATA_PORT); // high 8 bits
     outb(CURSOR_LOCATION_LOW, VGA_INDEX_PORT);
     outb(pos, VGA_DATA_PORT);
 }
 
+/*
+ * term_show
+ *   DESCRIPTION: Points the display at the displayed terminal's view: its screen, or the rows of
+ *                scrollback it's scrolled back to. A terminal in graphics mode shows its framebuffer.
+ *   INPUTS: terminal_id -- the displayed terminal
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: sets the VGA start address & the cursor, may switch the display's mode
+ */
+static void term_show(uint8_t terminal_id) {
+    terminal_data_t* term = &terminals[terminal_id];
+    uint32_t start = (term->ring - (uint16_t*) VIDEO_MEM) + (term->top - term->scrollback) * NUM_COLS;
+    vga_display(terminal_id);
+    outb(START_ADDRESS_HIGH, VGA_INDEX_PORT);
+    outb(start >> 8, VGA_DATA_PORT);
+    outb(START_ADDRESS_LOW, VGA_INDEX_PORT);
+    outb(start, VGA_DATA_PORT);
+    cursor_set(term->screen_x, term->screen_y);
+}
+
+/*
+ * term_is_vidmapped
+ *   DESCRIPTION: Tells whether a program has the terminal's screen mapped with vidmap
+ *   INPUTS: terminal_id -- the terminal
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if one does, 0 if not
+ *   SIDE EFFECTS: none
+ */
+static int32_t term_is_vidmapped(uint8_t terminal_id) {
+    int32_t pid;
+    pcb_t* pcb;
+    for (pid = 0; pid < MAX_PID_COUNT; pid++) {
+        pcb = get_pcb(pid);
+        if (pcb->active && pcb->is_vidmapped == VIDMAP_LIVE && pcb->terminal_id == terminal_id) return 1;
+    }
+    return 0;
+}
+
+/*
+ * term_scroll
+ *   DESCRIPTION: Scrolls a terminal up a row once its cursor runs off the bottom. The screen moves a row
+ *                down the ring, leaving the top row behind as scrollback, and the display follows it by
+ *                its start address, so only the new bottom row is written. Rows are copied only when
+ *                the screen reaches the end of the ring, then it goes back to the start along with
+ *                half the rows of scrollback. A screen a program has vidmapped, or one with no room for
+ *                scrollback, stays put and scrolls by copying.
+ *   INPUTS: terminal_id -- the terminal
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: moves the cursor to the bottom row
+ */
+void term_scroll(uint8_t terminal_id) {
+    terminal_data_t* term = &terminals[terminal_id];
+    uint16_t* row;
+    uint32_t keep, i;
+
+    term->screen_y = NUM_ROWS - 1;
+    term->screen_writes++;
+    if (term->ring_rows == NUM_ROWS || term_is_vidmapped(terminal_id)) {
+        memmove(term_screen(terminal_id), term_screen(terminal_id) + NUM_COLS, (NUM_ROWS - 1) * NUM_COLS * 2);
+    } else {
+        if (term->top + NUM_ROWS == term->ring_rows) {
+            // The display catches up with the copy below
+            keep = (term->ring_rows - NUM_ROWS) / 2;
+            if (keep > term->top) keep = term->top;
+            memmove(term->ring, term->ring + (term->top - keep) * NUM_COLS, (keep + NUM_ROWS) * NUM_COLS * 2);
+            term->top = keep;
+        }
+        term->top++;
+        // A view scrolled back stays on the rows being read
+        if (term->scrollback != 0) term->scrollback++;
+        if (term->scrollback > term->top) term->scrollback = term->top;
+    }
+
+    row = term_screen(terminal_id) + (NUM_ROWS - 1) * NUM_COLS;
+    for (i = 0; i < NUM_COLS; i++) {
+        row[i] = (ATTRIB << 8) | ' ';
+    }
+    if (terminal_id == curr_displaying_terminal_id) {
+        term_show(terminal_id);
+    }
+}
+
+/*
+ * term_scroll_view
+ *   DESCRIPTION: Scrolls the view of a terminal through its scrollback, Shift+PgUp / Shift+PgDn
+ *   INPUTS: terminal_id -- the terminal
+ *           rows -- rows to scroll back, negative to scroll forward
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: stops at the oldest row kept & at the screen
+ */
+void term_scroll_view(uint8_t terminal_id, int32_t rows) {
+    terminal_data_t* term = &terminals[terminal_id];
+    int32_t scrollback = (int32_t) term->scrollback + rows;
+
+    if (scrollback < 0) scrollback = 0;
+    if (scrollback > (int32_t) term->top) scrollback = term->top;
+    if ((uint32_t) scrollback == term->scrollback) return;
+    term->scrollback = scrollback;
+    if (terminal_id == curr_displaying_terminal_id) {
+        term_show(terminal_id);
+    }
+}
+
+/*
+ * term_pin_screen
+ *   DESCRIPTION: Moves a terminal's screen to the start of its ring, where vidmap maps it
+ *   INPUTS: terminal_id -- the terminal
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: the scrollback is overwritten
+ */
+void term_pin_screen(uint8_t terminal_id) {
+    terminal_data_t* term = &terminals[terminal_id];
+    if (term->top == 0 && term->scrollback == 0) return;
+
+    memmove(term->ring, term_screen(terminal_id), NUM_ROWS * NUM_COLS * 2);
+    term->top = 0;
+    term->scrollback = 0;
+    term->screen_writes++;
+    if (terminal_id == curr_displaying_terminal_id) {
+        term_show(terminal_id);
+    }
+}
+
+/*
+ * term_buffer_init
+ *   DESCRIPTION: Sets up the buffers of vidmap_buffered, both start out as a copy of the terminal's screen
+ *   INPUTS: terminal_id -- the terminal
+ *   OUTPUTS: back -- frame the program draws in
+ *            front -- frame keeping what was presented last
+ *            writes_seen -- the terminal's screen_writes the front buffer matches
+ *   RETURN VALUE: 0 on success, -1 if the frame pool ran out
+ *   SIDE EFFECTS: none
+ */
+int32_t term_buffer_init(uint8_t terminal_id, uint32_t* back, uint32_t* front, uint32_t* writes_seen) {
+    *back = frame_alloc();
+    if (*back == 0) return -1;
+    *front = frame_alloc();
+    if (*front == 0) {
+        frame_put(*back);
+        return -1;
+    }
+    memcpy((void*) *back, term_screen(terminal_id), NUM_ROWS * NUM_COLS * 2);
+    memcpy((void*) *front, term_screen(terminal_id), NUM_ROWS * NUM_COLS * 2);
+    *writes_seen = terminals[terminal_id].screen_writes;
+    return 0;
+}
+
+/*
+ * term_present
+ *   DESCRIPTION: Copies the rows of a back buffer that changed since the last present to the terminal's
+ *                screen. Rows are compared against the front buffer in RAM rather than the screen itself,
+ *                reading VGA memory is slow, and only rows that differ are written to it. Once anything
+ *                else wrote the screen (echo, terminal writes, scrolling, another program's present) the
+ *                front buffer no longer matches it, and every row is copied.
+ *   INPUTS: terminal_id -- the terminal
+ *           back -- frame the program draws in
+ *           front -- frame keeping what was presented last
+ *           writes_seen -- the terminal's screen_writes the front buffer matches
+ *   OUTPUTS: the screen, the front buffer, writes_seen
+ *   RETURN VALUE: number of rows copied
+ *   SIDE EFFECTS: none
+ */
+int32_t term_present(uint8_t terminal_id, uint32_t back, uint32_t front, uint32_t* writes_seen) {
+    terminal_data_t* term = &terminals[terminal_id];
+    uint32_t* b = (uint32_t*) back;
+    uint32_t* f = (uint32_t*) front;
+    uint16_t* screen = term_screen(terminal_id);
+    // A row is NUM_COLS 16 bit cells, compared 2 at a time
+    uint32_t words = NUM_COLS / 2, row, i;
+    uint8_t stale = *writes_seen != term->screen_writes;
+    int32_t flushed = 0;
+
+    for (row = 0; row < NUM_ROWS; row++, b += words, f += words, screen += NUM_COLS) {
+        for (i = 0; i < words && !stale; i++) {
+            if (b[i] != f[i]) break;
+        }
+        if (i == words) continue;
+        memcpy(f, b, NUM_COLS * 2);
+        memcpy(screen, b, NUM_COLS * 2);
+        flushed++;
+    }
+    // Other buffered programs on the terminal have to notice this present
+    if (flushed != 0) term->screen_writes++;
+    *writes_seen = term->screen_writes;
+    return flushed;
+}
+
 /*
  * term_video_switch
- *   DESCRIPTION: Switches the video memory to the given terminal.
+ *   DESCRIPTION: Switches the display to the given terminal's slot of VGA text memory. Every terminal
+ *                that owns a slot keeps writing to it, so nothing is copied or remapped. Terminals that
+ *                share the last slot swap their text in & out of it. A terminal without a shell yet
+ *                gets one.
  *   INPUTS: terminal_id -- the id of the terminal to switch to
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: sets the current display memory & remaps program paging.
+ *   SIDE EFFECTS: sets the VGA start address & the cursor
  */
 void term_video_switch(uint8_t terminal_id) {
+    terminal_data_t* shown;
+    terminal_data_t* next;
     if (curr_displaying_terminal_id == terminal_id) return;
-    if (terminal_id >= MAX_TERMINAL_ID) return;
-    
-    // Copy current video memory to the terminal background video memory
-    memcpy((void*) (VIDEO_MEM_BACKGROUND_START_ADDR + curr_displaying_terminal_id * PAGE_SIZE_4KB), 
-        (const void*) VIDEO_PERM_MEM_ADDR, PAGE_SIZE_4KB);
-    curr_displaying_terminal_id = terminal_id;
-
-    // Previously background task is now being displayed, update paging accordingly
-    map_program(curr_pid, curr_pcb->is_vidmapped, curr_pcb->terminal_id, curr_pcb->terminal_id == curr_displaying_terminal_id);
-
-    // Copy target terminal background video memory to video memory
-    memcpy((void*) VIDEO_PERM_MEM_ADDR, 
-        (const void*) (VIDEO_MEM_BACKGROUND_START_ADDR + curr_displaying_terminal_id * PAGE_SIZE_4KB), PAGE_SIZE_4KB);
+    if (terminal_id >= num_terminals) return;
+    shown = &terminals[curr_displaying_terminal_id];
+    next = &terminals[terminal_id];
 
+    if (shown->backing != NULL) {
+        memcpy(shown->backing, shown->ring, (shown->top + NUM_ROWS) * NUM_COLS * 2);
+        shown->ring = shown->backing;
+    }
+    if (next->backing != NULL) {
+        memcpy(term_shared_slot, next->ring, (next->top + NUM_ROWS) * NUM_COLS * 2);
+        next->ring = term_shared_slot;
+    }
+    curr_displaying_terminal_id = terminal_id;
+    if (shown->backing != NULL || next->backing != NULL) {
+        // vidmap of the terminals that swapped points somewhere else now. Tasks on other processors get
+        // remapped the next time they enter the kernel
+        mapping_generation++;
+        if (curr_pcb != NULL) map_program(curr_pid, curr_pcb->is_vidmapped, curr_pcb->terminal_id);
+    }
+    term_show(terminal_id);
 
-    cursor_set(terminals[curr_displaying_terminal_id].screen_x, terminals[curr_displaying_terminal_id].screen_y);
+    if (next->foreground_pid == -1) {
+        term_shell_pending |= 1 << terminal_id;
+    }
 }
 
 /*
- * term_context_switch
- *   DESCRIPTION: Switches to the task context of the given terminal.
- *   INPUTS: terminal_id -- the id of the terminal to switch to
+ * term_launch_shell
+ *   DESCRIPTION: Switches to a terminal that has no task yet and starts a shell on it.
+ *   INPUTS: terminal_id -- the id of the terminal to launch the shell on
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: sets the current display memory & remaps program paging.
+ *   SIDE EFFECTS: saves the current task context & executes a new shell.
  */
-void term_context_switch(uint8_t terminal_id) {
-    if (curr_executing_terminal_id == terminal_id) return;
-    if (terminal_id >= MAX_TERMINAL_ID) return;
+void term_launch_shell(uint8_t terminal_id) {
+    uint8_t original_terminal_id;
+    term_shell_pending &= ~(1 << terminal_id);
+    if (terminal_id >= num_terminals) return;
+    if (terminals[terminal_id].foreground_pid != -1) return;
+    if (!task_pid_available()) {
+        // Switching to the terminal again tries again
+        klog(KLOG_WARN, "no pid left for a shell on terminal %u", terminal_id + 1);
+        original_terminal_id = curr_executing_terminal_id;
+        curr_executing_terminal_id = terminal_id;
+        printf("No task left for a shell on terminal %d\n", terminal_id + 1);
+        curr_executing_terminal_id = original_terminal_id;
+        return;
+    }
 
     curr_pcb = get_pcb(curr_pid);
     if (curr_pcb != NULL) {
-        // Save stack registers for current task
+        // Save stack registers for current task, task_switch returns here later
         uint32_t saved_esp, saved_ebp;
 
         asm volatile (
@@ -267,32 +731,15 @@ void term_context_switch(uint8_t terminal_id) {
         );
         curr_pcb->esp = saved_esp;
         curr_pcb->ebp = saved_ebp;
+        curr_pcb->lock_depth = this_cpu()->lock_depth;
+        curr_pcb->irq_nesting = this_cpu()->irq_nesting;
+        curr_pcb->on_cpu = 0;
+        task_enqueue(curr_pid);
     }
 
-    // Set the new terminal & its task as the current
+    // Set the new terminal as the current & create its shell task
     curr_executing_terminal_id = terminal_id;
-    curr_pid = terminals[curr_executing_terminal_id].curr_pid;
-    // printf("now executing tid=%d pid=%d\n", curr_executing_terminal_id, curr_pid);
-    if (curr_pid != -1) { // switch to already running task
-        // basically copied from halt, but we aren't returning to a parent
-        tss.ss0 = KERNEL_DS;
-        // 8MB (bottom of 4MB kernel page) - 8KB (size of kernel stack) - 4B (to get to top of stack)
-        tss.esp0 = KERNEL_STACK_ADDR - USER_KERNEL_STACK_SIZE * curr_pid - 0x4;
-        curr_pcb = get_pcb(curr_pid);
-        map_program(curr_pid, curr_pcb->is_vidmapped, curr_pcb->terminal_id, curr_pcb->terminal_id == curr_displaying_terminal_id);
-        
-        // Restore stack pointers (no status code this time)
-        asm volatile ("       \n \
-            movl %0, %%esp \n \
-            movl %1, %%ebp \n \
-            "
-            :
-            : "r" (curr_pcb->esp), "r" (curr_pcb->ebp)
-            : "esp", "ebp"
-        );
-    } else { // create new shell task
-        // printf("launch\n");
-        curr_pcb = NULL;
-        execute((const uint8_t*) "shell");
-    }
+    curr_pid = -1;
+    curr_pcb = NULL;
+    execute((const uint8_t*) "shell");
 }
@@ -5,6 +5,8 @@
 #include "../types.h"
 #include "../filesystem/filesys_interface.h"
 #include "../devices/keyboard.h"
+#include "../smp.h"
+#include "../address.h"
 
 #define SCREEN_WIDTH (320 / 4)
 #define SCREEN_HEIGHT (200 / 4)
@@ -16,47 +18,101 @@
 #define CURSOR_START 0x0A
 #define CURSOR_LOCATION_HIGH 0x0E
 #define CURSOR_LOCATION_LOW 0x0F
-#define MAX_TERMINAL_ID 3
+// Cell the display starts at, the screen scrolls by moving it
+#define START_ADDRESS_HIGH 0x0C
+#define START_ADDRESS_LOW 0x0D
+// Most terminals there can be, one per Alt+F1..F12
+#define MAX_TERMINAL_ID 12
+// Terminals without a "terminals=N" boot parameter
+#define TERM_DEFAULT_COUNT 3
+#define TERM_CMDLINE_PARAM "terminals="
+
+// Terminals own equal, page aligned slots of VGA text memory while there are enough pages for all of
+// them, the display shows one slot at a time. Past that, the ones left share the last page and take
+// turns in it, keeping their text in a page of RAM while they're not displayed
+#define VGA_TEXT_PAGES (VGA_TEXT_MEM_SIZE / PAGE_SIZE_4KB)
+// Rows Shift+PgUp / Shift+PgDn move the view by
+#define TERM_SCROLLBACK_STEP (NUM_ROWS / 2)
+
+// Input modes, like termios' ICANON & ECHO
+#define TERM_MODE_CANON 0x1         // read returns a line at a time, typing edits the line until Enter
+#define TERM_MODE_ECHO 0x2          // typed characters show up on the screen
+#define TERM_MODE_DEFAULT (TERM_MODE_CANON | TERM_MODE_ECHO)
+// Bytes typed in raw mode that wait for a read, a power of 2 so the indices can wrap around
+#define TERM_INPUT_SIZE 128
+
+// ioctl requests on the terminal's fds, arg points to a term_mode_t
+#define TERM_GETMODE 0
+#define TERM_SETMODE 1
+
+typedef struct term_mode {
+    uint32_t flags;             // TERM_MODE_*
+    uint32_t min;               // raw mode: bytes a read waits for, 0 to return what's there
+    uint32_t time_ms;           // raw mode: how long a read waits, from its start with min 0 & from the
+                                // first byte otherwise. 0 waits as long as it takes
+} term_mode_t;
 
 typedef struct terminal_data {
     char keyboard_buffer[KBUFFER_SIZE];
     uint32_t keyboard_buffer_size;
     uint8_t is_done_typing;
 
+    term_mode_t mode;
+    uint8_t input[TERM_INPUT_SIZE];     // bytes typed in raw mode
+    uint32_t input_head;                // next byte a read takes
+    uint32_t input_tail;                // next free byte for the keyboard thread
+
     uint32_t screen_x;
     uint32_t screen_y;
 
-    int32_t curr_pid;
+    uint16_t* ring;             // ring_rows rows of cells, the terminal's slot of VGA text memory
+    uint16_t* backing;          // page the ring is kept in while another terminal has the shared slot, NULL for owned slots
+    uint32_t ring_rows;         // rows of text the terminal keeps, the ones above the screen are its scrollback
+    uint32_t top;               // ring row the screen starts at
+    uint32_t scrollback;        // rows the view is scrolled back from the screen, Shift+PgUp
+    uint32_t screen_writes;     // bumped by every write to the screen, tells present its front buffer is stale
 
-    int32_t rtc_enabled;
-    int32_t rtc_freq;
-    int32_t rtc_counter;
-    int32_t rtc_flag;
-
-    
+    int32_t foreground_pid;     // task in the foreground of the terminal, -1 before its shell starts
 } terminal_data_t;
 
-extern uint8_t curr_executing_terminal_id;
+// Terminal of the task running on the calling processor
+#define curr_executing_terminal_id (this_cpu()->terminal_id)
 extern uint8_t curr_displaying_terminal_id;
-extern terminal_data_t terminals[MAX_TERMINAL_ID];
+extern uint32_t num_terminals;
+extern terminal_data_t* terminals;
+// Bit t set if terminal t waits for the boot processor to start its shell
+extern volatile uint32_t term_shell_pending;
+
+// Video memory of a terminal's screen, rows of NUM_COLS cells
+#define term_screen(terminal_id) (terminals[terminal_id].ring + terminals[terminal_id].top * NUM_COLS)
 
 extern funcptrs stdin_fops;
 extern funcptrs stdout_fops;
 
 extern void term_reset();
-void term_init();
+void term_init(uint32_t count);
 extern int32_t term_open(fd_array_member_t* f, const uint8_t* filename);
 extern int32_t term_close(fd_array_member_t* f);
 extern int32_t term_read(fd_array_member_t* f, void* buf, int32_t nbytes);
 extern int32_t term_write(fd_array_member_t* f, const void* buf, int32_t nbytes);
+extern int32_t term_ioctl(fd_array_member_t* f, uint32_t request, void* arg);
 extern int32_t stdin_write_bad_call(fd_array_member_t *f, const void *buf, int32_t nbytes);
 extern int32_t stdout_read_bad_call(fd_array_member_t *f, void *buf, int32_t nbytes);
 
 extern void cursor_init();
 extern void cursor_set(uint32_t x, uint32_t y);
 
+void term_scroll(uint8_t terminal_id);
+void term_scroll_view(uint8_t terminal_id, int32_t rows);
+void term_pin_screen(uint8_t terminal_id);
+int32_t term_buffer_init(uint8_t terminal_id, uint32_t* back, uint32_t* front, uint32_t* writes_seen);
+int32_t term_present(uint8_t terminal_id, uint32_t back, uint32_t front, uint32_t* writes_seen);
+
+void term_input(uint8_t terminal_id, uint8_t c);
+void term_mode_reset(uint8_t terminal_id);
+
 int get_current_terminal_id();
 void term_video_switch(uint8_t terminal_id);
-void term_context_switch(uint8_t terminal_id);
+void term_launch_shell(uint8_t terminal_id);
 
 #endif
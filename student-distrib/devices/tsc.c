@@ -0,0 +1,117 @@
+#include "tsc.h"
+#include "../lib.h"
+#include "../timer.h"
+
+// Measured TSC frequency, 0 if calibration failed
+uint32_t tsc_khz = 0;
+
+// ns = (cycles * tsc_mult) >> tsc_shift
+static uint32_t tsc_mult = 0;
+static uint32_t tsc_shift = 0;
+// TSC value at boot, now_ns counts from here
+static uint64_t tsc_base = 0;
+
+/* 
+ * rdtsc
+ *   DESCRIPTION: Reads the time stamp counter
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: cycles since the processor was reset
+ *   SIDE EFFECTS: none
+ */
+static inline uint64_t rdtsc() {
+    uint64_t val;
+    asm volatile ("rdtsc" : "=A"(val));
+    return val;
+}
+
+/* 
+ * tsc_init
+ *   DESCRIPTION: Calibrates the TSC by counting cycles while PIT channel 2 counts down a known
+ *                interval. Channel 0 keeps driving the scheduler, channel 2 is normally the speaker.
+ *                Must be called with interrupts disabled.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: uses PIT channel 2 for TSC_CALIBRATE_MS ms
+ */
+void tsc_init() {
+    uint64_t start, cycles, hz, mult;
+    uint32_t loops = 0;
+
+    // Enable the channel 2 gate with the speaker off, then load a one-shot count
+    outb((inb(PIT_PORT_B) & ~PIT_PORT_B_SPEAKER) | PIT_PORT_B_GATE2, PIT_PORT_B);
+    outb(PIT_CHANNEL2_MODE, PIT_PORT);
+    outb(TSC_CALIBRATE_LATCH & 0xFF, PIT_CHANNEL2_DATA);
+    outb((TSC_CALIBRATE_LATCH >> 8) & 0xFF, PIT_CHANNEL2_DATA);
+
+    // OUT2 goes high when the count reaches 0. Give up on broken hardware instead of hanging
+    start = rdtsc();
+    while (!(inb(PIT_PORT_B) & PIT_PORT_B_OUT2) && loops < TSC_CALIBRATE_MAX_LOOPS) {
+        loops++;
+    }
+    cycles = rdtsc() - start;
+    tsc_base = start;
+    if (loops == TSC_CALIBRATE_MAX_LOOPS || cycles == 0) {
+        printf("TSC calibration failed\n");
+        return;
+    }
+
+    hz = cycles * (1000 / TSC_CALIBRATE_MS);
+    mult = hz;
+    div64_32(&mult, 1000);
+    tsc_khz = (uint32_t) mult;
+
+    // Largest shift whose multiplier still fits in 32 bits, for the best precision
+    for (tsc_shift = 32; tsc_shift > 0; tsc_shift--) {
+        mult = (uint64_t) NS_PER_MS << tsc_shift;
+        div64_32(&mult, tsc_khz);
+        if ((mult >> 32) == 0) break;
+    }
+    tsc_mult = (uint32_t) mult;
+}
+
+/* 
+ * now_cycles
+ *   DESCRIPTION: Reads the cycle counter, for measuring short intervals cheaply
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: current TSC value
+ *   SIDE EFFECTS: none
+ */
+uint64_t now_cycles() {
+    return rdtsc();
+}
+
+/* 
+ * cycles_to_ns
+ *   DESCRIPTION: Converts a number of TSC cycles to nanoseconds
+ *   INPUTS: cycles -- number of cycles
+ *   OUTPUTS: none
+ *   RETURN VALUE: nanoseconds, 0 if the TSC isn't calibrated
+ *   SIDE EFFECTS: none
+ */
+uint64_t cycles_to_ns(uint64_t cycles) {
+    // 64 x 32 bit multiply in two halves so the product doesn't overflow before the shift
+    uint64_t low = (uint64_t) (uint32_t) cycles * tsc_mult;
+    uint64_t high = (uint64_t) (uint32_t) (cycles >> 32) * tsc_mult;
+    if (tsc_shift == 32) {
+        return (low >> 32) + high;
+    }
+    return (low >> tsc_shift) + (high << (32 - tsc_shift));
+}
+
+/* 
+ * now_ns
+ *   DESCRIPTION: Gets a monotonic time with nanosecond resolution
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: nanoseconds since boot, only timer tick resolution if the TSC isn't calibrated
+ *   SIDE EFFECTS: none
+ */
+uint64_t now_ns() {
+    if (tsc_khz == 0) {
+        return (uint64_t) timer_ticks * (NS_PER_SEC / TIMER_TICK_HZ);
+    }
+    return cycles_to_ns(rdtsc() - tsc_base);
+}
@@ -0,0 +1,41 @@
+#ifndef _TSC_H
+#define _TSC_H
+
+#include "../types.h"
+#include "pit.h"
+
+// PIT channel 2, gated through the keyboard controller's port B
+#define PIT_CHANNEL2_DATA 0x42
+#define PIT_PORT_B 0x61
+#define PIT_PORT_B_GATE2 0x01
+#define PIT_PORT_B_SPEAKER 0x02
+#define PIT_PORT_B_OUT2 0x20
+// 0b10110000
+// Channel 2, lobyte/hibyte, interrupt on terminal count, binary mode
+#define PIT_CHANNEL2_MODE 0xB0
+
+// Length of the calibration window
+#define TSC_CALIBRATE_MS 50
+#define TSC_CALIBRATE_LATCH (PIT_BASE_FREQ * TSC_CALIBRATE_MS / 1000)
+// Port reads take about a microsecond, so this is seconds -- far longer than the window
+#define TSC_CALIBRATE_MAX_LOOPS 10000000
+
+#define NS_PER_SEC 1000000000
+#define NS_PER_MS 1000000
+
+// Clocks of clock_gettime
+#define CLOCK_MONOTONIC 0
+
+typedef struct timespec {
+    uint32_t tv_sec;
+    uint32_t tv_nsec;
+} timespec_t;
+
+extern uint32_t tsc_khz;
+
+void tsc_init();
+uint64_t now_cycles();
+uint64_t now_ns();
+uint64_t cycles_to_ns(uint64_t cycles);
+
+#endif
@@ -0,0 +1,354 @@
+#include "vga.h"
+#include "terminal.h"
+#include "../lib.h"
+#include "../paging.h"
+#include "../task.h"
+
+/*
+ * Graphics go through the Bochs/QEMU display interface rather than mode 13h: mode 13h's window is the
+ * same video memory the text mode keeps every terminal's characters & the font in. The framebuffer sits
+ * in video memory past the text planes instead, so the text survives and switching back is a matter of
+ * turning the interface off & restoring the VGA registers it changed. While the framebuffer is shown the
+ * legacy text window doesn't reach video memory, so the kernel's mapping of it is pointed at a copy in
+ * RAM meanwhile, and terminals in the background keep their output.
+ */
+typedef struct vga_regs {
+    uint8_t misc;
+    uint8_t seq[VGA_NUM_SEQ_REGS];
+    uint8_t crtc[VGA_NUM_CRTC_REGS];
+    uint8_t gc[VGA_NUM_GC_REGS];
+    uint8_t ac[VGA_NUM_AC_REGS];
+} vga_regs_t;
+
+static uint32_t vga_lfb = 0;                // physical address of the framebuffer BAR, 0 without the interface
+static uint32_t vga_vram_size = 0;
+static int32_t vga_gfx_pid = -1;            // task that has its terminal in graphics mode, -1 if none does
+static uint8_t vga_gfx_terminal = 0;
+static uint32_t vga_width = 0;
+static uint32_t vga_height = 0;
+static uint32_t vga_fb_offset = 0;          // where the framebuffer starts in video memory, page aligned
+static uint32_t vga_fb_pages = 0;
+static uint32_t vga_generation = 0;         // bumped whenever the framebuffer moves or changes hands
+static uint8_t vga_shown = 0;               // whether the display shows the framebuffer right now
+static vga_regs_t vga_text_regs;            // the text mode's registers, saved while the framebuffer is shown
+static uint16_t vga_text_shadow[VGA_TEXT_MEM_SIZE / 2] __attribute__((aligned(PAGE_SIZE_4KB)));
+
+// Framebuffer pages each processor's vidmap table has, & vga_generation when it got them
+static uint32_t vga_cpu_pages[MAX_CPUS];
+static uint32_t vga_cpu_generation[MAX_CPUS];
+
+/*
+ * pci_config_read
+ *   DESCRIPTION: Reads a register of a PCI device's configuration space
+ *   INPUTS: bus, device, function -- the device
+ *           offset -- register offset, a multiple of 4
+ *   OUTPUTS: none
+ *   RETURN VALUE: the register, all ones if there is no such device
+ *   SIDE EFFECTS: none
+ */
+static uint32_t pci_config_read(uint32_t bus, uint32_t device, uint32_t function, uint32_t offset) {
+    outl(PCI_CONFIG_ENABLE | (bus << 16) | (device << 11) | (function << 8) | offset, PCI_CONFIG_ADDRESS);
+    return inl(PCI_CONFIG_DATA);
+}
+
+/*
+ * dispi_read / dispi_write
+ *   DESCRIPTION: Read / write a register of the display interface
+ *   INPUTS: index -- VBE_DISPI_INDEX_*
+ *           value -- new value
+ *   OUTPUTS: none
+ *   RETURN VALUE: the register
+ *   SIDE EFFECTS: none
+ */
+static uint32_t dispi_read(uint32_t index) {
+    outw(index, VBE_DISPI_INDEX_PORT);
+    return inw(VBE_DISPI_DATA_PORT);
+}
+
+static void dispi_write(uint32_t index, uint32_t value) {
+    outw(index, VBE_DISPI_INDEX_PORT);
+    outw(value, VBE_DISPI_DATA_PORT);
+}
+
+/*
+ * vga_init
+ *   DESCRIPTION: Looks for the display interface & its framebuffer, the adapter QEMU & Bochs emulate
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void vga_init() {
+    uint32_t id, device;
+    id = dispi_read(VBE_DISPI_INDEX_ID);
+    if (id < VBE_DISPI_ID_MIN || id > VBE_DISPI_ID_MAX) return;
+
+    // QEMU puts the adapter on the first bus
+    for (device = 0; device < PCI_DEVICES_PER_BUS; device++) {
+        if (pci_config_read(0, device, 0, 0) == (VBE_PCI_DEVICE << 16 | VBE_PCI_VENDOR)) {
+            vga_lfb = pci_config_read(0, device, 0, PCI_BAR0) & PCI_BAR_MEM_MASK;
+            break;
+        }
+    }
+    vga_vram_size = dispi_read(VBE_DISPI_INDEX_VIDEO_MEMORY_64K) * 0x10000;
+}
+
+/*
+ * vga_gfx_available
+ *   DESCRIPTION: Tells whether vga_init found a framebuffer
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if it did, 0 if not
+ *   SIDE EFFECTS: none
+ */
+uint8_t vga_gfx_available() {
+    return vga_lfb != 0;
+}
+
+/*
+ * vga_regs_save / vga_regs_restore
+ *   DESCRIPTION: Read / write the VGA registers that make up a mode. The start address & the cursor are
+ *                left as they are when restoring, the terminal kept them up to date meanwhile.
+ *   INPUTS: regs -- the registers
+ *   OUTPUTS: regs -- the registers read
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: the attribute controller hands the palette back to the display
+ */
+static void vga_regs_save(vga_regs_t* regs) {
+    uint32_t i;
+    regs->misc = inb(VGA_MISC_READ);
+    for (i = 0; i < VGA_NUM_SEQ_REGS; i++) {
+        outb(i, VGA_SEQ_INDEX);
+        regs->seq[i] = inb(VGA_SEQ_DATA);
+    }
+    for (i = 0; i < VGA_NUM_CRTC_REGS; i++) {
+        outb(i, VGA_INDEX_PORT);
+        regs->crtc[i] = inb(VGA_DATA_PORT);
+    }
+    for (i = 0; i < VGA_NUM_GC_REGS; i++) {
+        outb(i, VGA_GC_INDEX);
+        regs->gc[i] = inb(VGA_GC_DATA);
+    }
+    for (i = 0; i < VGA_NUM_AC_REGS; i++) {
+        inb(VGA_INSTAT_READ);
+        outb(i, VGA_AC_INDEX);
+        regs->ac[i] = inb(VGA_AC_READ);
+    }
+    inb(VGA_INSTAT_READ);
+    outb(VGA_AC_PALETTE_SOURCE, VGA_AC_INDEX);
+}
+
+static void vga_regs_restore(vga_regs_t* regs) {
+    uint32_t i;
+    outb(regs->misc, VGA_MISC_WRITE);
+    for (i = 0; i < VGA_NUM_SEQ_REGS; i++) {
+        outb(i, VGA_SEQ_INDEX);
+        outb(regs->seq[i], VGA_SEQ_DATA);
+    }
+    // Registers 0-7 are write protected until the protect bit is cleared, it's restored last
+    outb(VGA_CRTC_VERTICAL_RETRACE_END, VGA_INDEX_PORT);
+    outb(regs->crtc[VGA_CRTC_VERTICAL_RETRACE_END] & ~VGA_CRTC_PROTECT, VGA_DATA_PORT);
+    for (i = 0; i < VGA_NUM_CRTC_REGS; i++) {
+        if (i == VGA_CRTC_VERTICAL_RETRACE_END) continue;
+        if (i >= START_ADDRESS_HIGH && i <= CURSOR_LOCATION_LOW) continue;
+        outb(i, VGA_INDEX_PORT);
+        outb(regs->crtc[i], VGA_DATA_PORT);
+    }
+    outb(VGA_CRTC_VERTICAL_RETRACE_END, VGA_INDEX_PORT);
+    outb(regs->crtc[VGA_CRTC_VERTICAL_RETRACE_END], VGA_DATA_PORT);
+    for (i = 0; i < VGA_NUM_GC_REGS; i++) {
+        outb(i, VGA_GC_INDEX);
+        outb(regs->gc[i], VGA_GC_DATA);
+    }
+    for (i = 0; i < VGA_NUM_AC_REGS; i++) {
+        inb(VGA_INSTAT_READ);
+        outb(i, VGA_AC_INDEX);
+        outb(regs->ac[i], VGA_AC_WRITE);
+    }
+    inb(VGA_INSTAT_READ);
+    outb(VGA_AC_PALETTE_SOURCE, VGA_AC_INDEX);
+}
+
+/*
+ * vga_text_remap
+ *   DESCRIPTION: Points every processor's kernel mapping of VGA text memory at the copy in RAM or back
+ *                at the hardware. Terminal rings keep their addresses either way.
+ *   INPUTS: to_shadow -- 1 for the copy, 0 for the hardware
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: other processors pick the change up the next time they enter the kernel
+ */
+static void vga_text_remap(uint8_t to_shadow) {
+    uint32_t cpu, i;
+    for (cpu = 0; cpu < num_cpus; cpu++) {
+        for (i = 0; i < VGA_TEXT_PAGES; i++) {
+            cpu_page_table[cpu][VIDEO_MEM_INDEX + i].page_addr =
+                to_shadow ? (uint32_t) vga_text_shadow / PAGE_SIZE_4KB + i : VIDEO_MEM_INDEX + i;
+        }
+    }
+    // vidmap of text terminals follows the kernel's mapping
+    mapping_generation++;
+    if (curr_pcb != NULL) {
+        map_program(curr_pid, curr_pcb->is_vidmapped, curr_pcb->terminal_id);
+    } else {
+        flush_tlb();
+    }
+}
+
+/*
+ * vga_fb_show / vga_fb_hide
+ *   DESCRIPTION: Turn the display over to the framebuffer / back to text
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: text memory moves to RAM & back, see vga_text_remap
+ */
+static void vga_fb_show() {
+    uint32_t pitch = vga_width * (VGA_GFX_BPP / 8);
+    vga_regs_save(&vga_text_regs);
+    memcpy(vga_text_shadow, (void*) VIDEO_MEM, VGA_TEXT_MEM_SIZE);
+    vga_text_remap(1);
+
+    dispi_write(VBE_DISPI_INDEX_ENABLE, 0);
+    dispi_write(VBE_DISPI_INDEX_XRES, vga_width);
+    dispi_write(VBE_DISPI_INDEX_YRES, vga_height);
+    dispi_write(VBE_DISPI_INDEX_BPP, VGA_GFX_BPP);
+    dispi_write(VBE_DISPI_INDEX_ENABLE, VBE_DISPI_ENABLED | VBE_DISPI_LFB_ENABLED | VBE_DISPI_NOCLEARMEM);
+    // Enabling resets the offsets, the display starts at the framebuffer's row after that
+    dispi_write(VBE_DISPI_INDEX_VIRT_WIDTH, vga_width);
+    dispi_write(VBE_DISPI_INDEX_VIRT_HEIGHT, vga_fb_offset / pitch + vga_height);
+    dispi_write(VBE_DISPI_INDEX_Y_OFFSET, vga_fb_offset / pitch);
+    vga_shown = 1;
+}
+
+static void vga_fb_hide() {
+    dispi_write(VBE_DISPI_INDEX_ENABLE, 0);
+    vga_regs_restore(&vga_text_regs);
+    vga_text_remap(0);
+    memcpy((void*) VIDEO_MEM, vga_text_shadow, VGA_TEXT_MEM_SIZE);
+    vga_shown = 0;
+}
+
+/*
+ * vga_display
+ *   DESCRIPTION: Shows the framebuffer if the displayed terminal is in graphics mode, text otherwise.
+ *                Called whenever the terminal shows what it displays, only a change costs anything.
+ *   INPUTS: terminal_id -- the displayed terminal
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may switch the display's mode
+ */
+void vga_display(uint8_t terminal_id) {
+    uint8_t show = vga_gfx_pid != -1 && terminal_id == vga_gfx_terminal;
+    if (show == vga_shown) return;
+    if (show) {
+        vga_fb_show();
+    } else {
+        vga_fb_hide();
+    }
+}
+
+/*
+ * vga_set_mode
+ *   DESCRIPTION: Puts a task's terminal in a graphics mode with 32 bit pixels, or back in text mode. One
+ *                task has graphics at a time; it may change the resolution as often as it likes.
+ *   INPUTS: pid -- the task
+ *           terminal_id -- its terminal
+ *           width -- pixels per row, a multiple of 8 from 64 to VBE_DISPI_MAX_XRES, 0 for text mode
+ *           height -- rows, up to VBE_DISPI_MAX_YRES, 0 for text mode
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if the mode can't be had
+ *   SIDE EFFECTS: clears the framebuffer, the display shows it if the terminal is displayed
+ */
+int32_t vga_set_mode(int32_t pid, uint8_t terminal_id, uint32_t width, uint32_t height) {
+    uint32_t pitch, size, rows;
+    if (width == 0 && height == 0) {
+        vga_release(pid);
+        return 0;
+    }
+    if (vga_lfb == 0) return -1;
+    if (vga_gfx_pid != -1 && vga_gfx_pid != pid) return -1;
+    // Narrower rows could put the first page aligned row past what the offset register takes
+    if (width < 64 || width > VBE_DISPI_MAX_XRES || width % 8 != 0) return -1;
+    if (height == 0 || height > VBE_DISPI_MAX_YRES) return -1;
+    pitch = width * (VGA_GFX_BPP / 8);
+    size = pitch * height;
+    if (size > PROGRAM_FB_MAX_SIZE) return -1;
+
+    // First row past the text planes that starts on a page, vidmap maps the framebuffer by the page
+    for (rows = VGA_TEXT_PLANES_SIZE / pitch; rows * pitch < VGA_TEXT_PLANES_SIZE || rows * pitch % PAGE_SIZE_4KB != 0; rows++);
+    if (rows * pitch + size > vga_vram_size) return -1;
+
+    if (vga_shown) vga_fb_hide();
+    vga_gfx_pid = pid;
+    vga_gfx_terminal = terminal_id;
+    vga_width = width;
+    vga_height = height;
+    vga_fb_offset = rows * pitch;
+    vga_fb_pages = (size + PAGE_SIZE_4KB - 1) / PAGE_SIZE_4KB;
+    vga_generation++;
+
+    memset(map_fb_window(vga_lfb + vga_fb_offset), 0, size);
+    vga_display(curr_displaying_terminal_id);
+    return 0;
+}
+
+/*
+ * vga_release
+ *   DESCRIPTION: Puts the terminal of a task in graphics mode back in text mode, called when it halts
+ *   INPUTS: pid -- the task
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: the display shows text again if it showed the framebuffer
+ */
+void vga_release(int32_t pid) {
+    if (vga_gfx_pid == -1 || vga_gfx_pid != pid) return;
+    vga_gfx_pid = -1;
+    vga_generation++;
+    if (vga_shown) vga_fb_hide();
+}
+
+/*
+ * vga_gfx_owner
+ *   DESCRIPTION: Tells whether a task has its terminal in graphics mode
+ *   INPUTS: pid -- the task
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if it does, 0 if not
+ *   SIDE EFFECTS: none
+ */
+uint8_t vga_gfx_owner(int32_t pid) {
+    return vga_gfx_pid != -1 && vga_gfx_pid == pid;
+}
+
+/*
+ * vga_map_task
+ *   DESCRIPTION: Maps the framebuffer into the calling processor's vidmap table for the task that has
+ *                graphics, write-combining when the PAT allows it, and takes it out for every other
+ *                task. Called by map_program, which flushes the TLB.
+ *   INPUTS: pid -- task being mapped
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void vga_map_task(int32_t pid) {
+    uint32_t cpu = this_cpu()->id;
+    uint32_t pages = vga_gfx_owner(pid) ? vga_fb_pages : 0;
+    page_table_entry_t* entry;
+    uint32_t i;
+    if (vga_cpu_pages[cpu] == pages && vga_cpu_generation[cpu] == vga_generation) return;
+
+    for (i = 0; i < vga_cpu_pages[cpu]; i++) {
+        vidmap_page_table[PROGRAM_FB_INDEX + i].present = 0;
+    }
+    for (i = 0; i < pages; i++) {
+        entry = &vidmap_page_table[PROGRAM_FB_INDEX + i];
+        entry->page_addr = (vga_lfb + vga_fb_offset) / PAGE_SIZE_4KB + i;
+        // PWT alone selects PAT entry 1, which paging_init_pat makes write-combining
+        entry->write_through = pat_write_combining;
+        entry->cache_disable = !pat_write_combining;
+        entry->pt_attribute_index = 0;
+        entry->present = 1;
+    }
+    vga_cpu_pages[cpu] = pages;
+    vga_cpu_generation[cpu] = vga_generation;
+}
@@ -0,0 +1,72 @@
+#ifndef _VGA_H
+#define _VGA_H
+
+#include "../types.h"
+
+/* VGA registers the text mode is saved & restored through, see vga_regs_save */
+#define VGA_MISC_READ 0x3CC
+#define VGA_MISC_WRITE 0x3C2
+#define VGA_SEQ_INDEX 0x3C4
+#define VGA_SEQ_DATA 0x3C5
+#define VGA_GC_INDEX 0x3CE
+#define VGA_GC_DATA 0x3CF
+#define VGA_AC_INDEX 0x3C0
+#define VGA_AC_WRITE 0x3C0
+#define VGA_AC_READ 0x3C1
+// Reading it sets the attribute controller back to taking an index
+#define VGA_INSTAT_READ 0x3DA
+#define VGA_NUM_SEQ_REGS 5
+#define VGA_NUM_CRTC_REGS 25
+#define VGA_NUM_GC_REGS 9
+#define VGA_NUM_AC_REGS 21
+// Attribute controller index bit that hands the palette back to the display
+#define VGA_AC_PALETTE_SOURCE 0x20
+// CRTC register whose top bit write protects registers 0-7
+#define VGA_CRTC_VERTICAL_RETRACE_END 0x11
+#define VGA_CRTC_PROTECT 0x80
+
+/* Bochs/QEMU display interface ("-vga std"), a linear framebuffer in the adapter's PCI BAR 0 */
+#define VBE_DISPI_INDEX_PORT 0x1CE
+#define VBE_DISPI_DATA_PORT 0x1CF
+#define VBE_DISPI_INDEX_ID 0x0
+#define VBE_DISPI_INDEX_XRES 0x1
+#define VBE_DISPI_INDEX_YRES 0x2
+#define VBE_DISPI_INDEX_BPP 0x3
+#define VBE_DISPI_INDEX_ENABLE 0x4
+#define VBE_DISPI_INDEX_VIRT_WIDTH 0x6
+#define VBE_DISPI_INDEX_VIRT_HEIGHT 0x7
+#define VBE_DISPI_INDEX_Y_OFFSET 0x9
+#define VBE_DISPI_INDEX_VIDEO_MEMORY_64K 0xA
+// Versions with 32 bit color & the linear framebuffer
+#define VBE_DISPI_ID_MIN 0xB0C2
+#define VBE_DISPI_ID_MAX 0xB0CF
+#define VBE_DISPI_ENABLED 0x01
+#define VBE_DISPI_LFB_ENABLED 0x40
+// Keep video memory as it is, clearing it would wipe the text mode's planes
+#define VBE_DISPI_NOCLEARMEM 0x80
+#define VBE_DISPI_MAX_XRES 1024
+#define VBE_DISPI_MAX_YRES 768
+#define VBE_PCI_VENDOR 0x1234
+#define VBE_PCI_DEVICE 0x1111
+
+#define PCI_CONFIG_ADDRESS 0xCF8
+#define PCI_CONFIG_DATA 0xCFC
+#define PCI_CONFIG_ENABLE 0x80000000
+#define PCI_DEVICES_PER_BUS 32
+#define PCI_BAR0 0x10
+#define PCI_BAR_MEM_MASK 0xFFFFFFF0
+
+// Graphics modes have 32 bit pixels, 0x00RRGGBB
+#define VGA_GFX_BPP 32
+// Video memory the text mode keeps its characters & font in, the framebuffer starts past it
+#define VGA_TEXT_PLANES_SIZE 0x40000
+
+void vga_init();
+uint8_t vga_gfx_available();
+int32_t vga_set_mode(int32_t pid, uint8_t terminal_id, uint32_t width, uint32_t height);
+void vga_release(int32_t pid);
+uint8_t vga_gfx_owner(int32_t pid);
+void vga_display(uint8_t terminal_id);
+void vga_map_task(int32_t pid);
+
+#endif
@@ -1,5 +1,14 @@
 #include "filesys.h"
 #include "../interrupt_handlers/syscalls_def.h"
+#include "../trace.h"
+
+boot_block_t* boot_block_ptr;
+inode_t* inode_ptr;
+data_block_t* data_block_ptr;
+
+dentry_t curr_dentry;
+
+int32_t curr_idx;
 
 funcptrs directory_fops = {
     .open = dir_open,
@@ -159,7 +168,9 @@ int32_t file_open(fd_array_member_t* f, const uint8_t* filename){
  *   SIDE EFFECTS: fills the buffer
  */
 int32_t file_read(fd_array_member_t* f, void* buf, int32_t nbytes){
+    TRACE(TRACE_FS_READ, f->inode, nbytes);
     int32_t fl = read_data(f->inode, f->file_pos, buf, nbytes);
+    TRACE(TRACE_FS_READ_DONE, f->inode, fl);
     if (fl == -1) return -1;
     f->file_pos += fl;
     return fl;
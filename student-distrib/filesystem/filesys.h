@@ -38,13 +38,13 @@ typedef struct data_block {
     uint8_t data[BLOCK_SIZE];
 } data_block_t;
 
-boot_block_t* boot_block_ptr;
-inode_t* inode_ptr;
-data_block_t* data_block_ptr;
+extern boot_block_t* boot_block_ptr;
+extern inode_t* inode_ptr;
+extern data_block_t* data_block_ptr;
 
-dentry_t curr_dentry;
+extern dentry_t curr_dentry;
 
-int32_t curr_idx;
+extern int32_t curr_idx;
 
 extern funcptrs directory_fops;
 extern funcptrs regular_fops;
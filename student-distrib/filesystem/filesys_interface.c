@@ -2,6 +2,19 @@
 #include "../devices/rtc.h"
 #include "filesys.h"
 #include "../devices/terminal.h"
+#include "../devices/pipe.h"
+#include "../devices/stats.h"
+#include "../devices/profiler.h"
+#include "../devices/serial.h"
+#include "../devices/kmsg.h"
+
+// Kernel devices that have no file system entry, opened by name
+static named_device_t named_devices[] = {
+    { STATS_DEVICE_NAME, &stats_fops },
+    { PROFILER_DEVICE_NAME, &profiler_fops },
+    { SERIAL_DEVICE_NAME, &serial_fops },
+    { KMSG_DEVICE_NAME, &kmsg_fops },
+};
 
 /* 
 * fs_interface_init
@@ -26,6 +39,24 @@ int32_t fs_interface_init(fd_array_member_t* fd_array) {
     return 0;
 }
 
+/* 
+* fs_interface_device
+*   DESCRIPTION: Looks up a kernel device that has no file system entry
+*   INPUTS: filename: the name being opened
+*   OUTPUTS: none
+*   RETURN VALUE: the device's file operations, NULL if no device has that name
+*   SIDE EFFECTS: none
+*/
+funcptrs* fs_interface_device(const uint8_t* filename) {
+    uint32_t i;
+    for (i = 0; i < sizeof(named_devices) / sizeof(named_devices[0]); i++) {
+        if (strncmp(named_devices[i].name, (int8_t*) filename, strlen(named_devices[i].name) + 1) == 0) {
+            return named_devices[i].fops;
+        }
+    }
+    return NULL;
+}
+
 /* 
 * fs_interface_read
 *   DESCRIPTION: Reads from the keyboard, a file, device (RTC), or directory
@@ -94,3 +125,38 @@ int32_t fs_interface_close(fd_array_member_t* f) {
     }
     return -1;
 }
+
+/*
+* fs_interface_ioctl
+*   DESCRIPTION: Controls a device through an open file descriptor
+*   INPUTS: f: the file descriptor array member
+*           request: what to do, the device defines its requests
+*           arg: the request's argument
+*   OUTPUTS: none
+*   RETURN VALUE: what the device returns, -1 if it has no controls
+*   SIDE EFFECTS: whatever the request does
+*/
+int32_t fs_interface_ioctl(fd_array_member_t* f, uint32_t request, void* arg) {
+    if (f->fops == NULL || f->fops->ioctl == NULL || f->flags == 0) return -1;
+    return f->fops->ioctl(f, request, arg);
+}
+
+/*
+* fs_interface_dup
+*   DESCRIPTION: Copies an open file descriptor into another file descriptor array member
+*   INPUTS: dest: the file descriptor array member to fill in
+*           src: the open file descriptor array member to copy
+*   OUTPUTS: none
+*   RETURN VALUE: 0 on success, -1 on failure
+*   SIDE EFFECTS: pipe ends, virtual RTCs and the buffers of the stats & profiler devices count the
+*                 extra copy so they stay open until both are closed
+*/
+int32_t fs_interface_dup(fd_array_member_t* dest, fd_array_member_t* src) {
+    if (src->flags == 0) return -1;
+    *dest = *src;
+    pipe_dup(dest);
+    rtc_dup(dest);
+    stats_dup(dest);
+    profiler_dup(dest);
+    return 0;
+}
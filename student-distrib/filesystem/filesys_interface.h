@@ -18,12 +18,21 @@ struct funcptrs {
   int32_t (*close)(fd_array_member_t* f);
   int32_t (*read)(fd_array_member_t* f, void* buf, int32_t nbytes);
   int32_t (*write)(fd_array_member_t* f, const void* buf, int32_t nbytes);
+  int32_t (*ioctl)(fd_array_member_t* f, uint32_t request, void* arg);     // NULL for files that have no controls
 };
 
+typedef struct named_device {
+  const int8_t* name;
+  funcptrs* fops;
+} named_device_t;
+
 int32_t fs_interface_init(fd_array_member_t* fd_array);
+funcptrs* fs_interface_device(const uint8_t* filename);
 int32_t fs_interface_read(fd_array_member_t* f, void* buf, int32_t nbytes);
 int32_t fs_interface_write(fd_array_member_t* f, const void* buf, int32_t nbytes);
 int32_t fs_interface_open(fd_array_member_t* f, const uint8_t* filename);
 int32_t fs_interface_close(fd_array_member_t* f);
+int32_t fs_interface_ioctl(fd_array_member_t* f, uint32_t request, void* arg);
+int32_t fs_interface_dup(fd_array_member_t* dest, fd_array_member_t* src);
 
 #endif
@@ -0,0 +1,151 @@
+#include "futex.h"
+#include "lib.h"
+#include "address.h"
+#include "paging.h"
+#include "task.h"
+#include "signal.h"
+
+// Waiters hashed by key, each waiter lives on the kernel stack of its task while it sleeps
+futex_waiter_t* futex_buckets[FUTEX_HASH_SIZE];
+
+/* 
+ * futex_init
+ *   DESCRIPTION: Empties the futex wait table
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void futex_init() {
+    int32_t i;
+    for (i = 0; i < FUTEX_HASH_SIZE; i++) {
+        futex_buckets[i] = NULL;
+    }
+}
+
+/* 
+ * futex_key
+ *   DESCRIPTION: Turns a user address into a key that is the same for every task sharing the word.
+ *                Program memory is private, so its key is the physical address of the word. Shared
+ *                memory segments have the same virtual address in every task, so that is used as is.
+ *   INPUTS: addr -- user virtual address of a 4-byte aligned word
+ *   OUTPUTS: none
+ *   RETURN VALUE: the key, 0 if addr is not a mapped user word
+ *   SIDE EFFECTS: none
+ */
+static uint32_t futex_key(int32_t* addr) {
+    uint32_t vaddr = (uint32_t) addr;
+    if (vaddr & (sizeof(int32_t) - 1)) return 0;
+
+    if (vaddr >= PROGRAM_IMAGE_VIRTUAL_BASE_ADDR && vaddr < PROGRAM_IMAGE_VIRTUAL_BASE_ADDR + PAGE_SIZE_4MB) {
+        return PROGRAM_IMAGE_PHYSICAL_BASE_ADDR + PAGE_SIZE_4MB * curr_pid + (vaddr - PROGRAM_IMAGE_VIRTUAL_BASE_ADDR);
+    }
+    if (vaddr >= SHM_VIRTUAL_ADDR && vaddr < SHM_VIRTUAL_ADDR + PAGE_SIZE_4MB) {
+        // Touching an unmapped segment would fault in the kernel
+        if (!shm_page_table[(vaddr - SHM_VIRTUAL_ADDR) / PAGE_SIZE_4KB].present) return 0;
+        return vaddr;
+    }
+    return 0;
+}
+
+/* 
+ * futex_bucket
+ *   DESCRIPTION: Gets the hash bucket of a key
+ *   INPUTS: key -- key from futex_key
+ *   OUTPUTS: none
+ *   RETURN VALUE: pointer to the head of the bucket's list
+ *   SIDE EFFECTS: none
+ */
+static futex_waiter_t** futex_bucket(uint32_t key) {
+    // Keys are word aligned, so drop the low bits and fold in the page number
+    return &futex_buckets[((key >> 2) ^ (key >> 12)) % FUTEX_HASH_SIZE];
+}
+
+/* 
+ * futex_wait
+ *   DESCRIPTION: Puts the current task to sleep if the word at addr still holds the expected value.
+ *                The check and going to sleep are atomic with respect to futex_wake.
+ *   INPUTS: addr -- user address of the word
+ *           expected -- value the caller last saw in the word
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 after being woken, -1 if addr is invalid, the word no longer holds expected or the
+ *                 task is being killed
+ *   SIDE EFFECTS: blocks the task
+ */
+int32_t futex_wait(int32_t* addr, int32_t expected) {
+    uint32_t flags;
+    futex_waiter_t waiter;
+    futex_waiter_t** link;
+
+    cli_and_save(flags);
+    waiter.key = futex_key(addr);
+    if (waiter.key == 0 || *addr != expected) {
+        restore_flags(flags);
+        return -1;
+    }
+    waiter.pid = curr_pid;
+    waiter.woken = 0;
+    waiter.next = NULL;
+
+    // Queue at the tail so waiters are woken in the order they arrived
+    link = futex_bucket(waiter.key);
+    while (*link != NULL) {
+        link = &(*link)->next;
+    }
+    *link = &waiter;
+
+    while (!waiter.woken) {
+        if (signal_fatal_pending()) {
+            // Nobody woke us, take the waiter out of the table before its stack frame goes away
+            link = futex_bucket(waiter.key);
+            while (*link != &waiter) {
+                link = &(*link)->next;
+            }
+            *link = waiter.next;
+            restore_flags(flags);
+            return -1;
+        }
+        task_block(&waiter);
+    }
+    restore_flags(flags);
+    return 0;
+}
+
+/* 
+ * futex_wake
+ *   DESCRIPTION: Wakes tasks sleeping in futex_wait on the word at addr, in the order they started waiting
+ *   INPUTS: addr -- user address of the word
+ *           count -- maximum number of tasks to wake
+ *   OUTPUTS: none
+ *   RETURN VALUE: number of tasks woken, -1 if addr is invalid
+ *   SIDE EFFECTS: makes tasks runnable
+ */
+int32_t futex_wake(int32_t* addr, int32_t count) {
+    uint32_t flags;
+    uint32_t key;
+    int32_t woken = 0;
+    futex_waiter_t** link;
+    futex_waiter_t* waiter;
+
+    cli_and_save(flags);
+    key = futex_key(addr);
+    if (key == 0) {
+        restore_flags(flags);
+        return -1;
+    }
+    link = futex_bucket(key);
+    while (*link != NULL && woken < count) {
+        waiter = *link;
+        if (waiter->key != key) {
+            link = &waiter->next;
+            continue;
+        }
+        // Unlink before waking, the waiter's stack frame is gone once it runs
+        *link = waiter->next;
+        waiter->woken = 1;
+        task_wakeup(waiter);
+        woken++;
+    }
+    restore_flags(flags);
+    return woken;
+}
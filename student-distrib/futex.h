@@ -0,0 +1,19 @@
+#ifndef _FUTEX_H
+#define _FUTEX_H
+
+#include "types.h"
+
+#define FUTEX_HASH_SIZE 16
+
+typedef struct futex_waiter {
+    uint32_t key;                   // physical address of the word the task waits on
+    int32_t pid;                    // waiting task
+    uint8_t woken;                  // set by futex_wake before the task is made runnable
+    struct futex_waiter* next;      // next waiter in the same hash bucket
+} futex_waiter_t;
+
+void futex_init();
+int32_t futex_wait(int32_t* addr, int32_t expected);
+int32_t futex_wake(int32_t* addr, int32_t count);
+
+#endif
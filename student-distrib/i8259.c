@@ -4,6 +4,8 @@
 
 #include "i8259.h"
 #include "lib.h"
+#include "apic.h"
+#include "irq_stats.h"
 #define ENABLE_IRQ_NUM 2
 
 /* Interrupt masks to determine which interrupts are enabled and disabled */
@@ -50,6 +52,10 @@ void i8259_init(void) {
     *   SIDE EFFECTS: Enables the specified IRQ
     */
 void enable_irq(uint32_t irq_num) {
+    if (apic_enabled) {
+        apic_enable_irq(irq_num);
+        return;
+    }
     uint8_t value = master_mask;
     uint16_t port = MASTER_8259_DATA; 
     int a = 0;
@@ -74,6 +80,10 @@ void enable_irq(uint32_t irq_num) {
     *   SIDE EFFECTS: Disables the specified IRQ
     */
 void disable_irq(uint32_t irq_num) {
+    if (apic_enabled) {
+        apic_disable_irq(irq_num);
+        return;
+    }
     uint8_t value = master_mask;
     uint16_t port = MASTER_8259_DATA; 
     int a = 0;
@@ -81,6 +91,7 @@ void disable_irq(uint32_t irq_num) {
         value = slave_mask;
         port = SLAVE_8259_DATA;
         irq_num -= 8;
+        a = 1;
     }
     value = value | (1 << irq_num);
     if(a == 0) master_mask = value;
@@ -94,9 +105,16 @@ void disable_irq(uint32_t irq_num) {
     *   INPUTS: irq_num -- number of the IRQ for which to send EOI
     *   OUTPUTS: none
     *   RETURN VALUE: none
-    *   SIDE EFFECTS: Sends EOI signal for the specified IRQ
+    *   SIDE EFFECTS: Sends EOI signal for the specified IRQ, to the local APIC if it took over, and
+    *                 records the handler's entry-to-EOI latency
     */
 void send_eoi(uint32_t irq_num) {
+    // Both controllers, and the IOAPIC, raise IRQ n on vector ICW2_MASTER + n
+    irq_stats_eoi(ICW2_MASTER + irq_num);
+    if (apic_enabled) {
+        apic_send_eoi();
+        return;
+    }
     if (irq_num >= 8) {
         // printf("Secondary PIC called");
         outb(EOI | (irq_num - 8), SLAVE_8259_PORT);
@@ -106,3 +124,20 @@ void send_eoi(uint32_t irq_num) {
     }
     return;
 }
+
+/* 
+    * i8259_handover
+    *   DESCRIPTION: Mask every IRQ on both PICs so the APIC can take over
+    *   INPUTS: none
+    *   OUTPUTS: none
+    *   RETURN VALUE: bit i set if IRQ i was enabled, the cascade excluded
+    *   SIDE EFFECTS: Masks both PICs
+    */
+uint16_t i8259_handover(void) {
+    uint16_t enabled = ~(master_mask | (slave_mask << 8)) & ~(1 << ENABLE_IRQ_NUM);
+    master_mask = 0xFF;
+    slave_mask = 0xFF;
+    outb(master_mask, MASTER_8259_DATA);
+    outb(slave_mask, SLAVE_8259_DATA);
+    return enabled;
+}
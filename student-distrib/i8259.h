@@ -39,5 +39,7 @@ void enable_irq(uint32_t irq_num);
 void disable_irq(uint32_t irq_num);
 /* Send end-of-interrupt signal for the specified IRQ */
 void send_eoi(uint32_t irq_num);
+/* Mask both PICs for the APIC, returns the IRQs that were enabled */
+uint16_t i8259_handover(void);
 
 #endif /* _I8259_H */
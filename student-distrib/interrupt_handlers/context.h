@@ -0,0 +1,148 @@
+#ifndef _CONTEXT_H
+#define _CONTEXT_H
+
+/*
+ * Every interrupt, exception and syscall entry saves the interrupted registers in the same layout,
+ * directly below the frame pushed by the processor. For an entry from user mode that is the top of
+ * the task's kernel stack.
+ */
+
+#include "../x86_desc.h"
+#include "../irq_stats.h"
+#include "../trace.h"
+
+// Byte offsets of saved registers in hw_context_t
+#define CONTEXT_EBX 0
+#define CONTEXT_ECX 4
+#define CONTEXT_EDX 8
+#define CONTEXT_EAX 24
+
+#ifndef ASM
+
+#include "../types.h"
+
+typedef struct hw_context {
+    uint32_t ebx;
+    uint32_t ecx;
+    uint32_t edx;
+    uint32_t esi;
+    uint32_t edi;
+    uint32_t ebp;
+    uint32_t eax;
+    uint32_t ds;
+    uint32_t es;
+    uint32_t fs;
+    uint32_t irq_exc;   // error code pushed by the processor, 0 if there is none
+    // pushed by the processor
+    uint32_t eip;
+    uint32_t cs;
+    uint32_t eflags;
+    uint32_t esp;       // only valid when coming from user mode
+    uint32_t ss;        // only valid when coming from user mode
+} hw_context_t;
+
+#else
+
+/* 
+ * SAVE_ALL / RESTORE_ALL
+ *   DESCRIPTION: Push / pop the registers of a hw_context_t below the error code slot
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+#define SAVE_ALL    \
+    PUSHL %FS      ;\
+    PUSHL %ES      ;\
+    PUSHL %DS      ;\
+    PUSHL %EAX     ;\
+    PUSHL %EBP     ;\
+    PUSHL %EDI     ;\
+    PUSHL %ESI     ;\
+    PUSHL %EDX     ;\
+    PUSHL %ECX     ;\
+    PUSHL %EBX
+
+#define RESTORE_ALL \
+    POPL %EBX      ;\
+    POPL %ECX      ;\
+    POPL %EDX      ;\
+    POPL %ESI      ;\
+    POPL %EDI      ;\
+    POPL %EBP      ;\
+    POPL %EAX      ;\
+    POPL %DS       ;\
+    POPL %ES       ;\
+    POPL %FS
+
+/* 
+ * ENTER_KERNEL
+ *   DESCRIPTION: Points GS at the processor's cpu_t (user mode leaves it null) and takes the kernel
+ *                lock. Goes right after SAVE_ALL, the matching kernel_exit is in return_from_interrupt.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: clobbers EAX, ECX and EDX
+ */
+#define ENTER_KERNEL \
+    MOVW $KERNEL_PERCPU, %AX   ;\
+    MOVW %AX, %GS              ;\
+    CALL kernel_enter
+
+/* 
+ * PUSH_IRQ_FRAME / IRQ_STATS_ENTER / IRQ_STATS_EXIT
+ *   DESCRIPTION: Time an entry for irq_stats.c. PUSH_IRQ_FRAME reads the TSC and builds an irq_frame_t
+ *                below the hw_context_t; it goes right after SAVE_ALL, so waiting for the kernel lock
+ *                counts. IRQ_STATS_ENTER goes after ENTER_KERNEL, IRQ_STATS_EXIT after the handler
+ *                and pops the frame again.
+ *   INPUTS: vector -- the entry's vector (PUSH_IRQ_FRAME only)
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: clobber EAX, ECX and EDX
+ */
+#define PUSH_IRQ_FRAME(vector) \
+    RDTSC                      ;\
+    PUSHL %EDX                 ;\
+    PUSHL %EAX                 ;\
+    PUSHL $0                   ;\
+    PUSHL $0                   ;\
+    PUSHL $vector
+
+#define IRQ_STATS_ENTER \
+    PUSHL %ESP                 ;\
+    CALL irq_stats_enter       ;\
+    ADDL $4, %ESP
+
+#define IRQ_STATS_EXIT \
+    PUSHL %ESP                 ;\
+    CALL irq_stats_exit        ;\
+    ADDL $(4 + IRQ_FRAME_SIZE), %ESP
+
+/* 
+ * TRACE_ENTRY / TRACE_EXIT
+ *   DESCRIPTION: Syscall and interrupt tracepoints of trace.c. They go right after IRQ_STATS_ENTER and
+ *                right before IRQ_STATS_EXIT, and only test trace_mask while tracing is off.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: clobber EAX, ECX and EDX
+ */
+#define TRACE_ENTRY \
+    TESTL $TRACE_MASK_ENTRY, trace_mask ;\
+    JZ 1f                      ;\
+    PUSHL %ESP                 ;\
+    CALL trace_entry           ;\
+    ADDL $4, %ESP              ;\
+1:
+
+#define TRACE_EXIT \
+    TESTL $TRACE_MASK_EXIT, trace_mask ;\
+    JZ 1f                      ;\
+    PUSHL %ESP                 ;\
+    CALL trace_exit            ;\
+    ADDL $4, %ESP              ;\
+1:
+
+#endif
+
+#endif
@@ -4,5 +4,7 @@
 void pit_interrupt();
 void keyboard_interrupt();
 void rtc_interrupt();
+void serial_interrupt();
+void apic_spurious_interrupt();
 
 #endif
@@ -1,9 +1,16 @@
 #include "exception.h"
 #include "../lib.h"
 #include "syscalls_def.h"
+#include "../signal.h"
+#include "../task.h"
+#include "../irq_stats.h"
+#include "../trace.h"
+#include "../klog.h"
 
 #define NUM_EXCEPTIONS 32
 #define PROGRAM_EXCEPTION_FAIL_NUM 256
+#define USER_PL 3
+#define PAGE_FAULT_EXCEPTION 14
 
 const char* exception_messages[NUM_EXCEPTIONS] = {
     "Division by zero",
@@ -42,13 +49,15 @@ const char* exception_messages[NUM_EXCEPTIONS] = {
 
 /* 
  * exception_handler
- *   DESCRIPTION: Handle trap exceptions.
+ *   DESCRIPTION: Handle trap exceptions. Exceptions of a user program are turned into DIV_ZERO or
+ *                SEGFAULT signals when the program handles them.
  *   INPUTS: int_vector -- negative exception number
+ *           context -- registers saved on entry
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: prints exception and halts the currently running process
+ *   SIDE EFFECTS: prints exception and halts the currently running process, or raises a signal
  */
-void exception_handler(int int_vector) {
+void exception_handler(int int_vector, hw_context_t* context) {
     cli();
 
     // Check garbage input
@@ -56,7 +65,21 @@ void exception_handler(int int_vector) {
         sti();
         return;
     }
+    irq_stats_count(-int_vector - 1);
+    if (-int_vector - 1 == PAGE_FAULT_EXCEPTION) {
+        uint32_t fault_addr;
+        asm volatile ("movl %%cr2, %0" : "=r"(fault_addr));
+        TRACE(TRACE_PAGE_FAULT, fault_addr, context->eip);
+    }
+
+    // The signal is delivered on the way back to user mode
+    if ((context->cs & USER_PL) == USER_PL && curr_pid != -1) {
+        if (signal_raise_fault(int_vector == -1 ? SIG_DIV_ZERO : SIG_SEGFAULT)) {
+            return;
+        }
+    }
 
+    klog(KLOG_ERR, "%s at eip 0x%x, killing the task", exception_messages[-int_vector - 1], context->eip);
     printf("Exception: %s\n", exception_messages[-int_vector - 1]);
     printf("Killing program\n");
     
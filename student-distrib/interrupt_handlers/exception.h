@@ -1,6 +1,8 @@
 #ifndef _EXCEPTION_H
 #define _EXCEPTION_H
 
-void exception_handler(int int_vector);
+#include "context.h"
+
+void exception_handler(int int_vector, hw_context_t* context);
 
 #endif
@@ -7,6 +7,8 @@
 #include "../devices/pit.h"
 #include "../devices/rtc.h"
 #include "../devices/keyboard.h"
+#include "../devices/serial.h"
+#include "../apic.h"
 
 #define NUM_EXCEPTIONS 32
 #define SYSCALL_NUM 0x80
@@ -72,6 +74,8 @@ void setup_idt() {
     SET_IDT_ENTRY(idt[PIC_BASE_NUM + PIT_IRQ_NUM], pit_interrupt);
     SET_IDT_ENTRY(idt[PIC_BASE_NUM + KEYBOARD_IRQ_NUM], keyboard_interrupt);
     SET_IDT_ENTRY(idt[PIC_BASE_NUM + RTC_IRQ_NUM], rtc_interrupt);
+    SET_IDT_ENTRY(idt[PIC_BASE_NUM + SERIAL_IRQ_NUM], serial_interrupt);
+    SET_IDT_ENTRY(idt[APIC_SPURIOUS_VECTOR], apic_spurious_interrupt);
 
     // put syscall handler in IDT
     SET_IDT_ENTRY(idt[SYSCALL_NUM], syscall_handler);
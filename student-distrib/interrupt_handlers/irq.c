@@ -0,0 +1,54 @@
+#include "irq.h"
+#include "../lib.h"
+#include "../smp.h"
+#include "../task.h"
+
+/* 
+ * irq_enter
+ *   DESCRIPTION: Called by the device trampolines before the handler, counts the nesting of device
+ *                interrupts on the processor
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void irq_enter() {
+    this_cpu()->irq_nesting++;
+}
+
+/* 
+ * irq_request_resched
+ *   DESCRIPTION: Asks for a task switch. Handlers that interrupted another handler can't switch tasks
+ *                under it (the interrupted one would finish much later, on whichever processor picks the
+ *                task), so the switch waits for the outermost handler to finish.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may switch tasks
+ */
+void irq_request_resched() {
+    if (this_cpu()->irq_nesting > 1) {
+        this_cpu()->need_resched = 1;
+    } else {
+        task_schedule();
+    }
+}
+
+/* 
+ * irq_exit
+ *   DESCRIPTION: Called by the device trampolines after the handler. Leaving the outermost handler
+ *                runs the task switch a nested handler asked for.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may switch tasks
+ */
+void irq_exit() {
+    uint32_t flags;
+    cli_and_save(flags);
+    if (--this_cpu()->irq_nesting == 0 && this_cpu()->need_resched) {
+        this_cpu()->need_resched = 0;
+        task_schedule();
+    }
+    restore_flags(flags);
+}
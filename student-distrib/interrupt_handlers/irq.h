@@ -0,0 +1,10 @@
+#ifndef _IRQ_H
+#define _IRQ_H
+
+#include "../types.h"
+
+void irq_enter();
+void irq_exit();
+void irq_request_resched();
+
+#endif
@@ -6,7 +6,53 @@
 #include "../devices/rtc.h"
 #include "../devices/keyboard.h"
 #include "../devices/terminal.h"
+#include "../devices/pipe.h"
+#include "../devices/vga.h"
 #include "../paging.h"
+#include "../shm.h"
+#include "../signal.h"
+#include "../timer.h"
+#include "../devices/tsc.h"
+#include "../smp.h"
+#include "../trace.h"
+#include "../klog.h"
+
+/* 
+ * vidmap_drop_buffers
+ *   DESCRIPTION: Gives the buffers of vidmap_buffered back to the frame pool
+ *   INPUTS: pcb -- the task
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: the task's mapping of them has to be redone or torn down
+ */
+static void vidmap_drop_buffers(pcb_t* pcb) {
+    if (pcb->is_vidmapped != VIDMAP_BUFFERED) return;
+    frame_put(pcb->vid_back);
+    frame_put(pcb->vid_front);
+    pcb->vid_back = 0;
+    pcb->vid_front = 0;
+    pcb->is_vidmapped = 0;
+}
+
+/* 
+ * shm_name_valid
+ *   DESCRIPTION: Checks that a segment name from user space is in the program page and fits in
+ *                SHM_NAME_LEN with its NULL, without reading past the page looking for the end
+ *   INPUTS: name -- user pointer to the name
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if the name can be used, 0 if not
+ *   SIDE EFFECTS: none
+ */
+static uint8_t shm_name_valid(const uint8_t* name) {
+    uint32_t len;
+    if ((uint32_t) name < USER_STACK_VIRTUAL_ADDR) return 0;
+    if ((uint32_t) name >= USER_STACK_VIRTUAL_ADDR + PAGE_SIZE_4MB) return 0;
+    for (len = 0; len < SHM_NAME_LEN && (uint32_t) name + len < USER_STACK_VIRTUAL_ADDR + PAGE_SIZE_4MB; len++) {
+        if (name[len] == '\0') return len != 0;
+    }
+    // Longer names would be cut off and could match another segment
+    return 0;
+}
 
 /* 
  * _halt
@@ -31,23 +77,72 @@ int32_t _halt(uint32_t status) {
     for (i = 0; i < MAX_FILE_COUNT; i++) {
         fs_interface_close(&curr_pcb->fd_array[i]);
     }
+
+    // Drop the task's shared memory, segments it was the last user of are freed
+    shm_release_task(curr_pid);
+    // Put the terminal back in text mode if the task had graphics
+    vga_release(curr_pid);
+    vidmap_drop_buffers(curr_pcb);
+
+    // Reap halted spawned children, the running ones no longer have a parent to wait for them
+    pcb_t* child;
+    for (i = 0; i < MAX_PID_COUNT; i++) {
+        child = get_pcb(i);
+        if (child->active && child->is_spawned && child->parent_pid == curr_pid) {
+            if (child->state == TASK_ZOMBIE) {
+                child->active = 0;
+            } else {
+                child->parent_pid = -1;
+            }
+        }
+    }
+
+    if (curr_pcb->is_spawned) {
+        // Spawned tasks have no execute to return into, keep the status around for wait
+        curr_pcb->exit_status = status;
+        if (curr_pcb->parent_pid == -1) {
+            curr_pcb->active = 0;
+        } else {
+            curr_pcb->state = TASK_ZOMBIE;
+            task_wakeup(curr_pcb);
+        }
+        // Give up the processor for good
+        while (1) {
+            int32_t next = task_next_runnable();
+            if (next == -1) {
+                cpu_idle();
+            } else {
+                task_switch(next);
+            }
+        }
+    }
+
     // Disable current task
     curr_pcb->active = 0;
     if (curr_pcb->parent_pid != -1) { // parent exists, return to parent
         // Unmap paging for current task
         // unmap_program(curr_pid);
         pcb_t* parent_pcb = get_pcb(curr_pcb->parent_pid);
-        map_program(curr_pcb->parent_pid, parent_pcb->is_vidmapped, parent_pcb->terminal_id, parent_pcb->terminal_id == curr_displaying_terminal_id);
-        tss.ss0 = KERNEL_DS;
+        map_program(curr_pcb->parent_pid, parent_pcb->is_vidmapped, parent_pcb->terminal_id);
+        this_cpu()->tss->ss0 = KERNEL_DS;
         // 8MB (bottom of 4MB kernel page) - 8KB (size of kernel stack) - 4B (to get to top of stack)
-        tss.esp0 = KERNEL_STACK_ADDR - USER_KERNEL_STACK_SIZE * curr_pcb->parent_pid - 0x4;
+        this_cpu()->tss->esp0 = KERNEL_STACK_ADDR - USER_KERNEL_STACK_SIZE * curr_pcb->parent_pid - 0x4;
+        this_cpu()->task_switches++;
+        TRACE(TRACE_SWITCH, curr_pid, curr_pcb->parent_pid);
+        curr_pcb->on_cpu = 0;
         // Switch back to parent's PID, set parent as active
         curr_pid = curr_pcb->parent_pid;
         curr_pcb = get_pcb(curr_pid);
         curr_pcb->active = 1;
-
-        // Update terminal's current pid
-        terminals[curr_executing_terminal_id].curr_pid = curr_pid;
+        curr_pcb->state = TASK_RUNNABLE;
+        curr_pcb->on_cpu = 1;
+        curr_pcb->cpu = this_cpu()->id;
+        this_cpu()->lock_depth = curr_pcb->lock_depth;
+        this_cpu()->irq_nesting = curr_pcb->irq_nesting;
+
+        // Update terminal's current pid, it gets the terminal back in the mode it expects
+        terminals[curr_executing_terminal_id].foreground_pid = curr_pid;
+        term_mode_reset(curr_executing_terminal_id);
         
         // Restore stack pointers & put status code in eax
         asm volatile ("       \n \
@@ -63,6 +158,7 @@ int32_t _halt(uint32_t status) {
         );
         // asm volatile (".2: hlt; jmp .2;");
     } else { // parent doesn't exist, restart shell
+        curr_pcb->on_cpu = 0;
         curr_pid = -1;
         curr_pcb = NULL;
         // printf("restart shell\n");
@@ -85,23 +181,15 @@ int32_t halt(uint8_t status) {
 }
 
 /* 
- * execute
- *   DESCRIPTION:  attempts to load and execute a new program, handing off the
- * processor to the new program until it terminates
+ * load_task
+ *   DESCRIPTION: Parses a command, loads the executable into a new task's memory and sets up its PCB.
+ *                Must be called with interrupts disabled. Leaves the new task's paging mapped.
  *   INPUTS: command -- command to execute
  *   OUTPUTS: none
- *   RETURN VALUE: 0 if successful, -1 if not successful
- *   SIDE EFFECTS: none 
+ *   RETURN VALUE: pid of the new task if successful, -1 if not successful
+ *   SIDE EFFECTS: claims a pid & overwrites the program image page of that pid
  */
-int32_t execute(const uint8_t* command) {
-    // printf("syscall %s (command=%s)\n", __FUNCTION__, command);
-
-    // Validate command
-    if (command == NULL) return -1;
-    if (command[0] == '\0') return -1;
-
-    cli();
-
+static int32_t load_task(const uint8_t* command) {
     // Parse command
     uint32_t cmd_len = strlen((int8_t*) command);
 
@@ -119,7 +207,6 @@ int32_t execute(const uint8_t* command) {
         }
         if (command[i] != ' ') {
             if (file_name_length >= FILE_NAME_LEN) {
-                sti();
                 return -1;
             }
             file_name[file_name_length] = command[i];
@@ -128,7 +215,6 @@ int32_t execute(const uint8_t* command) {
         i++;
     }
     if (file_name_length > FILE_NAME_LEN) {
-        sti();
         return -1;
     }
     file_name[file_name_length] = '\0';
@@ -139,7 +225,6 @@ int32_t execute(const uint8_t* command) {
             continue;
         }
         if (file_arg_length >= FILE_NAME_LEN) {
-            sti();
             return -1;
         }
         file_arg[file_arg_length] = command[i];
@@ -148,7 +233,6 @@ int32_t execute(const uint8_t* command) {
     }
     // Per docs, if the arguments and a terminal NULL (0-byte) do not fit in the buffer, simply return -1.
     if (file_arg_length > FILE_NAME_LEN) {
-        sti();
         return -1;
     }
     file_arg[file_arg_length] = '\0';
@@ -162,20 +246,17 @@ int32_t execute(const uint8_t* command) {
     // printf("reading file %s...\n", file_name);
     // file exists or not
     if (read_dentry_by_name(file_name, &syscall_dentry) == -1) {
-        sti();
         return -1;
     }
     // printf("file exists\n");
     // file reading errors
     if (read_data(syscall_dentry.inode_num, 0, file_data_top4B, sizeof(int32_t)) == -1) {
-        sti();
         return -1;
     }
     // printf("file read properly\n");
     // The first 4 bytes of the file represent a “magic number” that identifies the file as an executable. These
     // bytes are, respectively, 0: 0x7f; 1: 0x45; 2: 0x4c; 3: 0x46.
     if (file_data_top4B[0] != 0x7f || file_data_top4B[1] != 0x45 || file_data_top4B[2] != 0x4c || file_data_top4B[3] != 0x46) {
-        sti();
         return -1; // file is not exe
     }
     // printf("file magic correct\n");
@@ -183,8 +264,8 @@ int32_t execute(const uint8_t* command) {
     // Get new PID
     int32_t new_pid = get_new_pid(); 
     if (new_pid == -1) {
+        klog(KLOG_WARN, "execute: no pid left");
         printf("Maximum number of tasks reached.\n");
-        sti();
         return -1;
     }
 
@@ -194,15 +275,14 @@ int32_t execute(const uint8_t* command) {
     read_data(syscall_dentry.inode_num, PROGRAM_ENTRY_POINT, entry_buf, sizeof(int32_t));
     prog_eip = *((uint32_t*) entry_buf);
 
-    // Assign new PID to the current terminal
-    terminals[curr_executing_terminal_id].curr_pid = new_pid;
-
     pcb_t* pcb = get_pcb(new_pid);
     pcb->terminal_id = curr_executing_terminal_id;
     pcb->is_vidmapped = 0;
+    pcb->vid_back = 0;
+    pcb->vid_front = 0;
 
     // Setup paging
-    map_program(new_pid, 0, curr_executing_terminal_id, curr_executing_terminal_id == curr_displaying_terminal_id);
+    map_program(new_pid, 0, curr_executing_terminal_id);
 
     // Load the executable
     // printf("length = %#x\n", inode_ptr[syscall_dentry.inode_num].length);
@@ -221,6 +301,7 @@ int32_t execute(const uint8_t* command) {
     pcb->pid = new_pid;
     pcb->parent_pid = curr_pid;
     pcb->active = 1;
+    pcb->eip = prog_eip;
 
     // All user programs start at USER_STACK_VIRTUAL_ADDR
     // Stack starts at the end of the program and grows towards lower addresses (that's the + PAGE_SIZE_4MB part)
@@ -231,6 +312,37 @@ int32_t execute(const uint8_t* command) {
     pcb->esp = USER_STACK_VIRTUAL_ADDR + PAGE_SIZE_4MB - 4;
 
     // printf("finished setting pcb\n");
+    return new_pid;
+}
+
+/* 
+ * execute
+ *   DESCRIPTION:  attempts to load and execute a new program, handing off the
+ * processor to the new program until it terminates
+ *   INPUTS: command -- command to execute
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 if successful, -1 if not successful
+ *   SIDE EFFECTS: none 
+ */
+int32_t execute(const uint8_t* command) {
+    // printf("syscall %s (command=%s)\n", __FUNCTION__, command);
+
+    // Validate command
+    if (command == NULL) return -1;
+    if (command[0] == '\0') return -1;
+
+    cli();
+
+    int32_t new_pid = load_task(command);
+    if (new_pid == -1) {
+        sti();
+        return -1;
+    }
+    pcb_t* pcb = get_pcb(new_pid);
+    pcb->is_started = 1;
+
+    // Assign new PID to the current terminal
+    terminals[curr_executing_terminal_id].foreground_pid = new_pid;
 
     if (curr_pcb != NULL) {
         // Save ebp and esp values
@@ -246,19 +358,31 @@ int32_t execute(const uint8_t* command) {
         );
         curr_pcb->ebp = saved_ebp;
         curr_pcb->esp = saved_esp;
+        curr_pcb->lock_depth = this_cpu()->lock_depth;
+        curr_pcb->irq_nesting = this_cpu()->irq_nesting;
+        // Parent isn't scheduled again until the child halts back into it
+        curr_pcb->state = TASK_WAITING_CHILD;
+        curr_pcb->on_cpu = 0;
     }
 
     // printf("saved esp & ebp (if parent exists)\n");
 
     // Task switching
-    pcb->eip = prog_eip;
-    tss.ss0 = KERNEL_DS;
+    this_cpu()->tss->ss0 = KERNEL_DS;
     // 8MB (bottom of 4MB kernel page) - 8KB (size of kernel stack) - 4B (to get to top of stack)
-    tss.esp0 = KERNEL_STACK_ADDR - USER_KERNEL_STACK_SIZE * new_pid - 0x4;
+    this_cpu()->tss->esp0 = KERNEL_STACK_ADDR - USER_KERNEL_STACK_SIZE * new_pid - 0x4;
+    this_cpu()->task_switches++;
+    TRACE(TRACE_SWITCH, curr_pid, new_pid);
 
     // Switch to create task
     curr_pid = new_pid;
     curr_pcb = pcb;
+    pcb->on_cpu = 1;
+    pcb->cpu = this_cpu()->id;
+
+    // The new task starts out in user mode, where it doesn't hold the kernel lock or sit in a handler
+    kernel_unlock_all();
+    this_cpu()->irq_nesting = 0;
 
     // sti();
 
@@ -360,10 +484,21 @@ int32_t open(const uint8_t* filename) {
 
     dentry_t syscall_dentry;
     fd_array_member_t* f;
+    funcptrs* device_fops;
     int fd;
     for (fd = 0; fd < MAX_FILE_COUNT; fd++) {
         f = &curr_pcb->fd_array[fd];
         if (f->flags == 0) {
+            if ((device_fops = fs_interface_device(filename)) != NULL) {
+                // Kernel device without a file system entry
+                f->fops = device_fops;
+                f->inode = 0;
+                if (fs_interface_open(f, filename) == -1) return -1;
+                f->file_pos = 0;
+                f->flags = 1;
+                return fd;
+            }
+
             // Check if file exists
             if (read_dentry_by_name(filename, &syscall_dentry) == -1) return -1;
 
@@ -434,7 +569,8 @@ int32_t getargs(uint8_t* buf, int32_t nbytes) {
 
 /*
     * vidmap
-    *   DESCRIPTION: maps the text-mode video memory into user space at a pre-set virtual address
+    *   DESCRIPTION: maps the text-mode video memory into user space at a pre-set virtual address, or the
+    *                framebuffer once setmode put the caller's terminal in graphics mode
     *   INPUTS: screen_start -- pointer to the virtual address to map video memory to
     *   OUTPUTS: none
     *   RETURN VALUE: 0 on success, -1 on failure
@@ -444,24 +580,371 @@ int32_t vidmap(uint8_t** screen_start) {
     // Check if screen_start is an userspace address
     if (screen_start == NULL) return -1;
     if ((uint32_t) screen_start < USER_STACK_VIRTUAL_ADDR) return -1;
-    if ((uint32_t) screen_start > USER_STACK_VIRTUAL_ADDR + PAGE_SIZE_4MB) return -1;
+    if ((uint32_t) screen_start > USER_STACK_VIRTUAL_ADDR + PAGE_SIZE_4MB - sizeof(uint8_t*)) return -1;
 
     curr_pcb = get_pcb(curr_pid);
-    curr_pcb->is_vidmapped = 1;
-    map_program(curr_pid, 1, 
-        curr_pcb->terminal_id, curr_displaying_terminal_id == curr_pcb->terminal_id);
+    // Writes go straight to the screen from now on
+    vidmap_drop_buffers(curr_pcb);
+    curr_pcb->is_vidmapped = VIDMAP_LIVE;
+    if (vga_gfx_owner(curr_pid)) {
+        // Rows of 32 bit pixels, as wide as the mode
+        map_program(curr_pid, VIDMAP_LIVE, curr_pcb->terminal_id);
+        *screen_start = (uint8_t*) PROGRAM_FB_VIRTUAL_ADDR;
+        return 0;
+    }
+    // The program sees the start of the terminal's ring, scrolling keeps the screen there from now on
+    term_pin_screen(curr_pcb->terminal_id);
+    map_program(curr_pid, VIDMAP_LIVE, curr_pcb->terminal_id);
 
     // write virtual video memory addr to screen_start
     *screen_start = (uint8_t*) PROGRAM_VIDEO_VIRTUAL_ADDR;
     return 0;
 }
 
+/* 
+ * set_handler
+ *   DESCRIPTION: sets the user-level handler of a signal
+ *   INPUTS: signum -- signal number
+ *           handler_address -- handler taking the signal number, NULL to restore the default action
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on failure
+ *   SIDE EFFECTS: none */
 int32_t set_handler(int32_t signum, void* handler_address) {
     // printf("syscall %s\n", __FUNCTION__);
-    return -1;
+    return signal_set_handler(signum, handler_address);
 }
 
+/* 
+ * sigreturn
+ *   DESCRIPTION: returns from a signal handler to the code the signal interrupted. Called by the
+ *                trampoline the handler returns into, not directly by programs.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: the interrupted EAX, -1 on failure
+ *   SIDE EFFECTS: restores every user register, unmasks signals */
 int32_t sigreturn(void) {
     // printf("syscall %s\n", __FUNCTION__);
-    return -1;
+    return signal_return();
+}
+
+/* 
+ * pipe
+ *   DESCRIPTION: creates a pipe and opens a descriptor for each of its ends
+ *   INPUTS: fds -- user array of two ints, receives the read end in fds[0] and the write end in fds[1]
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on failure
+ *   SIDE EFFECTS: allocates a kernel pipe */
+int32_t pipe(int32_t* fds) {
+    // printf("syscall %s\n", __FUNCTION__);
+    if (fds == NULL) return -1;
+
+    curr_pcb = get_pcb(curr_pid);
+    if (curr_pcb == NULL) return -1;
+
+    // Find two unused file descriptors
+    int32_t read_fd, write_fd;
+    for (read_fd = 0; read_fd < MAX_FILE_COUNT; read_fd++) {
+        if (curr_pcb->fd_array[read_fd].flags == 0) break;
+    }
+    for (write_fd = read_fd + 1; write_fd < MAX_FILE_COUNT; write_fd++) {
+        if (curr_pcb->fd_array[write_fd].flags == 0) break;
+    }
+    if (write_fd >= MAX_FILE_COUNT) return -1;
+
+    if (pipe_create(&curr_pcb->fd_array[read_fd], &curr_pcb->fd_array[write_fd]) == -1) return -1;
+    fds[0] = read_fd;
+    fds[1] = write_fd;
+    return 0;
+}
+
+/* 
+ * spawn
+ *   DESCRIPTION: loads a new program that runs alongside the caller instead of replacing it until it
+ *                halts. The child's stdin & stdout are copies of the given descriptors of the caller.
+ *   INPUTS: command -- command to execute
+ *           in_fd -- caller descriptor to use as the child's stdin
+ *           out_fd -- caller descriptor to use as the child's stdout
+ *   OUTPUTS: none
+ *   RETURN VALUE: pid of the child on success, -1 on failure
+ *   SIDE EFFECTS: creates a new task, which starts running at the next scheduler tick */
+int32_t spawn(const uint8_t* command, int32_t in_fd, int32_t out_fd) {
+    // printf("syscall %s (command=%s)\n", __FUNCTION__, command);
+    if (command == NULL) return -1;
+    if (command[0] == '\0') return -1;
+    if (in_fd >= MAX_FILE_COUNT || in_fd < 0) return -1;
+    if (out_fd >= MAX_FILE_COUNT || out_fd < 0) return -1;
+
+    curr_pcb = get_pcb(curr_pid);
+    if (curr_pcb == NULL) return -1;
+    if (curr_pcb->fd_array[in_fd].flags == 0 || curr_pcb->fd_array[out_fd].flags == 0) return -1;
+
+    uint32_t flags;
+    cli_and_save(flags);
+
+    int32_t new_pid = load_task(command);
+    if (new_pid == -1) {
+        restore_flags(flags);
+        return -1;
+    }
+    pcb_t* pcb = get_pcb(new_pid);
+
+    // Hand the requested descriptors to the child as its stdin & stdout
+    fs_interface_dup(&pcb->fd_array[0], &curr_pcb->fd_array[in_fd]);
+    fs_interface_dup(&pcb->fd_array[1], &curr_pcb->fd_array[out_fd]);
+
+    // task_switch enters user mode the first time the scheduler picks the child
+    pcb->is_spawned = 1;
+    pcb->is_started = 0;
+    task_enqueue(new_pid);
+
+    // load_task left the child's memory mapped, go back to ours
+    map_program(curr_pid, curr_pcb->is_vidmapped, curr_pcb->terminal_id);
+
+    restore_flags(flags);
+    return new_pid;
+}
+
+/* 
+ * wait
+ *   DESCRIPTION: blocks until a spawned child halts and releases it
+ *   INPUTS: pid -- pid returned by spawn
+ *   OUTPUTS: none
+ *   RETURN VALUE: the child's halt status on success, -1 on failure
+ *   SIDE EFFECTS: frees the child's pid */
+int32_t wait(int32_t pid) {
+    // printf("syscall %s (pid=%d)\n", __FUNCTION__, pid);
+    pcb_t* child = get_pcb(pid);
+    if (child == NULL) return -1;
+    if (!child->active || !child->is_spawned || child->parent_pid != curr_pid) return -1;
+
+    uint32_t flags;
+    cli_and_save(flags);
+    while (child->state != TASK_ZOMBIE) {
+        if (signal_fatal_pending()) {
+            restore_flags(flags);
+            return -1;
+        }
+        task_block(child);
+    }
+    int32_t status = child->exit_status;
+    child->active = 0;
+    restore_flags(flags);
+    return status;
+}
+
+/* 
+ * shm_create
+ *   DESCRIPTION: creates a named shared memory segment and maps it into the caller. Every task that maps
+ *                the segment sees it at the same virtual address.
+ *   INPUTS: name -- name of the segment
+ *           size -- size of the segment in bytes, at most SHM_MAX_SIZE
+ *           addr -- receives the virtual address of the segment
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on failure
+ *   SIDE EFFECTS: allocates zeroed physical frames */
+int32_t shm_create(const uint8_t* name, int32_t size, uint8_t** addr) {
+    // printf("syscall %s\n", __FUNCTION__);
+    if (!shm_name_valid(name)) return -1;
+    if (addr == NULL) return -1;
+    if ((uint32_t) addr < USER_STACK_VIRTUAL_ADDR) return -1;
+    if ((uint32_t) addr > USER_STACK_VIRTUAL_ADDR + PAGE_SIZE_4MB - sizeof(uint8_t*)) return -1;
+
+    return shm_segment_create(name, size, addr);
+}
+
+/* 
+ * shm_map
+ *   DESCRIPTION: maps an existing named shared memory segment into the caller
+ *   INPUTS: name -- name of the segment
+ *           addr -- receives the virtual address of the segment
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on failure
+ *   SIDE EFFECTS: none */
+int32_t shm_map(const uint8_t* name, uint8_t** addr) {
+    // printf("syscall %s\n", __FUNCTION__);
+    if (!shm_name_valid(name)) return -1;
+    if (addr == NULL) return -1;
+    if ((uint32_t) addr < USER_STACK_VIRTUAL_ADDR) return -1;
+    if ((uint32_t) addr > USER_STACK_VIRTUAL_ADDR + PAGE_SIZE_4MB - sizeof(uint8_t*)) return -1;
+
+    return shm_segment_map(name, addr);
+}
+
+/* 
+ * shm_unmap
+ *   DESCRIPTION: unmaps a named shared memory segment from the caller
+ *   INPUTS: name -- name of the segment
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on failure
+ *   SIDE EFFECTS: frees the segment if the caller was its last user */
+int32_t shm_unmap(const uint8_t* name) {
+    // printf("syscall %s\n", __FUNCTION__);
+    if (!shm_name_valid(name)) return -1;
+
+    return shm_segment_unmap(name);
+}
+
+/* 
+ * kill
+ *   DESCRIPTION: sends a signal to a task
+ *   INPUTS: pid -- the task
+ *           signum -- signal number
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on failure
+ *   SIDE EFFECTS: the signal is delivered when the task next returns to user mode */
+int32_t kill(int32_t pid, int32_t signum) {
+    // printf("syscall %s (pid=%d, signum=%d)\n", __FUNCTION__, pid, signum);
+    pcb_t* pcb = get_pcb(pid);
+    if (pcb == NULL || !pcb->active) return -1;
+    if (signum < 0 || signum >= NUM_SIGNALS) return -1;
+
+    signal_send(pid, signum);
+    return 0;
+}
+
+/* 
+ * sleep
+ *   DESCRIPTION: blocks the caller for at least the given time
+ *   INPUTS: ms -- milliseconds to sleep, rounded up to the timer tick
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if the sleep was cut short to kill the caller
+ *   SIDE EFFECTS: other tasks run meanwhile */
+int32_t sleep(uint32_t ms) {
+    // printf("syscall %s (ms=%d)\n", __FUNCTION__, ms);
+    return timer_sleep(ms);
+}
+
+/* 
+ * clock_gettime
+ *   DESCRIPTION: reads a clock with nanosecond resolution
+ *   INPUTS: clock_id -- CLOCK_MONOTONIC, time since boot
+ *           ts -- receives the time
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on failure
+ *   SIDE EFFECTS: none */
+int32_t clock_gettime(int32_t clock_id, timespec_t* ts) {
+    // printf("syscall %s\n", __FUNCTION__);
+    if (clock_id != CLOCK_MONOTONIC) return -1;
+    if (ts == NULL) return -1;
+    if ((uint32_t) ts < USER_STACK_VIRTUAL_ADDR) return -1;
+    if ((uint32_t) ts > USER_STACK_VIRTUAL_ADDR + PAGE_SIZE_4MB - sizeof(timespec_t)) return -1;
+
+    uint64_t ns = now_ns();
+    ts->tv_nsec = div64_32(&ns, NS_PER_SEC);
+    ts->tv_sec = (uint32_t) ns;
+    return 0;
+}
+
+/* 
+ * profile
+ *   DESCRIPTION: controls the sampling profiler
+ *   INPUTS: cmd -- PROFILE_START, PROFILE_STOP or PROFILE_READ
+ *           arg -- samples per second for PROFILE_START, room in buf (in samples) for PROFILE_READ
+ *           buf -- receives the samples (PROFILE_READ only)
+ *   OUTPUTS: none
+ *   RETURN VALUE: number of samples read for PROFILE_READ, 0 on success otherwise, -1 on failure
+ *   SIDE EFFECTS: PROFILE_START throws away the samples taken before */
+int32_t profile(int32_t cmd, uint32_t arg, profile_sample_t* buf) {
+    // printf("syscall %s (cmd=%d)\n", __FUNCTION__, cmd);
+    switch (cmd) {
+        case PROFILE_START:
+            return profile_start(arg);
+        case PROFILE_STOP:
+            profile_stop();
+            return 0;
+        case PROFILE_READ:
+            arg = MIN(arg, PROFILE_RING_SIZE);
+            if ((uint32_t) buf < USER_STACK_VIRTUAL_ADDR) return -1;
+            if ((uint32_t) buf > USER_STACK_VIRTUAL_ADDR + PAGE_SIZE_4MB - arg * sizeof(profile_sample_t)) return -1;
+            return profile_read(buf, arg);
+        default:
+            return -1;
+    }
+}
+
+/* 
+ * ioctl
+ *   DESCRIPTION: controls the device behind a file descriptor, e.g. the terminal's input mode
+ *   INPUTS: fd -- file descriptor
+ *           request -- what to do, the device defines its requests
+ *           arg -- the request's argument
+ *   OUTPUTS: none
+ *   RETURN VALUE: what the device returns, -1 on failure
+ *   SIDE EFFECTS: whatever the request does */
+int32_t ioctl(int32_t fd, uint32_t request, void* arg) {
+    if (fd >= MAX_FILE_COUNT || fd < 0) return -1;
+    curr_pcb = get_pcb(curr_pid);
+    return fs_interface_ioctl(&curr_pcb->fd_array[fd], request, arg);
+}
+
+/* 
+ * setmode
+ *   DESCRIPTION: puts the caller's terminal in a graphics mode with 32 bit pixels, or back in text mode.
+ *                vidmap maps the framebuffer afterwards.
+ *   INPUTS: width -- pixels per row, a multiple of 8 from 64 to 1024, 0 for text mode
+ *           height -- rows, up to 768, 0 for text mode
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on failure (no framebuffer, another program has graphics, bad size)
+ *   SIDE EFFECTS: clears the framebuffer & shows it if the terminal is displayed. The terminal goes back
+ *                 to text mode when the caller halts */
+int32_t setmode(uint32_t width, uint32_t height) {
+    int32_t ret;
+    curr_pcb = get_pcb(curr_pid);
+    ret = vga_set_mode(curr_pid, curr_pcb->terminal_id, width, height);
+    // Drops a framebuffer mapping that changed or went away
+    if (ret == 0) map_program(curr_pid, curr_pcb->is_vidmapped, curr_pcb->terminal_id);
+    return ret;
+}
+
+/*
+ * vidmap_buffered
+ *   DESCRIPTION: maps a back buffer of the text screen into user space where vidmap maps the screen. The
+ *                program draws a whole frame in it and calls present to show it, so the screen never
+ *                has half a frame on it. Not for the framebuffer of setmode
+ *   INPUTS: screen_start -- pointer to the virtual address to map the buffer to
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on failure (bad pointer, graphics mode, the frame pool ran out)
+ *   SIDE EFFECTS: the buffer starts out as a copy of the screen; a later vidmap maps the screen again */
+int32_t vidmap_buffered(uint8_t** screen_start) {
+    uint32_t back, front;
+    if (screen_start == NULL) return -1;
+    if ((uint32_t) screen_start < USER_STACK_VIRTUAL_ADDR) return -1;
+    if ((uint32_t) screen_start > USER_STACK_VIRTUAL_ADDR + PAGE_SIZE_4MB - sizeof(uint8_t*)) return -1;
+
+    curr_pcb = get_pcb(curr_pid);
+    if (vga_gfx_owner(curr_pid)) return -1;
+    if (curr_pcb->is_vidmapped != VIDMAP_BUFFERED) {
+        if (term_buffer_init(curr_pcb->terminal_id, &back, &front, &curr_pcb->vid_writes) == -1) return -1;
+        curr_pcb->vid_back = back;
+        curr_pcb->vid_front = front;
+        curr_pcb->is_vidmapped = VIDMAP_BUFFERED;
+    }
+    map_program(curr_pid, VIDMAP_BUFFERED, curr_pcb->terminal_id);
+
+    *screen_start = (uint8_t*) PROGRAM_VIDEO_VIRTUAL_ADDR;
+    return 0;
+}
+
+/*
+ * present
+ *   DESCRIPTION: shows the frame drawn in the buffer of vidmap_buffered, copying only the rows that changed
+ *                since the last present. Given an open rtc fd, it first waits for that fd's next tick, so
+ *                frames go out at the rate set on it and the wait & the copy take one call
+ *   INPUTS: rtc_fd -- rtc fd to wait on, -1 to copy right away
+ *   OUTPUTS: none
+ *   RETURN VALUE: number of rows copied, -1 on failure (no vidmap_buffered, rtc_fd isn't an open rtc,
+ *                 the task is being killed)
+ *   SIDE EFFECTS: other tasks run while it waits */
+int32_t present(int32_t rtc_fd) {
+    fd_array_member_t* f;
+    curr_pcb = get_pcb(curr_pid);
+    if (curr_pcb->is_vidmapped != VIDMAP_BUFFERED) return -1;
+
+    if (rtc_fd != -1) {
+        if (rtc_fd >= MAX_FILE_COUNT || rtc_fd < 0) return -1;
+        f = &curr_pcb->fd_array[rtc_fd];
+        if (f->flags == 0 || f->fops != &rtc_fops) return -1;
+        if (rtc_read(f, NULL, 0) == -1) return -1;
+    }
+    return term_present(curr_pcb->terminal_id, curr_pcb->vid_back, curr_pcb->vid_front, &curr_pcb->vid_writes);
 }
@@ -2,6 +2,8 @@
 #define _SYSCALLS_DEF_H
 
 #include "../types.h"
+#include "../devices/tsc.h"
+#include "../profile.h"
 
 int32_t _halt(uint32_t status);
 int32_t halt(uint8_t status);
@@ -14,5 +16,19 @@ int32_t getargs(uint8_t* buf, int32_t nbytes);
 int32_t vidmap(uint8_t** screen_start);
 int32_t set_handler (int32_t signum, void* handler_address);
 int32_t sigreturn (void);
+int32_t pipe(int32_t* fds);
+int32_t spawn(const uint8_t* command, int32_t in_fd, int32_t out_fd);
+int32_t wait(int32_t pid);
+int32_t shm_create(const uint8_t* name, int32_t size, uint8_t** addr);
+int32_t shm_map(const uint8_t* name, uint8_t** addr);
+int32_t shm_unmap(const uint8_t* name);
+int32_t kill(int32_t pid, int32_t signum);
+int32_t sleep(uint32_t ms);
+int32_t clock_gettime(int32_t clock_id, timespec_t* ts);
+int32_t profile(int32_t cmd, uint32_t arg, profile_sample_t* buf);
+int32_t ioctl(int32_t fd, uint32_t request, void* arg);
+int32_t setmode(uint32_t width, uint32_t height);
+int32_t vidmap_buffered(uint8_t** screen_start);
+int32_t present(int32_t rtc_fd);
 
 #endif
@@ -0,0 +1,254 @@
+#include "irq_stats.h"
+#include "lib.h"
+#include "smp.h"
+#include "devices/tsc.h"
+
+/*
+ * Every entry that records here holds the kernel lock, so the counters need no lock of their own.
+ * Only the EOI timestamps are per processor: the EOI comes from the handler on the processor that
+ * took the interrupt.
+ */
+static irq_vector_stats_t irq_stats[IRQ_STATS_SLOTS];
+static uint64_t irq_eoi_entry[MAX_CPUS][IRQ_STATS_SLOTS];
+
+static uint8_t irq_report[IRQ_STATS_REPORT_SIZE];
+
+/* 
+ * irq_stats_slot
+ *   DESCRIPTION: Finds where a vector's statistics are kept
+ *   INPUTS: vector -- interrupt vector
+ *   OUTPUTS: none
+ *   RETURN VALUE: index in irq_stats, -1 if the vector isn't tracked
+ *   SIDE EFFECTS: none
+ */
+static int32_t irq_stats_slot(uint32_t vector) {
+    if (vector < IRQ_STATS_LOW_VECTORS) return vector;
+    if (vector == IRQ_STATS_SYSCALL_VECTOR) return IRQ_STATS_LOW_VECTORS;
+    if (vector == IRQ_STATS_SPURIOUS_VECTOR) return IRQ_STATS_LOW_VECTORS + 1;
+    return -1;
+}
+
+/* 
+ * irq_hist_bucket
+ *   DESCRIPTION: Finds the log2 bucket of a latency
+ *   INPUTS: cycles -- the latency
+ *   OUTPUTS: none
+ *   RETURN VALUE: index of the highest set bit, 0 for 0 cycles
+ *   SIDE EFFECTS: none
+ */
+static uint32_t irq_hist_bucket(uint64_t cycles) {
+    uint32_t bucket;
+    if (cycles >> 32) return IRQ_HIST_BUCKETS - 1;
+    if ((uint32_t) cycles == 0) return 0;
+    asm ("bsrl %1, %0" : "=r"(bucket) : "rm"((uint32_t) cycles));
+    return bucket;
+}
+
+/* 
+ * irq_stats_enter
+ *   DESCRIPTION: Called by the entry stubs once they hold the kernel lock. Counts the entry and
+ *                remembers the entry time for the handler's EOI.
+ *   INPUTS: frame -- the stub's irq_frame_t, vector & entry filled in
+ *   OUTPUTS: fills in the processor fields of frame
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void irq_stats_enter(irq_frame_t* frame) {
+    int32_t slot = irq_stats_slot(frame->vector);
+    frame->cpu = this_cpu()->id;
+    frame->switches = this_cpu()->task_switches;
+    if (slot == -1) return;
+    irq_stats[slot].count++;
+    irq_eoi_entry[frame->cpu][slot] = frame->entry;
+}
+
+/* 
+ * irq_stats_exit
+ *   DESCRIPTION: Called by the entry stubs after the handler, right before the common return path.
+ *                Entries that switched tasks meanwhile would measure other tasks' run time, so they
+ *                are only counted.
+ *   INPUTS: frame -- the stub's irq_frame_t
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void irq_stats_exit(irq_frame_t* frame) {
+    int32_t slot = irq_stats_slot(frame->vector);
+    if (slot == -1) return;
+    if (frame->cpu != this_cpu()->id || frame->switches != this_cpu()->task_switches) {
+        irq_stats[slot].switched++;
+        return;
+    }
+    irq_stats[slot].iret_hist[irq_hist_bucket(now_cycles() - frame->entry)]++;
+}
+
+/* 
+ * irq_stats_eoi
+ *   DESCRIPTION: Called by send_eoi, records the time from entry to EOI of the interrupt being handled
+ *   INPUTS: vector -- vector of the interrupt being acknowledged
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void irq_stats_eoi(uint32_t vector) {
+    int32_t slot = irq_stats_slot(vector);
+    uint64_t* entry;
+    // this_cpu only works once irqoff_ready is set
+    if (slot == -1 || !irqoff_ready) return;
+    entry = &irq_eoi_entry[this_cpu()->id][slot];
+    // EOIs outside a handler (while setting up a device) have no entry
+    if (*entry == 0) return;
+    irq_stats[slot].eoi_hist[irq_hist_bucket(now_cycles() - *entry)]++;
+    *entry = 0;
+}
+
+/* 
+ * irq_stats_count
+ *   DESCRIPTION: Counts an entry through a vector without timing it (exceptions)
+ *   INPUTS: vector -- the vector
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void irq_stats_count(uint32_t vector) {
+    int32_t slot = irq_stats_slot(vector);
+    if (slot != -1) irq_stats[slot].count++;
+}
+
+/* 
+ * irq_stats_get
+ *   DESCRIPTION: Gets the statistics of a vector
+ *   INPUTS: vector -- the vector
+ *   OUTPUTS: none
+ *   RETURN VALUE: its statistics, NULL if the vector isn't tracked
+ *   SIDE EFFECTS: none
+ */
+irq_vector_stats_t* irq_stats_get(uint32_t vector) {
+    int32_t slot = irq_stats_slot(vector);
+    return slot == -1 ? NULL : &irq_stats[slot];
+}
+
+/* 
+ * irq_stats_reset
+ *   DESCRIPTION: Zeroes every counter and histogram, to measure a workload on its own
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void irq_stats_reset() {
+    uint32_t flags;
+    cli_and_save(flags);
+    memset(irq_stats, 0, sizeof(irq_stats));
+    restore_flags(flags);
+}
+
+/* 
+ * report_str / report_uint
+ *   DESCRIPTION: Append a string / a decimal number to the report, dropping what doesn't fit
+ *   INPUTS: buf -- the report
+ *           size -- its capacity
+ *           len -- its current length
+ *           s / value -- what to append
+ *   OUTPUTS: none
+ *   RETURN VALUE: the new length
+ *   SIDE EFFECTS: none
+ */
+static uint32_t report_str(int8_t* buf, uint32_t size, uint32_t len, const int8_t* s) {
+    while (*s != '\0' && len < size) {
+        buf[len++] = *s++;
+    }
+    return len;
+}
+
+static uint32_t report_uint(int8_t* buf, uint32_t size, uint32_t len, uint32_t value) {
+    int8_t digits[11];
+    return report_str(buf, size, len, itoa(value, digits, 10));
+}
+
+/* 
+ * report_hist
+ *   DESCRIPTION: Appends the non-empty buckets of a histogram as "<upper bound>:count" pairs, bounds
+ *                in ns once the TSC is calibrated and in cycles before
+ *   INPUTS: buf, size, len -- the report
+ *           label -- name of the histogram
+ *           hist -- the buckets
+ *   OUTPUTS: none
+ *   RETURN VALUE: the new length
+ *   SIDE EFFECTS: none
+ */
+static uint32_t report_hist(int8_t* buf, uint32_t size, uint32_t len, const int8_t* label, uint32_t* hist) {
+    uint32_t i;
+    uint64_t bound;
+    len = report_str(buf, size, len, label);
+    for (i = 0; i < IRQ_HIST_BUCKETS; i++) {
+        if (hist[i] == 0) continue;
+        bound = (uint64_t) 1 << (i + 1);
+        len = report_str(buf, size, len, (int8_t*) " <");
+        if (tsc_khz != 0) {
+            len = report_uint(buf, size, len, (uint32_t) cycles_to_ns(bound));
+            len = report_str(buf, size, len, (int8_t*) "ns:");
+        } else {
+            len = report_uint(buf, size, len, (uint32_t) bound);
+            len = report_str(buf, size, len, (int8_t*) "cyc:");
+        }
+        len = report_uint(buf, size, len, hist[i]);
+    }
+    return report_str(buf, size, len, (int8_t*) "\n");
+}
+
+/* 
+ * irq_stats_format
+ *   DESCRIPTION: Writes a text report of every vector that fired: its count, how many entries switched
+ *                tasks, and its latency histograms
+ *   INPUTS: buf -- where to write the report
+ *           size -- capacity of buf
+ *   OUTPUTS: the report, not NULL terminated
+ *   RETURN VALUE: length of the report
+ *   SIDE EFFECTS: none
+ */
+uint32_t irq_stats_format(int8_t* buf, uint32_t size) {
+    uint32_t vector, len = 0;
+    int8_t hex[9];
+    irq_vector_stats_t* stats;
+    for (vector = 0; vector <= IRQ_STATS_SPURIOUS_VECTOR; vector++) {
+        if ((stats = irq_stats_get(vector)) == NULL || stats->count == 0) continue;
+        len = report_str(buf, size, len, (int8_t*) "vector 0x");
+        len = report_str(buf, size, len, itoa(vector, hex, 16));
+        switch (vector) {
+            case IRQ_STATS_PIT_VECTOR: len = report_str(buf, size, len, (int8_t*) " (timer)"); break;
+            case IRQ_STATS_KEYBOARD_VECTOR: len = report_str(buf, size, len, (int8_t*) " (keyboard)"); break;
+            case IRQ_STATS_RTC_VECTOR: len = report_str(buf, size, len, (int8_t*) " (rtc)"); break;
+            case IRQ_STATS_SYSCALL_VECTOR: len = report_str(buf, size, len, (int8_t*) " (syscall)"); break;
+            case IRQ_STATS_SPURIOUS_VECTOR: len = report_str(buf, size, len, (int8_t*) " (spurious)"); break;
+            default: break;
+        }
+        len = report_str(buf, size, len, (int8_t*) ": ");
+        len = report_uint(buf, size, len, stats->count);
+        len = report_str(buf, size, len, (int8_t*) " entries, ");
+        len = report_uint(buf, size, len, stats->switched);
+        len = report_str(buf, size, len, (int8_t*) " switched tasks\n");
+        if (vector != IRQ_STATS_SYSCALL_VECTOR && vector >= IRQ_STATS_PIT_VECTOR) {
+            len = report_hist(buf, size, len, (int8_t*) "  eoi: ", stats->eoi_hist);
+        }
+        if (vector >= IRQ_STATS_PIT_VECTOR) {
+            len = report_hist(buf, size, len, (int8_t*) "  iret:", stats->iret_hist);
+        }
+    }
+    return len;
+}
+
+/* 
+ * irq_stats_print
+ *   DESCRIPTION: Prints the report of irq_stats_format
+ *   INPUTS: none
+ *   OUTPUTS: the report
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void irq_stats_print() {
+    uint32_t i, len = irq_stats_format((int8_t*) irq_report, IRQ_STATS_REPORT_SIZE);
+    for (i = 0; i < len; i++) {
+        putc(irq_report[i]);
+    }
+}
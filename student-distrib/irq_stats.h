@@ -0,0 +1,60 @@
+/* irq_stats.h - Per-vector interrupt counts and latency histograms
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _IRQ_STATS_H
+#define _IRQ_STATS_H
+
+// Size of irq_frame_t, the entry stubs reserve it on the stack
+#define IRQ_FRAME_SIZE 20
+
+// Vectors the entry stubs pass in
+#define IRQ_STATS_PIT_VECTOR 0x20
+#define IRQ_STATS_KEYBOARD_VECTOR 0x21
+#define IRQ_STATS_SERIAL_VECTOR 0x24
+#define IRQ_STATS_RTC_VECTOR 0x28
+#define IRQ_STATS_SYSCALL_VECTOR 0x80
+#define IRQ_STATS_SPURIOUS_VECTOR 0xFF
+
+#ifndef ASM
+
+#include "types.h"
+
+// Exceptions and both PICs' vectors, then the syscall and the APIC spurious vector
+#define IRQ_STATS_LOW_VECTORS 0x30
+#define IRQ_STATS_SLOTS (IRQ_STATS_LOW_VECTORS + 2)
+
+// Bucket i counts latencies of 2^i to 2^(i+1) - 1 cycles
+#define IRQ_HIST_BUCKETS 32
+
+// Room for the text report
+#define IRQ_STATS_REPORT_SIZE 4096
+
+// Built on the stack by the entry stubs, lowest address first
+typedef struct irq_frame {
+    uint32_t vector;
+    uint32_t cpu;                   // processor the entry ran on
+    uint32_t switches;              // its task_switches at entry
+    uint64_t entry;                 // TSC read right after saving the registers
+} irq_frame_t;
+
+typedef struct irq_vector_stats {
+    uint32_t count;                                 // entries through the vector
+    uint32_t switched;                              // entries that switched tasks before returning
+    uint32_t eoi_hist[IRQ_HIST_BUCKETS];            // entry to EOI
+    uint32_t iret_hist[IRQ_HIST_BUCKETS];           // entry to the return path, entries that didn't switch tasks
+} irq_vector_stats_t;
+
+void irq_stats_enter(irq_frame_t* frame);
+void irq_stats_exit(irq_frame_t* frame);
+void irq_stats_eoi(uint32_t vector);
+void irq_stats_count(uint32_t vector);
+
+irq_vector_stats_t* irq_stats_get(uint32_t vector);
+void irq_stats_reset();
+uint32_t irq_stats_format(int8_t* buf, uint32_t size);
+void irq_stats_print();
+
+#endif /* ASM */
+
+#endif /* _IRQ_STATS_H */
@@ -0,0 +1,198 @@
+#include "irqoff.h"
+#include "lib.h"
+#include "lock.h"
+#include "smp.h"
+#include "devices/tsc.h"
+#include "interrupt_handlers/context.h"
+#include "irq_stats.h"
+
+// Set by cpu_init_bsp once this_cpu works, cli/sti before that aren't measured
+uint8_t irqoff_ready = 0;
+
+// The span open on each processor
+typedef struct irqoff_cpu {
+    uint64_t start;                 // TSC when interrupts were disabled, 0 if they are enabled
+    const int8_t* file;
+    uint32_t line;
+} irqoff_cpu_t;
+
+static irqoff_cpu_t irqoff_cpus[MAX_CPUS];
+
+// Longest spans first. Shortest span in the full table, shorter ones skip the lock
+static irqoff_span_t irqoff_worst[IRQOFF_WORST_N];
+static volatile uint64_t irqoff_min_cycles = 0;
+static spinlock_t irqoff_lock = SPINLOCK_INIT;
+
+/* 
+ * irqoff_record
+ *   DESCRIPTION: Puts a finished span in the table if it is among the longest. Spans between the same
+ *                call sites share an entry keeping the longest of them. Called with interrupts disabled.
+ *   INPUTS: begin -- where the span started
+ *           cycles -- its length
+ *           file, line -- where it ended
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void irqoff_record(irqoff_cpu_t* begin, uint64_t cycles, const int8_t* file, uint32_t line) {
+    irqoff_span_t* span = NULL;
+    irqoff_span_t tmp;
+    int32_t i;
+    if (cycles <= irqoff_min_cycles) return;
+
+    spin_lock(&irqoff_lock);
+    for (i = 0; i < IRQOFF_WORST_N; i++) {
+        if (irqoff_worst[i].begin_file == begin->file && irqoff_worst[i].begin_line == begin->line &&
+            irqoff_worst[i].end_file == file && irqoff_worst[i].end_line == line) {
+            span = &irqoff_worst[i];
+            break;
+        }
+    }
+    if (span == NULL) {
+        // The last entry is the shortest (or unused)
+        span = &irqoff_worst[IRQOFF_WORST_N - 1];
+        if (span->begin_file != NULL && cycles <= span->max_cycles) {
+            spin_unlock(&irqoff_lock);
+            return;
+        }
+        span->begin_file = begin->file;
+        span->begin_line = begin->line;
+        span->end_file = file;
+        span->end_line = line;
+        span->max_cycles = 0;
+        i = IRQOFF_WORST_N - 1;
+    }
+
+    if (cycles > span->max_cycles) {
+        span->max_cycles = cycles;
+        // Keep the table sorted
+        for (; i > 0 && (irqoff_worst[i - 1].begin_file == NULL ||
+                         irqoff_worst[i - 1].max_cycles < irqoff_worst[i].max_cycles); i--) {
+            tmp = irqoff_worst[i - 1];
+            irqoff_worst[i - 1] = irqoff_worst[i];
+            irqoff_worst[i] = tmp;
+        }
+    }
+    if (irqoff_worst[IRQOFF_WORST_N - 1].begin_file != NULL) {
+        irqoff_min_cycles = irqoff_worst[IRQOFF_WORST_N - 1].max_cycles;
+    }
+    spin_unlock(&irqoff_lock);
+}
+
+/* 
+ * irqoff_begin
+ *   DESCRIPTION: Called by cli and cli_and_save right after disabling interrupts. Starts a span if
+ *                interrupts were enabled before.
+ *   INPUTS: flags -- EFLAGS from before the cli
+ *           file, line -- call site
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void irqoff_begin(uint32_t flags, const int8_t* file, uint32_t line) {
+    irqoff_cpu_t* cpu;
+    if (!irqoff_ready || !(flags & EFLAGS_IF)) return;
+    cpu = &irqoff_cpus[this_cpu()->id];
+    cpu->start = now_cycles();
+    cpu->file = file;
+    cpu->line = line;
+}
+
+/* 
+ * irqoff_end
+ *   DESCRIPTION: Called by sti and restore_flags right before enabling interrupts. Ends the open span.
+ *   INPUTS: file, line -- call site
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void irqoff_end(const int8_t* file, uint32_t line) {
+    irqoff_cpu_t* cpu;
+    uint64_t cycles;
+    if (!irqoff_ready) return;
+    cpu = &irqoff_cpus[this_cpu()->id];
+    if (cpu->start == 0) return;
+    cycles = now_cycles() - cpu->start;
+    cpu->start = 0;
+    irqoff_record(cpu, cycles, file, line);
+}
+
+/* 
+ * irqoff_interrupt_entry
+ *   DESCRIPTION: Starts a span when an interrupt gate disabled interrupts, the handler's sti or the
+ *                iret ends it. Called once the kernel lock is taken, but the span starts at the TSC the
+ *                entry stub read before, so spinning on the lock with interrupts off counts.
+ *   INPUTS: frame -- the entry's irq_frame_t
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void irqoff_interrupt_entry(struct irq_frame* frame) {
+    irqoff_begin(EFLAGS_IF, (int8_t*) "interrupt entry", 0);
+    if (irqoff_ready) {
+        irqoff_cpus[this_cpu()->id].start = frame->entry;
+    }
+}
+
+/* 
+ * irqoff_iret
+ *   DESCRIPTION: Ends the open span when return_from_interrupt is about to enable interrupts with iret
+ *   INPUTS: context -- the hw_context_t being restored
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void irqoff_iret(hw_context_t* context) {
+    if (context->eflags & EFLAGS_IF) {
+        irqoff_end((int8_t*) "iret", 0);
+    }
+}
+
+/* 
+ * irqoff_worst_get
+ *   DESCRIPTION: Gets one of the longest spans recorded
+ *   INPUTS: idx -- rank of the span, 0 is the longest
+ *   OUTPUTS: none
+ *   RETURN VALUE: the span, NULL if fewer were recorded
+ *   SIDE EFFECTS: none
+ */
+irqoff_span_t* irqoff_worst_get(uint32_t idx) {
+    if (idx >= IRQOFF_WORST_N || irqoff_worst[idx].begin_file == NULL) return NULL;
+    return &irqoff_worst[idx];
+}
+
+/* 
+ * irqoff_reset
+ *   DESCRIPTION: Forgets every recorded span, to measure a workload on its own
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void irqoff_reset() {
+    uint32_t flags;
+    spin_lock_irqsave(&irqoff_lock, flags);
+    memset(irqoff_worst, 0, sizeof(irqoff_worst));
+    irqoff_min_cycles = 0;
+    spin_unlock_irqrestore(&irqoff_lock, flags);
+}
+
+/* 
+ * irqoff_print
+ *   DESCRIPTION: Prints the longest spans with interrupts disabled and where they started and ended
+ *   INPUTS: none
+ *   OUTPUTS: one line per span, longest first
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void irqoff_print() {
+    uint32_t i;
+    uint64_t us;
+    irqoff_span_t* span;
+    for (i = 0; (span = irqoff_worst_get(i)) != NULL; i++) {
+        us = cycles_to_ns(span->max_cycles);
+        div64_32(&us, 1000);
+        printf("%u us: %s:%u -> %s:%u\n", (uint32_t) us,
+            span->begin_file, span->begin_line, span->end_file, span->end_line);
+    }
+}
@@ -0,0 +1,38 @@
+/* irqoff.h - Profiler of the spans interrupts stay disabled for
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _IRQOFF_H
+#define _IRQOFF_H
+
+#include "types.h"
+
+// Interrupt enable bit of EFLAGS
+#define EFLAGS_IF 0x200
+
+// How many of the longest spans are kept, one per pair of call sites
+#define IRQOFF_WORST_N 16
+
+typedef struct irqoff_span {
+    const int8_t* begin_file;       // where interrupts were disabled, NULL if the slot is unused
+    uint32_t begin_line;
+    const int8_t* end_file;         // where they were enabled again
+    uint32_t end_line;
+    uint64_t max_cycles;            // longest span between the two sites
+} irqoff_span_t;
+
+struct hw_context;
+struct irq_frame;
+
+extern uint8_t irqoff_ready;
+
+void irqoff_begin(uint32_t flags, const int8_t* file, uint32_t line);
+void irqoff_end(const int8_t* file, uint32_t line);
+void irqoff_interrupt_entry(struct irq_frame* frame);
+void irqoff_iret(struct hw_context* context);
+
+irqoff_span_t* irqoff_worst_get(uint32_t idx);
+void irqoff_reset();
+void irqoff_print();
+
+#endif /* _IRQOFF_H */
@@ -6,6 +6,8 @@
 #include "x86_desc.h"
 #include "lib.h"
 #include "i8259.h"
+#include "apic.h"
+#include "smp.h"
 #include "debug.h"
 #include "tests.h"
 #include "paging.h"
@@ -16,6 +18,17 @@
 #include "devices/rtc.h"
 #include "devices/keyboard.h"
 #include "devices/terminal.h"
+#include "devices/pipe.h"
+#include "devices/serial.h"
+#include "devices/vga.h"
+#include "shm.h"
+#include "futex.h"
+#include "timer.h"
+#include "signal.h"
+#include "devices/tsc.h"
+#include "profile.h"
+#include "trace.h"
+#include "klog.h"
 #include "interrupt_handlers/syscalls_def.h"
 
 // #define RUN_TESTS
@@ -24,11 +37,57 @@
 /* Check if the bit BIT in FLAGS is set. */
 #define CHECK_FLAG(flags, bit)   ((flags) & (1 << (bit)))
 unsigned int FS_BASE = 0;
+
+/*
+ * cmdline_terminals
+ *   DESCRIPTION: Reads the number of terminals from a "terminals=N" boot parameter
+ *   INPUTS: mbi -- the Multiboot information structure
+ *   OUTPUTS: none
+ *   RETURN VALUE: N, TERM_DEFAULT_COUNT without the parameter
+ *   SIDE EFFECTS: none
+ */
+static uint32_t cmdline_terminals(multiboot_info_t* mbi) {
+    int8_t* s;
+    uint32_t count = 0, len = strlen((int8_t*) TERM_CMDLINE_PARAM);
+    if (!CHECK_FLAG(mbi->flags, 2)) return TERM_DEFAULT_COUNT;
+
+    for (s = (int8_t*) mbi->cmdline; *s != '\0'; s++) {
+        if (strncmp(s, (int8_t*) TERM_CMDLINE_PARAM, len) != 0) continue;
+        for (s += len; *s >= '0' && *s <= '9'; s++) {
+            count = count * 10 + (*s - '0');
+        }
+        return count;
+    }
+    return TERM_DEFAULT_COUNT;
+}
+
+/*
+ * cmdline_has
+ *   DESCRIPTION: Tells whether a boot parameter was passed
+ *   INPUTS: mbi -- the Multiboot information structure
+ *           param -- the parameter, e.g. "console=serial"
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if the command line has it, 0 if not
+ *   SIDE EFFECTS: none
+ */
+static uint8_t cmdline_has(multiboot_info_t* mbi, int8_t* param) {
+    int8_t* s;
+    uint32_t len = strlen(param);
+    if (!CHECK_FLAG(mbi->flags, 2)) return 0;
+
+    for (s = (int8_t*) mbi->cmdline; *s != '\0'; s++) {
+        if (strncmp(s, param, len) == 0 && (s[len] == ' ' || s[len] == '\0')) return 1;
+    }
+    return 0;
+}
+
 /* Check if MAGIC is valid and print the Multiboot information structure
    pointed by ADDR. */
 void entry(unsigned long magic, unsigned long addr) {
 
     multiboot_info_t *mbi;
+    uint32_t terminal_count;
+    uint8_t serial_console;
 
     /* Clear the screen. */
     clear();
@@ -44,6 +103,8 @@ void entry(unsigned long magic, unsigned long addr) {
 
     /* Print out the flags. */
     printf("flags = 0x%#x\n", (unsigned)mbi->flags);
+    terminal_count = cmdline_terminals(mbi);
+    serial_console = cmdline_has(mbi, (int8_t*) SERIAL_CMDLINE_CONSOLE);
 
     /* Are mem_* valid? */
     if (CHECK_FLAG(mbi->flags, 0))
@@ -148,6 +209,9 @@ void entry(unsigned long magic, unsigned long addr) {
         ltr(KERNEL_TSS);
     }
 
+    /* Per-CPU data of the boot processor, curr_pid & co. live there */
+    cpu_init_bsp();
+
     /* Init the PIC */
     i8259_init();
 
@@ -158,12 +222,33 @@ void entry(unsigned long magic, unsigned long addr) {
      * PIC, any other initialization stuff... */
     keyboard_init();
     fs_init((uint32_t*) FS_BASE);
-    term_init();
+    pipe_init();
+    shm_init();
+    futex_init();
+    timer_init();
+    signal_init();
+    profile_init();
+    serial_init();
+    serial_set_console(serial_console);
+    vga_init();
     rtc_init();
     
     initialize_paging();
 
+    /* The terminals' memory comes from the frame pool paging sets up */
+    term_init(terminal_count);
+
+    /* Echo & line editing run in their own task, the keyboard interrupt only queues scancodes */
+    keyboard_thread_start();
+
+    /* Move the enabled IRQs over to the APIC if there is one, the PIC stays otherwise */
+    apic_init();
+
+    tsc_init();
+    /* Start the other processors, they wait for pit_init to set up their timers */
+    smp_init();
     pit_init();
+    klog(KLOG_INFO, "booted: %u cpus, %u terminals, tsc %u kHz", num_cpus, terminal_count, tsc_khz);
     
     /* Enable interrupts */
     /* Do not enable the following until after you have set up your
@@ -171,6 +256,8 @@ void entry(unsigned long magic, unsigned long addr) {
      * without showing you any output */
     // printf("Enabling Interrupts\n");
     // rtc_open("test");
+    cli();
+    kernel_exit();
     sti();
 
 #ifdef RUN_TESTS
@@ -0,0 +1,222 @@
+#include "klog.h"
+#include "lib.h"
+#include "smp.h"
+#include "irqoff.h"
+#include "devices/tsc.h"
+#include "devices/serial.h"
+
+/*
+ * Loggers claim a record by bumping klog_next atomically, so any processor or nested interrupt can log
+ * without a lock or turning interrupts off. A record's seq says when it is complete; readers copy it
+ * out and check seq again, a record overwritten meanwhile is skipped. Nothing is formatted until a
+ * reader asks for the text, logging only costs storing the format string & its arguments.
+ */
+volatile uint32_t klog_level = KLOG_INFO;
+
+static klog_record_t klog_ring[KLOG_RING_SIZE];
+static volatile uint32_t klog_next = 0;        // sequence number of the next record
+static uint32_t klog_serial_pos = 0;            // next record klog_flush sends
+
+/*
+ * klog
+ *   DESCRIPTION: Logs a message at a severity level. Only the format string's address & the first
+ *                KLOG_MAX_ARGS arguments are kept; %s arguments must stay valid forever, like literals.
+ *                Takes %d, %u, %x, %c, %s and %%.
+ *   INPUTS: level -- KLOG_*
+ *           fmt -- format string, a literal
+ *           ... -- 32 bit arguments
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: overwrites the oldest record once the ring is full
+ */
+void klog(uint32_t level, const int8_t* fmt, ...) {
+    // Arguments follow the format string on the stack, like printf reads them
+    uint32_t* args = (uint32_t*) &fmt + 1;
+    klog_record_t* record;
+    uint32_t seq = 1, i;
+
+    if (level > klog_level) return;
+    asm volatile ("lock xaddl %0, %1" : "+r"(seq), "+m"(klog_next) : : "memory");
+    record = &klog_ring[seq % KLOG_RING_SIZE];
+    record->seq = 0;
+    asm volatile ("" : : : "memory");
+
+    record->level = level;
+    // this_cpu only works once irqoff_ready is set
+    record->cpu = irqoff_ready ? this_cpu()->id : 0;
+    record->pid = irqoff_ready ? this_cpu()->pid : -1;
+    record->ns = now_ns();
+    record->fmt = fmt;
+    for (i = 0; i < KLOG_MAX_ARGS; i++) {
+        record->args[i] = args[i];
+    }
+    // x86 keeps stores in order, the compiler has to as well
+    asm volatile ("" : : : "memory");
+    record->seq = seq + 1;
+}
+
+/*
+ * klog_next_record
+ *   DESCRIPTION: Copies out the record a reader is at & moves the reader past it. Readers that fell more
+ *                than a ring behind skip to the oldest record still there.
+ *   INPUTS: pos -- sequence number of the reader's next record
+ *           record -- where to copy it
+ *   OUTPUTS: the record, the reader's new position
+ *   RETURN VALUE: 1 if there was a complete record, 0 if the reader is caught up
+ *   SIDE EFFECTS: none
+ */
+uint32_t klog_next_record(uint32_t* pos, klog_record_t* record) {
+    klog_record_t* slot;
+    uint32_t seq, next = klog_next;
+
+    while (1) {
+        if (next - *pos > KLOG_RING_SIZE) *pos = next - KLOG_RING_SIZE;
+        if (*pos == next) return 0;
+
+        slot = &klog_ring[*pos % KLOG_RING_SIZE];
+        seq = slot->seq;
+        // Still being written, it's complete the next time around. A slot still holding the record a
+        // ring older is one whose writer claimed it but hasn't marked it yet
+        if (seq == 0 || (int32_t) (seq - (*pos + 1)) < 0) return 0;
+        asm volatile ("" : : : "memory");
+        *record = *slot;
+        asm volatile ("" : : : "memory");
+        // A newer record took the slot, before or while it was copied
+        if (seq != *pos + 1 || slot->seq != seq) {
+            (*pos)++;
+            continue;
+        }
+        (*pos)++;
+        return 1;
+    }
+}
+
+/*
+ * klog_append / klog_append_num
+ *   DESCRIPTION: Append a string / a number to a line being formatted, as much as fits
+ *   INPUTS: buf, size -- the line & its capacity
+ *           len -- length so far
+ *           s -- the string
+ *           value, radix -- the number & its base
+ *           digits -- fewest digits to write, zero padded
+ *   OUTPUTS: the line
+ *   RETURN VALUE: new length of the line
+ *   SIDE EFFECTS: none
+ */
+static uint32_t klog_append(int8_t* buf, uint32_t size, uint32_t len, const int8_t* s) {
+    while (*s != '\0' && len < size) {
+        buf[len++] = *s++;
+    }
+    return len;
+}
+
+static uint32_t klog_append_num(int8_t* buf, uint32_t size, uint32_t len, uint32_t value, int32_t radix,
+                                uint32_t digits) {
+    int8_t num[11];
+    itoa(value, num, radix);
+    while (digits-- > strlen(num) && len < size) {
+        buf[len++] = '0';
+    }
+    return klog_append(buf, size, len, num);
+}
+
+/*
+ * klog_format
+ *   DESCRIPTION: Writes a record as a line of text, "<level>[seconds.microseconds] cpuN pid N: message"
+ *                or "... cpuN idle: message"
+ *   INPUTS: record -- the record
+ *           buf -- where to write the line
+ *           size -- capacity of buf, KLOG_LINE_SIZE fits every line
+ *   OUTPUTS: the line, not NULL terminated
+ *   RETURN VALUE: length of the line, which ends with a newline even when it's cut short
+ *   SIDE EFFECTS: none
+ */
+uint32_t klog_format(klog_record_t* record, int8_t* buf, uint32_t size) {
+    uint64_t secs = record->ns;
+    uint32_t nsecs, arg, len = 0, n = 0;
+    const int8_t* s;
+
+    if (size == 0) return 0;
+    // Room for the newline
+    size--;
+    nsecs = div64_32(&secs, 1000000000);
+
+    len = klog_append(buf, size, len, "<");
+    len = klog_append_num(buf, size, len, record->level, 10, 1);
+    len = klog_append(buf, size, len, ">[");
+    len = klog_append_num(buf, size, len, (uint32_t) secs, 10, 1);
+    len = klog_append(buf, size, len, ".");
+    len = klog_append_num(buf, size, len, nsecs / 1000, 10, 6);
+    len = klog_append(buf, size, len, "] ");
+    len = klog_append(buf, size, len, "cpu");
+    len = klog_append_num(buf, size, len, record->cpu, 10, 1);
+    len = klog_append(buf, size, len, record->pid < 0 ? " idle: " : " pid ");
+    if (record->pid >= 0) {
+        len = klog_append_num(buf, size, len, record->pid, 10, 1);
+        len = klog_append(buf, size, len, ": ");
+    }
+
+    for (s = record->fmt; *s != '\0' && len < size; s++) {
+        if (*s != '%' || s[1] == '\0') {
+            buf[len++] = *s;
+            continue;
+        }
+        s++;
+        if (*s == '%') {
+            buf[len++] = '%';
+            continue;
+        }
+        arg = n < KLOG_MAX_ARGS ? record->args[n++] : 0;
+        switch (*s) {
+            case 'd':
+                if ((int32_t) arg < 0) {
+                    buf[len++] = '-';
+                    arg = -(int32_t) arg;
+                }
+                len = klog_append_num(buf, size, len, arg, 10, 1);
+                break;
+            case 'u':
+                len = klog_append_num(buf, size, len, arg, 10, 1);
+                break;
+            case 'x':
+                len = klog_append_num(buf, size, len, arg, 16, 1);
+                break;
+            case 'c':
+                buf[len++] = (int8_t) arg;
+                break;
+            case 's':
+                len = klog_append(buf, size, len, arg != 0 ? (const int8_t*) arg : "(null)");
+                break;
+            default:
+                buf[len++] = '?';
+                break;
+        }
+    }
+    buf[len++] = '\n';
+    return len;
+}
+
+/*
+ * klog_flush
+ *   DESCRIPTION: Called by the boot processor's timer tick. Formats the records the serial port hasn't
+ *                had yet, while a whole line fits in the serial driver's transmit ring, up to
+ *                KLOG_SERIAL_BUDGET bytes; it never waits for the line.
+ *   INPUTS: none
+ *   OUTPUTS: log lines on the serial port, ending in CR LF
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void klog_flush() {
+    klog_record_t record;
+    int8_t line[KLOG_LINE_SIZE + 1];
+    uint32_t len, sent = 0;
+    if (!serial_present()) return;
+
+    while (sent < KLOG_SERIAL_BUDGET && serial_tx_room() > KLOG_LINE_SIZE) {
+        if (!klog_next_record(&klog_serial_pos, &record)) return;
+        len = klog_format(&record, line, KLOG_LINE_SIZE);
+        line[len - 1] = '\r';
+        line[len++] = '\n';
+        sent += serial_send(line, len);
+    }
+}
@@ -0,0 +1,47 @@
+/* klog.h - Kernel log of binary records in a lock-free ring, formatted as text when they're read
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _KLOG_H
+#define _KLOG_H
+
+// Severity levels, most severe first
+#define KLOG_ERR 0
+#define KLOG_WARN 1
+#define KLOG_INFO 2
+#define KLOG_DEBUG 3
+
+// Records the ring holds, a power of 2. The oldest are overwritten, readers that fall behind skip them
+#define KLOG_RING_SIZE 1024
+// Arguments a record keeps for its format string
+#define KLOG_MAX_ARGS 4
+// Longest line a record formats to, longer ones are cut short
+#define KLOG_LINE_SIZE 128
+// Bytes of log lines the timer tick may put in the serial driver's transmit ring
+#define KLOG_SERIAL_BUDGET 512
+
+#ifndef ASM
+
+#include "types.h"
+
+typedef struct klog_record {
+    volatile uint32_t seq;          // sequence number + 1 once the record is complete, 0 while it's written
+    uint8_t level;                  // KLOG_*
+    uint8_t cpu;
+    int8_t pid;                     // task running on the processor, -1 while idle
+    uint64_t ns;                    // time since boot
+    const int8_t* fmt;              // format string, never copied so it has to be a literal
+    uint32_t args[KLOG_MAX_ARGS];
+} klog_record_t;
+
+// Records less severe than this are not kept
+extern volatile uint32_t klog_level;
+
+void klog(uint32_t level, const int8_t* fmt, ...);
+uint32_t klog_next_record(uint32_t* pos, klog_record_t* record);
+uint32_t klog_format(klog_record_t* record, int8_t* buf, uint32_t size);
+void klog_flush();
+
+#endif /* ASM */
+
+#endif /* _KLOG_H */
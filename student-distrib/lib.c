@@ -4,6 +4,7 @@
 #include "lib.h"
 #include "devices/keyboard.h"
 #include "devices/terminal.h"
+#include "devices/serial.h"
 
 char* video_mem = (char *)VIDEO;
 
@@ -13,10 +14,11 @@ char* video_mem = (char *)VIDEO;
  * Function: Clears video memory */
 void clear(void) {
     int32_t i;
+    uint16_t* screen = term_screen(curr_executing_terminal_id);
     for (i = 0; i < NUM_ROWS * NUM_COLS; i++) {
-        *(uint8_t *)(video_mem + (i << 1)) = ' ';
-        *(uint8_t *)(video_mem + (i << 1) + 1) = ATTRIB;
+        screen[i] = (ATTRIB << 8) | ' ';
     }
+    terminals[curr_executing_terminal_id].screen_writes++;
     terminals[curr_executing_terminal_id].screen_x = terminals[curr_executing_terminal_id].screen_y = 0;
 }
 
@@ -160,15 +162,7 @@ int32_t puts(int8_t* s) {
 }
 
 void scroll() {
-    terminals[curr_executing_terminal_id].screen_y = NUM_ROWS - 1;
-    // 2nd row starts at video memory index (NUM_COLS * 1 + 0) << 1
-    // size is (rows - 1) * cols * 2
-    memmove(video_mem, video_mem + (NUM_COLS << 1), (NUM_ROWS - 1) * NUM_COLS * 2);
-    int i;
-    for (i = NUM_COLS * terminals[curr_executing_terminal_id].screen_y; i < NUM_COLS * (terminals[curr_executing_terminal_id].screen_y + 1); i++) {
-        *(uint8_t *)(video_mem + (i << 1)) = ' ';
-        *(uint8_t *)(video_mem + (i << 1) + 1) = ATTRIB;
-    }
+    term_scroll(curr_executing_terminal_id);
 }
 
 /* void putc(uint8_t c);
@@ -176,6 +170,22 @@ void scroll() {
  * Return Value: void
  *  Function: Output a character to the console */
 void putc(uint8_t c) {
+    putc_raw(c);
+    serial_console_write(&c, 1);
+    if (curr_executing_terminal_id == curr_displaying_terminal_id) {
+        cursor_set(terminals[curr_executing_terminal_id].screen_x, terminals[curr_executing_terminal_id].screen_y);
+    }
+}
+
+/* void putc_raw(uint8_t c);
+ * Inputs: uint_8* c = character to print
+ * Return Value: void
+ *  Function: Output a character to the console without moving the hardware cursor,
+ *            for writers that move it once they're done */
+void putc_raw(uint8_t c) {
+    if (c != '\0') {
+        terminals[curr_executing_terminal_id].screen_writes++;
+    }
     switch (c) {
         case '\0':
             return;
@@ -203,16 +213,16 @@ void putc(uint8_t c) {
                 } else {
                     terminals[curr_executing_terminal_id].screen_x--;
                 }
-                *(uint8_t *)(video_mem + ((NUM_COLS * terminals[curr_executing_terminal_id].screen_y + terminals[curr_executing_terminal_id].screen_x) << 1)) = ' ';
-                *(uint8_t *)(video_mem + ((NUM_COLS * terminals[curr_executing_terminal_id].screen_y + terminals[curr_executing_terminal_id].screen_x) << 1) + 1) = ATTRIB;
+                *(uint8_t *)((char*) term_screen(curr_executing_terminal_id) + ((NUM_COLS * terminals[curr_executing_terminal_id].screen_y + terminals[curr_executing_terminal_id].screen_x) << 1)) = ' ';
+                *(uint8_t *)((char*) term_screen(curr_executing_terminal_id) + ((NUM_COLS * terminals[curr_executing_terminal_id].screen_y + terminals[curr_executing_terminal_id].screen_x) << 1) + 1) = ATTRIB;
             }
             break;
         case '\t':
             {
                 int i = 0;
                 for (i = 0; i < 4; i++) {
-                    *(uint8_t *)(video_mem + ((NUM_COLS * terminals[curr_executing_terminal_id].screen_y + terminals[curr_executing_terminal_id].screen_x) << 1)) = ' ';
-                    *(uint8_t *)(video_mem + ((NUM_COLS * terminals[curr_executing_terminal_id].screen_y + terminals[curr_executing_terminal_id].screen_x) << 1) + 1) = ATTRIB;
+                    *(uint8_t *)((char*) term_screen(curr_executing_terminal_id) + ((NUM_COLS * terminals[curr_executing_terminal_id].screen_y + terminals[curr_executing_terminal_id].screen_x) << 1)) = ' ';
+                    *(uint8_t *)((char*) term_screen(curr_executing_terminal_id) + ((NUM_COLS * terminals[curr_executing_terminal_id].screen_y + terminals[curr_executing_terminal_id].screen_x) << 1) + 1) = ATTRIB;
                     terminals[curr_executing_terminal_id].screen_x++;
                     if (terminals[curr_executing_terminal_id].screen_x >= NUM_COLS) {
                         terminals[curr_executing_terminal_id].screen_x = 0;
@@ -226,8 +236,8 @@ void putc(uint8_t c) {
             }
             break;
         default:
-            *(uint8_t *)(video_mem + ((NUM_COLS * terminals[curr_executing_terminal_id].screen_y + terminals[curr_executing_terminal_id].screen_x) << 1)) = c;
-            *(uint8_t *)(video_mem + ((NUM_COLS * terminals[curr_executing_terminal_id].screen_y + terminals[curr_executing_terminal_id].screen_x) << 1) + 1) = ATTRIB;
+            *(uint8_t *)((char*) term_screen(curr_executing_terminal_id) + ((NUM_COLS * terminals[curr_executing_terminal_id].screen_y + terminals[curr_executing_terminal_id].screen_x) << 1)) = c;
+            *(uint8_t *)((char*) term_screen(curr_executing_terminal_id) + ((NUM_COLS * terminals[curr_executing_terminal_id].screen_y + terminals[curr_executing_terminal_id].screen_x) << 1) + 1) = ATTRIB;
             terminals[curr_executing_terminal_id].screen_x++;
             if (terminals[curr_executing_terminal_id].screen_x >= NUM_COLS) {
                 terminals[curr_executing_terminal_id].screen_x = 0;
@@ -239,9 +249,6 @@ void putc(uint8_t c) {
             }
             break;
     }
-    if (curr_executing_terminal_id == curr_displaying_terminal_id) {
-        cursor_set(terminals[curr_executing_terminal_id].screen_x, terminals[curr_executing_terminal_id].screen_y);
-    }
 }
 
 /* int8_t* itoa(uint32_t value, int8_t* buf, int32_t radix);
@@ -536,6 +543,31 @@ int8_t* strncpy(int8_t* dest, const int8_t* src, uint32_t n) {
     return dest;
 }
 
+/* uint32_t div64_32(uint64_t* n, uint32_t base)
+ * Inputs: uint64_t* n = dividend, replaced by the quotient
+ *         uint32_t base = divisor
+ * Return Value: remainder
+ * Function: divide a 64-bit number without the libgcc helpers we don't link
+ *           against, using two 32-bit divides */
+uint32_t div64_32(uint64_t* n, uint32_t base) {
+    uint32_t high = (uint32_t) (*n >> 32);
+    uint32_t low = (uint32_t) *n;
+    uint32_t quot_high = 0;
+    uint32_t rem;
+    if (high >= base) {
+        quot_high = high / base;
+        high %= base;
+    }
+    // high < base now, so the quotient of high:low fits in 32 bits
+    asm volatile ("divl %4"
+            : "=a"(low), "=d"(rem)
+            : "0"(low), "1"(high), "rm"(base)
+            : "cc"
+    );
+    *n = ((uint64_t) quot_high << 32) | low;
+    return rem;
+}
+
 /* void test_interrupts(void)
  * Inputs: void
  * Return Value: void
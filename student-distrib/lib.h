@@ -6,6 +6,7 @@
 #define _LIB_H
 
 #include "types.h"
+#include "irqoff.h"
 
 #define VIDEO       0xB8000
 #define NUM_COLS    80
@@ -20,6 +21,7 @@ extern char* video_mem;
 int32_t printf(int8_t *format, ...);
 void scroll();
 void putc(uint8_t c);
+void putc_raw(uint8_t c);
 int32_t puts(int8_t *s);
 int8_t *itoa(uint32_t value, int8_t* buf, int32_t radix);
 int8_t *strrev(int8_t* s);
@@ -36,6 +38,7 @@ void* memmove(void* dest, const void* src, uint32_t n);
 int32_t strncmp(const int8_t* s1, const int8_t* s2, uint32_t n);
 int8_t* strcpy(int8_t* dest, const int8_t*src);
 int8_t* strncpy(int8_t* dest, const int8_t*src, uint32_t n);
+uint32_t div64_32(uint64_t* n, uint32_t base);
 
 void test_interrupts(void);
 void test_interrupts_cp2(int32_t interrupt_counter);
@@ -111,21 +114,47 @@ do {                                    \
 /* Writes four bytes to four consecutive ports */
 #define outl(data, port)                \
 do {                                    \
-    asm volatile ("outl %l1, (%w0)"     \
+    asm volatile ("outl %k1, (%w0)"     \
             :                           \
             : "d"(port), "a"(data)      \
             : "memory", "cc"            \
     );                                  \
 } while (0)
 
+/* Runs the CPUID instruction for a leaf, returning the registers it sets */
+static inline void cpuid(uint32_t leaf, uint32_t* eax, uint32_t* ebx, uint32_t* ecx, uint32_t* edx) {
+    asm volatile ("cpuid" : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx) : "a"(leaf), "c"(0));
+}
+
+/* Reads a model specific register */
+static inline uint64_t rdmsr(uint32_t msr) {
+    uint64_t val;
+    asm volatile ("rdmsr" : "=A"(val) : "c"(msr));
+    return val;
+}
+
+/* Writes a model specific register */
+static inline void wrmsr(uint32_t msr, uint64_t val) {
+    asm volatile ("wrmsr" : : "c"(msr), "A"(val));
+}
+
+/* The macros below report every change of the interrupt flag, with their call site, to the
+ * interrupts-off profiler (irqoff.c) */
+
 /* Clear interrupt flag - disables interrupts on this processor */
 #define cli()                           \
 do {                                    \
-    asm volatile ("cli"                 \
-            :                           \
+    uint32_t _cli_flags;                \
+    asm volatile ("                   \n\
+            pushfl                    \n\
+            popl %0                   \n\
+            cli                       \n\
+            "                           \
+            : "=r"(_cli_flags)          \
             :                           \
             : "memory", "cc"            \
     );                                  \
+    irqoff_begin(_cli_flags, (int8_t*) __FILE__, __LINE__); \
 } while (0)
 
 /* Save flags and then clear interrupt flag
@@ -142,11 +171,13 @@ do {                                    \
             :                           \
             : "memory", "cc"            \
     );                                  \
+    irqoff_begin(flags, (int8_t*) __FILE__, __LINE__); \
 } while (0)
 
 /* Set interrupt flag - enable interrupts on this processor */
 #define sti()                           \
 do {                                    \
+    irqoff_end((int8_t*) __FILE__, __LINE__); \
     asm volatile ("sti"                 \
             :                           \
             :                           \
@@ -159,6 +190,9 @@ do {                                    \
  * after a cli_and_save_flags(flags) */
 #define restore_flags(flags)            \
 do {                                    \
+    if ((flags) & EFLAGS_IF) {          \
+        irqoff_end((int8_t*) __FILE__, __LINE__); \
+    }                                   \
     asm volatile ("                   \n\
             pushl %0                  \n\
             popfl                     \n\
@@ -0,0 +1,371 @@
+#include "lock.h"
+#include "task.h"
+#include "devices/tsc.h"
+
+// Named locks, in the order they were initialized
+static lock_stats_t* lock_stats_table[MAX_LOCK_STATS];
+static uint32_t lock_stats_count = 0;
+static spinlock_t lock_stats_lock = SPINLOCK_INIT;
+
+/* 
+ * xchg
+ *   DESCRIPTION: Atomically swaps a word with a new value
+ *   INPUTS: addr -- the word
+ *           val -- new value
+ *   OUTPUTS: none
+ *   RETURN VALUE: old value of the word
+ *   SIDE EFFECTS: full memory barrier
+ */
+static inline uint32_t xchg(volatile uint32_t* addr, uint32_t val) {
+    asm volatile ("xchgl %0, %1" : "+r"(val), "+m"(*addr) : : "memory");
+    return val;
+}
+
+/* 
+ * lock_stats_init
+ *   DESCRIPTION: Clears a lock's statistics and lists it for lock_stats_print if it has a name
+ *   INPUTS: stats -- the statistics
+ *           name -- name to list them under, NULL to keep them unlisted
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: locks past MAX_LOCK_STATS are counted but not listed
+ */
+static void lock_stats_init(lock_stats_t* stats, const int8_t* name) {
+    uint32_t flags;
+    stats->name = name;
+    stats->acquires = 0;
+    stats->contended = 0;
+    stats->max_hold_cycles = 0;
+    stats->hold_start = 0;
+    if (name == NULL) return;
+
+    spin_lock_irqsave(&lock_stats_lock, flags);
+    if (lock_stats_count < MAX_LOCK_STATS) {
+        lock_stats_table[lock_stats_count++] = stats;
+    }
+    spin_unlock_irqrestore(&lock_stats_lock, flags);
+}
+
+/* 
+ * lock_acquired / lock_released
+ *   DESCRIPTION: Account for a lock being taken / given back. Called by the holder, which is the only
+ *                one touching the statistics meanwhile.
+ *   INPUTS: stats -- the lock's statistics
+ *           waited -- whether the taker had to wait for the lock (lock_acquired only)
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void lock_acquired(lock_stats_t* stats, uint32_t waited) {
+    stats->acquires++;
+    if (waited) stats->contended++;
+    stats->hold_start = now_cycles();
+}
+
+static void lock_released(lock_stats_t* stats) {
+    uint64_t held = now_cycles() - stats->hold_start;
+    if (held > stats->max_hold_cycles) {
+        stats->max_hold_cycles = held;
+    }
+}
+
+/* 
+ * spin_lock_init
+ *   DESCRIPTION: Initializes a spinlock as unlocked
+ *   INPUTS: lock -- the lock
+ *           name -- name lock_stats_print lists it under, NULL to leave it out
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void spin_lock_init(spinlock_t* lock, const int8_t* name) {
+    lock->locked = 0;
+    lock_stats_init(&lock->stats, name);
+}
+
+/* 
+ * spin_lock
+ *   DESCRIPTION: Takes a spinlock, busy waiting while another processor holds it. Spinlocks don't
+ *                nest and don't disable interrupts, callers that share the lock with an interrupt
+ *                handler disable them first.
+ *   INPUTS: lock -- the lock
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void spin_lock(spinlock_t* lock) {
+    uint32_t waited = 0;
+    while (xchg(&lock->locked, 1) != 0) {
+        waited = 1;
+        // Wait with plain reads so the cache line isn't bounced between processors
+        while (lock->locked) {
+            asm volatile ("pause" : : : "memory");
+        }
+    }
+    lock_acquired(&lock->stats, waited);
+}
+
+/* 
+ * spin_trylock
+ *   DESCRIPTION: Takes a spinlock if it is free
+ *   INPUTS: lock -- the lock
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if the lock was taken, 0 if another processor holds it
+ *   SIDE EFFECTS: none
+ */
+int32_t spin_trylock(spinlock_t* lock) {
+    if (xchg(&lock->locked, 1) != 0) return 0;
+    lock_acquired(&lock->stats, 0);
+    return 1;
+}
+
+/* 
+ * spin_unlock
+ *   DESCRIPTION: Releases a spinlock
+ *   INPUTS: lock -- the lock
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void spin_unlock(spinlock_t* lock) {
+    lock_released(&lock->stats);
+    xchg(&lock->locked, 0);
+}
+
+/* 
+ * lock_wait
+ *   DESCRIPTION: Sleeps until the holder of a mutex or rwlock wakes its waiters. Called with the lock's
+ *                guard held and interrupts disabled, returns the same way. The kernel lock keeps the
+ *                wakeup from slipping in between dropping the guard and going to sleep.
+ *   INPUTS: channel -- the mutex or rwlock
+ *           guard -- its guard
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: switches to other tasks meanwhile
+ */
+static void lock_wait(void* channel, spinlock_t* guard) {
+    spin_unlock(guard);
+    task_block(channel);
+    spin_lock(guard);
+}
+
+/* 
+ * mutex_init
+ *   DESCRIPTION: Initializes a mutex as unlocked
+ *   INPUTS: mutex -- the mutex
+ *           name -- name lock_stats_print lists it under, NULL to leave it out
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void mutex_init(mutex_t* mutex, const int8_t* name) {
+    spin_lock_init(&mutex->guard, NULL);
+    mutex->locked = 0;
+    mutex->owner = -1;
+    lock_stats_init(&mutex->stats, name);
+}
+
+/* 
+ * mutex_lock
+ *   DESCRIPTION: Takes a mutex, sleeping while someone else holds it. Mutexes don't nest.
+ *   INPUTS: mutex -- the mutex
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may switch to other tasks
+ */
+void mutex_lock(mutex_t* mutex) {
+    uint32_t flags, waited = 0;
+    spin_lock_irqsave(&mutex->guard, flags);
+    while (mutex->locked) {
+        waited = 1;
+        lock_wait(mutex, &mutex->guard);
+    }
+    mutex->locked = 1;
+    mutex->owner = curr_pid;
+    lock_acquired(&mutex->stats, waited);
+    spin_unlock_irqrestore(&mutex->guard, flags);
+}
+
+/* 
+ * mutex_trylock
+ *   DESCRIPTION: Takes a mutex if it is free
+ *   INPUTS: mutex -- the mutex
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if the mutex was taken, 0 if someone else holds it
+ *   SIDE EFFECTS: none
+ */
+int32_t mutex_trylock(mutex_t* mutex) {
+    uint32_t flags;
+    int32_t taken = 0;
+    spin_lock_irqsave(&mutex->guard, flags);
+    if (!mutex->locked) {
+        mutex->locked = 1;
+        mutex->owner = curr_pid;
+        lock_acquired(&mutex->stats, 0);
+        taken = 1;
+    }
+    spin_unlock_irqrestore(&mutex->guard, flags);
+    return taken;
+}
+
+/* 
+ * mutex_unlock
+ *   DESCRIPTION: Releases a mutex and wakes the tasks waiting for it
+ *   INPUTS: mutex -- the mutex
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void mutex_unlock(mutex_t* mutex) {
+    uint32_t flags;
+    spin_lock_irqsave(&mutex->guard, flags);
+    lock_released(&mutex->stats);
+    mutex->locked = 0;
+    mutex->owner = -1;
+    task_wakeup(mutex);
+    spin_unlock_irqrestore(&mutex->guard, flags);
+}
+
+/* 
+ * rwlock_init
+ *   DESCRIPTION: Initializes a reader/writer lock as unlocked
+ *   INPUTS: rwlock -- the lock
+ *           name -- name lock_stats_print lists it under, NULL to leave it out
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void rwlock_init(rwlock_t* rwlock, const int8_t* name) {
+    spin_lock_init(&rwlock->guard, NULL);
+    rwlock->readers = 0;
+    rwlock->writer = 0;
+    rwlock->writers_waiting = 0;
+    lock_stats_init(&rwlock->stats, name);
+}
+
+/* 
+ * read_lock
+ *   DESCRIPTION: Takes a reader/writer lock shared, sleeping while a writer holds or waits for it
+ *   INPUTS: rwlock -- the lock
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may switch to other tasks
+ */
+void read_lock(rwlock_t* rwlock) {
+    uint32_t flags, waited = 0;
+    spin_lock_irqsave(&rwlock->guard, flags);
+    while (rwlock->writer || rwlock->writers_waiting > 0) {
+        waited = 1;
+        lock_wait(rwlock, &rwlock->guard);
+    }
+    rwlock->readers++;
+    rwlock->stats.acquires++;
+    if (waited) rwlock->stats.contended++;
+    spin_unlock_irqrestore(&rwlock->guard, flags);
+}
+
+/* 
+ * read_unlock
+ *   DESCRIPTION: Releases a shared hold, the last reader out lets a waiting writer in
+ *   INPUTS: rwlock -- the lock
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void read_unlock(rwlock_t* rwlock) {
+    uint32_t flags;
+    spin_lock_irqsave(&rwlock->guard, flags);
+    if (--rwlock->readers == 0 && rwlock->writers_waiting > 0) {
+        task_wakeup(rwlock);
+    }
+    spin_unlock_irqrestore(&rwlock->guard, flags);
+}
+
+/* 
+ * write_lock
+ *   DESCRIPTION: Takes a reader/writer lock exclusively, sleeping while anyone else holds it
+ *   INPUTS: rwlock -- the lock
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may switch to other tasks
+ */
+void write_lock(rwlock_t* rwlock) {
+    uint32_t flags, waited = 0;
+    spin_lock_irqsave(&rwlock->guard, flags);
+    rwlock->writers_waiting++;
+    while (rwlock->writer || rwlock->readers > 0) {
+        waited = 1;
+        lock_wait(rwlock, &rwlock->guard);
+    }
+    rwlock->writers_waiting--;
+    rwlock->writer = 1;
+    lock_acquired(&rwlock->stats, waited);
+    spin_unlock_irqrestore(&rwlock->guard, flags);
+}
+
+/* 
+ * write_unlock
+ *   DESCRIPTION: Releases an exclusive hold and wakes every waiter
+ *   INPUTS: rwlock -- the lock
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void write_unlock(rwlock_t* rwlock) {
+    uint32_t flags;
+    spin_lock_irqsave(&rwlock->guard, flags);
+    lock_released(&rwlock->stats);
+    rwlock->writer = 0;
+    task_wakeup(rwlock);
+    spin_unlock_irqrestore(&rwlock->guard, flags);
+}
+
+/* 
+ * lock_stats_get
+ *   DESCRIPTION: Gets the statistics of a named lock
+ *   INPUTS: idx -- position of the lock in initialization order
+ *   OUTPUTS: none
+ *   RETURN VALUE: the statistics, NULL past the last named lock
+ *   SIDE EFFECTS: none
+ */
+lock_stats_t* lock_stats_get(uint32_t idx) {
+    return idx < lock_stats_count ? lock_stats_table[idx] : NULL;
+}
+
+/* 
+ * lock_stats_reset
+ *   DESCRIPTION: Zeroes the counters of every named lock, to measure a workload on its own
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void lock_stats_reset() {
+    uint32_t i;
+    for (i = 0; i < lock_stats_count; i++) {
+        lock_stats_table[i]->acquires = 0;
+        lock_stats_table[i]->contended = 0;
+        lock_stats_table[i]->max_hold_cycles = 0;
+    }
+}
+
+/* 
+ * lock_stats_print
+ *   DESCRIPTION: Prints the acquire & contention counts and the longest hold of every named lock
+ *   INPUTS: none
+ *   OUTPUTS: one line per lock
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void lock_stats_print() {
+    uint32_t i;
+    uint64_t hold_us;
+    lock_stats_t* stats;
+    for (i = 0; i < lock_stats_count; i++) {
+        stats = lock_stats_table[i];
+        hold_us = cycles_to_ns(stats->max_hold_cycles);
+        div64_32(&hold_us, 1000);
+        printf("%s: %u acquires, %u contended, longest hold %u us\n",
+            stats->name, stats->acquires, stats->contended, (uint32_t) hold_us);
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef _LOCK_H
+#define _LOCK_H
+
+#include "types.h"
+#include "lib.h"
+
+// How many named locks lock_stats_print can list
+#define MAX_LOCK_STATS 32
+
+typedef struct lock_stats {
+    const int8_t* name;             // shown by lock_stats_print, NULL for locks that aren't listed
+    uint32_t acquires;              // times the lock was taken
+    uint32_t contended;             // times the taker had to wait for it
+    uint64_t max_hold_cycles;       // longest time (TSC cycles) it was held exclusively
+    uint64_t hold_start;            // TSC when the current exclusive holder took it
+} lock_stats_t;
+
+typedef struct spinlock {
+    volatile uint32_t locked;       // 1 while a processor holds the lock
+    lock_stats_t stats;
+} spinlock_t;
+
+// Sleeping lock for task context only, never for interrupt handlers
+typedef struct mutex {
+    spinlock_t guard;               // protects the fields below
+    uint8_t locked;
+    int32_t owner;                  // pid of the holder, -1 for kernel code running without a task
+    lock_stats_t stats;
+} mutex_t;
+
+// Sleeping reader/writer lock, waiting writers keep new readers out so they can't starve
+typedef struct rwlock {
+    spinlock_t guard;               // protects the fields below
+    uint32_t readers;               // number of readers holding the lock
+    uint8_t writer;                 // whether a writer holds the lock
+    uint32_t writers_waiting;
+    lock_stats_t stats;             // the hold time is measured for writers only
+} rwlock_t;
+
+// Unlisted spinlock for static initialization, spin_lock_init gives it a name
+#define SPINLOCK_INIT { 0, { NULL, 0, 0, 0, 0 } }
+
+/* Spinlock that an interrupt handler on the same processor may also take */
+#define spin_lock_irqsave(lock, flags)      \
+do {                                        \
+    cli_and_save(flags);                    \
+    spin_lock(lock);                        \
+} while (0)
+
+#define spin_unlock_irqrestore(lock, flags) \
+do {                                        \
+    spin_unlock(lock);                      \
+    restore_flags(flags);                   \
+} while (0)
+
+void spin_lock_init(spinlock_t* lock, const int8_t* name);
+void spin_lock(spinlock_t* lock);
+int32_t spin_trylock(spinlock_t* lock);
+void spin_unlock(spinlock_t* lock);
+
+void mutex_init(mutex_t* mutex, const int8_t* name);
+void mutex_lock(mutex_t* mutex);
+int32_t mutex_trylock(mutex_t* mutex);
+void mutex_unlock(mutex_t* mutex);
+
+void rwlock_init(rwlock_t* rwlock, const int8_t* name);
+void read_lock(rwlock_t* rwlock);
+void read_unlock(rwlock_t* rwlock);
+void write_lock(rwlock_t* rwlock);
+void write_unlock(rwlock_t* rwlock);
+
+lock_stats_t* lock_stats_get(uint32_t idx);
+void lock_stats_reset();
+void lock_stats_print();
+
+#endif
@@ -1,10 +1,26 @@
 #include "paging.h"
 #include "address.h"
 #include "lib.h"
+#include "shm.h"
+#include "apic.h"
+#include "devices/terminal.h"
+#include "devices/vga.h"
+#include "task.h"
 
 extern void loadPageDirectory(int);
 extern void enablePaging();
 
+page_directory_entry_t cpu_page_directory[MAX_CPUS][TABLE_SIZE] __attribute__((aligned(PAGE_SIZE_4KB)));
+page_table_entry_t cpu_page_table[MAX_CPUS][TABLE_SIZE] __attribute__((aligned(PAGE_SIZE_4KB)));
+page_table_entry_t cpu_vidmap_page_table[MAX_CPUS][TABLE_SIZE] __attribute__((aligned(PAGE_SIZE_4KB)));
+page_table_entry_t cpu_shm_page_table[MAX_CPUS][TABLE_SIZE] __attribute__((aligned(PAGE_SIZE_4KB)));
+
+// Number of users of each frame in the frame pool, 0 = free
+uint16_t frame_refcounts[FRAME_POOL_COUNT];
+
+volatile uint32_t mapping_generation = 0;
+uint8_t pat_write_combining = 0;
+
 /*
  * initialize_paging
  *   DESCRIPTION: Initializes paging by setting up the page directory and page table
@@ -41,12 +57,8 @@ void initialize_paging() {
         page_table[i].global_page = 0;
         page_table[i].available = 0;
         page_table[i].page_addr = 0;
-        // || i == VIDEO_PERM_MEM_INDEX
-        if (i == VIDEO_MEM_INDEX || i == VIDEO_PERM_MEM_INDEX) {
-            page_table[i].present = 1;
-            page_table[i].page_addr = VIDEO_MEM_INDEX;
-            page_table[i].cache_disable = 0;
-        } else if (i >= VIDEO_MEM_BACKGROUND_START_INDEX && i <= VIDEO_MEM_BACKGROUND_END_INDEX) {
+        // VGA text memory, identity mapped for good since every terminal has its own ring to write to
+        if (i >= VIDEO_MEM_INDEX && i < VGA_TEXT_END_INDEX) {
             page_table[i].present = 1;
             page_table[i].page_addr = i;
             page_table[i].cache_disable = 0;
@@ -114,19 +126,98 @@ void initialize_paging() {
         }
     }
 
+    // identity map the frame pool so the kernel can reach every frame
+    page_directory[FRAME_POOL_PD_IDX].present = 1;
+    page_directory[FRAME_POOL_PD_IDX].cache_disable = 0;
+    page_directory[FRAME_POOL_PD_IDX].page_table_addr = FRAME_POOL_PHYSICAL_ADDR / PAGE_SIZE_4KB;
+    for (i = 0; i < FRAME_POOL_COUNT; i++) {
+        frame_refcounts[i] = 0;
+    }
+
+    // set up shared memory page directory entry, the table entries are filled in per task by shm_map_task
+    page_directory[SHM_PD_IDX].present = 1;
+    page_directory[SHM_PD_IDX].read_write = 1;
+    page_directory[SHM_PD_IDX].user_supervisor = 1;
+    page_directory[SHM_PD_IDX].write_through = 0;
+    page_directory[SHM_PD_IDX].cache_disable = 0;
+    page_directory[SHM_PD_IDX].accessed = 0;
+    page_directory[SHM_PD_IDX].reserved = 0;
+    page_directory[SHM_PD_IDX].page_size = 0;
+    page_directory[SHM_PD_IDX].global_page = 0;
+    page_directory[SHM_PD_IDX].available = 0;
+    page_directory[SHM_PD_IDX].page_table_addr = ((uint32_t) shm_page_table) / PAGE_SIZE_4KB;
+
+    // set up shared memory page table
+    for (i = 0; i < TABLE_SIZE; i++) {
+        shm_page_table[i].present = 0;
+        shm_page_table[i].read_write = 1;
+        shm_page_table[i].user_supervisor = 1;
+        shm_page_table[i].write_through = 0;
+        shm_page_table[i].cache_disable = 0;
+        shm_page_table[i].accessed = 0;
+        shm_page_table[i].dirty = 0;
+        shm_page_table[i].pt_attribute_index = 0;
+        shm_page_table[i].global_page = 0;
+        shm_page_table[i].available = 0;
+        shm_page_table[i].page_addr = 0;
+    }
+
+    paging_init_pat();
     loadPageDirectory((int) page_directory);
     enablePaging();
 }
 
+/*
+ * paging_init_pat
+ *   DESCRIPTION: Makes PAT entry 1 write-combining on the calling processor. Nothing maps with it but
+ *                framebuffers, every other mapping leaves PWT clear or sets PCD too. Every processor runs
+ *                it while it boots, before any framebuffer is mapped.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: sets pat_write_combining if the processor has a PAT
+ */
+void paging_init_pat() {
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(CPUID_FEATURES, &eax, &ebx, &ecx, &edx);
+    if (!(edx & CPUID_EDX_PAT)) return;
+    wrmsr(IA32_PAT_MSR, (rdmsr(IA32_PAT_MSR) & ~((uint64_t) PAT_ENTRY_MASK << PAT_ENTRY_SHIFT)) |
+                        ((uint64_t) PAT_WRITE_COMBINING << PAT_ENTRY_SHIFT));
+    pat_write_combining = 1;
+}
+
+/*
+ * paging_init_cpu
+ *   DESCRIPTION: Gives an application processor its own copy of the boot processor's paging structures
+ *   INPUTS: cpu_id -- index of the processor
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: the processor can load cpu_page_directory[cpu_id] once this returns
+ */
+void paging_init_cpu(uint32_t cpu_id) {
+    memcpy(cpu_page_directory[cpu_id], cpu_page_directory[0], sizeof(cpu_page_directory[0]));
+    memcpy(cpu_page_table[cpu_id], cpu_page_table[0], sizeof(cpu_page_table[0]));
+    memcpy(cpu_vidmap_page_table[cpu_id], cpu_vidmap_page_table[0], sizeof(cpu_vidmap_page_table[0]));
+    memcpy(cpu_shm_page_table[cpu_id], cpu_shm_page_table[0], sizeof(cpu_shm_page_table[0]));
+
+    // Point the copied directory at the copied tables
+    cpu_page_directory[cpu_id][0].page_table_addr = ((uint32_t) cpu_page_table[cpu_id]) / PAGE_SIZE_4KB;
+    cpu_page_directory[cpu_id][PROGRAM_VIDEO_PD_IDX].page_table_addr = ((uint32_t) cpu_vidmap_page_table[cpu_id]) / PAGE_SIZE_4KB;
+    cpu_page_directory[cpu_id][SHM_PD_IDX].page_table_addr = ((uint32_t) cpu_shm_page_table[cpu_id]) / PAGE_SIZE_4KB;
+}
+
 /* 
  * map_program
  *   DESCRIPTION: Maps a program to a page directory entry (maps virtual address to physical address)
  *   INPUTS: pid - the process id of the program
+ *           is_vidmapped - VIDMAP_* if the program called vidmap or vidmap_buffered, 0 if not
+ *           owning_terminal_id - terminal whose screen vidmap shows
  *   OUTPUTS: none
  *   RETURN VALUE: none
  *   SIDE EFFECTS: maps a program to a page directory entry
  */
-void map_program(int32_t pid, uint8_t is_vidmapped, uint32_t owning_terminal_id, uint8_t is_terminal_displayed) {
+void map_program(int32_t pid, uint8_t is_vidmapped, uint32_t owning_terminal_id) {
+    uint32_t ring;
     // Per the docs, the first user-level program (the shell) should be loaded at physical 8 MB,
     // and the second user-level program, when it is executed by the shell, should be loaded at
     // physical 12 MB
@@ -144,19 +235,24 @@ void map_program(int32_t pid, uint8_t is_vidmapped, uint32_t owning_terminal_id,
     page_directory[PROGRAM_IMAGE_PD_IDX].page_table_addr = physical_addr / PAGE_SIZE_4KB;
 
     // Mapping video memory (physical & virtual)
-    page_directory[PROGRAM_VIDEO_PD_IDX].present = is_vidmapped == 1;
-    if (is_terminal_displayed) {
-        // Direct access to video memory (with VIDEO_MEM)
-        page_table[VIDEO_MEM_INDEX].page_addr = VIDEO_MEM_INDEX;
-        // Virtual memory access to video memory (with PROGRAM_VIDEO_VIRTUAL_ADDR)
-        vidmap_page_table[VIDEO_MEM_INDEX].page_addr = VIDEO_MEM_INDEX;
+    page_directory[PROGRAM_VIDEO_PD_IDX].present = is_vidmapped != 0;
+    if (is_vidmapped == VIDMAP_BUFFERED) {
+        // The program draws in its back buffer, present copies it to the screen
+        vidmap_page_table[VIDEO_MEM_INDEX].page_addr = get_pcb(pid)->vid_back / PAGE_SIZE_4KB;
     } else {
-        // Redirect to background video memory
-        page_table[VIDEO_MEM_INDEX].page_addr = VIDEO_MEM_BACKGROUND_START_INDEX + owning_terminal_id;
-        vidmap_page_table[VIDEO_MEM_INDEX].page_addr = VIDEO_MEM_BACKGROUND_START_INDEX + owning_terminal_id;
+        // A vidmapped terminal's screen is pinned to the start of its ring, in its slot of VGA text memory.
+        // The slot is wherever the kernel's own mapping of it points, which is RAM while graphics are shown
+        ring = (uint32_t) terminals[owning_terminal_id].ring;
+        vidmap_page_table[VIDEO_MEM_INDEX].page_addr = ring < PAGE_SIZE_4MB ? page_table[ring / PAGE_SIZE_4KB].page_addr : ring / PAGE_SIZE_4KB;
     }
+    // The framebuffer, for the task with the terminal in graphics mode
+    vga_map_task(pid);
+
+    // Shared memory segments the task has mapped
+    shm_map_task(pid);
+    this_cpu()->map_generation = mapping_generation;
     flush_tlb();
-    // printf("mapping %d (vidmap=%d, tid=%d, displayed=%d)\n", pid, is_vidmapped, owning_terminal_id, is_terminal_displayed);
+    // printf("mapping %d (vidmap=%d, tid=%d)\n", pid, is_vidmapped, owning_terminal_id);
 }
 
 /* 
@@ -190,3 +286,145 @@ void flush_tlb() {
         : "memory", "cc"
     );
 }
+
+/* 
+ * map_mmio
+ *   DESCRIPTION: Identity maps the 4MB page holding a device's registers, uncached
+ *   INPUTS: phys_addr -- physical address of the registers
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: the registers can be accessed through phys_addr
+ */
+void map_mmio(uint32_t phys_addr) {
+    uint32_t idx = phys_addr >> 22;
+    page_directory[idx].present = 1;
+    page_directory[idx].read_write = 1;
+    page_directory[idx].user_supervisor = 0;
+    page_directory[idx].write_through = 1;
+    page_directory[idx].cache_disable = 1;
+    page_directory[idx].page_size = 1;
+    page_directory[idx].page_table_addr = (phys_addr & ~(PAGE_SIZE_4MB - 1)) / PAGE_SIZE_4KB;
+    flush_tlb();
+}
+
+/* 
+ * phys_window_map
+ *   DESCRIPTION: Points the physical window of the calling processor at phys_addr with the given caching
+ *   INPUTS: phys_addr -- physical address to reach
+ *           write_through, cache_disable -- PWT and PCD of the window, which pick its PAT entry
+ *   OUTPUTS: none
+ *   RETURN VALUE: kernel pointer to phys_addr
+ *   SIDE EFFECTS: pointers returned by earlier calls may no longer be valid
+ */
+static void* phys_window_map(uint32_t phys_addr, uint8_t write_through, uint8_t cache_disable) {
+    uint32_t base = phys_addr & ~(PAGE_SIZE_4MB - 1);
+    int32_t i;
+    if (!page_directory[PHYS_WINDOW_PD_IDX].present || page_directory[PHYS_WINDOW_PD_IDX].page_table_addr != base / PAGE_SIZE_4KB ||
+        page_directory[PHYS_WINDOW_PD_IDX].write_through != write_through || page_directory[PHYS_WINDOW_PD_IDX].cache_disable != cache_disable) {
+        for (i = 0; i < 2; i++) {
+            page_directory[PHYS_WINDOW_PD_IDX + i].present = 1;
+            page_directory[PHYS_WINDOW_PD_IDX + i].read_write = 1;
+            page_directory[PHYS_WINDOW_PD_IDX + i].user_supervisor = 0;
+            page_directory[PHYS_WINDOW_PD_IDX + i].write_through = write_through;
+            page_directory[PHYS_WINDOW_PD_IDX + i].cache_disable = cache_disable;
+            page_directory[PHYS_WINDOW_PD_IDX + i].page_size = 1;
+            page_directory[PHYS_WINDOW_PD_IDX + i].page_table_addr = (base + i * PAGE_SIZE_4MB) / PAGE_SIZE_4KB;
+        }
+        flush_tlb();
+    }
+    return (void*) (PHYS_WINDOW_VIRTUAL_ADDR + phys_addr - base);
+}
+
+/* 
+ * map_phys_window
+ *   DESCRIPTION: Maps arbitrary physical memory (such as ACPI tables) into the physical window of the
+ *                calling processor, write-back. At least 4MB past phys_addr can be accessed.
+ *   INPUTS: phys_addr -- physical address to reach
+ *   OUTPUTS: none
+ *   RETURN VALUE: kernel pointer to phys_addr
+ *   SIDE EFFECTS: pointers returned by earlier calls may no longer be valid
+ */
+void* map_phys_window(uint32_t phys_addr) {
+    return phys_window_map(phys_addr, 0, 0);
+}
+
+/* 
+ * map_fb_window
+ *   DESCRIPTION: Maps a framebuffer into the physical window of the calling processor with the memory type
+ *                vidmap gives it, write-combining (uncached without a PAT). Mapping a framebuffer
+ *                write-back while a task has it write-combining is undefined.
+ *   INPUTS: phys_addr -- physical address of the framebuffer
+ *   OUTPUTS: none
+ *   RETURN VALUE: kernel pointer to phys_addr
+ *   SIDE EFFECTS: pointers returned by earlier calls may no longer be valid
+ */
+void* map_fb_window(uint32_t phys_addr) {
+    // PWT alone selects PAT entry 1, which paging_init_pat makes write-combining
+    return phys_window_map(phys_addr, pat_write_combining, !pat_write_combining);
+}
+
+/* 
+ * frame_alloc
+ *   DESCRIPTION: Allocates a zeroed 4KB frame from the frame pool
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: physical address of the frame (with a reference count of 1), 0 if the pool is empty
+ *   SIDE EFFECTS: none
+ */
+uint32_t frame_alloc() {
+    uint32_t flags, frame_addr;
+    int32_t i;
+    cli_and_save(flags);
+    for (i = 0; i < FRAME_POOL_COUNT; i++) {
+        if (frame_refcounts[i] == 0) {
+            frame_refcounts[i] = 1;
+            break;
+        }
+    }
+    restore_flags(flags);
+    if (i == FRAME_POOL_COUNT) return 0;
+
+    // The pool is identity mapped, so the physical address works as a kernel pointer
+    frame_addr = FRAME_POOL_PHYSICAL_ADDR + i * PAGE_SIZE_4KB;
+    memset((void*) frame_addr, 0, PAGE_SIZE_4KB);
+    return frame_addr;
+}
+
+/* 
+ * frame_get
+ *   DESCRIPTION: Adds a reference to an allocated frame
+ *   INPUTS: frame_addr -- physical address returned by frame_alloc
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void frame_get(uint32_t frame_addr) {
+    frame_refcounts[(frame_addr - FRAME_POOL_PHYSICAL_ADDR) / PAGE_SIZE_4KB]++;
+}
+
+/* 
+ * frame_put
+ *   DESCRIPTION: Drops a reference to an allocated frame, the last one frees it
+ *   INPUTS: frame_addr -- physical address returned by frame_alloc
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void frame_put(uint32_t frame_addr) {
+    uint32_t i = (frame_addr - FRAME_POOL_PHYSICAL_ADDR) / PAGE_SIZE_4KB;
+    if (frame_refcounts[i] > 0) {
+        frame_refcounts[i]--;
+    }
+}
+
+/* 
+ * frame_refcount
+ *   DESCRIPTION: Gets the number of references to a frame
+ *   INPUTS: frame_addr -- physical address returned by frame_alloc
+ *   OUTPUTS: none
+ *   RETURN VALUE: reference count, 0 if the frame is free
+ *   SIDE EFFECTS: none
+ */
+uint32_t frame_refcount(uint32_t frame_addr) {
+    return frame_refcounts[(frame_addr - FRAME_POOL_PHYSICAL_ADDR) / PAGE_SIZE_4KB];
+}
@@ -4,6 +4,7 @@
 #ifndef ASM
 #include "types.h"
 #include "address.h"
+#include "smp.h"
 
 typedef struct __attribute__((packed)) page_directory_entry_t {
     uint32_t present : 1;           // 0
@@ -33,14 +34,45 @@ typedef struct __attribute__((packed)) page_table_entry_t {
     uint32_t page_addr : 20;
 } page_table_entry_t;
 
-page_directory_entry_t page_directory[TABLE_SIZE] __attribute__((aligned(PAGE_SIZE_4KB)));
-page_table_entry_t page_table[TABLE_SIZE] __attribute__((aligned(PAGE_SIZE_4KB)));
-page_table_entry_t vidmap_page_table[TABLE_SIZE] __attribute__((aligned(PAGE_SIZE_4KB)));
+// Every processor runs a different task, so each has its own copy of the paging structures
+extern page_directory_entry_t cpu_page_directory[MAX_CPUS][TABLE_SIZE];
+extern page_table_entry_t cpu_page_table[MAX_CPUS][TABLE_SIZE];
+extern page_table_entry_t cpu_vidmap_page_table[MAX_CPUS][TABLE_SIZE];
+extern page_table_entry_t cpu_shm_page_table[MAX_CPUS][TABLE_SIZE];
+
+// The calling processor's copy
+#define page_directory (cpu_page_directory[this_cpu()->id])
+#define page_table (cpu_page_table[this_cpu()->id])
+#define vidmap_page_table (cpu_vidmap_page_table[this_cpu()->id])
+#define shm_page_table (cpu_shm_page_table[this_cpu()->id])
+
+// Page attribute table: entry 1 (PWT set, PCD clear) is made write-combining, framebuffers use it
+#define IA32_PAT_MSR 0x277
+#define CPUID_EDX_PAT 0x10000
+#define PAT_ENTRY_SHIFT 8
+#define PAT_ENTRY_MASK 0xFF
+#define PAT_WRITE_COMBINING 0x01
+
+// Whether paging_init_pat could make PAT entry 1 write-combining
+extern uint8_t pat_write_combining;
+
+// Bumped whenever a change (like switching terminals) invalidates the mappings of tasks on other processors
+extern volatile uint32_t mapping_generation;
 
 void initialize_paging();
-void map_program(int32_t pid, uint8_t is_vidmapped, uint32_t owning_terminal_id, uint8_t is_terminal_displayed);
+void paging_init_cpu(uint32_t cpu_id);
+void paging_init_pat();
+void map_program(int32_t pid, uint8_t is_vidmapped, uint32_t owning_terminal_id);
 void unmap_program(int32_t pid);
 void flush_tlb();
+void map_mmio(uint32_t phys_addr);
+void* map_phys_window(uint32_t phys_addr);
+void* map_fb_window(uint32_t phys_addr);
+
+uint32_t frame_alloc();
+void frame_get(uint32_t frame_addr);
+void frame_put(uint32_t frame_addr);
+uint32_t frame_refcount(uint32_t frame_addr);
 
 #endif
 #endif
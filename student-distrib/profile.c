@@ -0,0 +1,191 @@
+#include "profile.h"
+#include "lib.h"
+#include "address.h"
+#include "smp.h"
+#include "timer.h"
+
+/*
+ * The timer handler and the syscall both hold the kernel lock, so the ring needs no lock of its own.
+ * Each processor counts its own ticks down to the next sample.
+ */
+profile_ring_t profile_ring;
+
+static uint8_t profile_enabled = 0;
+static uint32_t profile_interval = 1;               // timer ticks between samples
+static uint32_t profile_countdown[MAX_CPUS];
+
+/*
+ * profile_init
+ *   DESCRIPTION: Sets up the empty ring, profiling starts out off
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void profile_init() {
+    profile_ring.magic = PROFILE_MAGIC;
+    profile_ring.head = 0;
+    profile_ring.count = 0;
+    profile_ring.dropped = 0;
+    profile_enabled = 0;
+}
+
+/*
+ * profile_start
+ *   DESCRIPTION: Empties the ring and starts taking samples on every processor. The timer is the
+ *                sampling clock, so the rate is rounded to a whole number of ticks.
+ *   INPUTS: hz -- samples per second on each processor, 1 to TIMER_TICK_HZ
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 for a rate the timer can't give
+ *   SIDE EFFECTS: none
+ */
+int32_t profile_start(uint32_t hz) {
+    uint32_t i;
+    if (hz == 0 || hz > TIMER_TICK_HZ) return -1;
+
+    profile_ring.head = 0;
+    profile_ring.count = 0;
+    profile_ring.dropped = 0;
+    profile_interval = TIMER_TICK_HZ / hz;
+    for (i = 0; i < MAX_CPUS; i++) {
+        profile_countdown[i] = profile_interval;
+    }
+    profile_enabled = 1;
+    return 0;
+}
+
+/*
+ * profile_stop
+ *   DESCRIPTION: Stops taking samples, the ring keeps the ones taken so far
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void profile_stop() {
+    profile_enabled = 0;
+}
+
+/*
+ * profile_running
+ *   DESCRIPTION: Tells whether samples are being taken
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if they are, 0 if not
+ *   SIDE EFFECTS: none
+ */
+uint8_t profile_running() {
+    return profile_enabled;
+}
+
+/*
+ * profile_walk
+ *   DESCRIPTION: Follows the saved frame pointers of interrupted kernel code. Every frame has to sit
+ *                higher on the same stack in the kernel's 4MB page and return into it, so a function
+ *                that doesn't set up EBP only ends the walk early.
+ *   INPUTS: ebp -- frame pointer of the interrupted function
+ *           callers -- where to put the return addresses
+ *   OUTPUTS: callers, innermost first
+ *   RETURN VALUE: number of return addresses found, at most PROFILE_MAX_DEPTH
+ *   SIDE EFFECTS: none
+ */
+static uint8_t profile_walk(uint32_t ebp, uint32_t* callers) {
+    uint8_t depth = 0;
+    uint32_t* frame;
+    while (depth < PROFILE_MAX_DEPTH) {
+        if (ebp < KERNEL_MEM || ebp > KERNEL_MEM + PAGE_SIZE_4MB - 2 * sizeof(uint32_t)) break;
+        if (ebp & (sizeof(uint32_t) - 1)) break;
+        frame = (uint32_t*) ebp;
+        // frame[0] is the caller's EBP, frame[1] the return address
+        if (frame[1] < KERNEL_MEM || frame[1] >= KERNEL_MEM + PAGE_SIZE_4MB) break;
+        callers[depth++] = frame[1];
+        if (frame[0] <= ebp) break;
+        ebp = frame[0];
+    }
+    return depth;
+}
+
+/*
+ * profile_tick
+ *   DESCRIPTION: Called by the timer handler on every tick of every processor. Once the processor's
+ *                interval is up, records where the tick interrupted it.
+ *   INPUTS: context -- registers of the interrupted code
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: overwrites the oldest sample once the ring is full
+ */
+void profile_tick(hw_context_t* context) {
+    profile_sample_t* sample;
+    uint32_t cpu = this_cpu()->id;
+
+    if (!profile_enabled) return;
+    if (--profile_countdown[cpu] != 0) return;
+    profile_countdown[cpu] = profile_interval;
+
+    if (profile_ring.count == PROFILE_RING_SIZE) {
+        profile_ring.head = (profile_ring.head + 1) % PROFILE_RING_SIZE;
+        profile_ring.count--;
+        profile_ring.dropped++;
+    }
+    sample = &profile_ring.samples[(profile_ring.head + profile_ring.count) % PROFILE_RING_SIZE];
+    profile_ring.count++;
+
+    sample->eip = context->eip;
+    sample->cpl = context->cs & 0x3;
+    sample->cpu = cpu;
+    sample->pid = this_cpu()->pid;
+    // User stacks belong to programs the kernel image can't symbolize
+    sample->depth = sample->cpl == 0 ? profile_walk(context->ebp, sample->callers) : 0;
+}
+
+/*
+ * profile_read
+ *   DESCRIPTION: Takes the oldest samples out of the ring
+ *   INPUTS: buf -- where to copy them
+ *           max -- room in buf, in samples
+ *   OUTPUTS: the samples, oldest first
+ *   RETURN VALUE: number of samples copied
+ *   SIDE EFFECTS: none
+ */
+uint32_t profile_read(profile_sample_t* buf, uint32_t max) {
+    uint32_t n = 0;
+    while (n < max && profile_ring.count != 0) {
+        buf[n++] = profile_ring.samples[profile_ring.head];
+        profile_ring.head = (profile_ring.head + 1) % PROFILE_RING_SIZE;
+        profile_ring.count--;
+    }
+    return n;
+}
+
+/*
+ * profile_format
+ *   DESCRIPTION: Writes a sample as a line of text for symbolize_profile.py:
+ *                "<eip> <cpl> <pid> <cpu> <caller>...", addresses in hex
+ *   INPUTS: sample -- the sample
+ *           buf -- where to write the line
+ *           size -- capacity of buf, PROFILE_LINE_SIZE always fits
+ *   OUTPUTS: the line, not NULL terminated
+ *   RETURN VALUE: length of the line
+ *   SIDE EFFECTS: none
+ */
+uint32_t profile_format(profile_sample_t* sample, int8_t* buf, uint32_t size) {
+    int8_t digits[11];
+    uint32_t i, len = 0;
+    int8_t* s;
+
+    for (i = 0; i < 4 + sample->depth; i++) {
+        switch (i) {
+            case 0: s = itoa(sample->eip, digits, 16); break;
+            case 1: s = itoa(sample->cpl, digits, 10); break;
+            case 2: s = sample->pid < 0 ? (int8_t*) "-1" : itoa(sample->pid, digits, 10); break;
+            case 3: s = itoa(sample->cpu, digits, 10); break;
+            default: s = itoa(sample->callers[i - 4], digits, 16); break;
+        }
+        if (i != 0 && len < size) buf[len++] = ' ';
+        while (*s != '\0' && len < size) {
+            buf[len++] = *s++;
+        }
+    }
+    if (len < size) buf[len++] = '\n';
+    return len;
+}
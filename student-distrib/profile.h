@@ -0,0 +1,55 @@
+/* profile.h - Sampling profiler driven by the timer interrupt
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _PROFILE_H
+#define _PROFILE_H
+
+#include "types.h"
+#include "interrupt_handlers/context.h"
+
+// Commands of the profile syscall
+#define PROFILE_START 0         // arg: samples per second on each processor, clears the ring
+#define PROFILE_STOP 1
+#define PROFILE_READ 2          // arg: room in buf, in samples. Takes the oldest samples out of the ring
+
+// Samples the ring holds, the oldest are overwritten once it's full
+#define PROFILE_RING_SIZE 1024
+// Kernel callers recorded per sample, innermost first
+#define PROFILE_MAX_DEPTH 8
+
+// Marks the start of the ring in a memory dump (bytes "PROF")
+#define PROFILE_MAGIC 0x464F5250
+
+// Room for one line of the text format
+#define PROFILE_LINE_SIZE 128
+
+typedef struct profile_sample {
+    uint32_t eip;                               // where the processor was interrupted
+    uint8_t cpl;                                // privilege level it ran at, 0 kernel or 3 user
+    uint8_t cpu;
+    int8_t pid;                                 // task it ran, -1 while idle
+    uint8_t depth;                              // callers recorded (kernel samples only)
+    uint32_t callers[PROFILE_MAX_DEPTH];        // return addresses from walking the frame pointers
+} profile_sample_t;
+
+// Layout symbolize_profile.py expects in a memory dump of profile_ring
+typedef struct profile_ring {
+    uint32_t magic;
+    uint32_t head;                              // oldest sample
+    uint32_t count;
+    uint32_t dropped;                           // samples overwritten before they were read
+    profile_sample_t samples[PROFILE_RING_SIZE];
+} profile_ring_t;
+
+extern profile_ring_t profile_ring;
+
+void profile_init();
+int32_t profile_start(uint32_t hz);
+void profile_stop();
+uint8_t profile_running();
+void profile_tick(hw_context_t* context);
+uint32_t profile_read(profile_sample_t* buf, uint32_t max);
+uint32_t profile_format(profile_sample_t* sample, int8_t* buf, uint32_t size);
+
+#endif /* _PROFILE_H */
@@ -0,0 +1,247 @@
+#include "shm.h"
+#include "lib.h"
+#include "paging.h"
+#include "task.h"
+#include "lock.h"
+
+shm_segment_t shm_segments[MAX_SHM_COUNT];
+
+// Protects shm_segments, nothing here runs in interrupt handlers
+static mutex_t shm_lock;
+
+// Segments currently marked present in each processor's shm_page_table
+static uint32_t shm_loaded_mask[MAX_CPUS];
+
+/* 
+ * shm_init
+ *   DESCRIPTION: Marks every shared memory segment slot as unused
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void shm_init() {
+    int32_t i;
+    for (i = 0; i < MAX_SHM_COUNT; i++) {
+        shm_segments[i].num_pages = 0;
+    }
+    for (i = 0; i < MAX_CPUS; i++) {
+        shm_loaded_mask[i] = 0;
+    }
+    mutex_init(&shm_lock, (int8_t*) "shm");
+}
+
+/* 
+ * shm_find
+ *   DESCRIPTION: Looks up a segment by name
+ *   INPUTS: name -- name of the segment
+ *   OUTPUTS: none
+ *   RETURN VALUE: index of the segment, -1 if there is none with that name
+ *   SIDE EFFECTS: none
+ */
+static int32_t shm_find(const uint8_t* name) {
+    int32_t i;
+    for (i = 0; i < MAX_SHM_COUNT; i++) {
+        if (shm_segments[i].num_pages != 0 &&
+            strncmp((int8_t*) shm_segments[i].name, (int8_t*) name, SHM_NAME_LEN) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* 
+ * shm_attach
+ *   DESCRIPTION: Maps a segment into the current task
+ *   INPUTS: idx -- index of the segment
+ *           addr -- user pointer receiving the virtual address of the segment
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success
+ *   SIDE EFFECTS: updates the task's paging
+ */
+static int32_t shm_attach(int32_t idx, uint8_t** addr) {
+    curr_pcb = get_pcb(curr_pid);
+    curr_pcb->shm_mask |= 1 << idx;
+    shm_map_task(curr_pid);
+    flush_tlb();
+
+    // Every task sees a segment at the same address, so pointers into it can be shared
+    *addr = (uint8_t*) (SHM_VIRTUAL_ADDR + idx * SHM_MAX_SIZE);
+    return 0;
+}
+
+/* 
+ * shm_segment_create
+ *   DESCRIPTION: Creates a named shared memory segment of zeroed pages and maps it into the current task
+ *   INPUTS: name -- name of the new segment
+ *           size -- size of the segment in bytes, rounded up to whole pages
+ *           addr -- user pointer receiving the virtual address of the segment
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on failure (bad arguments, name taken, out of slots or frames)
+ *   SIDE EFFECTS: allocates frames
+ */
+int32_t shm_segment_create(const uint8_t* name, int32_t size, uint8_t** addr) {
+    if (size <= 0 || size > SHM_MAX_SIZE) return -1;
+    if (get_pcb(curr_pid) == NULL) return -1;
+
+    uint32_t cpu;
+    int32_t i, j;
+    shm_segment_t* seg;
+    mutex_lock(&shm_lock);
+    if (shm_find(name) != -1) {
+        mutex_unlock(&shm_lock);
+        return -1;
+    }
+    for (i = 0; i < MAX_SHM_COUNT; i++) {
+        if (shm_segments[i].num_pages == 0) break;
+    }
+    if (i == MAX_SHM_COUNT) {
+        mutex_unlock(&shm_lock);
+        return -1;
+    }
+
+    seg = &shm_segments[i];
+    seg->num_pages = (size + PAGE_SIZE_4KB - 1) / PAGE_SIZE_4KB;
+    for (j = 0; j < seg->num_pages; j++) {
+        // The allocation reference belongs to the creating task
+        if ((seg->frames[j] = frame_alloc()) == 0) {
+            while (--j >= 0) {
+                frame_put(seg->frames[j]);
+            }
+            seg->num_pages = 0;
+            mutex_unlock(&shm_lock);
+            return -1;
+        }
+        // Any processor may run a task that maps the segment
+        for (cpu = 0; cpu < MAX_CPUS; cpu++) {
+            cpu_shm_page_table[cpu][i * SHM_MAX_PAGES + j].page_addr = seg->frames[j] / PAGE_SIZE_4KB;
+        }
+    }
+    strncpy((int8_t*) seg->name, (int8_t*) name, SHM_NAME_LEN);
+
+    shm_attach(i, addr);
+    mutex_unlock(&shm_lock);
+    return 0;
+}
+
+/* 
+ * shm_segment_map
+ *   DESCRIPTION: Maps an existing named shared memory segment into the current task
+ *   INPUTS: name -- name of the segment
+ *           addr -- user pointer receiving the virtual address of the segment
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on failure (bad arguments, no such segment)
+ *   SIDE EFFECTS: references the segment's frames
+ */
+int32_t shm_segment_map(const uint8_t* name, uint8_t** addr) {
+    curr_pcb = get_pcb(curr_pid);
+    if (curr_pcb == NULL) return -1;
+
+    int32_t i, j;
+    mutex_lock(&shm_lock);
+    if ((i = shm_find(name)) == -1) {
+        mutex_unlock(&shm_lock);
+        return -1;
+    }
+    if (!(curr_pcb->shm_mask & (1 << i))) {
+        for (j = 0; j < shm_segments[i].num_pages; j++) {
+            frame_get(shm_segments[i].frames[j]);
+        }
+    }
+    shm_attach(i, addr);
+    mutex_unlock(&shm_lock);
+    return 0;
+}
+
+/* 
+ * shm_detach
+ *   DESCRIPTION: Drops a task's references to a segment, freeing it after the last user
+ *   INPUTS: pcb -- task using the segment
+ *           idx -- index of the segment
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may free frames
+ */
+static void shm_detach(pcb_t* pcb, int32_t idx) {
+    shm_segment_t* seg = &shm_segments[idx];
+    int32_t j;
+    pcb->shm_mask &= ~(1 << idx);
+    for (j = 0; j < seg->num_pages; j++) {
+        frame_put(seg->frames[j]);
+    }
+    // All the frames of a segment share the same users
+    if (frame_refcount(seg->frames[0]) == 0) {
+        seg->num_pages = 0;
+    }
+}
+
+/* 
+ * shm_segment_unmap
+ *   DESCRIPTION: Unmaps a named shared memory segment from the current task
+ *   INPUTS: name -- name of the segment
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on failure (bad name, segment not mapped)
+ *   SIDE EFFECTS: updates the task's paging, frees the segment after its last user
+ */
+int32_t shm_segment_unmap(const uint8_t* name) {
+    curr_pcb = get_pcb(curr_pid);
+    if (curr_pcb == NULL) return -1;
+
+    int32_t i;
+    mutex_lock(&shm_lock);
+    if ((i = shm_find(name)) == -1 || !(curr_pcb->shm_mask & (1 << i))) {
+        mutex_unlock(&shm_lock);
+        return -1;
+    }
+    shm_detach(curr_pcb, i);
+    shm_map_task(curr_pid);
+    flush_tlb();
+    mutex_unlock(&shm_lock);
+    return 0;
+}
+
+/* 
+ * shm_release_task
+ *   DESCRIPTION: Unmaps every segment of a halting task
+ *   INPUTS: pid -- the halting task
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: frees segments whose last user was the task
+ */
+void shm_release_task(int32_t pid) {
+    pcb_t* pcb = get_pcb(pid);
+    int32_t i;
+    if (pcb == NULL) return;
+    mutex_lock(&shm_lock);
+    for (i = 0; i < MAX_SHM_COUNT; i++) {
+        if (pcb->shm_mask & (1 << i)) {
+            shm_detach(pcb, i);
+        }
+    }
+    mutex_unlock(&shm_lock);
+}
+
+/* 
+ * shm_map_task
+ *   DESCRIPTION: Makes the calling processor's shared memory page table show exactly the segments of a
+ *                task. The frames of a segment always sit at the same table entries, so only segments whose
+ *                presence differs from the task previously mapped there are touched. Caller flushes the TLB.
+ *   INPUTS: pid -- the task being mapped
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: modifies shm_page_table
+ */
+void shm_map_task(int32_t pid) {
+    pcb_t* pcb = get_pcb(pid);
+    uint32_t mask = pcb == NULL ? 0 : pcb->shm_mask;
+    uint32_t changed = mask ^ shm_loaded_mask[this_cpu()->id];
+    int32_t i, j;
+    for (i = 0; i < MAX_SHM_COUNT; i++) {
+        if (changed & (1 << i)) {
+            for (j = 0; j < SHM_MAX_PAGES; j++) {
+                shm_page_table[i * SHM_MAX_PAGES + j].present = (mask & (1 << i)) && j < shm_segments[i].num_pages;
+            }
+        }
+    }
+    shm_loaded_mask[this_cpu()->id] = mask;
+}
@@ -0,0 +1,25 @@
+#ifndef _SHM_H
+#define _SHM_H
+
+#include "types.h"
+#include "address.h"
+
+#define MAX_SHM_COUNT 16
+#define SHM_NAME_LEN 32
+#define SHM_MAX_PAGES 16
+#define SHM_MAX_SIZE (SHM_MAX_PAGES * PAGE_SIZE_4KB)
+
+typedef struct shm_segment {
+    uint8_t name[SHM_NAME_LEN];         // name used to find the segment, NULL terminated
+    uint32_t num_pages;                 // size of the segment in 4KB pages, 0 if the slot is unused
+    uint32_t frames[SHM_MAX_PAGES];     // physical addresses of the backing frames
+} shm_segment_t;
+
+void shm_init();
+int32_t shm_segment_create(const uint8_t* name, int32_t size, uint8_t** addr);
+int32_t shm_segment_map(const uint8_t* name, uint8_t** addr);
+int32_t shm_segment_unmap(const uint8_t* name);
+void shm_release_task(int32_t pid);
+void shm_map_task(int32_t pid);
+
+#endif
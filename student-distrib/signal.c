@@ -0,0 +1,270 @@
+#include "signal.h"
+#include "address.h"
+#include "lib.h"
+#include "task.h"
+#include "x86_desc.h"
+#include "timer.h"
+#include "devices/terminal.h"
+#include "interrupt_handlers/syscalls_def.h"
+
+#define USER_PL 3
+#define EFLAGS_IOPL 0x3000
+#define EFLAGS_NT 0x4000
+#define EFLAGS_VM 0x20000
+// Arithmetic flags & the direction flag, the only ones a handler may change: CF PF AF ZF SF DF OF
+#define EFLAGS_USER_MASK 0x0CD5
+
+// movl $10, %eax (sigreturn); int $0x80; nop -- copied onto the user stack as the handler's return address
+static const uint8_t sigreturn_trampoline[] = { 0xB8, 0x0A, 0x00, 0x00, 0x00, 0xCD, 0x80, 0x90 };
+
+static timer_t alarm_timer;
+
+/* 
+ * signal_alarm
+ *   DESCRIPTION: Periodic timer callback sending ALARM to the foreground program of every terminal
+ *   INPUTS: timer -- the alarm timer
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void signal_alarm(timer_t* timer) {
+    int32_t t;
+    for (t = 0; t < num_terminals; t++) {
+        if (terminals[t].foreground_pid != -1) {
+            signal_send(terminals[t].foreground_pid, SIG_ALARM);
+        }
+    }
+}
+
+/* 
+ * signal_init
+ *   DESCRIPTION: Starts the periodic ALARM signal
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: arms a timer
+ */
+void signal_init() {
+    timer_setup(&alarm_timer, signal_alarm, NULL);
+    timer_add(&alarm_timer, SIGNAL_ALARM_PERIOD * TIMER_TICK_HZ, SIGNAL_ALARM_PERIOD * TIMER_TICK_HZ);
+}
+
+/* 
+ * signal_default_kills
+ *   DESCRIPTION: Whether a signal without a handler kills the program (otherwise it is ignored)
+ *   INPUTS: signum -- signal number
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if the default action is to kill, 0 if it is to ignore
+ *   SIDE EFFECTS: none
+ */
+static int32_t signal_default_kills(int32_t signum) {
+    return signum == SIG_DIV_ZERO || signum == SIG_SEGFAULT || signum == SIG_INTERRUPT;
+}
+
+/* 
+ * signal_user_range_ok
+ *   DESCRIPTION: Checks that a range of user memory is inside the program page
+ *   INPUTS: start -- user virtual address
+ *           size -- number of bytes
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if the kernel can safely access the range, 0 if not
+ *   SIDE EFFECTS: none
+ */
+static int32_t signal_user_range_ok(uint32_t start, uint32_t size) {
+    if (start < PROGRAM_IMAGE_VIRTUAL_BASE_ADDR) return 0;
+    if (start + size < start) return 0;
+    if (start + size > PROGRAM_IMAGE_VIRTUAL_BASE_ADDR + PAGE_SIZE_4MB) return 0;
+    return 1;
+}
+
+/* 
+ * signal_init_task
+ *   DESCRIPTION: Resets the handlers, pending and masked signals of a new task
+ *   INPUTS: pid -- the task
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void signal_init_task(int32_t pid) {
+    pcb_t* pcb = get_pcb(pid);
+    int32_t i;
+    if (pcb == NULL) return;
+    for (i = 0; i < NUM_SIGNALS; i++) {
+        pcb->signal_handlers[i] = NULL;
+    }
+    pcb->signal_pending = 0;
+    pcb->signal_masked = 0;
+}
+
+/* 
+ * signal_set_handler
+ *   DESCRIPTION: Sets the user handler of a signal for the current task
+ *   INPUTS: signum -- signal number
+ *           handler -- user function taking the signal number, NULL for the default action
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on failure
+ *   SIDE EFFECTS: none
+ */
+int32_t signal_set_handler(int32_t signum, void* handler) {
+    pcb_t* pcb = get_pcb(curr_pid);
+    if (pcb == NULL) return -1;
+    if (signum < 0 || signum >= NUM_SIGNALS) return -1;
+    if (handler != NULL && !signal_user_range_ok((uint32_t) handler, 1)) return -1;
+
+    pcb->signal_handlers[signum] = handler;
+    return 0;
+}
+
+/* 
+ * signal_send
+ *   DESCRIPTION: Marks a signal pending for a task, it is delivered the next time the task returns to
+ *                user mode. A blocked task is woken if the signal will kill it.
+ *   INPUTS: pid -- the task
+ *           signum -- signal number
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may wake the task
+ */
+void signal_send(int32_t pid, int32_t signum) {
+    pcb_t* pcb = get_pcb(pid);
+    uint32_t flags;
+    if (pcb == NULL || !pcb->active) return;
+    if (signum < 0 || signum >= NUM_SIGNALS) return;
+
+    cli_and_save(flags);
+    pcb->signal_pending |= 1 << signum;
+    if (pcb->state == TASK_BLOCKED && pcb->signal_handlers[signum] == NULL && signal_default_kills(signum)) {
+        pcb->state = TASK_RUNNABLE;
+        task_enqueue(pid);
+    }
+    restore_flags(flags);
+}
+
+/* 
+ * signal_raise_fault
+ *   DESCRIPTION: Raises a signal for an exception caused by the current task in user mode
+ *   INPUTS: signum -- SIG_DIV_ZERO or SIG_SEGFAULT
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if the task handles the signal, 0 if it has to be killed
+ *   SIDE EFFECTS: none
+ */
+int32_t signal_raise_fault(int32_t signum) {
+    pcb_t* pcb = get_pcb(curr_pid);
+    if (pcb == NULL) return 0;
+    // Faulting again inside a handler can't be handled, the instruction would fault forever
+    if (pcb->signal_handlers[signum] == NULL || (pcb->signal_masked & (1 << signum))) return 0;
+
+    pcb->signal_pending |= 1 << signum;
+    return 1;
+}
+
+/* 
+ * signal_fatal_pending
+ *   DESCRIPTION: Whether the current task has a pending signal that will kill it. Blocking syscalls
+ *                give up early in that case so the task can die.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if a fatal signal is pending, 0 if not
+ *   SIDE EFFECTS: none
+ */
+int32_t signal_fatal_pending() {
+    pcb_t* pcb = get_pcb(curr_pid);
+    int32_t signum;
+    if (pcb == NULL) return 0;
+    for (signum = 0; signum < NUM_SIGNALS; signum++) {
+        if ((pcb->signal_pending & (1 << signum)) && pcb->signal_handlers[signum] == NULL &&
+            signal_default_kills(signum)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* 
+ * signal_deliver
+ *   DESCRIPTION: Called on every return from an interrupt, exception or syscall. When going back to
+ *                user mode with an unmasked pending signal, runs its default action or sets up the
+ *                user stack so the program enters the handler, which returns into a sigreturn
+ *                trampoline. The handler sees the signal number and then the saved hw_context_t.
+ *   INPUTS: context -- registers that are restored by the iret
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may halt the task, modifies the user stack and context
+ */
+void signal_deliver(hw_context_t* context) {
+    pcb_t* pcb;
+    uint32_t deliverable, user_esp, trampoline_addr;
+    int32_t signum;
+
+    if ((context->cs & USER_PL) != USER_PL) return;
+    pcb = get_pcb(curr_pid);
+    if (pcb == NULL) return;
+
+    while ((deliverable = pcb->signal_pending & ~pcb->signal_masked) != 0) {
+        for (signum = 0; !(deliverable & (1 << signum)); signum++);
+        pcb->signal_pending &= ~(1 << signum);
+
+        if (pcb->signal_handlers[signum] == NULL) {
+            if (signal_default_kills(signum)) {
+                _halt(SIGNAL_KILL_STATUS);
+            }
+            continue;
+        }
+
+        // Stack, top down: trampoline code, saved context, signal number, return address
+        user_esp = context->esp - sizeof(sigreturn_trampoline);
+        trampoline_addr = user_esp;
+        user_esp -= sizeof(hw_context_t) + 2 * sizeof(uint32_t);
+        if (!signal_user_range_ok(user_esp, context->esp - user_esp)) {
+            _halt(SIGNAL_KILL_STATUS);
+        }
+        memcpy((void*) trampoline_addr, sigreturn_trampoline, sizeof(sigreturn_trampoline));
+        memcpy((void*) (user_esp + 2 * sizeof(uint32_t)), context, sizeof(hw_context_t));
+        ((uint32_t*) user_esp)[1] = signum;
+        ((uint32_t*) user_esp)[0] = trampoline_addr;
+
+        // No signals while the handler runs, sigreturn unmasks them
+        pcb->signal_masked = SIGNAL_ALL;
+        context->esp = user_esp;
+        context->eip = (uint32_t) pcb->signal_handlers[signum];
+        return;
+    }
+}
+
+/* 
+ * signal_return
+ *   DESCRIPTION: Implements sigreturn. Restores the context saved by signal_deliver into the context
+ *                of the sigreturn syscall, so the program resumes where the signal interrupted it.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: the restored EAX, so the syscall return leaves it unchanged. -1 if there is no frame
+ *   SIDE EFFECTS: unmasks signals
+ */
+int32_t signal_return() {
+    pcb_t* pcb = get_pcb(curr_pid);
+    hw_context_t* context;
+    uint32_t frame, eflags;
+    if (pcb == NULL) return -1;
+
+    // A syscall from user mode saved its context at the top of the task's kernel stack
+    context = (hw_context_t*) (KERNEL_STACK_ADDR - USER_KERNEL_STACK_SIZE * curr_pid - 0x4 - sizeof(hw_context_t));
+
+    // The handler's ret popped the trampoline address, the signal number is on top of the stack
+    frame = context->esp + sizeof(uint32_t);
+    if (!signal_user_range_ok(frame, sizeof(hw_context_t))) return -1;
+    // The flags sigreturn was called with, the saved frame only supplies the ones user code owns
+    eflags = context->eflags;
+    memcpy(context, (void*) frame, sizeof(hw_context_t));
+
+    // The handler can modify the saved context, never let it return to kernel privilege
+    context->cs = USER_CS;
+    context->ss = USER_DS;
+    context->ds = USER_DS;
+    context->es = USER_DS;
+    context->fs = USER_DS;
+    eflags = (eflags & ~EFLAGS_USER_MASK) | (context->eflags & EFLAGS_USER_MASK);
+    context->eflags = (eflags & ~(EFLAGS_IOPL | EFLAGS_NT | EFLAGS_VM)) | EFLAGS_IF;
+
+    pcb->signal_masked = 0;
+    return context->eax;
+}
@@ -0,0 +1,32 @@
+#ifndef _SIGNAL_H
+#define _SIGNAL_H
+
+#include "types.h"
+#include "interrupt_handlers/context.h"
+
+// Signal numbers, same as enum signums in ece391syscall.h
+#define SIG_DIV_ZERO 0
+#define SIG_SEGFAULT 1
+#define SIG_INTERRUPT 2
+#define SIG_ALARM 3
+#define SIG_USER1 4
+#define NUM_SIGNALS 5
+
+#define SIGNAL_ALL ((1 << NUM_SIGNALS) - 1)
+
+// Halt status of a program killed by a signal, like an exception
+#define SIGNAL_KILL_STATUS 256
+
+// Seconds between ALARM signals
+#define SIGNAL_ALARM_PERIOD 10
+
+void signal_init();
+void signal_init_task(int32_t pid);
+int32_t signal_set_handler(int32_t signum, void* handler);
+void signal_send(int32_t pid, int32_t signum);
+int32_t signal_raise_fault(int32_t signum);
+int32_t signal_fatal_pending();
+void signal_deliver(hw_context_t* context);
+int32_t signal_return();
+
+#endif
@@ -0,0 +1,316 @@
+#include "smp.h"
+#include "lib.h"
+#include "apic.h"
+#include "paging.h"
+#include "task.h"
+#include "x86_desc.h"
+#include "devices/pit.h"
+#include "devices/terminal.h"
+#include "devices/tsc.h"
+
+cpu_t cpus[MAX_CPUS];
+uint32_t num_cpus = 1;
+
+/*
+ * The kernel lock. Kernel code was written for one processor and relies on cli/sti to keep
+ * interrupt handlers out, so only one processor runs kernel code at a time. Every kernel entry
+ * takes the lock and the matching return to user mode drops it; user code runs in parallel.
+ */
+static spinlock_t kernel_lock = SPINLOCK_INIT;
+
+// Handed to the application processor being started by the trampoline
+uint32_t ap_boot_cr3;
+uint32_t ap_boot_stack;
+cpu_t* ap_boot_cpu;
+
+static uint8_t ap_stacks[MAX_CPUS][AP_STACK_SIZE] __attribute__((aligned(16)));
+
+// Lock names are kept by pointer, room for "run_queue" and the cpu id
+static int8_t run_queue_names[MAX_CPUS][16];
+
+extern uint8_t ap_trampoline_start[];
+extern uint8_t ap_trampoline_end[];
+extern uint8_t ap_trampoline_gdt_desc[];
+
+/*
+ * cpu_load_percpu
+ *   DESCRIPTION: Points the processor's per-CPU GDT entry at its cpu_t and loads it into GS
+ *   INPUTS: cpu -- the processor's cpu_t
+ *           desc -- the per-CPU entry in the processor's GDT
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: this_cpu works once this returns
+ */
+static void cpu_load_percpu(cpu_t* cpu, seg_desc_t* desc) {
+    seg_desc_t the_percpu_desc;
+    the_percpu_desc.granularity   = 0x0;
+    the_percpu_desc.opsize        = 0x1;
+    the_percpu_desc.reserved      = 0x0;
+    the_percpu_desc.avail         = 0x0;
+    the_percpu_desc.present       = 0x1;
+    the_percpu_desc.dpl           = 0x0;
+    the_percpu_desc.sys           = 0x1;
+    the_percpu_desc.type          = 0x2;     // read/write data
+
+    // A data segment has the same base & limit layout as the LDT
+    SET_LDT_PARAMS(the_percpu_desc, cpu, sizeof(cpu_t) - 1);
+    *desc = the_percpu_desc;
+
+    cpu->self = cpu;
+    asm volatile ("movw %w0, %%gs" : : "r"(KERNEL_PERCPU) : "memory");
+}
+
+/*
+ * cpu_setup
+ *   DESCRIPTION: Fills in the fields every processor starts with
+ *   INPUTS: cpu -- the processor's cpu_t
+ *           id -- its index in cpus
+ *           apic_id -- its local APIC ID
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void cpu_setup(cpu_t* cpu, uint32_t id, uint32_t apic_id) {
+    cpu->self = cpu;
+    cpu->id = id;
+    cpu->apic_id = apic_id;
+    cpu->online = 0;
+    cpu->pid = -1;
+    cpu->pcb = NULL;
+    cpu->terminal_id = 0;
+    cpu->lock_depth = 0;
+    cpu->map_generation = 0;
+    cpu->task_switches = 0;
+    cpu->irq_nesting = 0;
+    cpu->need_resched = 0;
+    // Named after the processor, so lock_stats_print tells the queues apart
+    strcpy(run_queue_names[id], (int8_t*) "run_queue");
+    itoa(id, run_queue_names[id] + strlen(run_queue_names[id]), 10);
+    spin_lock_init(&cpu->run_queue.lock, run_queue_names[id]);
+    cpu->run_queue.head = 0;
+    cpu->run_queue.count = 0;
+}
+
+/*
+ * cpu_init_bsp
+ *   DESCRIPTION: Sets up the boot processor's cpu_t. Must run before anything uses curr_pid, curr_pcb
+ *                or the paging structures.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: loads GS, takes the kernel lock, starts the interrupts-off profiler
+ */
+void cpu_init_bsp() {
+    spin_lock_init(&kernel_lock, (int8_t*) "kernel");
+    cpu_setup(&cpus[0], 0, 0);
+    cpus[0].online = 1;
+    cpus[0].tss = &tss;
+    cpu_load_percpu(&cpus[0], &percpu_desc_ptr);
+
+    // Booting counts as being in the kernel, kernel.c drops the lock before enabling interrupts
+    kernel_enter();
+    irqoff_ready = 1;
+}
+
+/*
+ * udelay
+ *   DESCRIPTION: Busy waits on the TSC
+ *   INPUTS: us -- microseconds to wait
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void udelay(uint32_t us) {
+    uint64_t start = now_cycles();
+    uint64_t wait = (uint64_t) (tsc_khz / 1000) * us;
+    while (now_cycles() - start < wait);
+}
+
+/*
+ * smp_start_ap
+ *   DESCRIPTION: Starts an application processor with INIT-SIPI-SIPI and waits for it to come online
+ *   INPUTS: cpu -- the processor's cpu_t, set up by cpu_setup
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 if it came online, -1 otherwise
+ *   SIDE EFFECTS: the processor idles, taking timer interrupts
+ */
+static int32_t smp_start_ap(cpu_t* cpu) {
+    uint8_t* trampoline = (uint8_t*) map_phys_window(AP_TRAMPOLINE_ADDR);
+    uint8_t* gdt_desc = trampoline + (ap_trampoline_gdt_desc - ap_trampoline_start);
+    uint32_t waited;
+
+    // Own GDT, TSS and paging structures
+    memcpy(cpu->gdt, gdt, sizeof(cpu->gdt));
+    memset(&cpu->ap_tss, 0, sizeof(tss_t));
+    cpu->ap_tss.ldt_segment_selector = KERNEL_LDT;
+    cpu->ap_tss.ss0 = KERNEL_DS;
+    cpu->tss = &cpu->ap_tss;
+    SET_TSS_PARAMS(cpu->gdt[KERNEL_TSS >> 3], &cpu->ap_tss, tss_size);
+    // The copy is marked busy since the boot processor loaded its TSS, ltr wants it available
+    cpu->gdt[KERNEL_TSS >> 3].type = 0x9;
+    paging_init_cpu(cpu->id);
+
+    // What the trampoline needs: the GDT to enter protected mode with, paging & a stack
+    *((uint16_t*) gdt_desc) = sizeof(cpu->gdt) - 1;
+    *((uint32_t*) (gdt_desc + sizeof(uint16_t))) = (uint32_t) cpu->gdt;
+    ap_boot_cr3 = (uint32_t) cpu_page_directory[cpu->id];
+    ap_boot_stack = (uint32_t) (ap_stacks[cpu->id] + AP_STACK_SIZE);
+    ap_boot_cpu = cpu;
+
+    apic_send_ipi(cpu->apic_id, LAPIC_ICR_INIT | LAPIC_ICR_ASSERT);
+    udelay(AP_INIT_DELAY_US);
+    apic_send_ipi(cpu->apic_id, LAPIC_ICR_STARTUP | (AP_TRAMPOLINE_ADDR >> 12));
+    udelay(AP_SIPI_DELAY_US);
+    if (!cpu->online) {
+        apic_send_ipi(cpu->apic_id, LAPIC_ICR_STARTUP | (AP_TRAMPOLINE_ADDR >> 12));
+    }
+
+    for (waited = 0; !cpu->online && waited < AP_STARTUP_TIMEOUT_US; waited += AP_SIPI_DELAY_US) {
+        udelay(AP_SIPI_DELAY_US);
+    }
+    return cpu->online ? 0 : -1;
+}
+
+/*
+ * smp_init
+ *   DESCRIPTION: Starts the other processors the MADT lists, one at a time. Needs the APIC and a
+ *                calibrated TSC, without them the kernel stays on the boot processor. Must be called
+ *                with interrupts disabled, before pit_init measures the local APIC timer.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: writes the trampoline to AP_TRAMPOLINE_ADDR
+ */
+void smp_init() {
+    uint32_t i;
+    cpu_t* cpu;
+
+    cpus[0].apic_id = apic_id();
+    if (!apic_enabled || tsc_khz == 0) return;
+
+    memcpy(map_phys_window(AP_TRAMPOLINE_ADDR), ap_trampoline_start, ap_trampoline_end - ap_trampoline_start);
+    for (i = 0; i < apic_num_cpus && num_cpus < MAX_CPUS; i++) {
+        if (apic_cpu_ids[i] == cpus[0].apic_id) continue;
+        cpu = &cpus[num_cpus];
+        cpu_setup(cpu, num_cpus, apic_cpu_ids[i]);
+        if (smp_start_ap(cpu) == 0) {
+            num_cpus++;
+        } else {
+            printf("CPU with APIC ID %d didn't start\n", apic_cpu_ids[i]);
+        }
+    }
+    printf("%d CPUs online\n", num_cpus);
+}
+
+/*
+ * ap_main
+ *   DESCRIPTION: C entry point of an application processor, called by the trampoline with paging on.
+ *                Idles until its timer interrupts find a task to run. Without a local APIC timer the
+ *                processor has nothing to schedule with and stays parked.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: never returns
+ */
+void ap_main() {
+    cpu_t* cpu = ap_boot_cpu;
+    cpu_load_percpu(cpu, &cpu->gdt[KERNEL_PERCPU >> 3]);
+    ltr(KERNEL_TSS);
+    lldt(KERNEL_LDT);
+
+    apic_local_init();
+    paging_init_pat();
+    cpu->online = 1;
+
+    // The boot processor measures the timer in pit_init, right after starting every processor
+    while (!apic_timer_enabled) {
+        asm volatile ("pause");
+    }
+    apic_timer_start();
+
+    sti();
+    while (1) {
+        asm volatile ("hlt");
+    }
+}
+
+/*
+ * cpu_idle
+ *   DESCRIPTION: Waits for an interrupt with the kernel lock dropped, so the other processors can
+ *                enter the kernel meanwhile. Must be called with interrupts disabled.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: the interrupt handler may switch tasks before this returns
+ */
+void cpu_idle() {
+    uint32_t depth = this_cpu()->lock_depth;
+    if (depth > 0) {
+        this_cpu()->lock_depth = 0;
+        spin_unlock(&kernel_lock);
+    }
+    sti();
+    asm volatile ("hlt");
+    cli();
+    // The task may have been switched out and picked up by another processor meanwhile
+    if (depth > 0) {
+        spin_lock(&kernel_lock);
+        this_cpu()->lock_depth = depth;
+        // Mappings may have changed while the lock was dropped, like in kernel_enter
+        if (this_cpu()->map_generation != mapping_generation && curr_pcb != NULL) {
+            map_program(curr_pid, curr_pcb->is_vidmapped, curr_pcb->terminal_id);
+        }
+    }
+}
+
+/*
+ * kernel_enter
+ *   DESCRIPTION: Takes the kernel lock on entry from an interrupt, exception or syscall. Nested entries
+ *                on the same processor only count. A processor coming back into the kernel also picks
+ *                up mapping changes made elsewhere while its task ran.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may spin until another processor leaves the kernel
+ */
+void kernel_enter() {
+    uint32_t flags;
+    cli_and_save(flags);
+    if (this_cpu()->lock_depth++ == 0) {
+        spin_lock(&kernel_lock);
+        if (this_cpu()->map_generation != mapping_generation && curr_pcb != NULL) {
+            map_program(curr_pid, curr_pcb->is_vidmapped, curr_pcb->terminal_id);
+        }
+    }
+    restore_flags(flags);
+}
+
+/*
+ * kernel_exit
+ *   DESCRIPTION: Undoes kernel_enter on the way back out. Must be called with interrupts disabled.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: releases the kernel lock when leaving the outermost entry
+ */
+void kernel_exit() {
+    if (this_cpu()->lock_depth > 0 && --this_cpu()->lock_depth == 0) {
+        spin_unlock(&kernel_lock);
+    }
+}
+
+/*
+ * kernel_unlock_all
+ *   DESCRIPTION: Drops the kernel lock completely before jumping straight into user mode (execute and
+ *                the first run of a spawned task). Must be called with interrupts disabled.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void kernel_unlock_all() {
+    if (this_cpu()->lock_depth > 0) {
+        this_cpu()->lock_depth = 0;
+        spin_unlock(&kernel_lock);
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef _SMP_H
+#define _SMP_H
+
+#define MAX_CPUS 4
+
+// Real mode code the application processors start in, must be 4KB aligned and below 1MB
+#define AP_TRAMPOLINE_ADDR 0x8000
+// Stack each application processor idles on while it has no task
+#define AP_STACK_SIZE 0x1000
+
+// INIT-SIPI-SIPI timing from the Intel MultiProcessor Specification (B.4)
+#define AP_INIT_DELAY_US 10000
+#define AP_SIPI_DELAY_US 200
+#define AP_STARTUP_TIMEOUT_US 100000
+
+// Room for every task in a run queue (MAX_PID_COUNT)
+#define RUN_QUEUE_SIZE 16
+
+#ifndef ASM
+
+#include "types.h"
+#include "x86_desc.h"
+#include "lock.h"
+
+struct pcb;
+
+typedef struct run_queue {
+    spinlock_t lock;
+    int32_t pids[RUN_QUEUE_SIZE];   // runnable tasks that aren't running anywhere, oldest first
+    uint32_t head;
+    uint32_t count;
+} run_queue_t;
+
+typedef struct cpu {
+    struct cpu* self;               // this_cpu reads this through GS, must stay first
+    uint32_t id;                    // index in cpus
+    uint32_t apic_id;               // local APIC ID, for IPIs
+    volatile uint32_t online;       // set by the processor once it takes interrupts
+    int32_t pid;                    // task running here (curr_pid), -1 while idle
+    struct pcb* pcb;                // its PCB (curr_pcb)
+    uint8_t terminal_id;            // terminal of the task running here (curr_executing_terminal_id)
+    uint32_t lock_depth;            // nesting of the kernel lock on this processor
+    uint32_t map_generation;        // mapping_generation when the task's memory was last mapped here
+    uint32_t task_switches;         // times the processor changed tasks
+    uint32_t irq_nesting;           // device interrupt handlers running on the processor
+    uint8_t need_resched;           // a nested handler wants a task switch once the outermost one is done
+    tss_t* tss;                     // task state segment, holds the kernel stack for entries from user mode
+    run_queue_t run_queue;
+    seg_desc_t gdt[GDT_ENTRIES] __attribute__((aligned(8)));   // application processors only
+    tss_t ap_tss;                                               // application processors only
+} cpu_t;
+
+extern cpu_t cpus[MAX_CPUS];
+extern uint32_t num_cpus;
+
+/*
+ * this_cpu
+ *   DESCRIPTION: Gets the processor the caller runs on. A task can move to another processor whenever
+ *                it switches away, so the result shouldn't be kept across task_switch or cpu_idle.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: the processor's cpu_t
+ *   SIDE EFFECTS: none
+ */
+static inline cpu_t* this_cpu() {
+    cpu_t* cpu;
+    asm volatile ("movl %%gs:0, %0" : "=r"(cpu));
+    return cpu;
+}
+
+void cpu_init_bsp();
+void smp_init();
+void ap_main();
+void cpu_idle();
+
+void kernel_enter();
+void kernel_exit();
+void kernel_unlock_all();
+
+#endif /* ASM */
+
+#endif
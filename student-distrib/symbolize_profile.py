@@ -0,0 +1,145 @@
+#!/usr/bin/env python3
+"""Symbolize samples of the kernel's sampling profiler against bootimg.
+
+Samples come in one of two forms:
+  - the text "cat profile" prints, one sample per line:
+        <eip> <cpl> <pid> <cpu> <caller>...      (addresses in hex)
+  - a raw dump of the ring, taken from gdb while the kernel is stopped:
+        (gdb) dump binary value profile.bin profile_ring
+
+Prints a flat profile (samples in each function, and in it or its callees),
+and writes folded stacks for flamegraph.pl / speedscope with --folded.
+
+    ./symbolize_profile.py samples.txt
+    ./symbolize_profile.py --folded out.folded profile.bin
+    flamegraph.pl out.folded > kernel.svg
+"""
+
+import argparse
+import bisect
+import collections
+import re
+import struct
+import subprocess
+import sys
+
+# Must match profile.h
+PROFILE_MAGIC = 0x464F5250
+PROFILE_RING_SIZE = 1024
+PROFILE_MAX_DEPTH = 8
+RING_HEADER = struct.Struct("<4I")
+SAMPLE = struct.Struct("<IBBbB%dI" % PROFILE_MAX_DEPTH)
+
+LINE = re.compile(r"^\s*([0-9a-fA-F]+) ([03]) (-?\d+) (\d+)((?: [0-9a-fA-F]+)*)\s*$")
+
+Sample = collections.namedtuple("Sample", "eip cpl pid cpu callers")
+
+
+def load_symbols(image):
+    """Sorted (address, name) pairs of the functions in the kernel image."""
+    out = subprocess.run(["nm", "-n", "--defined-only", image],
+                         check=True, stdout=subprocess.PIPE, universal_newlines=True).stdout
+    addrs, names = [], []
+    for line in out.splitlines():
+        fields = line.split()
+        if len(fields) != 3 or fields[1] not in "tT":
+            continue
+        addrs.append(int(fields[0], 16))
+        names.append(fields[2])
+    return addrs, names
+
+
+def symbolize(symbols, addr):
+    addrs, names = symbols
+    i = bisect.bisect_right(addrs, addr) - 1
+    if i < 0:
+        return "0x%x" % addr
+    return names[i]
+
+
+def read_dump(data):
+    magic, head, count, dropped = RING_HEADER.unpack_from(data, 0)
+    if magic != PROFILE_MAGIC:
+        sys.exit("not a dump of profile_ring (bad magic 0x%x)" % magic)
+    if dropped:
+        print("%d samples were overwritten before the dump" % dropped, file=sys.stderr)
+    samples = []
+    for i in range(count):
+        offset = RING_HEADER.size + ((head + i) % PROFILE_RING_SIZE) * SAMPLE.size
+        fields = SAMPLE.unpack_from(data, offset)
+        eip, cpl, cpu, pid, depth = fields[:5]
+        samples.append(Sample(eip, cpl, pid, cpu, list(fields[5:5 + depth])))
+    return samples
+
+
+def read_text(text):
+    samples = []
+    for line in text.splitlines():
+        m = LINE.match(line)
+        if not m:
+            continue
+        callers = [int(c, 16) for c in m.group(5).split()]
+        samples.append(Sample(int(m.group(1), 16), int(m.group(2)), int(m.group(3)),
+                              int(m.group(4)), callers))
+    return samples
+
+
+def read_samples(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if len(data) >= 4 and struct.unpack_from("<I", data)[0] == PROFILE_MAGIC:
+        return read_dump(data)
+    return read_text(data.decode("ascii", "replace"))
+
+
+def stack_of(symbols, sample):
+    """Function names of a sample, outermost first."""
+    if sample.cpl != 0:
+        # User programs aren't part of bootimg
+        return ["[user pid %d]" % sample.pid]
+    # Return addresses point past the call, which may be the first byte of the next function
+    frames = [symbolize(symbols, addr - 1) for addr in reversed(sample.callers)]
+    frames.append(symbolize(symbols, sample.eip))
+    return frames
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("samples", help="text from 'cat profile' or a gdb dump of profile_ring")
+    parser.add_argument("--image", default="bootimg", help="kernel image to symbolize against")
+    parser.add_argument("--folded", metavar="FILE", help="write folded stacks for flame graphs")
+    parser.add_argument("--top", type=int, default=30, help="functions to list in the flat profile")
+    args = parser.parse_args()
+
+    samples = read_samples(args.samples)
+    if not samples:
+        sys.exit("no samples in %s" % args.samples)
+    symbols = load_symbols(args.image)
+
+    self_count = collections.Counter()
+    total_count = collections.Counter()
+    folded = collections.Counter()
+    for sample in samples:
+        stack = stack_of(symbols, sample)
+        self_count[stack[-1]] += 1
+        # Recursion counts a function once per sample
+        for name in set(stack):
+            total_count[name] += 1
+        folded[";".join(stack)] += 1
+
+    n = len(samples)
+    user = sum(1 for s in samples if s.cpl != 0)
+    print("%d samples, %d in the kernel, %d in user mode" % (n, n - user, user))
+    print("%7s %7s %7s %7s  %s" % ("self", "self%", "total", "total%", "function"))
+    for name, count in self_count.most_common(args.top):
+        print("%7d %6.1f%% %7d %6.1f%%  %s" % (count, 100.0 * count / n, total_count[name],
+                                              100.0 * total_count[name] / n, name))
+
+    if args.folded:
+        with open(args.folded, "w") as f:
+            for stack, count in sorted(folded.items()):
+                f.write("%s %d\n" % (stack, count))
+
+
+if __name__ == "__main__":
+    main()
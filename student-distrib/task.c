@@ -1,8 +1,11 @@
 #include "task.h"
 #include "address.h"
-
-int32_t curr_pid = -1;
-pcb_t* curr_pcb = NULL;
+#include "lib.h"
+#include "paging.h"
+#include "x86_desc.h"
+#include "devices/terminal.h"
+#include "smp.h"
+#include "trace.h"
 
 /* 
  * task_init
@@ -20,6 +23,19 @@ void task_init() {
         pcb->active = 0;
         pcb->terminal_id = -1;
         pcb->is_vidmapped = 0;
+        pcb->vid_back = 0;
+        pcb->vid_front = 0;
+        pcb->state = TASK_RUNNABLE;
+        pcb->wait_channel = NULL;
+        pcb->is_spawned = 0;
+        pcb->is_started = 0;
+        pcb->shm_mask = 0;
+        pcb->on_cpu = 0;
+        pcb->queued = 0;
+        pcb->cpu = -1;
+        pcb->lock_depth = 0;
+        pcb->irq_nesting = 0;
+        signal_init_task(i);
     }
 }
 
@@ -49,8 +65,362 @@ int32_t get_new_pid() {
     for (i = 0; i < MAX_PID_COUNT; i++) {
         if (get_pcb(i)->active == 0) {
             get_pcb(i)->active = 1;
+            get_pcb(i)->state = TASK_RUNNABLE;
+            get_pcb(i)->wait_channel = NULL;
+            get_pcb(i)->is_spawned = 0;
+            get_pcb(i)->is_started = 0;
+            get_pcb(i)->shm_mask = 0;
+            get_pcb(i)->on_cpu = 0;
+            get_pcb(i)->queued = 0;
+            get_pcb(i)->cpu = -1;
+            get_pcb(i)->lock_depth = 0;
+            get_pcb(i)->irq_nesting = 0;
+            signal_init_task(i);
             return i;
         }
     }
     return -1;
 }
+
+/* 
+ * task_pid_available
+ *   DESCRIPTION: Tells whether get_new_pid would find a pid
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if some PCB is inactive, 0 if not
+ *   SIDE EFFECTS: none */
+uint8_t task_pid_available() {
+    int32_t i;
+    for (i = 0; i < MAX_PID_COUNT; i++) {
+        if (get_pcb(i)->active == 0) return 1;
+    }
+    return 0;
+}
+
+/* 
+ * task_create_kthread
+ *   DESCRIPTION: Creates a kernel thread, a task that never enters user mode. It starts out queued and
+ *                runs entry on its kernel stack the first time it is switched to, holding the kernel lock
+ *                like every task inside the kernel. It belongs to terminal 0 until it says otherwise.
+ *   INPUTS: entry -- function the thread runs, must never return
+ *   OUTPUTS: none
+ *   RETURN VALUE: pid of the thread, -1 if no pid is left
+ *   SIDE EFFECTS: takes a pid */
+int32_t task_create_kthread(void (*entry)()) {
+    int32_t pid = get_new_pid();
+    pcb_t* pcb;
+    uint32_t* stack;
+    int32_t i;
+    if (pid == -1) return -1;
+
+    pcb = get_pcb(pid);
+    pcb->pid = pid;
+    pcb->parent_pid = -1;
+    pcb->terminal_id = 0;
+    pcb->is_vidmapped = 0;
+    pcb->vid_back = 0;
+    pcb->vid_front = 0;
+    for (i = 0; i < MAX_FILE_COUNT; i++) {
+        pcb->fd_array[i].flags = 0;
+    }
+    // Already in the kernel, task_switch resumes it like a task that saved its context
+    pcb->is_started = 1;
+    pcb->lock_depth = 1;
+
+    // task_switch's leave & ret pop a frame pointer & return into entry, which sees a null return address
+    stack = (uint32_t*) (KERNEL_STACK_ADDR - USER_KERNEL_STACK_SIZE * pid - 0x4);
+    *--stack = 0;
+    *--stack = (uint32_t) entry;
+    *--stack = 0;
+    pcb->esp = (uint32_t) stack;
+    pcb->ebp = (uint32_t) stack;
+
+    task_enqueue(pid);
+    return pid;
+}
+
+/* 
+ * task_enqueue
+ *   DESCRIPTION: Puts a runnable task in the run queue of the processor it ran on last, so it keeps
+ *                its caches warm. Tasks already queued or running somewhere are left alone.
+ *   INPUTS: pid -- the task
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none */
+void task_enqueue(int32_t pid) {
+    pcb_t* pcb = get_pcb(pid);
+    run_queue_t* rq;
+    uint32_t flags;
+    if (pcb == NULL || !pcb->active || pcb->state != TASK_RUNNABLE) return;
+
+    rq = (pcb->cpu >= 0 && pcb->cpu < num_cpus) ? &cpus[pcb->cpu].run_queue : &this_cpu()->run_queue;
+    spin_lock_irqsave(&rq->lock, flags);
+    if (!pcb->queued && !pcb->on_cpu) {
+        rq->pids[(rq->head + rq->count) % RUN_QUEUE_SIZE] = pid;
+        rq->count++;
+        pcb->queued = 1;
+    }
+    spin_unlock_irqrestore(&rq->lock, flags);
+}
+
+/* 
+ * task_enqueue_first
+ *   DESCRIPTION: Puts a runnable task at the head of the calling processor's run queue, so it runs
+ *                next there. For tasks that someone is waiting on, like the keyboard thread.
+ *   INPUTS: pid -- the task
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none */
+void task_enqueue_first(int32_t pid) {
+    pcb_t* pcb = get_pcb(pid);
+    run_queue_t* rq = &this_cpu()->run_queue;
+    uint32_t flags;
+    if (pcb == NULL || !pcb->active || pcb->state != TASK_RUNNABLE) return;
+
+    spin_lock_irqsave(&rq->lock, flags);
+    if (!pcb->queued && !pcb->on_cpu) {
+        rq->head = (rq->head + RUN_QUEUE_SIZE - 1) % RUN_QUEUE_SIZE;
+        rq->pids[rq->head] = pid;
+        rq->count++;
+        pcb->queued = 1;
+    }
+    spin_unlock_irqrestore(&rq->lock, flags);
+}
+
+/* 
+ * run_queue_pop
+ *   DESCRIPTION: Takes the oldest task that can still run out of a run queue. Entries of tasks that
+ *                stopped being runnable since they were queued are dropped on the way.
+ *   INPUTS: rq -- the run queue
+ *   OUTPUTS: none
+ *   RETURN VALUE: pid of the task, -1 if the queue has none
+ *   SIDE EFFECTS: none */
+static int32_t run_queue_pop(run_queue_t* rq) {
+    int32_t pid = -1;
+    pcb_t* pcb;
+    spin_lock(&rq->lock);
+    while (rq->count > 0 && pid == -1) {
+        pid = rq->pids[rq->head];
+        rq->head = (rq->head + 1) % RUN_QUEUE_SIZE;
+        rq->count--;
+        pcb = get_pcb(pid);
+        pcb->queued = 0;
+        if (!pcb->active || pcb->state != TASK_RUNNABLE || pcb->on_cpu) {
+            pid = -1;
+        }
+    }
+    spin_unlock(&rq->lock);
+    return pid;
+}
+
+/* 
+ * task_next_runnable
+ *   DESCRIPTION: Pick the next task to run, from the calling processor's run queue first. An empty
+ *                queue steals from the longest queue of the other processors.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: pid of the next runnable task, -1 if none is waiting
+ *   SIDE EFFECTS: removes the task from its run queue */
+int32_t task_next_runnable() {
+    cpu_t* cpu = this_cpu();
+    int32_t pid, i, victim;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    pid = run_queue_pop(&cpu->run_queue);
+    while (pid == -1) {
+        // Counts are read without the locks, run_queue_pop sorts out queues that emptied meanwhile
+        victim = -1;
+        for (i = 0; i < num_cpus; i++) {
+            if (i != cpu->id && cpus[i].run_queue.count > 0 &&
+                (victim == -1 || cpus[i].run_queue.count > cpus[victim].run_queue.count)) {
+                victim = i;
+            }
+        }
+        if (victim == -1) break;
+        pid = run_queue_pop(&cpus[victim].run_queue);
+    }
+    restore_flags(flags);
+    return pid;
+}
+
+/* 
+ * task_switch
+ *   DESCRIPTION: Switch to the kernel context of the given task. Must be called with interrupts disabled
+ *                and the kernel lock held. The current task resumes by returning from the function that
+ *                saved its context, on whichever processor picks it next.
+ *   INPUTS: pid -- the task to switch to
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: saves the current stack pointers, requeues the current task if it can still run,
+ *                remaps paging & swaps the TSS kernel stack */
+void task_switch(int32_t pid) {
+    pcb_t* next = get_pcb(pid);
+    if (next == NULL || pid == curr_pid) return;
+
+    curr_pcb = get_pcb(curr_pid);
+    if (curr_pcb != NULL) {
+        // Save stack registers for current task
+        uint32_t saved_esp, saved_ebp;
+
+        asm volatile (
+            " movl %%esp, %0 \n\
+            movl %%ebp, %1"
+            : "=r"(saved_esp), "=r"(saved_ebp)
+            :
+            : "memory"
+        );
+        curr_pcb->esp = saved_esp;
+        curr_pcb->ebp = saved_ebp;
+        curr_pcb->lock_depth = this_cpu()->lock_depth;
+        curr_pcb->irq_nesting = this_cpu()->irq_nesting;
+        // Nobody else can pick the task before the kernel lock is released, which is after the switch
+        curr_pcb->on_cpu = 0;
+        task_enqueue(curr_pid);
+    }
+
+    // Set the new task & its terminal as the current
+    TRACE(TRACE_SWITCH, curr_pid, pid);
+    curr_pid = pid;
+    curr_pcb = next;
+    curr_executing_terminal_id = next->terminal_id;
+    next->on_cpu = 1;
+    next->cpu = this_cpu()->id;
+    this_cpu()->lock_depth = next->lock_depth;
+    this_cpu()->irq_nesting = next->irq_nesting;
+    this_cpu()->task_switches++;
+    this_cpu()->tss->ss0 = KERNEL_DS;
+    // 8MB (bottom of 4MB kernel page) - 8KB (size of kernel stack) - 4B (to get to top of stack)
+    this_cpu()->tss->esp0 = KERNEL_STACK_ADDR - USER_KERNEL_STACK_SIZE * pid - 0x4;
+    map_program(pid, next->is_vidmapped, next->terminal_id);
+
+    if (!next->is_started) {
+        // Spawned task that never ran, enter user mode the same way execute does
+        // esp/eip still hold the user stack & entry point set up by spawn
+        next->is_started = 1;
+        kernel_unlock_all();
+        asm volatile(" \
+            movw %%ax, %%ds      ;\
+            pushl %%eax          ;\
+            movl %%ebx, %%eax    ;\
+            pushl %%eax          ;\
+            pushfl               ;\
+            popl %%ebx           ;\
+            orl $0x200, %%ebx    ;\
+            pushl %%ebx          ;\
+            pushl %%ecx          ;\
+            pushl %%edx          ;\
+            iret               "
+            :
+            : "a"(USER_DS), "b"(next->esp) , "c"(USER_CS), "d"(next->eip)
+            : "memory"
+        );
+    }
+
+    // Restore stack pointers and return from whichever function saved them
+    asm volatile ("       \n \
+        movl %%ebx, %%esp \n \
+        movl %%ecx, %%ebp \n \
+        leave             \n \
+        ret               \n \
+        "
+        :
+        : "b" (next->esp), "c" (next->ebp)
+        : "ebp", "esp"
+    );
+}
+
+/* 
+ * task_schedule
+ *   DESCRIPTION: Preempt the current task (called from the timer handler of every processor). Terminals
+ *                waiting for a shell get one first, otherwise the next queued task is switched to. Idle
+ *                terminals cost nothing here, only the ones waiting are looked at.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may switch tasks */
+void task_schedule() {
+    int32_t next;
+    // Shells are started from the boot processor only
+    if (term_shell_pending != 0 && this_cpu()->id == 0) {
+        term_launch_shell(__builtin_ctz(term_shell_pending));
+        return;
+    }
+
+    next = task_next_runnable();
+    if (next != -1) {
+        task_switch(next);
+    }
+}
+
+/* 
+ * task_block
+ *   DESCRIPTION: Put the current task to sleep on a wait channel until task_wakeup is called on it.
+ *                Must be called with interrupts disabled; callers re-check their condition afterwards.
+ *                If nothing else can run, the processor idles until an interrupt wakes a task.
+ *   INPUTS: channel -- address identifying what the task waits for
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: switches to other tasks while blocked */
+void task_block(void* channel) {
+    pcb_t* pcb = get_pcb(curr_pid);
+    int32_t next;
+    if (pcb == NULL) {
+        // No task to put to sleep (kernel tests), just wait for the next interrupt
+        cpu_idle();
+        return;
+    }
+
+    pcb->wait_channel = channel;
+    pcb->state = TASK_BLOCKED;
+    while (pcb->state == TASK_BLOCKED) {
+        next = task_next_runnable();
+        if (next == -1) {
+            // Nothing to run, wait for an interrupt to make some task runnable
+            cpu_idle();
+        } else {
+            task_switch(next);
+        }
+    }
+    pcb->wait_channel = NULL;
+}
+
+/* 
+ * task_wakeup
+ *   DESCRIPTION: Make every task blocked on the given wait channel runnable again and queue it
+ *   INPUTS: channel -- address identifying what the tasks wait for
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: changes task states */
+void task_wakeup(void* channel) {
+    pcb_t* pcb;
+    int32_t i;
+    for (i = 0; i < MAX_PID_COUNT; i++) {
+        pcb = get_pcb(i);
+        if (pcb->active && pcb->state == TASK_BLOCKED && pcb->wait_channel == channel) {
+            pcb->state = TASK_RUNNABLE;
+            task_enqueue(i);
+        }
+    }
+}
+
+/* 
+ * task_wakeup_first
+ *   DESCRIPTION: Like task_wakeup, but the tasks go ahead of everything queued on the calling processor
+ *   INPUTS: channel -- address identifying what the tasks wait for
+ *   OUTPUTS: none
+ *   RETURN VALUE: number of tasks woken
+ *   SIDE EFFECTS: changes task states */
+int32_t task_wakeup_first(void* channel) {
+    pcb_t* pcb;
+    int32_t i, woken = 0;
+    for (i = 0; i < MAX_PID_COUNT; i++) {
+        pcb = get_pcb(i);
+        if (pcb->active && pcb->state == TASK_BLOCKED && pcb->wait_channel == channel) {
+            pcb->state = TASK_RUNNABLE;
+            task_enqueue_first(i);
+            woken++;
+        }
+    }
+    return woken;
+}
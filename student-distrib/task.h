@@ -3,11 +3,23 @@
 
 #include "types.h"
 #include "filesystem/filesys_interface.h"
+#include "signal.h"
+#include "smp.h"
 
 #define MAX_FILE_COUNT 8
-#define MAX_PID_COUNT 6
+#define MAX_PID_COUNT 16
 #define FILE_NAME_LEN 32
 
+// Scheduling states of a task
+#define TASK_RUNNABLE 0         // can be picked by the scheduler
+#define TASK_BLOCKED 1          // sleeping on a wait channel until task_wakeup
+#define TASK_WAITING_CHILD 2    // inside execute, resumed directly by the child's halt
+#define TASK_ZOMBIE 3           // spawned task that halted and hasn't been reaped by wait
+
+// How a task has its terminal's screen mapped
+#define VIDMAP_LIVE 1           // vidmap, the program writes the screen itself
+#define VIDMAP_BUFFERED 2       // vidmap_buffered, the program writes a back buffer that present copies out
+
 typedef struct pcb {
     int32_t pid;                                // pid
     int32_t parent_pid;                         // parent's pid (-1 if none)
@@ -18,14 +30,43 @@ typedef struct pcb {
     uint8_t file_arg[FILE_NAME_LEN];            // launch argument
     uint32_t active;                            // whether the task is active
     uint32_t terminal_id;                       // terminal the task is runnning on
-    uint8_t is_vidmapped;                       // whether vidmap was called
+    uint8_t is_vidmapped;                       // VIDMAP_* once vidmap or vidmap_buffered was called, 0 before
+    uint32_t vid_back;                          // frame the program draws in (VIDMAP_BUFFERED only)
+    uint32_t vid_front;                         // frame holding what present copied out last (VIDMAP_BUFFERED only)
+    uint32_t vid_writes;                        // screen_writes of the terminal the front frame matches
+    uint32_t state;                             // scheduling state (TASK_*)
+    void* wait_channel;                         // what the task is blocked on (TASK_BLOCKED only)
+    uint8_t is_spawned;                         // started by spawn, runs alongside its parent
+    uint8_t is_started;                         // whether the task has entered user mode yet
+    uint32_t exit_status;                       // status passed to halt (TASK_ZOMBIE only)
+    uint32_t shm_mask;                          // bit i set if shared memory segment i is mapped
+    void* signal_handlers[NUM_SIGNALS];         // user handler of each signal, NULL for the default action
+    uint32_t signal_pending;                    // bit i set if signal i waits to be delivered
+    uint32_t signal_masked;                     // bit i set if signal i can't be delivered right now
+    uint8_t on_cpu;                             // whether some processor is running the task (or idling on its stack)
+    uint8_t queued;                             // whether the task sits in a run queue
+    int32_t cpu;                                // processor that ran the task last, -1 if none yet
+    uint32_t lock_depth;                        // kernel lock nesting of the task while switched out
+    uint32_t irq_nesting;                       // device interrupt nesting of the task while switched out
 } pcb_t;
 
-extern int32_t curr_pid;
-extern pcb_t* curr_pcb;
+// The task running on the calling processor
+#define curr_pid (this_cpu()->pid)
+#define curr_pcb (this_cpu()->pcb)
 
 void task_init();
 pcb_t* get_pcb(uint32_t pid);
 int32_t get_new_pid();
+uint8_t task_pid_available();
+int32_t task_create_kthread(void (*entry)());
+
+void task_enqueue(int32_t pid);
+void task_enqueue_first(int32_t pid);
+int32_t task_next_runnable();
+void task_switch(int32_t pid);
+void task_schedule();
+void task_block(void* channel);
+void task_wakeup(void* channel);
+int32_t task_wakeup_first(void* channel);
 
 #endif
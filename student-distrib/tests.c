@@ -9,7 +9,25 @@
 #include "filesystem/filesys.h"
 #include "devices/rtc.h"
 #include "devices/keyboard.h"
+#include "devices/serial.h"
 #include "devices/terminal.h"
+#include "devices/pipe.h"
+#include "shm.h"
+#include "futex.h"
+#include "signal.h"
+#include "timer.h"
+#include "devices/tsc.h"
+#include "apic.h"
+#include "smp.h"
+#include "lock.h"
+#include "irqoff.h"
+#include "irq_stats.h"
+#include "devices/stats.h"
+#include "profile.h"
+#include "trace.h"
+#include "klog.h"
+#include "devices/kmsg.h"
+#include "devices/vga.h"
 
 #define PASS 1
 #define FAIL 0
@@ -288,7 +306,7 @@ int test_paging_can_access() {
     }
 
     /* Test end of video memory */
-    ptr = (int*)(VIDEO_MEM + PAGE_SIZE_4KB - PDE_SIZE);
+    ptr = (int*)(VIDEO_MEM + VGA_TEXT_MEM_SIZE - PDE_SIZE);
     *ptr = 0x12345678;
     if (*ptr != 0x12345678) {
         assertion_failure();
@@ -335,7 +353,7 @@ int test_paging_cant_access() {
     }
 
     /* Test can't access just after video memory */
-    ptr = (int*)(VIDEO_MEM + PAGE_SIZE_4KB);
+    ptr = (int*)(VIDEO_MEM + VGA_TEXT_MEM_SIZE);
     *ptr = 0x12345678;
     if (*ptr == 0x12345678) {
         printf("Failed to catch access to just after video memory");
@@ -395,7 +413,7 @@ int test_values_in_paging_structs() {
 
     /* Test all page table entries except video memory to not present */
     for (i = 0; i < TABLE_SIZE; i++) {
-        if (i * PAGE_SIZE_4KB == VIDEO_MEM) {
+        if (i >= VIDEO_MEM_INDEX && i < VGA_TEXT_END_INDEX) {
             if (page_table[i].present != 1) {
                 printf("Entry %d in page table is not present", i);
                 result = FAIL;
@@ -429,20 +447,21 @@ int test_changing_rtc_freq() {
     int result = PASS;
 
     const uint8_t* filename = (uint8_t*)"rtc";
-    rtc_open(NULL, filename);
+    fd_array_member_t f;
+    rtc_open(&f, filename);
 
     int freq;
     int num_bytes_written = 4;
     int i;
 
     for (freq = 2; freq <= MAX_RTC_FREQ; freq *= 2) {
-        if (rtc_write(NULL, &freq, num_bytes_written) == -1) {
+        if (rtc_write(&f, &freq, num_bytes_written) == -1) {
             printf("Failed to change RTC frequency to %d", freq);
             result = FAIL;
         }
 
         for (i = 0; i <= freq; i++) {
-            if (rtc_read(NULL, NULL, 0) == -1) {
+            if (rtc_read(&f, NULL, 0) == -1) {
                 printf("Failed to receive RTC interrupt at frequency %d", freq);
                 result = FAIL;
             }
@@ -453,14 +472,15 @@ int test_changing_rtc_freq() {
     }  
 
     // Test bad buffer pointer to write
-    if (rtc_write(NULL, NULL, num_bytes_written) != -1) {
+    if (rtc_write(&f, NULL, num_bytes_written) != -1) {
         printf("RTC write succeeded with bad buffer pointer");
         result = FAIL;
     }  
 
     // Set frequency back to 2
     freq = 2;
-    rtc_write(NULL, &freq, num_bytes_written);
+    rtc_write(&f, &freq, num_bytes_written);
+    rtc_close(&f);
 
     return result;
 }
@@ -477,7 +497,8 @@ int test_rtc_helper_funcs() {
     int result = PASS;
 
     const uint8_t* filename = (uint8_t*)"rtc";
-    rtc_open(NULL, filename);
+    fd_array_member_t f;
+    rtc_open(&f, filename);
 
     // Test frequency that's not a power of 2
     if (set_rtc_freq(3) != -1) {
@@ -503,6 +524,7 @@ int test_rtc_helper_funcs() {
         result = FAIL;
     }
 
+    rtc_close(&f);
     return result;
 }
 
@@ -1173,10 +1195,9 @@ int syscalls_vidmap_test() {
         return FAIL;
     }
 
-    video_mem = (char*) buffer;
-    printf("hello, world with virtual addr\n");
-
-    video_mem = (char*) VIDEO_MEM;
+    // The mapping shows the terminal's screen
+    ((uint16_t*) buffer)[NUM_COLS * (NUM_ROWS - 1)] = (ATTRIB << 8) | '!';
+    if (term_screen(curr_executing_terminal_id)[NUM_COLS * (NUM_ROWS - 1)] != ((ATTRIB << 8) | '!')) return FAIL;
     printf("hello, world with physical addr\n");
 
     return ret != -1;
@@ -1211,6 +1232,1095 @@ int syscalls_invalid_test() {
 
 /* Checkpoint 5 tests */
 
+/* Syscall Test - Pipe
+    * 
+    * Asserts that bytes written to a pipe come out of its read end in order, across the ring wrap,
+    * and that the read end reports end of file once the write end is closed
+    * Inputs: None
+    * Outputs: PASS/FAIL
+    * Side Effects: None
+    * Coverage: Syscall, pipes
+    * Files: syscall.c/h, pipe.c/h */
+int syscalls_pipe_test() {
+    TEST_HEADER;
+    int ret, i, round;
+    curr_pid = get_new_pid();
+    curr_pcb = get_pcb(curr_pid);
+    fs_interface_init(curr_pcb->fd_array);
+
+    int pipe_arg = 11;
+    int read_arg = 3;
+    int write_arg = 4;
+    int close_arg = 6;
+    int32_t fds[2];
+    uint8_t out[PIPE_BUFFER_SIZE / 2 + 100];
+    uint8_t in[PIPE_BUFFER_SIZE / 2 + 100];
+
+    SYSCALL(ret, pipe_arg, NULL, NULL, NULL);
+    if (ret != -1) return FAIL;
+    SYSCALL(ret, pipe_arg, fds, NULL, NULL);
+    if (ret == -1) return FAIL;
+
+    // Wrong directions are rejected
+    SYSCALL(ret, read_arg, fds[1], in, 1);
+    if (ret != -1) return FAIL;
+    SYSCALL(ret, write_arg, fds[0], out, 1);
+    if (ret != -1) return FAIL;
+
+    // Three rounds of a bit more than half the ring, so the data wraps around
+    for (round = 0; round < 3; round++) {
+        for (i = 0; i < sizeof(out); i++) {
+            out[i] = (uint8_t) (i + round);
+        }
+        SYSCALL(ret, write_arg, fds[1], out, sizeof(out));
+        if (ret != sizeof(out)) return FAIL;
+        SYSCALL(ret, read_arg, fds[0], in, sizeof(in));
+        if (ret != sizeof(in)) return FAIL;
+        for (i = 0; i < sizeof(in); i++) {
+            if (in[i] != out[i]) return FAIL;
+        }
+    }
+
+    SYSCALL(ret, close_arg, fds[1], NULL, NULL);
+    if (ret == -1) return FAIL;
+    SYSCALL(ret, read_arg, fds[0], in, sizeof(in));
+    if (ret != 0) return FAIL;
+    SYSCALL(ret, close_arg, fds[0], NULL, NULL);
+    if (ret == -1) return FAIL;
+
+    return PASS;
+}
+
+/* Shared Memory Test
+    * 
+    * Asserts that two tasks mapping the same segment see each other's writes at the same address,
+    * and that the segment's frames are freed after both unmap it
+    * Inputs: None
+    * Outputs: PASS/FAIL
+    * Side Effects: None
+    * Coverage: Shared memory, frame pool
+    * Files: shm.c/h, paging.c/h */
+int shm_share_test() {
+    TEST_HEADER;
+    uint8_t* addr_a;
+    uint8_t* addr_b;
+    uint32_t frame;
+    int32_t pid_a = get_new_pid();
+    int32_t pid_b = get_new_pid();
+    uint8_t name[] = "shm_test";
+
+    curr_pid = pid_a;
+    map_program(pid_a, 0, 0);
+    if (shm_segment_create(name, PAGE_SIZE_4KB + 1, &addr_a) == -1) return FAIL;
+    // Names are unique
+    if (shm_segment_create(name, PAGE_SIZE_4KB, &addr_b) != -1) return FAIL;
+    // Frames start zeroed, write to both pages
+    if (addr_a[0] != 0 || addr_a[PAGE_SIZE_4KB] != 0) return FAIL;
+    addr_a[0] = 0x39;
+    addr_a[PAGE_SIZE_4KB] = 0x91;
+
+    curr_pid = pid_b;
+    map_program(pid_b, 0, 0);
+    if (shm_segment_map(name, &addr_b) == -1) return FAIL;
+    if (addr_a != addr_b) return FAIL;
+    if (addr_b[0] != 0x39 || addr_b[PAGE_SIZE_4KB] != 0x91) return FAIL;
+    frame = shm_page_table[((uint32_t) addr_b - SHM_VIRTUAL_ADDR) / PAGE_SIZE_4KB].page_addr * PAGE_SIZE_4KB;
+    if (frame_refcount(frame) != 2) return FAIL;
+    if (shm_segment_unmap(name) == -1) return FAIL;
+    if (shm_segment_unmap(name) != -1) return FAIL;
+
+    // The creator halting drops the last reference
+    shm_release_task(pid_a);
+    if (frame_refcount(frame) != 0) return FAIL;
+    if (shm_segment_map(name, &addr_b) != -1) return FAIL;
+
+    get_pcb(pid_a)->active = 0;
+    get_pcb(pid_b)->active = 0;
+    return PASS;
+}
+
+/* Futex Test
+    * 
+    * Asserts that futex_wait refuses to sleep when the word changed and that bad addresses are rejected
+    * Inputs: None
+    * Outputs: PASS/FAIL
+    * Side Effects: None
+    * Coverage: Futex
+    * Files: futex.c/h */
+int futex_test() {
+    TEST_HEADER;
+    int32_t pid = get_new_pid();
+    int32_t* word = (int32_t*) (PROGRAM_IMAGE_VIRTUAL_BASE_ADDR + PAGE_SIZE_4MB - PAGE_SIZE_4KB);
+
+    curr_pid = pid;
+    map_program(pid, 0, 0);
+    *word = 1;
+
+    // Value changed since the caller looked, so it must not sleep
+    if (futex_wait(word, 0) != -1) return FAIL;
+    // Kernel memory & misaligned words are not user words
+    if (futex_wait((int32_t*) VIDEO_MEM, 0) != -1) return FAIL;
+    if (futex_wake((int32_t*) ((uint32_t) word + 1), 1) != -1) return FAIL;
+    // Nobody is waiting
+    if (futex_wake(word, 1) != 0) return FAIL;
+
+    get_pcb(pid)->active = 0;
+    return PASS;
+}
+
+/* Signal Test
+    * 
+    * Asserts that a pending signal with a handler redirects a user context into the handler, with the
+    * signal number & the interrupted context on the user stack, and that ignored signals are dropped
+    * Inputs: None
+    * Outputs: PASS/FAIL
+    * Side Effects: None
+    * Coverage: Signals
+    * Files: signal.c/h */
+int signal_deliver_test() {
+    TEST_HEADER;
+    int32_t pid = get_new_pid();
+    uint32_t* frame;
+    hw_context_t context;
+    uint32_t handler = PROGRAM_IMAGE_VIRTUAL_ADDR;
+
+    curr_pid = pid;
+    map_program(pid, 0, 0);
+    memset(&context, 0, sizeof(context));
+    context.cs = USER_CS;
+    context.eip = PROGRAM_IMAGE_VIRTUAL_ADDR + 0x100;
+    context.esp = PROGRAM_IMAGE_VIRTUAL_BASE_ADDR + PAGE_SIZE_4MB - 0x10;
+    context.eax = 0x391;
+
+    if (signal_set_handler(NUM_SIGNALS, (void*) handler) != -1) return FAIL;
+    if (signal_set_handler(SIG_USER1, (void*) VIDEO_MEM) != -1) return FAIL;
+    if (signal_set_handler(SIG_USER1, (void*) handler) != 0) return FAIL;
+
+    // ALARM has no handler and is ignored
+    signal_send(pid, SIG_ALARM);
+    signal_deliver(&context);
+    if (context.eip != PROGRAM_IMAGE_VIRTUAL_ADDR + 0x100) return FAIL;
+    if (get_pcb(pid)->signal_pending != 0) return FAIL;
+
+    signal_send(pid, SIG_USER1);
+    signal_deliver(&context);
+    if (context.eip != handler) return FAIL;
+    frame = (uint32_t*) context.esp;
+    if (frame[1] != SIG_USER1) return FAIL;
+    if (((hw_context_t*) &frame[2])->eax != 0x391) return FAIL;
+    if (get_pcb(pid)->signal_masked != SIGNAL_ALL) return FAIL;
+
+    get_pcb(pid)->active = 0;
+    return PASS;
+}
+
+/* Helpers for the timer wheel test */
+static uint32_t timer_test_fired_at[6];
+static uint32_t timer_test_fire_count[6];
+static void timer_test_callback(timer_t* timer) {
+    uint32_t i = (uint32_t) timer->data;
+    // timer_ticks was already advanced past the tick being processed
+    timer_test_fired_at[i] = timer_ticks - 1;
+    timer_test_fire_count[i]++;
+}
+
+/* Timer Wheel Test
+    * 
+    * Asserts that one-shot timers in every level of the wheel fire exactly on their tick, that periodic
+    * timers keep firing and that deleted timers don't fire
+    * Inputs: None
+    * Outputs: PASS/FAIL
+    * Side Effects: None
+    * Coverage: Timers
+    * Files: timer.c/h */
+int timer_wheel_test() {
+    TEST_HEADER;
+    uint32_t delays[] = { 1, 255, 256, 300, 20000, 100 };
+    timer_t timers[6];
+    uint32_t flags, start, i;
+
+    // Drive the wheel by hand, the PIT must not tick meanwhile
+    cli_and_save(flags);
+    start = timer_ticks;
+    for (i = 0; i < 6; i++) {
+        timer_test_fired_at[i] = 0;
+        timer_test_fire_count[i] = 0;
+        timer_setup(&timers[i], timer_test_callback, (void*) i);
+        timer_add(&timers[i], delays[i], 0);
+    }
+    // Last one is periodic, the one before is deleted
+    timer_add(&timers[5], 7, 7);
+    timer_del(&timers[4]);
+
+    for (i = 0; i < 21000; i++) {
+        timer_tick();
+    }
+    timer_del(&timers[5]);
+    restore_flags(flags);
+
+    for (i = 0; i < 4; i++) {
+        if (timer_test_fire_count[i] != 1) return FAIL;
+        if (timer_test_fired_at[i] != start + delays[i]) return FAIL;
+    }
+    if (timer_test_fire_count[4] != 0) return FAIL;
+    if (timer_test_fire_count[5] != 21000 / 7) return FAIL;
+    return PASS;
+}
+
+/* TSC Clock Test
+    * 
+    * Asserts that the calibrated TSC agrees with the PIT: 20 timer ticks (200 ms) must measure within 5%
+    * Inputs: None
+    * Outputs: PASS/FAIL
+    * Side Effects: None
+    * Coverage: TSC clocksource
+    * Files: tsc.c/h */
+int tsc_clock_test() {
+    TEST_HEADER;
+    uint64_t start_ns, elapsed_ns, start_cycles;
+    uint32_t start_tick;
+    uint32_t expected_ms = 20 * 1000 / TIMER_TICK_HZ;
+    uint32_t elapsed_ms;
+
+    if (tsc_khz == 0) return FAIL;
+    printf("TSC: %d kHz\n", tsc_khz);
+
+    // Line up with a tick edge first
+    start_tick = timer_ticks;
+    while (timer_ticks == start_tick);
+    start_tick = timer_ticks;
+    start_ns = now_ns();
+    start_cycles = now_cycles();
+    while (timer_ticks - start_tick < 20);
+    elapsed_ns = now_ns() - start_ns;
+    if (now_cycles() <= start_cycles) return FAIL;
+
+    div64_32(&elapsed_ns, NS_PER_MS);
+    elapsed_ms = (uint32_t) elapsed_ns;
+    printf("20 ticks took %d ms\n", elapsed_ms);
+    if (elapsed_ms < expected_ms * 95 / 100 || elapsed_ms > expected_ms * 105 / 100) return FAIL;
+    return PASS;
+}
+
+/* Virtual RTC Test
+    * 
+    * Asserts that two fds at 2 Hz and 16 Hz tick independently: 16 reads of the fast one take one 2 Hz period
+    * Inputs: None
+    * Outputs: PASS/FAIL
+    * Side Effects: None
+    * Coverage: per-fd virtual RTCs
+    * Files: rtc.c/h */
+int rtc_virtual_test() {
+    TEST_HEADER;
+    fd_array_member_t slow, fast;
+    int32_t freq, i;
+    uint32_t start_tick, elapsed;
+
+    if (rtc_open(&slow, (uint8_t*)"rtc") != 0) return FAIL;
+    if (rtc_open(&fast, (uint8_t*)"rtc") != 0) return FAIL;
+    if (slow.inode == fast.inode) return FAIL;
+    freq = 16;
+    if (rtc_write(&fast, &freq, 4) != 0) return FAIL;
+
+    rtc_read(&fast, NULL, 0);
+    start_tick = timer_ticks;
+    for (i = 0; i < 16; i++) {
+        rtc_read(&fast, NULL, 0);
+    }
+    elapsed = timer_ticks - start_tick;
+    // The 2 Hz fd must still tick on its own schedule
+    rtc_read(&slow, NULL, 0);
+    rtc_close(&fast);
+    rtc_close(&slow);
+
+    printf("16 reads at 16 Hz took %d ticks\n", elapsed);
+    if (elapsed < TIMER_TICK_HZ * 9 / 10 || elapsed > TIMER_TICK_HZ * 11 / 10) return FAIL;
+    return PASS;
+}
+
+/* APIC Routing Test
+    * 
+    * Asserts that the keyboard and RTC are routed through the IOAPIC to their usual vectors, that the PIT
+    * pin is masked while the local timer schedules, and that the scheduler tick still runs at 100 Hz
+    * Inputs: None
+    * Outputs: PASS/FAIL
+    * Side Effects: None
+    * Coverage: APIC backend
+    * Files: apic.c/h, i8259.c/h */
+int apic_routing_test() {
+    TEST_HEADER;
+    fd_array_member_t f;
+    uint32_t start_tick, elapsed_ms;
+    uint64_t start_ns, elapsed_ns;
+
+    if (!apic_enabled) {
+        printf("No APIC, nothing to check on the 8259\n");
+        return PASS;
+    }
+    if ((ioapic_redirection(KEYBOARD_IRQ_NUM) & 0xFF) != ICW2_MASTER + KEYBOARD_IRQ_NUM) return FAIL;
+    if (ioapic_redirection(KEYBOARD_IRQ_NUM) & IOAPIC_MASKED) return FAIL;
+    if (apic_timer_enabled && !(ioapic_redirection(PIT_IRQ_NUM) & IOAPIC_MASKED)) return FAIL;
+
+    // The RTC pin is only open while someone has the RTC open
+    if (!(ioapic_redirection(RTC_IRQ_NUM) & IOAPIC_MASKED)) return FAIL;
+    rtc_open(&f, (uint8_t*)"rtc");
+    if (ioapic_redirection(RTC_IRQ_NUM) & IOAPIC_MASKED) return FAIL;
+    rtc_read(&f, NULL, 0);
+    rtc_close(&f);
+    if (!(ioapic_redirection(RTC_IRQ_NUM) & IOAPIC_MASKED)) return FAIL;
+
+    start_tick = timer_ticks;
+    while (timer_ticks == start_tick);
+    start_tick = timer_ticks;
+    start_ns = now_ns();
+    while (timer_ticks - start_tick < 20);
+    elapsed_ns = now_ns() - start_ns;
+    div64_32(&elapsed_ns, NS_PER_MS);
+    elapsed_ms = (uint32_t) elapsed_ns;
+    printf("20 ticks took %d ms\n", elapsed_ms);
+    if (elapsed_ms < 190 || elapsed_ms > 210) return FAIL;
+    return PASS;
+}
+
+/* SMP Per-CPU Test
+    * 
+    * Asserts that GS points at the boot processor's cpu_t, that every processor that came online has
+    * its own APIC ID and paging structures sharing the kernel mappings, and that a spinlock excludes
+    * a second taker
+    * Inputs: None
+    * Outputs: PASS/FAIL
+    * Side Effects: None
+    * Coverage: SMP bring-up, spinlocks
+    * Files: smp.c/h, lock.c/h, paging.c/h */
+int smp_percpu_test() {
+    TEST_HEADER;
+    uint32_t i, j;
+    spinlock_t lock = SPINLOCK_INIT;
+
+    if (this_cpu()->self != this_cpu() || this_cpu() != &cpus[0]) return FAIL;
+    if (this_cpu()->lock_depth != 0) return FAIL;
+    if (num_cpus < 1 || num_cpus > MAX_CPUS) return FAIL;
+
+    printf("%d CPUs online\n", num_cpus);
+    for (i = 0; i < num_cpus; i++) {
+        if (!cpus[i].online || cpus[i].id != i) return FAIL;
+        if (cpu_page_directory[i][KERNEL_MEM >> 22].page_table_addr != cpu_page_directory[0][KERNEL_MEM >> 22].page_table_addr) return FAIL;
+        if (i > 0 && cpu_page_directory[i][0].page_table_addr == cpu_page_directory[0][0].page_table_addr) return FAIL;
+        for (j = 0; j < i; j++) {
+            if (cpus[i].apic_id == cpus[j].apic_id) return FAIL;
+        }
+    }
+
+    if (!spin_trylock(&lock)) return FAIL;
+    if (spin_trylock(&lock)) return FAIL;
+    spin_unlock(&lock);
+    if (!spin_trylock(&lock)) return FAIL;
+    spin_unlock(&lock);
+    return PASS;
+}
+
+/* Lock Stats Test
+    * 
+    * Asserts that spinlocks, mutexes and reader/writer locks exclude who they should, that readers share,
+    * and that acquires and hold times are counted and listed by name
+    * Inputs: None
+    * Outputs: PASS/FAIL
+    * Side Effects: None
+    * Coverage: Lock primitives & statistics
+    * Files: lock.c/h */
+int lock_stats_test() {
+    TEST_HEADER;
+    // Listed locks must outlive the test
+    static spinlock_t spin;
+    static mutex_t mutex;
+    static rwlock_t rwlock;
+    lock_stats_t* stats;
+    uint32_t i, flags, found = 0;
+    int result = PASS;
+
+    spin_lock_init(&spin, (int8_t*) "test_spin");
+    mutex_init(&mutex, (int8_t*) "test_mutex");
+    rwlock_init(&rwlock, (int8_t*) "test_rwlock");
+
+    // Failures fall through, the locks have to be let go of
+    spin_lock_irqsave(&spin, flags);
+    if (spin_trylock(&spin)) result = FAIL;
+    for (i = 0; i < 1000; i++);
+    spin_unlock_irqrestore(&spin, flags);
+    if (result == FAIL) return FAIL;
+    if (spin.stats.acquires != 1 || spin.stats.max_hold_cycles == 0) return FAIL;
+
+    mutex_lock(&mutex);
+    if (mutex_trylock(&mutex)) result = FAIL;
+    mutex_unlock(&mutex);
+    if (result == FAIL) return FAIL;
+    if (!mutex_trylock(&mutex)) return FAIL;
+    mutex_unlock(&mutex);
+    if (mutex.stats.acquires != 2 || mutex.stats.contended != 0) return FAIL;
+
+    read_lock(&rwlock);
+    read_lock(&rwlock);
+    if (rwlock.readers != 2) return FAIL;
+    read_unlock(&rwlock);
+    read_unlock(&rwlock);
+    write_lock(&rwlock);
+    if (!rwlock.writer || rwlock.readers != 0) return FAIL;
+    write_unlock(&rwlock);
+    if (rwlock.stats.acquires != 3) return FAIL;
+
+    for (i = 0; (stats = lock_stats_get(i)) != NULL; i++) {
+        if (stats == &spin.stats || stats == &mutex.stats || stats == &rwlock.stats) found++;
+    }
+    lock_stats_print();
+    return found == 3 ? PASS : FAIL;
+}
+
+/* Interrupts-Off Profiler Test
+    * 
+    * Asserts that a 2 ms span with interrupts disabled is recorded as the longest one, with the lines
+    * of the cli and sti that bound it
+    * Inputs: None
+    * Outputs: PASS/FAIL
+    * Side Effects: None
+    * Coverage: Interrupts-off profiler
+    * Files: irqoff.c/h, lib.h */
+int irqoff_test() {
+    TEST_HEADER;
+    uint32_t begin_line, end_line, us;
+    uint64_t start, ns;
+    irqoff_span_t* span;
+
+    if (tsc_khz == 0) return FAIL;
+    irqoff_reset();
+    begin_line = __LINE__; cli();
+    start = now_cycles();
+    while (now_cycles() - start < (uint64_t) tsc_khz * 2);
+    end_line = __LINE__; sti();
+
+    if ((span = irqoff_worst_get(0)) == NULL) return FAIL;
+    irqoff_print();
+    if (span->begin_line != begin_line || span->end_line != end_line) return FAIL;
+    if (strncmp(span->begin_file, (int8_t*) __FILE__, strlen((int8_t*) __FILE__) + 1) != 0) return FAIL;
+    ns = cycles_to_ns(span->max_cycles);
+    div64_32(&ns, 1000);
+    us = (uint32_t) ns;
+    return (us >= 2000 && us < 2500) ? PASS : FAIL;
+}
+
+/* IRQ Stats Test
+    * 
+    * Asserts that timer interrupts and syscalls are counted on their vectors, that every timer entry
+    * lands in the EOI histogram, and that the stats device reports the timer vector
+    * Inputs: None
+    * Outputs: PASS/FAIL
+    * Side Effects: None
+    * Coverage: Interrupt statistics, stats device
+    * Files: irq_stats.c/h, devices/stats.c/h, device_handlers.S, syscall.S */
+int irq_stats_test() {
+    TEST_HEADER;
+    uint32_t i, start_tick, eois = 0, irets = 0;
+    int32_t ret, len;
+    fd_array_member_t f;
+    int8_t buf[64];
+    irq_vector_stats_t* pit = irq_stats_get(IRQ_STATS_PIT_VECTOR);
+    irq_vector_stats_t* syscall = irq_stats_get(IRQ_STATS_SYSCALL_VECTOR);
+
+    irq_stats_reset();
+    start_tick = timer_ticks;
+    while (timer_ticks - start_tick < 10);
+    // Syscall 0 doesn't exist, the entry is still counted
+    asm volatile ("int $0x80" : "=a"(ret) : "a"(0) : "memory");
+    if (ret != -1 || syscall->count != 1) return FAIL;
+
+    for (i = 0; i < IRQ_HIST_BUCKETS; i++) {
+        eois += pit->eoi_hist[i];
+        irets += pit->iret_hist[i];
+    }
+    printf("%u timer entries, %u EOIs, %u returns\n", pit->count, eois, irets);
+    if (pit->count < 10 || eois < pit->count - 1) return FAIL;
+    if (irets + pit->switched + 1 < pit->count) return FAIL;
+
+    f.file_pos = 0;
+    if (stats_open(&f, (uint8_t*) STATS_DEVICE_NAME) != 0) return FAIL;
+    len = stats_read(&f, buf, sizeof(buf) - 1);
+    stats_close(&f);
+    if (len <= 0) return FAIL;
+    buf[len] = '\0';
+    return strncmp(buf, (int8_t*) "vector 0x20", strlen((int8_t*) "vector 0x20")) == 0 ? PASS : FAIL;
+}
+
+
+/* Helpers for the keyboard storm jitter test */
+#define JITTER_SAMPLES 50
+static uint64_t jitter_stamps[JITTER_SAMPLES];
+static volatile uint32_t jitter_count;
+static void jitter_test_callback(timer_t* timer) {
+    if (jitter_count < JITTER_SAMPLES) {
+        jitter_stamps[jitter_count++] = now_cycles();
+    }
+}
+
+/* Keyboard Storm Jitter Test
+    * 
+    * Asserts that the timer keeps ticking every 10 ms (within 1 ms) while the keyboard handler runs
+    * back to back, driven by software interrupts with typing queued up: echoed letters, new lines that
+    * scroll and backspaces that edit the line
+    * Inputs: None
+    * Outputs: PASS/FAIL
+    * Side Effects: None
+    * Coverage: Nested interrupts, keyboard scancode ring & thread
+    * Files: keyboard.c/h, irq.c/h, device_handlers.S */
+int keyboard_storm_jitter_test() {
+    TEST_HEADER;
+    static const uint8_t typing[] = {
+        0x1E, 0x9E,                         // a, echoed
+        0x1C, 0x9C,                         // enter, a new line that scrolls at the bottom
+        0x0E, 0x8E, 0x0E, 0x8E              // backspace twice, the line is back where it was
+    };
+    terminal_data_t* term = &terminals[curr_displaying_terminal_id];
+    term_mode_t original_mode = term->mode;
+    uint32_t original_size = term->keyboard_buffer_size;
+    timer_t timer;
+    uint64_t interval;
+    uint32_t i, flags, interval_us, worst_us = 0;
+    uint32_t expected_us = 1000000 / TIMER_TICK_HZ;
+
+    if (tsc_khz == 0) return FAIL;
+
+    term->mode.flags = TERM_MODE_DEFAULT;
+    jitter_count = 0;
+    timer_setup(&timer, jitter_test_callback, NULL);
+    timer_add(&timer, 1, 1);
+    while (jitter_count < JITTER_SAMPLES) {
+        // The interrupt handler is the ring's producer, it can't run while the test queues
+        cli_and_save(flags);
+        for (i = 0; i < sizeof(typing); i++) {
+            keyboard_queue_scancode(typing[i]);
+        }
+        restore_flags(flags);
+        asm volatile ("int $0x21" : : : "memory");
+    }
+    timer_del(&timer);
+    term->mode = original_mode;
+    term->keyboard_buffer_size = original_size;
+    term->is_done_typing = 0;
+
+    for (i = 1; i < JITTER_SAMPLES; i++) {
+        interval = cycles_to_ns(jitter_stamps[i] - jitter_stamps[i - 1]);
+        div64_32(&interval, 1000);
+        interval_us = (uint32_t) interval;
+        interval_us = interval_us > expected_us ? interval_us - expected_us : expected_us - interval_us;
+        if (interval_us > worst_us) worst_us = interval_us;
+    }
+    printf("worst timer jitter %u us\n", worst_us);
+    if (worst_us > 1000) return FAIL;
+    return PASS;
+}
+
+/* Profiler Test
+    * 
+    * Asserts that the profiler rejects rates the timer can't give, and that busy kernel code sampled
+    * for 20 ticks shows up in the ring as kernel samples with at least one caller
+    * Inputs: None
+    * Outputs: PASS/FAIL
+    * Side Effects: None
+    * Coverage: Sampling profiler, profile syscall
+    * Files: profile.c/h, pit.c, device_handlers.S */
+int profile_test() {
+    TEST_HEADER;
+    profile_sample_t samples[32];
+    uint32_t i, n, start_tick;
+
+    if (profile_start(0) != -1) return FAIL;
+    if (profile_start(TIMER_TICK_HZ + 1) != -1) return FAIL;
+    if (profile_start(TIMER_TICK_HZ) != 0) return FAIL;
+    start_tick = timer_ticks;
+    while (timer_ticks - start_tick < 20);
+    profile_stop();
+
+    n = profile_read(samples, 32);
+    printf("%u samples\n", n);
+    if (n < 10) return FAIL;
+    for (i = 0; i < n; i++) {
+        // Other processors may be running user programs meanwhile
+        if (samples[i].cpu != this_cpu()->id) continue;
+        if (samples[i].cpl != 0) return FAIL;
+        if (samples[i].eip < KERNEL_MEM || samples[i].eip >= KERNEL_MEM + PAGE_SIZE_4MB) return FAIL;
+        if (samples[i].depth == 0) return FAIL;
+    }
+    return PASS;
+}
+
+/* Trace Test
+    * 
+    * Asserts that turning tracing on records the TSC rate, that a syscall records its entry & exit with
+    * the syscall number and return value, and that nothing is recorded with tracing off
+    * Inputs: None
+    * Outputs: PASS/FAIL
+    * Side Effects: None
+    * Coverage: Tracepoints
+    * Files: trace.c/h, context.h, syscall.S */
+int trace_test() {
+    TEST_HEADER;
+    uint32_t flags, count, i;
+    int32_t ret;
+    trace_ring_t* ring;
+    trace_record_t* record;
+    uint32_t first, seen = 0;
+
+    // Keep the timer from sending the records out meanwhile
+    cli_and_save(flags);
+    ring = trace_ring_get(this_cpu()->id);
+    first = ring->count;
+    trace_set_mask(TRACE_MASK_ALL);
+    // Syscall 0 doesn't exist, it still goes through the tracepoints
+    asm volatile ("int $0x80" : "=a"(ret) : "a"(0) : "memory");
+    trace_set_mask(0);
+    count = ring->count;
+    TRACE(TRACE_SWITCH, 0, 0);
+
+    for (i = first; i < count; i++) {
+        record = &ring->records[(ring->head + i) % TRACE_RING_SIZE];
+        if (record->magic != TRACE_RECORD_MAGIC) break;
+        if (record->type == TRACE_CLOCK && record->arg0 == tsc_khz) seen |= TRACE_BIT(TRACE_CLOCK);
+        if (record->type == TRACE_SYSCALL_ENTER && record->arg0 == 0) seen |= TRACE_BIT(TRACE_SYSCALL_ENTER);
+        if (record->type == TRACE_SYSCALL_EXIT && record->arg0 == (uint32_t) -1) seen |= TRACE_BIT(TRACE_SYSCALL_EXIT);
+    }
+    i = ring->count;
+    restore_flags(flags);
+
+    if (ret != -1) return FAIL;
+    if (i != count) return FAIL;
+    if (seen != (TRACE_BIT(TRACE_CLOCK) | TRACE_BIT(TRACE_SYSCALL_ENTER) | TRACE_BIT(TRACE_SYSCALL_EXIT))) return FAIL;
+    return PASS;
+}
+
+/* Terminal Write Throughput Test
+    * 
+    * Asserts that term_write lays out text like putc does, and benchmarks both on counter-style output
+    * (short numbered lines), which term_write has to write faster
+    * Inputs: None
+    * Outputs: PASS/FAIL
+    * Side Effects: None
+    * Coverage: Terminal
+    * Files: terminal.c/h, lib.c/h */
+int term_write_throughput_test() {
+    TEST_HEADER;
+    int8_t buf[1024];
+    int8_t digits[11];
+    uint16_t expected[NUM_COLS];
+    uint32_t i, len = 0, reps = 20, x, y;
+    uint64_t start, putc_cycles, write_cycles;
+    terminal_data_t* term = &terminals[curr_executing_terminal_id];
+
+    // What counter prints: a number per line
+    for (i = 0; len < sizeof(buf) - 16; i++) {
+        strcpy(buf + len, itoa(i, digits, 10));
+        len += strlen(digits);
+        buf[len++] = '\t';
+        buf[len++] = '\n';
+    }
+
+    start = now_cycles();
+    for (i = 0; i < reps * len; i++) {
+        putc(buf[i % len]);
+    }
+    putc_cycles = now_cycles() - start;
+
+    start = now_cycles();
+    for (i = 0; i < reps; i++) {
+        term_write(NULL, buf, len);
+    }
+    write_cycles = now_cycles() - start;
+
+    // Both leave the cursor after the last line, the row above it shows the last number & its tab
+    x = term->screen_x;
+    y = term->screen_y;
+    if (x != 0 || y == 0) return FAIL;
+    putc_raw('\n');
+    term_write(NULL, "391\t|", 5);
+    memcpy(expected, term_screen(curr_executing_terminal_id) + NUM_COLS * term->screen_y, sizeof(expected));
+    putc('\n');
+    for (i = 0; i < 5; i++) putc("391\t|"[i]);
+    for (i = 0; i < NUM_COLS; i++) {
+        if (term_screen(curr_executing_terminal_id)[NUM_COLS * term->screen_y + i] != expected[i]) return FAIL;
+    }
+    putc('\n');
+
+    div64_32(&putc_cycles, reps * len);
+    div64_32(&write_cycles, reps * len);
+    printf("putc: %u cycles/byte, term_write: %u cycles/byte\n", (uint32_t) putc_cycles, (uint32_t) write_cycles);
+    if (write_cycles >= putc_cycles) return FAIL;
+    return PASS;
+}
+
+/* Terminal Scroll Ring Test
+    * 
+    * Asserts that scrolling past the end of the ring keeps the screen & its scrollback in order, that
+    * the view stops at both ends of the scrollback, and benchmarks a scroll
+    * Inputs: None
+    * Outputs: PASS/FAIL
+    * Side Effects: None
+    * Coverage: Terminal
+    * Files: terminal.c/h, lib.c/h */
+int term_scroll_ring_test() {
+    TEST_HEADER;
+    uint8_t terminal_id = curr_executing_terminal_id;
+    terminal_data_t* term = &terminals[terminal_id];
+    uint32_t i, lines = 2 * term->ring_rows;
+    uint64_t start, cycles;
+
+    // Line i starts with a letter of its own, the ring wraps at least once
+    for (i = 0; i < lines; i++) {
+        putc('A' + i % 26);
+        putc('\n');
+    }
+    if (term->screen_y != NUM_ROWS - 1) return FAIL;
+    if (term->top + NUM_ROWS > term->ring_rows) return FAIL;
+    // The last line printed is right above the cursor
+    if ((term_screen(terminal_id)[NUM_COLS * (NUM_ROWS - 2)] & 0xFF) != 'A' + (lines - 1) % 26) return FAIL;
+
+    // With enough terminals to leave no room for scrollback the screen scrolls by copying
+    if (term->ring_rows > NUM_ROWS) {
+        // The row before the screen is the newest scrollback, and half of it survives a wrap
+        if (term->top < (term->ring_rows - NUM_ROWS) / 2) return FAIL;
+        if ((term->ring[NUM_COLS * (term->top - 1)] & 0xFF) != 'A' + (lines - NUM_ROWS) % 26) return FAIL;
+
+        term_scroll_view(terminal_id, TERM_SCROLLBACK_STEP);
+        if (term->scrollback != TERM_SCROLLBACK_STEP) return FAIL;
+        term_scroll_view(terminal_id, term->ring_rows);
+        if (term->scrollback != term->top) return FAIL;
+        term_scroll_view(terminal_id, -(int32_t) term->ring_rows);
+        if (term->scrollback != 0) return FAIL;
+    }
+
+    start = now_cycles();
+    for (i = 0; i < lines; i++) {
+        scroll();
+    }
+    cycles = now_cycles() - start;
+    div64_32(&cycles, lines);
+    printf("scroll: %u cycles\n", (uint32_t) cycles);
+    return PASS;
+}
+
+/* Terminal Switch Test
+    * 
+    * Asserts that terminals that own a slot of VGA text memory write to their own page aligned slot,
+    * and that switching between them only moves the display's start address there, benchmarking a switch
+    * Inputs: None
+    * Outputs: PASS/FAIL
+    * Side Effects: None
+    * Coverage: Terminal
+    * Files: terminal.c/h */
+int term_switch_test() {
+    TEST_HEADER;
+    uint8_t shown = curr_displaying_terminal_id;
+    uint8_t other = (shown + 1) % num_terminals;
+    uint16_t cells[MAX_TERMINAL_ID];
+    uint16_t* slot_end = (uint16_t*) VIDEO_MEM;
+    uint32_t i, start;
+    uint64_t cycles;
+
+    for (i = 0; i < num_terminals; i++) {
+        cells[i] = term_screen(i)[0];
+        if (terminals[i].backing != NULL) continue;
+        if ((uint32_t) terminals[i].ring % PAGE_SIZE_4KB != 0) return FAIL;
+        if (terminals[i].ring < slot_end) return FAIL;
+        slot_end = terminals[i].ring + terminals[i].ring_rows * NUM_COLS;
+        if ((uint32_t) slot_end > VIDEO_MEM + VGA_TEXT_MEM_SIZE) return FAIL;
+    }
+    if (terminals[shown].backing != NULL || terminals[other].backing != NULL) return PASS;
+
+    cycles = now_cycles();
+    term_video_switch(other);
+    cycles = now_cycles() - cycles;
+    if (curr_displaying_terminal_id != other) return FAIL;
+    outb(START_ADDRESS_HIGH, VGA_INDEX_PORT);
+    start = inb(VGA_DATA_PORT) << 8;
+    outb(START_ADDRESS_LOW, VGA_INDEX_PORT);
+    start |= inb(VGA_DATA_PORT);
+    term_video_switch(shown);
+
+    if (other != shown && start != (terminals[other].ring - (uint16_t*) VIDEO_MEM) + (terminals[other].top - terminals[other].scrollback) * NUM_COLS) return FAIL;
+    for (i = 0; i < num_terminals; i++) {
+        if (term_screen(i)[0] != cells[i]) return FAIL;
+    }
+    printf("switch: %u cycles\n", (uint32_t) cycles);
+    return PASS;
+}
+
+/* Keyboard Ring Test
+    * 
+    * Asserts that scancodes in the ring reach the displayed terminal's line once drained, and that
+    * the ring drops what doesn't fit instead of overwriting what the thread hasn't taken yet
+    * Inputs: None
+    * Outputs: PASS/FAIL
+    * Side Effects: None
+    * Coverage: Keyboard scancode ring
+    * Files: keyboard.c/h */
+int keyboard_ring_test() {
+    TEST_HEADER;
+    terminal_data_t* term = &terminals[curr_displaying_terminal_id];
+    uint8_t original_terminal_id = curr_executing_terminal_id;
+    uint32_t i, size, dropped, flags;
+    int result = PASS;
+
+    // Keep the keyboard thread from draining the ring before the test does
+    keyboard_thread_pause(1);
+    cli_and_save(flags);
+    keyboard_drain();
+    size = term->keyboard_buffer_size;
+    if (size >= KBUFFER_SIZE) result = FAIL;
+
+    keyboard_queue_scancode(0x1E);         // a pressed
+    keyboard_queue_scancode(0x9E);         // and released
+    if (result == PASS && keyboard_drain() != 2) result = FAIL;
+    if (result == PASS && (term->keyboard_buffer_size != size + 1 || term->keyboard_buffer[size] != 'a')) result = FAIL;
+    term->keyboard_buffer_size = size;
+
+    dropped = keyboard_dropped;
+    for (i = 0; i < KEYBOARD_RING_SIZE + 1; i++) {
+        keyboard_queue_scancode(0xAA);     // left shift released
+    }
+    if (keyboard_dropped != dropped + 1) result = FAIL;
+    if (keyboard_drain() != KEYBOARD_RING_SIZE) result = FAIL;
+    curr_executing_terminal_id = original_terminal_id;
+    restore_flags(flags);
+    keyboard_thread_pause(0);
+    return result;
+}
+
+/* Terminal Raw Mode Test
+    * 
+    * Asserts that in raw mode keys reach read as they are typed, arrows as escape sequences, and that a
+    * read with nothing typed returns nothing once its timeout is up
+    * Inputs: None
+    * Outputs: PASS/FAIL
+    * Side Effects: None
+    * Coverage: Terminal input modes
+    * Files: terminal.c/h, keyboard.c/h */
+int term_raw_mode_test() {
+    TEST_HEADER;
+    terminal_data_t* term = &terminals[curr_displaying_terminal_id];
+    uint8_t original_terminal_id = curr_executing_terminal_id;
+    term_mode_t original_mode = term->mode;
+    uint8_t buf[8];
+    uint32_t flags, start;
+    int32_t n;
+    int result = PASS;
+
+    term->mode.flags = 0;
+    term->mode.min = 0;
+    term->mode.time_ms = 0;
+    term->input_head = term->input_tail;
+
+    // The test is the ring's consumer, the thread stays out of it
+    keyboard_thread_pause(1);
+    cli_and_save(flags);
+    keyboard_queue_scancode(0x1E);         // a pressed
+    keyboard_queue_scancode(0x9E);         // and released
+    keyboard_queue_scancode(0xE0);         // up arrow pressed
+    keyboard_queue_scancode(0x48);
+    keyboard_queue_scancode(0xE0);         // and released
+    keyboard_queue_scancode(0xC8);
+    keyboard_drain();
+    restore_flags(flags);
+    keyboard_thread_pause(0);
+
+    curr_executing_terminal_id = curr_displaying_terminal_id;
+    n = term_read(NULL, buf, sizeof(buf));
+    if (n != 4 || buf[0] != 'a' || buf[1] != ASCII_ESCAPE || buf[2] != '[' || buf[3] != 'A') result = FAIL;
+
+    term->mode.time_ms = 20;
+    start = timer_ticks;
+    if (term_read(NULL, buf, sizeof(buf)) != 0) result = FAIL;
+    if (timer_ticks - start < timer_ms_to_ticks(20)) result = FAIL;
+
+    term->mode = original_mode;
+    curr_executing_terminal_id = original_terminal_id;
+    return result;
+}
+
+/* Serial Loopback Test
+    * 
+    * Asserts that bytes sent through the serial driver's transmit ring come back through its receive
+    * ring with the UART in loopback mode, once what was queued before has gone out (passes without a UART)
+    * Inputs: None
+    * Outputs: PASS/FAIL
+    * Side Effects: None
+    * Coverage: Serial driver
+    * Files: serial.c/h */
+int serial_loopback_test() {
+    TEST_HEADER;
+    uint8_t buf[SERIAL_RX_SIZE];
+    uint32_t flags, i;
+    int32_t n;
+    int result = PASS;
+
+    if (!serial_present()) return PASS;
+    // In loopback the UART's interrupt line stays quiet, so the test services it itself, without an EOI
+    cli_and_save(flags);
+    // Console, trace & log lines already queued would loop back ahead of the test's bytes
+    for (i = 0; i < 1000000 && (serial_tx_room() != SERIAL_TX_SIZE ||
+                                !(inb(SERIAL_PORT + UART_LSR) & UART_LSR_TEMT)); i++) {
+        serial_service();
+    }
+    if (serial_tx_room() != SERIAL_TX_SIZE) result = FAIL;
+    outb(UART_MCR_DTR_RTS_OUT2 | UART_MCR_LOOPBACK, SERIAL_PORT + UART_MCR);
+    if (serial_send("ok!", 3) != 3) result = FAIL;
+    for (i = 0; i < 100000 && !(inb(SERIAL_PORT + UART_LSR) & UART_LSR_TEMT); i++);
+    serial_service();
+    // Whatever arrived from outside before is in the receive ring ahead of them
+    n = serial_read(NULL, buf, sizeof(buf));
+    if (n < 3 || strncmp((int8_t*) buf + n - 3, (int8_t*) "ok!", 3) != 0) result = FAIL;
+    outb(UART_MCR_DTR_RTS_OUT2, SERIAL_PORT + UART_MCR);
+    restore_flags(flags);
+    return result;
+}
+
+/* Kernel Log Test
+    * 
+    * Asserts that a logged record reads back formatted with its level & arguments, through
+    * klog_next_record and the kmsg device, and that records less severe than klog_level are not kept
+    * Inputs: None
+    * Outputs: PASS/FAIL
+    * Side Effects: None
+    * Coverage: Kernel log
+    * Files: klog.c/h, kmsg.c/h */
+int klog_test() {
+    TEST_HEADER;
+    const int8_t* expected = ": klog test -5 0x1f ok%\n";
+    uint32_t expected_len = strlen(expected);
+    klog_record_t record;
+    fd_array_member_t f;
+    int8_t line[KLOG_LINE_SIZE];
+    uint32_t pos = 0, len, original_level = klog_level;
+    int result = PASS;
+
+    // Catch up with what's logged already
+    while (klog_next_record(&pos, &record));
+    f.file_pos = pos;
+
+    klog_level = KLOG_INFO;
+    klog(KLOG_INFO, "klog test %d 0x%x %s%%", -5, 0x1F, "ok");
+    klog(KLOG_DEBUG, "klog test, not kept");
+    klog_level = original_level;
+
+    if (!klog_next_record(&pos, &record) || record.level != KLOG_INFO) return FAIL;
+    len = klog_format(&record, line, sizeof(line));
+    if (len < expected_len || strncmp(line, "<2>[", 4) != 0 ||
+        strncmp(line + len - expected_len, expected, expected_len) != 0) result = FAIL;
+    if (klog_next_record(&pos, &record)) result = FAIL;
+
+    // The device hands out the same line, & nothing once the reader is caught up
+    if (kmsg_read(&f, line, sizeof(line)) != len || f.file_pos != pos) result = FAIL;
+    if (kmsg_read(&f, line, sizeof(line)) != 0) result = FAIL;
+    return result;
+}
+
+/* Graphics Mode Test
+    * 
+    * Asserts that vga_set_mode turns down sizes the display interface can't show, that one task has
+    * graphics at a time, and that releasing it puts the display back in text mode with the text intact
+    * (passes without a framebuffer)
+    * Inputs: None
+    * Outputs: PASS/FAIL
+    * Side Effects: None
+    * Coverage: Graphics modes
+    * Files: vga.c/h */
+int vga_mode_test() {
+    TEST_HEADER;
+    uint16_t* cell = (uint16_t*) VIDEO_MEM;
+    uint16_t original = *cell;
+    int result = PASS;
+
+    if (!vga_gfx_available()) return PASS;
+    if (vga_set_mode(MAX_PID_COUNT - 1, curr_displaying_terminal_id, 321, 200) != -1) result = FAIL;
+    if (vga_set_mode(MAX_PID_COUNT - 1, curr_displaying_terminal_id, 320, 0) != -1) result = FAIL;
+    if (vga_set_mode(MAX_PID_COUNT - 1, curr_displaying_terminal_id, 2048, 200) != -1) result = FAIL;
+
+    if (vga_set_mode(MAX_PID_COUNT - 1, curr_displaying_terminal_id, 320, 200) != 0) return FAIL;
+    // Text written while the framebuffer is shown is still there afterwards
+    *cell = 0x0741;
+    if (!vga_gfx_owner(MAX_PID_COUNT - 1)) result = FAIL;
+    if (vga_set_mode(MAX_PID_COUNT - 2, curr_displaying_terminal_id, 320, 200) != -1) result = FAIL;
+    vga_release(MAX_PID_COUNT - 2);
+    if (!vga_gfx_owner(MAX_PID_COUNT - 1)) result = FAIL;
+    vga_release(MAX_PID_COUNT - 1);
+    if (vga_gfx_owner(MAX_PID_COUNT - 1)) result = FAIL;
+    if (*cell != 0x0741) result = FAIL;
+
+    *cell = original;
+    return result;
+}
+
+/* Present Test
+    * 
+    * Asserts that term_present copies only the rows of the back buffer that changed since the last
+    * present, both to the screen and to the front buffer, that nothing is copied when nothing changed,
+    * and that every row is copied again once something else wrote the screen
+    * Inputs: None
+    * Outputs: PASS/FAIL
+    * Side Effects: None
+    * Coverage: Double-buffered vidmap
+    * Files: terminal.c/h */
+int present_test() {
+    TEST_HEADER;
+    uint16_t* screen = term_screen(curr_displaying_terminal_id);
+    uint16_t original = screen[NUM_COLS * 3 + 5];
+    uint32_t back, front, writes;
+    int result = PASS;
+
+    if (term_buffer_init(curr_displaying_terminal_id, &back, &front, &writes) == -1) return FAIL;
+    // Both start out as the screen
+    if (term_present(curr_displaying_terminal_id, back, front, &writes) != 0) result = FAIL;
+
+    ((uint16_t*) back)[NUM_COLS * 3 + 5] = original ^ 0x0100;
+    if (term_present(curr_displaying_terminal_id, back, front, &writes) != 1) result = FAIL;
+    if (screen[NUM_COLS * 3 + 5] != (original ^ 0x0100)) result = FAIL;
+    if (((uint16_t*) front)[NUM_COLS * 3 + 5] != (original ^ 0x0100)) result = FAIL;
+    if (term_present(curr_displaying_terminal_id, back, front, &writes) != 0) result = FAIL;
+
+    // Echo or a terminal write changed the screen behind the front buffer's back
+    terminals[curr_displaying_terminal_id].screen_writes++;
+    if (term_present(curr_displaying_terminal_id, back, front, &writes) != NUM_ROWS) result = FAIL;
+    if (term_present(curr_displaying_terminal_id, back, front, &writes) != 0) result = FAIL;
+
+    screen[NUM_COLS * 3 + 5] = original;
+    frame_put(back);
+    frame_put(front);
+    return result;
+}
+
+/* RTC Dup Test
+    * 
+    * Asserts that a virtual RTC copied by fs_interface_dup (as spawn does) keeps ticking after one copy is
+    * closed, and goes away with the last one
+    * Inputs: None
+    * Outputs: PASS/FAIL
+    * Side Effects: None
+    * Coverage: per-fd virtual RTCs shared with a spawned task
+    * Files: rtc.c/h, filesys_interface.c/h */
+int rtc_dup_test() {
+    TEST_HEADER;
+    fd_array_member_t parent, child;
+    int32_t freq = 16;
+    int result = PASS;
+
+    parent.fops = &rtc_fops;
+    parent.flags = 1;
+    if (rtc_open(&parent, (uint8_t*)"rtc") != 0) return FAIL;
+    if (fs_interface_dup(&child, &parent) != 0) result = FAIL;
+    rtc_close(&child);
+    if (!rtc_timers[parent.inode].in_use) result = FAIL;
+    // Still in the deadline list, so it ticks at the new rate
+    if (rtc_write(&parent, &freq, 4) != 0) result = FAIL;
+    if (rtc_read(&parent, NULL, 0) != 0) result = FAIL;
+    rtc_close(&parent);
+    if (rtc_timers[parent.inode].in_use) result = FAIL;
+    return result;
+}
 
 /* Test suite entry point */
 void launch_tests() {
@@ -1254,4 +2364,29 @@ void launch_tests() {
     // TEST_OUTPUT("test_syscalls_invalid", syscalls_invalid_test());
 
     // Checkpoint 5 tests
+    // TEST_OUTPUT("test_syscall_pipe", syscalls_pipe_test());
+    // TEST_OUTPUT("shm_share_test", shm_share_test());
+    // TEST_OUTPUT("futex_test", futex_test());
+    // TEST_OUTPUT("signal_deliver_test", signal_deliver_test());
+    // TEST_OUTPUT("timer_wheel_test", timer_wheel_test());
+    // TEST_OUTPUT("tsc_clock_test", tsc_clock_test());
+    // TEST_OUTPUT("rtc_virtual_test", rtc_virtual_test());
+    // TEST_OUTPUT("apic_routing_test", apic_routing_test());
+    // TEST_OUTPUT("smp_percpu_test", smp_percpu_test());
+    // TEST_OUTPUT("lock_stats_test", lock_stats_test());
+    // TEST_OUTPUT("irqoff_test", irqoff_test());
+    // TEST_OUTPUT("irq_stats_test", irq_stats_test());
+    // TEST_OUTPUT("keyboard_storm_jitter_test", keyboard_storm_jitter_test());
+    // TEST_OUTPUT("profile_test", profile_test());
+    // TEST_OUTPUT("trace_test", trace_test());
+    // TEST_OUTPUT("term_write_throughput_test", term_write_throughput_test());
+    // TEST_OUTPUT("term_scroll_ring_test", term_scroll_ring_test());
+    // TEST_OUTPUT("term_switch_test", term_switch_test());
+    // TEST_OUTPUT("keyboard_ring_test", keyboard_ring_test());
+    // TEST_OUTPUT("term_raw_mode_test", term_raw_mode_test());
+    // TEST_OUTPUT("serial_loopback_test", serial_loopback_test());
+    // TEST_OUTPUT("klog_test", klog_test());
+    // TEST_OUTPUT("vga_mode_test", vga_mode_test());
+    // TEST_OUTPUT("present_test", present_test());
+    // TEST_OUTPUT("rtc_dup_test", rtc_dup_test());
 }
@@ -0,0 +1,265 @@
+#include "timer.h"
+#include "lib.h"
+#include "task.h"
+#include "signal.h"
+
+// Next tick to be processed
+volatile uint32_t timer_ticks = 0;
+
+// Timers due within TIMER_ROOT_SIZE ticks, one slot per tick
+static timer_t* timer_root[TIMER_ROOT_SIZE];
+// Timers further away, each slot of level i covers 2^(TIMER_ROOT_BITS + i * TIMER_LEVEL_BITS) ticks
+static timer_t* timer_levels[TIMER_LEVELS][TIMER_LEVEL_SIZE];
+
+/* 
+ * timer_init
+ *   DESCRIPTION: Empties the timer wheel
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void timer_init() {
+    int32_t i, j;
+    timer_ticks = 0;
+    for (i = 0; i < TIMER_ROOT_SIZE; i++) {
+        timer_root[i] = NULL;
+    }
+    for (i = 0; i < TIMER_LEVELS; i++) {
+        for (j = 0; j < TIMER_LEVEL_SIZE; j++) {
+            timer_levels[i][j] = NULL;
+        }
+    }
+}
+
+/* 
+ * timer_setup
+ *   DESCRIPTION: Initializes an unarmed timer
+ *   INPUTS: timer -- the timer
+ *           callback -- function called when the timer fires
+ *           data -- for the callback
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void timer_setup(timer_t* timer, timer_callback_t callback, void* data) {
+    timer->callback = callback;
+    timer->data = data;
+    timer->period = 0;
+    timer->next = NULL;
+    timer->pprev = NULL;
+}
+
+/* 
+ * timer_link
+ *   DESCRIPTION: Puts a timer in the slot matching its expiry, the slots get coarser the further away
+ *                the expiry is. Must be called with interrupts disabled.
+ *   INPUTS: timer -- the timer, with expires set
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void timer_link(timer_t* timer) {
+    uint32_t expires = timer->expires;
+    int32_t delta = (int32_t) (expires - timer_ticks);
+    timer_t** slot;
+    int32_t level, shift;
+
+    if (delta < 0) {
+        // Already due, fires at the next tick
+        slot = &timer_root[timer_ticks & TIMER_ROOT_MASK];
+    } else if (delta < TIMER_ROOT_SIZE) {
+        slot = &timer_root[expires & TIMER_ROOT_MASK];
+    } else {
+        shift = TIMER_ROOT_BITS;
+        for (level = 0; level < TIMER_LEVELS - 1; level++) {
+            if (delta < (1 << (shift + TIMER_LEVEL_BITS))) break;
+            shift += TIMER_LEVEL_BITS;
+        }
+        slot = &timer_levels[level][(expires >> shift) & TIMER_LEVEL_MASK];
+    }
+
+    timer->next = *slot;
+    if (*slot != NULL) {
+        (*slot)->pprev = &timer->next;
+    }
+    *slot = timer;
+    timer->pprev = slot;
+}
+
+/* 
+ * timer_unlink
+ *   DESCRIPTION: Removes an armed timer from its slot. Must be called with interrupts disabled.
+ *   INPUTS: timer -- the timer
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void timer_unlink(timer_t* timer) {
+    *timer->pprev = timer->next;
+    if (timer->next != NULL) {
+        timer->next->pprev = timer->pprev;
+    }
+    timer->next = NULL;
+    timer->pprev = NULL;
+}
+
+/* 
+ * timer_add
+ *   DESCRIPTION: Arms a timer, re-arming it if it was already armed
+ *   INPUTS: timer -- the timer
+ *           ticks -- ticks until it fires, at least 1
+ *           period -- ticks between later firings, 0 for a one-shot timer
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void timer_add(timer_t* timer, uint32_t ticks, uint32_t period) {
+    uint32_t flags;
+    cli_and_save(flags);
+    if (timer->pprev != NULL) {
+        timer_unlink(timer);
+    }
+    timer->expires = timer_ticks + MIN(MAX(ticks, 1), TIMER_MAX_TICKS);
+    timer->period = MIN(period, TIMER_MAX_TICKS);
+    timer_link(timer);
+    restore_flags(flags);
+}
+
+/* 
+ * timer_del
+ *   DESCRIPTION: Disarms a timer, does nothing if it isn't armed
+ *   INPUTS: timer -- the timer
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void timer_del(timer_t* timer) {
+    uint32_t flags;
+    cli_and_save(flags);
+    if (timer->pprev != NULL) {
+        timer_unlink(timer);
+    }
+    timer->period = 0;
+    restore_flags(flags);
+}
+
+/* 
+ * timer_pending
+ *   DESCRIPTION: Whether a timer is armed
+ *   INPUTS: timer -- the timer
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if it is armed, 0 if not
+ *   SIDE EFFECTS: none
+ */
+int32_t timer_pending(timer_t* timer) {
+    return timer->pprev != NULL;
+}
+
+/* 
+ * timer_ms_to_ticks
+ *   DESCRIPTION: Converts milliseconds to timer ticks, rounding up so a timer never fires early
+ *   INPUTS: ms -- milliseconds
+ *   OUTPUTS: none
+ *   RETURN VALUE: number of ticks
+ *   SIDE EFFECTS: none
+ */
+uint32_t timer_ms_to_ticks(uint32_t ms) {
+    return ms / 1000 * TIMER_TICK_HZ + ((ms % 1000) * TIMER_TICK_HZ + 999) / 1000;
+}
+
+/* 
+ * timer_cascade
+ *   DESCRIPTION: Moves the timers of a slot of a coarse level down to finer slots
+ *   INPUTS: level -- the level
+ *           index -- the slot
+ *   OUTPUTS: none
+ *   RETURN VALUE: index, so callers can stop cascading unless the slot was the level's first
+ *   SIDE EFFECTS: none
+ */
+static int32_t timer_cascade(int32_t level, int32_t index) {
+    timer_t* timer = timer_levels[level][index];
+    timer_t* next;
+    timer_levels[level][index] = NULL;
+    while (timer != NULL) {
+        next = timer->next;
+        timer_link(timer);
+        timer = next;
+    }
+    return index;
+}
+
+/* 
+ * timer_tick
+ *   DESCRIPTION: Advances the wheel by one tick and runs the timers that expire. Only the current
+ *                root slot is looked at, plus one slot per level each time a lower level wraps around.
+ *                Called from the PIT interrupt with interrupts disabled.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: runs timer callbacks, re-arms periodic timers
+ */
+void timer_tick() {
+    int32_t index = timer_ticks & TIMER_ROOT_MASK;
+    int32_t level, shift;
+    timer_t* timer;
+
+    // The root wrapped around, bring the next slot of each level down as long as levels wrap too
+    shift = TIMER_ROOT_BITS;
+    for (level = 0; index == 0 && level < TIMER_LEVELS; level++) {
+        if (timer_cascade(level, (timer_ticks >> shift) & TIMER_LEVEL_MASK) != 0) break;
+        shift += TIMER_LEVEL_BITS;
+    }
+    timer_ticks++;
+
+    // Callbacks may add & delete timers, take them out one at a time
+    while ((timer = timer_root[index]) != NULL) {
+        timer_unlink(timer);
+        if (timer->period != 0) {
+            timer->expires += timer->period;
+            timer_link(timer);
+        }
+        timer->callback(timer);
+    }
+}
+
+/* 
+ * timer_sleep_wakeup
+ *   DESCRIPTION: Timer callback waking the task sleeping on the timer
+ *   INPUTS: timer -- the expired timer
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void timer_sleep_wakeup(timer_t* timer) {
+    task_wakeup(timer);
+}
+
+/* 
+ * timer_sleep
+ *   DESCRIPTION: Blocks the current task for at least the given time. The task costs nothing while it
+ *                sleeps, only the timer's expiry wakes it.
+ *   INPUTS: ms -- milliseconds to sleep
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 after sleeping, -1 if the task is being killed
+ *   SIDE EFFECTS: switches to other tasks
+ */
+int32_t timer_sleep(uint32_t ms) {
+    timer_t timer;
+    uint32_t flags;
+    if (ms == 0) return 0;
+
+    cli_and_save(flags);
+    timer_setup(&timer, timer_sleep_wakeup, NULL);
+    timer_add(&timer, timer_ms_to_ticks(ms), 0);
+    while (timer_pending(&timer)) {
+        if (signal_fatal_pending()) {
+            timer_del(&timer);
+            restore_flags(flags);
+            return -1;
+        }
+        task_block(&timer);
+    }
+    restore_flags(flags);
+    return 0;
+}
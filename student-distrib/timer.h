@@ -0,0 +1,43 @@
+#ifndef _TIMER_H
+#define _TIMER_H
+
+#include "types.h"
+#include "devices/pit.h"
+
+// Wheel layout: 256 slots of single ticks, then 3 levels of 64 coarser slots each
+#define TIMER_ROOT_BITS 8
+#define TIMER_LEVEL_BITS 6
+#define TIMER_ROOT_SIZE (1 << TIMER_ROOT_BITS)
+#define TIMER_LEVEL_SIZE (1 << TIMER_LEVEL_BITS)
+#define TIMER_ROOT_MASK (TIMER_ROOT_SIZE - 1)
+#define TIMER_LEVEL_MASK (TIMER_LEVEL_SIZE - 1)
+#define TIMER_LEVELS 3
+// Longest delay the wheel can hold (about 7 days at 100 Hz), longer ones are clamped
+#define TIMER_MAX_TICKS ((1 << (TIMER_ROOT_BITS + TIMER_LEVELS * TIMER_LEVEL_BITS)) - 1)
+
+#define TIMER_TICK_HZ PIT_DESIRED_FREQ
+
+typedef struct timer timer_t;
+typedef void (*timer_callback_t)(timer_t* timer);
+
+struct timer {
+    uint32_t expires;               // tick at which the timer fires
+    uint32_t period;                // ticks between firings, 0 for a one-shot timer
+    timer_callback_t callback;      // called from the timer interrupt with interrupts disabled
+    void* data;                     // for the callback
+    timer_t* next;                  // next timer in the same slot
+    timer_t** pprev;                // link pointing to this timer, NULL if not armed
+};
+
+extern volatile uint32_t timer_ticks;
+
+void timer_init();
+void timer_setup(timer_t* timer, timer_callback_t callback, void* data);
+void timer_add(timer_t* timer, uint32_t ticks, uint32_t period);
+void timer_del(timer_t* timer);
+int32_t timer_pending(timer_t* timer);
+uint32_t timer_ms_to_ticks(uint32_t ms);
+void timer_tick();
+int32_t timer_sleep(uint32_t ms);
+
+#endif
@@ -0,0 +1,160 @@
+#include "trace.h"
+#include "lib.h"
+#include "smp.h"
+#include "irqoff.h"
+#include "devices/tsc.h"
+#include "devices/serial.h"
+#include "interrupt_handlers/context.h"
+
+/*
+ * Each processor records into its own ring, with interrupts off so a nested handler's tracepoint
+ * can't tear a record. The boot processor's timer tick moves the records to the serial driver, oldest
+ * first; it holds the kernel lock like every recording tracepoint does. Tracing starts out off.
+ */
+volatile uint32_t trace_mask = 0;
+
+static trace_ring_t trace_rings[MAX_CPUS];
+
+/*
+ * trace_set_mask
+ *   DESCRIPTION: Chooses the events to record. Turning tracing on records the TSC rate first, so the
+ *                stream can be decoded from that point on.
+ *   INPUTS: mask -- TRACE_BIT of every event to record, 0 to stop tracing
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void trace_set_mask(uint32_t mask) {
+    uint32_t was_off = (trace_mask == 0);
+    trace_mask = mask;
+    if (was_off && mask != 0) {
+        trace_record(TRACE_CLOCK, tsc_khz, 0);
+    }
+}
+
+/*
+ * trace_record
+ *   DESCRIPTION: Appends a record to the calling processor's ring, TRACE checks the event is on first
+ *   INPUTS: type -- TRACE_*
+ *           arg0, arg1 -- the event's arguments
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: overwrites the oldest record once the ring is full
+ */
+void trace_record(uint32_t type, uint32_t arg0, uint32_t arg1) {
+    uint32_t flags;
+    trace_ring_t* ring;
+    trace_record_t* record;
+
+    // this_cpu only works once irqoff_ready is set
+    if (!irqoff_ready) return;
+    cli_and_save(flags);
+    ring = &trace_rings[this_cpu()->id];
+    if (ring->count == TRACE_RING_SIZE) {
+        ring->head = (ring->head + 1) % TRACE_RING_SIZE;
+        ring->count--;
+        ring->dropped++;
+    }
+    record = &ring->records[(ring->head + ring->count) % TRACE_RING_SIZE];
+    ring->count++;
+
+    record->magic = TRACE_RECORD_MAGIC;
+    record->type = type;
+    record->cpu = this_cpu()->id;
+    record->pid = this_cpu()->pid;
+    record->tsc = now_cycles();
+    record->arg0 = arg0;
+    record->arg1 = arg1;
+    restore_flags(flags);
+}
+
+/*
+ * trace_entry / trace_exit
+ *   DESCRIPTION: Called by the entry stubs when syscall or interrupt tracing is on. The registers the
+ *                entry saved sit right above its irq_frame_t.
+ *   INPUTS: frame -- the stub's irq_frame_t
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void trace_entry(irq_frame_t* frame) {
+    hw_context_t* context = (hw_context_t*) (frame + 1);
+    if (frame->vector == IRQ_STATS_SYSCALL_VECTOR) {
+        TRACE(TRACE_SYSCALL_ENTER, context->eax, context->ebx);
+    } else {
+        TRACE(TRACE_IRQ_ENTER, frame->vector, 0);
+    }
+}
+
+void trace_exit(irq_frame_t* frame) {
+    hw_context_t* context = (hw_context_t*) (frame + 1);
+    if (frame->vector == IRQ_STATS_SYSCALL_VECTOR) {
+        // The stub already stored the return value
+        TRACE(TRACE_SYSCALL_EXIT, context->eax, 0);
+    } else {
+        TRACE(TRACE_IRQ_EXIT, frame->vector, 0);
+    }
+}
+
+/*
+ * trace_next
+ *   DESCRIPTION: Takes the oldest record out of the rings
+ *   INPUTS: record -- where to copy it
+ *   OUTPUTS: the record
+ *   RETURN VALUE: 1 if there was one, 0 if every ring is empty
+ *   SIDE EFFECTS: none
+ */
+static uint32_t trace_next(trace_record_t* record) {
+    uint32_t flags, cpu;
+    trace_ring_t* oldest = NULL;
+    trace_ring_t* ring;
+
+    cli_and_save(flags);
+    for (cpu = 0; cpu < num_cpus; cpu++) {
+        ring = &trace_rings[cpu];
+        if (ring->count == 0) continue;
+        if (oldest == NULL || ring->records[ring->head].tsc < oldest->records[oldest->head].tsc) {
+            oldest = ring;
+        }
+    }
+    if (oldest != NULL) {
+        *record = oldest->records[oldest->head];
+        oldest->head = (oldest->head + 1) % TRACE_RING_SIZE;
+        oldest->count--;
+    }
+    restore_flags(flags);
+    return oldest != NULL;
+}
+
+/*
+ * trace_flush
+ *   DESCRIPTION: Called by the boot processor's timer tick. Puts records in the serial driver's transmit
+ *                ring while a whole one fits, up to TRACE_SERIAL_BUDGET bytes; it never waits for the
+ *                line. Whole records keep the console mirror from landing in the middle of one.
+ *   INPUTS: none
+ *   OUTPUTS: records on the serial port
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: takes the records sent out of the rings
+ */
+void trace_flush() {
+    trace_record_t record;
+    uint32_t sent = 0;
+    if (!serial_present()) return;
+
+    while (sent < TRACE_SERIAL_BUDGET && serial_tx_room() >= sizeof(trace_record_t)) {
+        if (!trace_next(&record)) return;
+        sent += serial_send(&record, sizeof(trace_record_t));
+    }
+}
+
+/*
+ * trace_ring_get
+ *   DESCRIPTION: Gets a processor's ring
+ *   INPUTS: cpu -- index of the processor
+ *   OUTPUTS: none
+ *   RETURN VALUE: its ring, NULL if there is no such processor
+ *   SIDE EFFECTS: none
+ */
+trace_ring_t* trace_ring_get(uint32_t cpu) {
+    return cpu < MAX_CPUS ? &trace_rings[cpu] : NULL;
+}
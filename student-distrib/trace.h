@@ -0,0 +1,85 @@
+/* trace.h - Static tracepoints recorded into per-CPU rings and streamed out the serial port
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _TRACE_H
+#define _TRACE_H
+
+// Events, arg0 / arg1 of each record
+#define TRACE_CLOCK 0               // tsc_khz, 0. Recorded when tracing is turned on, to convert timestamps
+#define TRACE_SYSCALL_ENTER 1       // syscall number, first argument
+#define TRACE_SYSCALL_EXIT 2        // return value, 0
+#define TRACE_IRQ_ENTER 3           // vector, 0
+#define TRACE_IRQ_EXIT 4            // vector, 0
+#define TRACE_SWITCH 5              // pid switched from, pid switched to (-1 for none)
+#define TRACE_PAGE_FAULT 6          // faulting address (CR2), EIP
+#define TRACE_FS_READ 7             // inode, bytes asked for
+#define TRACE_FS_READ_DONE 8        // inode, bytes read (-1 on failure)
+#define TRACE_EVENTS 9
+
+#define TRACE_BIT(event) (1 << (event))
+#define TRACE_MASK_ALL (TRACE_BIT(TRACE_EVENTS) - 1)
+// Events the entry stubs record
+#define TRACE_MASK_ENTRY (TRACE_BIT(TRACE_SYSCALL_ENTER) | TRACE_BIT(TRACE_IRQ_ENTER))
+#define TRACE_MASK_EXIT (TRACE_BIT(TRACE_SYSCALL_EXIT) | TRACE_BIT(TRACE_IRQ_EXIT))
+
+// First byte of every record, lets trace_to_chrome.py find records in the serial stream
+#define TRACE_RECORD_MAGIC 0xA5
+
+// Records each processor's ring holds, the oldest are overwritten when it fills up faster than it drains
+#define TRACE_RING_SIZE 512
+
+// Bytes the timer tick may put in the serial driver's transmit ring, it only puts whole records there
+#define TRACE_SERIAL_BUDGET 512
+
+#ifndef ASM
+
+#include "types.h"
+#include "irq_stats.h"
+
+typedef struct __attribute__((packed)) trace_record {
+    uint8_t magic;                  // TRACE_RECORD_MAGIC
+    uint8_t type;                   // TRACE_*
+    uint8_t cpu;
+    int8_t pid;                     // task running on the processor, -1 while idle
+    uint64_t tsc;
+    uint32_t arg0;
+    uint32_t arg1;
+} trace_record_t;
+
+typedef struct trace_ring {
+    uint32_t head;                  // oldest record
+    uint32_t count;
+    uint32_t dropped;               // records overwritten before they were sent
+    trace_record_t records[TRACE_RING_SIZE];
+} trace_ring_t;
+
+// Bit TRACE_BIT(event) set if the event is recorded
+extern volatile uint32_t trace_mask;
+
+/*
+ * TRACE
+ *   DESCRIPTION: Tracepoint. With the event turned off, all it costs is testing a bit of trace_mask.
+ *   INPUTS: event -- TRACE_*
+ *           arg0, arg1 -- the event's arguments
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+#define TRACE(event, arg0, arg1)                                        \
+do {                                                                    \
+    if (trace_mask & TRACE_BIT(event)) {                                \
+        trace_record((event), (uint32_t) (arg0), (uint32_t) (arg1));    \
+    }                                                                   \
+} while (0)
+
+void trace_set_mask(uint32_t mask);
+void trace_record(uint32_t type, uint32_t arg0, uint32_t arg1);
+void trace_entry(irq_frame_t* frame);
+void trace_exit(irq_frame_t* frame);
+void trace_flush();
+trace_ring_t* trace_ring_get(uint32_t cpu);
+
+#endif /* ASM */
+
+#endif /* _TRACE_H */
@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+"""Decode the kernel's trace stream into Chrome trace / Perfetto JSON.
+
+Capture COM1 while tracing is on (Ctrl+Alt+T toggles it), e.g. with
+    qemu-system-i386 ... -serial file:trace.bin
+then
+    ./trace_to_chrome.py trace.bin > trace.json
+and open trace.json in chrome://tracing or ui.perfetto.dev.
+
+The timeline has one process per CPU, with the task it runs and the
+interrupts it takes, and a "tasks" process with each pid's syscalls, file
+reads and page faults.
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+# Must match trace.h
+TRACE_RECORD_MAGIC = 0xA5
+RECORD = struct.Struct("<BBBbQII")
+(TRACE_CLOCK, TRACE_SYSCALL_ENTER, TRACE_SYSCALL_EXIT, TRACE_IRQ_ENTER, TRACE_IRQ_EXIT,
+ TRACE_SWITCH, TRACE_PAGE_FAULT, TRACE_FS_READ, TRACE_FS_READ_DONE, TRACE_EVENTS) = range(10)
+MAX_CPUS = 4
+
+# Index is the syscall number, see syscalls/ece391sysnum.h
+SYSCALLS = [None, "halt", "execute", "read", "write", "open", "close", "getargs", "vidmap",
+            "set_handler", "sigreturn", "pipe", "spawn", "wait", "shm_create", "shm_map",
+            "shm_unmap", "futex_wait", "futex_wake", "kill", "sleep", "clock_gettime", "profile",
+            "ioctl", "setmode", "vidmap_buffered", "present"]
+SYS_HALT = 1
+
+VECTORS = {0x20: "timer", 0x21: "keyboard", 0x24: "serial", 0x28: "rtc", 0xFF: "spurious"}
+
+TASKS_PID = 100
+CPU_TASK_TID = 0
+CPU_IRQ_TID = 1
+
+
+def records(data):
+    """Records in the stream, skipping bytes that aren't part of one."""
+    i = 0
+    while i + RECORD.size <= len(data):
+        magic, kind, cpu, pid, tsc, arg0, arg1 = RECORD.unpack_from(data, i)
+        if magic != TRACE_RECORD_MAGIC or kind >= TRACE_EVENTS or cpu >= MAX_CPUS:
+            i += 1
+            continue
+        yield kind, cpu, pid, tsc, arg0, arg1
+        i += RECORD.size
+
+
+def signed(value):
+    return value - (1 << 32) if value & 0x80000000 else value
+
+
+def task_name(pid):
+    return "idle" if pid < 0 else "pid %d" % pid
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("stream", help="raw bytes captured from COM1")
+    parser.add_argument("--khz", type=int, help="TSC rate, if the stream lacks the clock record")
+    args = parser.parse_args()
+
+    with open(args.stream, "rb") as f:
+        stream = sorted(records(f.read()), key=lambda r: r[3])
+    if not stream:
+        sys.exit("no trace records in %s" % args.stream)
+
+    khz = args.khz
+    for kind, _, _, _, arg0, _ in stream:
+        if kind == TRACE_CLOCK and arg0:
+            khz = arg0
+            break
+    if not khz:
+        sys.exit("no clock record in the stream, pass --khz")
+    start = stream[0][3]
+
+    def us(tsc):
+        return (tsc - start) * 1000.0 / khz
+
+    events = [{"ph": "M", "name": "process_name", "pid": TASKS_PID, "args": {"name": "tasks"}}]
+    for cpu in sorted({r[1] for r in stream}):
+        events.append({"ph": "M", "name": "process_name", "pid": cpu, "args": {"name": "cpu %d" % cpu}})
+        events.append({"ph": "M", "name": "thread_name", "pid": cpu, "tid": CPU_TASK_TID,
+                       "args": {"name": "running"}})
+        events.append({"ph": "M", "name": "thread_name", "pid": cpu, "tid": CPU_IRQ_TID,
+                       "args": {"name": "interrupts"}})
+
+    # Task each CPU runs since when, from the switch records
+    running = {}
+    for kind, cpu, pid, tsc, arg0, arg1 in stream:
+        ts = us(tsc)
+        task = {"pid": TASKS_PID, "tid": pid, "ts": ts}
+        if kind == TRACE_SYSCALL_ENTER:
+            name = SYSCALLS[arg0] if arg0 < len(SYSCALLS) and SYSCALLS[arg0] else "syscall %d" % arg0
+            # halt never returns
+            task.update(ph="i" if arg0 == SYS_HALT else "B", name=name, args={"arg": signed(arg1)})
+            events.append(task)
+        elif kind == TRACE_SYSCALL_EXIT:
+            task.update(ph="E", args={"ret": signed(arg0)})
+            events.append(task)
+        elif kind == TRACE_FS_READ:
+            task.update(ph="B", name="fs read", args={"inode": arg0, "nbytes": signed(arg1)})
+            events.append(task)
+        elif kind == TRACE_FS_READ_DONE:
+            task.update(ph="E", args={"read": signed(arg1)})
+            events.append(task)
+        elif kind == TRACE_PAGE_FAULT:
+            task.update(ph="i", s="t", name="page fault", args={"cr2": hex(arg0), "eip": hex(arg1)})
+            events.append(task)
+        elif kind == TRACE_IRQ_ENTER:
+            events.append({"ph": "B", "pid": cpu, "tid": CPU_IRQ_TID, "ts": ts,
+                           "name": VECTORS.get(arg0, "vector 0x%x" % arg0)})
+        elif kind == TRACE_IRQ_EXIT:
+            events.append({"ph": "E", "pid": cpu, "tid": CPU_IRQ_TID, "ts": ts})
+        elif kind == TRACE_SWITCH:
+            if cpu in running:
+                prev, since = running[cpu]
+                events.append({"ph": "X", "pid": cpu, "tid": CPU_TASK_TID, "ts": since,
+                               "dur": ts - since, "name": task_name(prev)})
+            running[cpu] = (signed(arg1), ts)
+
+    end = us(stream[-1][3])
+    for cpu, (pid, since) in running.items():
+        events.append({"ph": "X", "pid": cpu, "tid": CPU_TASK_TID, "ts": since,
+                       "dur": end - since, "name": task_name(pid)})
+    for pid in sorted({r[2] for r in stream}):
+        events.append({"ph": "M", "name": "thread_name", "pid": TASKS_PID, "tid": pid,
+                       "args": {"name": task_name(pid)}})
+
+    json.dump({"traceEvents": events, "displayTimeUnit": "ns"}, sys.stdout)
+    sys.stdout.write("\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -15,6 +15,10 @@
 #define USER_DS     0x002B
 #define KERNEL_TSS  0x0030
 #define KERNEL_LDT  0x0038
+#define KERNEL_PERCPU 0x0040
+
+/* Number of entries in the GDT (every processor has its own copy) */
+#define GDT_ENTRIES 9
 
 /* Size of the task state segment (TSS) */
 #define TSS_SIZE    104
@@ -113,6 +117,7 @@ typedef struct __attribute__((packed)) tss_t {
 
 /* Some external descriptors declared in .S files */
 extern x86_desc_t gdt_desc;
+extern seg_desc_t gdt[GDT_ENTRIES];
 
 extern uint16_t ldt_desc;
 extern uint32_t ldt_size;
@@ -125,6 +130,8 @@ extern uint32_t tss_size;
 extern seg_desc_t tss_desc_ptr;
 extern tss_t tss;
 
+extern seg_desc_t percpu_desc_ptr;
+
 /* Sets runtime-settable parameters in the GDT entry for the LDT */
 #define SET_LDT_PARAMS(str, addr, lim)                          \
 do {                                                            \
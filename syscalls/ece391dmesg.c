@@ -0,0 +1,44 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Prints the kernel log, the lines of records at least as severe as the
+ * level given (0 errors ... 3 debug), all of them without one. Lines
+ * come from the kernel as "<level>[time] ...", the level is dropped.
+ */
+int main ()
+{
+    int32_t fd, cnt, i, start;
+    uint8_t buf[1024];
+    uint8_t max_level = '9';
+
+    if (0 == ece391_getargs (buf, 1024) && buf[0] >= '0' && buf[0] <= '9')
+        max_level = buf[0];
+
+    if (-1 == (fd = ece391_open ((uint8_t*)"kmsg"))) {
+        ece391_fdputs (1, (uint8_t*)"no kernel log\n");
+	return 2;
+    }
+
+    /* The kernel only hands out whole lines */
+    while (0 != (cnt = ece391_read (fd, buf, 1024))) {
+        if (-1 == cnt) {
+	    ece391_fdputs (1, (uint8_t*)"kernel log read failed\n");
+	    return 3;
+	}
+	for (start = 0; start < cnt; start = i + 1) {
+	    for (i = start; i < cnt - 1 && buf[i] != '\n'; i++);
+	    if (i - start >= 3 && buf[start] == '<' && buf[start + 2] == '>') {
+	        if (buf[start + 1] > max_level)
+		    continue;
+		start += 3;
+	    }
+	    if (-1 == ece391_write (1, buf + start, i + 1 - start))
+	        return 3;
+	}
+    }
+
+    return 0;
+}
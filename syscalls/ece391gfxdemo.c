@@ -0,0 +1,66 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Bounces a square over a gradient in a 320x200 graphics mode, redrawing
+ * the whole screen every frame, then prints the frame rate it got.
+ */
+#define WIDTH 320
+#define HEIGHT 200
+#define BALL 24
+#define FRAMES 600
+
+static uint32_t background_pixels[WIDTH * HEIGHT];
+static uint32_t ball_pixels[BALL * BALL];
+
+int main ()
+{
+    ece391_surface_t screen = { 0, WIDTH, HEIGHT };
+    ece391_surface_t background = { background_pixels, WIDTH, HEIGHT };
+    ece391_surface_t ball = { ball_pixels, BALL, BALL };
+    ece391_timespec_t start, end;
+    uint32_t x, y, frame, ms;
+    int32_t bx = 0, by = 0, dx = 3, dy = 2;
+    uint8_t buf[16];
+
+    for (y = 0; y < HEIGHT; y++)
+        for (x = 0; x < WIDTH; x++)
+            background_pixels[y * WIDTH + x] = ((x * 255 / WIDTH) << 16) | (y * 255 / HEIGHT);
+    ece391_fill_rect(&ball, 0, 0, BALL, BALL, 0xFFFF00);
+    ece391_fill_rect(&ball, 4, 4, BALL - 8, BALL - 8, 0xFF8000);
+
+    if (-1 == ece391_setmode (WIDTH, HEIGHT) ||
+        -1 == ece391_vidmap ((uint8_t**)&screen.pixels)) {
+        ece391_fdputs (1, (uint8_t*)"no graphics mode\n");
+        return 2;
+    }
+
+    ece391_clock_gettime (CLOCK_MONOTONIC, &start);
+    for (frame = 0; frame < FRAMES; frame++) {
+        ece391_blit (&screen, 0, 0, &background);
+        ece391_blit (&screen, bx, by, &ball);
+        bx += dx;
+        by += dy;
+        if (bx < 0 || bx + BALL > WIDTH) {
+            dx = -dx;
+            bx += 2 * dx;
+        }
+        if (by < 0 || by + BALL > HEIGHT) {
+            dy = -dy;
+            by += 2 * dy;
+        }
+    }
+    ece391_clock_gettime (CLOCK_MONOTONIC, &end);
+    ece391_setmode (0, 0);
+
+    ms = (end.tv_sec - start.tv_sec) * 1000 + end.tv_nsec / 1000000 - start.tv_nsec / 1000000;
+    ece391_fdputs (1, ece391_itoa (FRAMES, buf, 10));
+    ece391_fdputs (1, (uint8_t*)" frames in ");
+    ece391_fdputs (1, ece391_itoa (ms, buf, 10));
+    ece391_fdputs (1, (uint8_t*)" ms, ");
+    ece391_fdputs (1, ece391_itoa (ms ? FRAMES * 1000 / ms : 0, buf, 10));
+    ece391_fdputs (1, (uint8_t*)" fps\n");
+    return 0;
+}
@@ -4,12 +4,79 @@
 #include "ece391syscall.h"
 
 #define BUFSIZE 1024
+#define MAX_STAGES 3
+
+/*
+ * Run "a | b | ..." with every stage spawned at once, each stage's stdout
+ * feeding the next stage's stdin through a pipe.  Returns the status of the
+ * last stage, or -1 if any stage could not be started.
+ */
+static int32_t run_pipeline (uint8_t* buf)
+{
+    uint8_t* stages[MAX_STAGES];
+    int32_t pids[MAX_STAGES];
+    int32_t fds[2];
+    int32_t n_stages = 1, i, end, in_fd = 0, out_fd, status, rval = 0;
+    uint8_t* p;
+
+    stages[0] = buf;
+    for (p = buf; '\0' != *p; p++) {
+	if ('|' == *p) {
+	    if (MAX_STAGES == n_stages)
+		return -1;
+	    *p = '\0';
+	    stages[n_stages++] = p + 1;
+	}
+    }
+
+    for (i = 0; i < n_stages; i++) {
+	/* trailing spaces would end up in the program's arguments */
+	end = ece391_strlen (stages[i]);
+	while (end > 0 && ' ' == stages[i][end - 1])
+	    stages[i][--end] = '\0';
+
+	out_fd = 1;
+	if (i < n_stages - 1) {
+	    if (-1 == ece391_pipe (fds)) {
+		if (0 != in_fd)
+		    ece391_close (in_fd);
+		n_stages = i;
+		rval = -1;
+		break;
+	    }
+	    out_fd = fds[1];
+	}
+	if (-1 == (pids[i] = ece391_spawn (stages[i], in_fd, out_fd)))
+	    rval = -1;
+	/* the children hold their own copies of the pipe ends */
+	if (0 != in_fd)
+	    ece391_close (in_fd);
+	if (1 != out_fd)
+	    ece391_close (out_fd);
+	in_fd = fds[0];
+    }
+
+    for (i = 0; i < n_stages; i++) {
+	if (-1 == pids[i])
+	    continue;
+	status = ece391_wait (pids[i]);
+	if (-1 != rval)
+	    rval = status;
+    }
+    return rval;
+}
+
+/* Ctrl+C is meant for the program in the foreground, the shell keeps running */
+static void interrupt_handler (int32_t signum)
+{
+}
 
 int main ()
 {
-    int32_t cnt, rval;
+    int32_t cnt, rval, i;
     uint8_t buf[BUFSIZE];
     ece391_fdputs (1, (uint8_t*)"Starting 391 Shell\n");
+    (void)ece391_set_handler (INTERRUPT, interrupt_handler);
 
     while (1) {
         ece391_fdputs (1, (uint8_t*)"391OS> ");
@@ -24,7 +91,11 @@ int main ()
 	    return 0;
 	if ('\0' == buf[0])
 	    continue;
-	rval = ece391_execute (buf);
+	for (i = 0; '\0' != buf[i] && '|' != buf[i]; i++);
+	if ('|' == buf[i])
+	    rval = run_pipeline (buf);
+	else
+	    rval = ece391_execute (buf);
 	if (-1 == rval)
 	    ece391_fdputs (1, (uint8_t*)"no such command\n");
 	else if (256 == rval)
@@ -0,0 +1,71 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Measures how throughput scales with processors: runs 1, 2, 4 and 8
+ * copies of a job side by side and prints how long each round took and
+ * its throughput relative to one copy. The job is the command given, such
+ * as "grep the", or a loop that stays in user mode without one. Commands
+ * that read the keyboard (counter) get its input one copy at a time.
+ */
+#define MAX_JOBS 8
+#define SPIN_ROUNDS 50000000
+
+static uint32_t elapsed_ms (ece391_timespec_t* start, ece391_timespec_t* end)
+{
+    return (end->tv_sec - start->tv_sec) * 1000 + end->tv_nsec / 1000000 - start->tv_nsec / 1000000;
+}
+
+int main ()
+{
+    uint8_t command[128];
+    uint8_t buf[16];
+    ece391_timespec_t start, end;
+    int32_t pids[MAX_JOBS];
+    uint32_t jobs, i, ms, one_ms = 0, speedup;
+    volatile uint32_t x = 1;
+
+    if (0 != ece391_getargs (command, 128) || command[0] == '\0')
+        ece391_strcpy (command, (uint8_t*)"smpbench spin");
+    if (0 == ece391_strcmp (command, (uint8_t*)"spin")) {
+        for (i = 0; i < SPIN_ROUNDS; i++)
+            x = x * 1103515245 + 12345;
+        return 0;
+    }
+
+    for (jobs = 1; jobs <= MAX_JOBS; jobs *= 2) {
+        ece391_clock_gettime (CLOCK_MONOTONIC, &start);
+        for (i = 0; i < jobs; i++) {
+            if (-1 == (pids[i] = ece391_spawn (command, 0, 1))) {
+                ece391_fdputs (1, (uint8_t*)"can't start the job\n");
+                while (i-- > 0)
+                    ece391_wait (pids[i]);
+                return 2;
+            }
+        }
+        for (i = 0; i < jobs; i++)
+            ece391_wait (pids[i]);
+        ece391_clock_gettime (CLOCK_MONOTONIC, &end);
+
+        ms = elapsed_ms (&start, &end);
+        if (ms == 0)
+            ms = 1;
+        if (jobs == 1)
+            one_ms = ms;
+        /* Jobs per second over one job's rate, in hundredths */
+        speedup = jobs * one_ms * 100 / ms;
+        ece391_fdputs (1, ece391_itoa (jobs, buf, 10));
+        ece391_fdputs (1, (uint8_t*)" jobs in ");
+        ece391_fdputs (1, ece391_itoa (ms, buf, 10));
+        ece391_fdputs (1, (uint8_t*)" ms, ");
+        ece391_fdputs (1, ece391_itoa (speedup / 100, buf, 10));
+        ece391_fdputs (1, (uint8_t*)".");
+        if (speedup % 100 < 10)
+            ece391_fdputs (1, (uint8_t*)"0");
+        ece391_fdputs (1, ece391_itoa (speedup % 100, buf, 10));
+        ece391_fdputs (1, (uint8_t*)"x the throughput of one\n");
+    }
+    return 0;
+}
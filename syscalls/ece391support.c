@@ -16,7 +16,7 @@ void ece391_strcpy(uint8_t* dst, const uint8_t* src)
     while ('\0' != (*dst++ = *src++));
 }
 
-void ece391_fdxputs(int32_t fd, const uint8_t* s)
+void ece391_fdputs(int32_t fd, const uint8_t* s)
 {
     (void)ece391_write (fd, s, ece391_strlen(s));
 }
@@ -102,3 +102,159 @@ uint8_t* ece391_strrev(uint8_t* s)
    return s;
 }
 
+/* Atomically replace *addr with newval if it holds oldval, return the old contents */
+static int32_t cmpxchg(volatile int32_t* addr, int32_t oldval, int32_t newval)
+{
+    int32_t prev;
+
+    asm volatile ("lock; cmpxchgl %2, %1"
+                  : "=a" (prev), "+m" (*addr)
+                  : "r" (newval), "0" (oldval)
+                  : "memory", "cc");
+    return prev;
+}
+
+/* Atomically store newval in *addr, return the old contents */
+static int32_t xchg(volatile int32_t* addr, int32_t newval)
+{
+    asm volatile ("xchgl %0, %1"
+                  : "+r" (newval), "+m" (*addr)
+                  :
+                  : "memory");
+    return newval;
+}
+
+/* Atomically add delta to *addr */
+static void atomic_add(volatile int32_t* addr, int32_t delta)
+{
+    asm volatile ("lock; addl %1, %0"
+                  : "+m" (*addr)
+                  : "r" (delta)
+                  : "memory", "cc");
+}
+
+void ece391_mutex_lock(ece391_mutex_t* m)
+{
+    int32_t c;
+
+    /* Fast path: unlocked -> locked without a syscall */
+    if ((c = cmpxchg(&m->state, 0, 1)) == 0)
+        return;
+
+    /* Mark the mutex contended and sleep until the holder hands it over */
+    if (c != 2)
+        c = xchg(&m->state, 2);
+    while (c != 0) {
+        (void)ece391_futex_wait((int32_t*)&m->state, 2);
+        c = xchg(&m->state, 2);
+    }
+}
+
+int32_t ece391_mutex_trylock(ece391_mutex_t* m)
+{
+    return cmpxchg(&m->state, 0, 1) == 0 ? 0 : -1;
+}
+
+void ece391_mutex_unlock(ece391_mutex_t* m)
+{
+    /* Only enter the kernel if someone may be sleeping */
+    if (xchg(&m->state, 0) == 2)
+        (void)ece391_futex_wake((int32_t*)&m->state, 1);
+}
+
+void ece391_cond_wait(ece391_cond_t* c, ece391_mutex_t* m)
+{
+    int32_t seq = c->seq;
+
+    ece391_mutex_unlock(m);
+    /* Returns at once if a signal came in after the unlock */
+    (void)ece391_futex_wait((int32_t*)&c->seq, seq);
+
+    /* Other waiters may have been woken too, so take the mutex as contended */
+    while (xchg(&m->state, 2) != 0)
+        (void)ece391_futex_wait((int32_t*)&m->state, 2);
+}
+
+void ece391_cond_signal(ece391_cond_t* c)
+{
+    atomic_add(&c->seq, 1);
+    (void)ece391_futex_wake((int32_t*)&c->seq, 1);
+}
+
+void ece391_cond_broadcast(ece391_cond_t* c)
+{
+    atomic_add(&c->seq, 1);
+    (void)ece391_futex_wake((int32_t*)&c->seq, 0x7FFFFFFF);
+}
+
+/*
+ * Every row is a single rep stosl / rep movsl, and a whole-width rectangle
+ * a single one for all its rows: sequential stores are what a
+ * write-combining framebuffer takes best.
+ */
+static void fill32(uint32_t* dst, uint32_t color, uint32_t count)
+{
+    asm volatile ("cld; rep stosl"
+                  : "+D"(dst), "+c"(count)
+                  : "a"(color)
+                  : "memory", "cc");
+}
+
+static void copy32(uint32_t* dst, const uint32_t* src, uint32_t count)
+{
+    asm volatile ("cld; rep movsl"
+                  : "+D"(dst), "+S"(src), "+c"(count)
+                  :
+                  : "memory", "cc");
+}
+
+/* Clip a w x h rectangle at x, y to the surface; 0 if nothing is left */
+static int32_t clip(const ece391_surface_t* s, int32_t* x, int32_t* y, int32_t* w, int32_t* h,
+                    int32_t* skip_x, int32_t* skip_y)
+{
+    *skip_x = *x < 0 ? -*x : 0;
+    *skip_y = *y < 0 ? -*y : 0;
+    *x += *skip_x;
+    *y += *skip_y;
+    *w -= *skip_x;
+    *h -= *skip_y;
+    if (*x + *w > s->width)
+        *w = s->width - *x;
+    if (*y + *h > s->height)
+        *h = s->height - *y;
+    return *w > 0 && *h > 0;
+}
+
+void ece391_fill_rect(ece391_surface_t* dst, int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color)
+{
+    int32_t skip_x, skip_y, row;
+    uint32_t* p;
+
+    if (!clip(dst, &x, &y, &w, &h, &skip_x, &skip_y))
+        return;
+    p = dst->pixels + y * dst->width + x;
+    if (w == dst->width) {
+        fill32(p, color, w * h);
+        return;
+    }
+    for (row = 0; row < h; row++, p += dst->width)
+        fill32(p, color, w);
+}
+
+void ece391_blit(ece391_surface_t* dst, int32_t x, int32_t y, const ece391_surface_t* src)
+{
+    int32_t skip_x, skip_y, w = src->width, h = src->height, row;
+    uint32_t* p;
+    const uint32_t* q;
+
+    if (!clip(dst, &x, &y, &w, &h, &skip_x, &skip_y))
+        return;
+    p = dst->pixels + y * dst->width + x;
+    q = src->pixels + skip_y * src->width + skip_x;
+    if (w == dst->width && w == src->width) {
+        copy32(p, q, w * h);
+        return;
+    }
+    for (row = 0; row < h; row++, p += dst->width, q += src->width)
+        copy32(p, q, w);
+}
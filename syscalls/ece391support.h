@@ -9,5 +9,40 @@ extern int32_t ece391_strncmp(const uint8_t* s1, const uint8_t* s2, uint32_t n);
 extern uint8_t *ece391_itoa(uint32_t value, uint8_t* buf, int32_t radix);
 extern uint8_t *ece391_strrev(uint8_t* s);
 
+/*
+ * Mutex and condition variable built on futex_wait/futex_wake. Both only
+ * enter the kernel when a thread actually has to sleep or wake someone.
+ * Initialize them to zero. To use them across programs, place them in a
+ * shared memory segment.
+ */
+typedef struct ece391_mutex {
+    volatile int32_t state;     /* 0 unlocked, 1 locked, 2 locked with sleepers */
+} ece391_mutex_t;
+
+typedef struct ece391_cond {
+    volatile int32_t seq;       /* bumped by every signal/broadcast */
+} ece391_cond_t;
+
+extern void ece391_mutex_lock(ece391_mutex_t* m);
+extern int32_t ece391_mutex_trylock(ece391_mutex_t* m);
+extern void ece391_mutex_unlock(ece391_mutex_t* m);
+extern void ece391_cond_wait(ece391_cond_t* c, ece391_mutex_t* m);
+extern void ece391_cond_signal(ece391_cond_t* c);
+extern void ece391_cond_broadcast(ece391_cond_t* c);
+
+/*
+ * Drawing with 32 bit pixels, e.g. into the framebuffer vidmap returns
+ * after ece391_setmode (pixels = the framebuffer, width and height = the
+ * mode's). Rows are width pixels apart. Both clip to dst.
+ */
+typedef struct ece391_surface {
+    uint32_t* pixels;
+    int32_t width;
+    int32_t height;
+} ece391_surface_t;
+
+extern void ece391_fill_rect(ece391_surface_t* dst, int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color);
+extern void ece391_blit(ece391_surface_t* dst, int32_t x, int32_t y, const ece391_surface_t* src);
+
 #endif /* ECE391SUPPORT_H */
 
@@ -22,6 +22,115 @@ extern int32_t ece391_vidmap (uint8_t** screen_start);
 extern int32_t ece391_set_handler (int32_t signum, void* handler);
 extern int32_t ece391_sigreturn (void);
 
+/*
+ * pipe fills fds[0] with the read end and fds[1] with the write end.
+ * spawn starts a program that runs alongside the caller, with in_fd and
+ * out_fd of the caller as its stdin and stdout, and returns its pid.
+ * wait blocks until that pid halts and returns its status.
+ */
+extern int32_t ece391_pipe (int32_t fds[2]);
+extern int32_t ece391_spawn (const uint8_t* command, int32_t in_fd, int32_t out_fd);
+extern int32_t ece391_wait (int32_t pid);
+
+/*
+ * shm_create makes a named segment of up to 64 kB of zeroed memory and maps
+ * it, shm_map maps an existing one. Both store the segment's address, which
+ * is the same in every program, in *addr. A segment is freed once every
+ * program using it has called shm_unmap or halted.
+ */
+extern int32_t ece391_shm_create (const uint8_t* name, int32_t size, uint8_t** addr);
+extern int32_t ece391_shm_map (const uint8_t* name, uint8_t** addr);
+extern int32_t ece391_shm_unmap (const uint8_t* name);
+
+/*
+ * futex_wait sleeps until woken if *addr still equals expected, and returns
+ * -1 right away if it does not. futex_wake wakes up to count programs
+ * sleeping on addr and returns how many it woke.
+ */
+extern int32_t ece391_futex_wait (int32_t* addr, int32_t expected);
+extern int32_t ece391_futex_wake (int32_t* addr, int32_t count);
+
+/*
+ * A handler runs the next time the program returns from the kernel, with
+ * all signals blocked until the handler returns. Without a handler,
+ * DIV_ZERO, SEGFAULT and INTERRUPT (Ctrl+C) halt the program with status
+ * 256, and ALARM (every 10 seconds) and USER1 are ignored. kill sends a
+ * signal to the program with the given pid.
+ */
+extern int32_t ece391_kill (int32_t pid, int32_t signum);
+
+/* sleep blocks for at least ms milliseconds (10 ms resolution). */
+extern int32_t ece391_sleep (uint32_t ms);
+
+/* clock_gettime reads CLOCK_MONOTONIC, the time since boot, in ns resolution. */
+#define CLOCK_MONOTONIC 0
+typedef struct ece391_timespec {
+    uint32_t tv_sec;
+    uint32_t tv_nsec;
+} ece391_timespec_t;
+extern int32_t ece391_clock_gettime (int32_t clock_id, ece391_timespec_t* ts);
+
+/*
+ * profile controls the kernel's sampling profiler. PROFILE_START clears the
+ * samples and takes arg samples per second (at most 100) on each processor,
+ * PROFILE_STOP stops, and PROFILE_READ moves up to arg of the oldest
+ * samples into buf and returns how many it moved.
+ */
+#define PROFILE_START 0
+#define PROFILE_STOP 1
+#define PROFILE_READ 2
+#define PROFILE_MAX_DEPTH 8
+typedef struct ece391_profile_sample {
+    uint32_t eip;
+    uint8_t cpl;
+    uint8_t cpu;
+    int8_t pid;
+    uint8_t depth;
+    uint32_t callers[PROFILE_MAX_DEPTH];
+} ece391_profile_sample_t;
+extern int32_t ece391_profile (int32_t cmd, uint32_t arg, ece391_profile_sample_t* buf);
+
+/*
+ * ioctl controls the device behind fd. On the terminal (fds 0 and 1),
+ * TERM_GETMODE and TERM_SETMODE read and change its input mode. Without
+ * TERM_MODE_CANON, read returns keys as they are typed instead of whole
+ * lines: arrows come as ESC [ A..D and Ctrl+letter as its control code. It
+ * waits for min bytes, giving up time_ms after the first one; with min 0 it
+ * waits time_ms for any byte, and with both 0 it returns right away. Setting
+ * the mode throws away unread input, and the terminal goes back to
+ * TERM_MODE_CANON | TERM_MODE_ECHO when the program halts.
+ */
+#define TERM_GETMODE 0
+#define TERM_SETMODE 1
+#define TERM_MODE_CANON 0x1
+#define TERM_MODE_ECHO 0x2
+typedef struct ece391_term_mode {
+    uint32_t flags;
+    uint32_t min;
+    uint32_t time_ms;
+} ece391_term_mode_t;
+extern int32_t ece391_ioctl (int32_t fd, uint32_t request, void* arg);
+
+/*
+ * setmode puts the program's terminal in a width x height graphics mode
+ * with 32 bit pixels, 0x00RRGGBB, or back in text mode with 0 x 0. Width
+ * is a multiple of 8 from 64 to 1024, height at most 768. One program has
+ * graphics at a time, and its terminal goes back to text when it halts.
+ * After setmode, vidmap returns the framebuffer, height rows of width
+ * pixels, which the screen shows while the terminal is displayed.
+ */
+extern int32_t ece391_setmode (uint32_t width, uint32_t height);
+
+/*
+ * vidmap_buffered maps a back buffer of the text screen where vidmap maps
+ * the screen, starting out as a copy of it. Nothing drawn there shows until
+ * present, which copies the rows that changed since the last present to the
+ * screen and returns how many. Given an open rtc fd, present first waits
+ * for its next tick, pass -1 to copy right away. Text mode only.
+ */
+extern int32_t ece391_vidmap_buffered (uint8_t** screen_start);
+extern int32_t ece391_present (int32_t rtc_fd);
+
 enum signums {
 	DIV_ZERO = 0,
 	SEGFAULT,
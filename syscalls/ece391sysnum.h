@@ -11,5 +11,21 @@
 #define SYS_VIDMAP  8
 #define SYS_SET_HANDLER  9
 #define SYS_SIGRETURN  10
+#define SYS_PIPE    11
+#define SYS_SPAWN   12
+#define SYS_WAIT    13
+#define SYS_SHM_CREATE 14
+#define SYS_SHM_MAP 15
+#define SYS_SHM_UNMAP 16
+#define SYS_FUTEX_WAIT 17
+#define SYS_FUTEX_WAKE 18
+#define SYS_KILL    19
+#define SYS_SLEEP   20
+#define SYS_CLOCK_GETTIME 21
+#define SYS_PROFILE 22
+#define SYS_IOCTL   23
+#define SYS_SETMODE 24
+#define SYS_VIDMAP_BUFFERED 25
+#define SYS_PRESENT 26
 
 #endif /* ECE391SYSNUM_H */